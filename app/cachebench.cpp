@@ -0,0 +1,217 @@
+// Benchmark of the peer cache under concurrent connect/close churn.
+//
+// Every connection looks its peer up in the cache when it connects, and updates it when it closes. The first part
+// runs that churn through the API against a local listener, the second part runs the same lookup and update pairs
+// on the cache alone, with few and with many more hosts than the cache holds, so that evictions are measured too.
+//
+// The cache is internal to the library, so this program is linked with the static library.
+//
+// usage: cachebench [connections per thread], defaults to 200
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "udt.h"
+#include "cache.h"
+#include "common.h"
+
+using namespace std;
+
+
+const int g_Server_Port = 9100;
+const int g_CacheSize = 1024;
+
+int g_iConnections = 200;
+
+// results of a client thread
+struct CChurn
+{
+   int m_iFailures;		// number of connections that could not be set up
+   uint64_t m_ullTime;		// time spent on the connections that were set up, microseconds
+};
+int g_iHosts = 0;
+int g_iOps = 0;
+CCache<CInfoBlock>* g_pCache = NULL;
+
+
+void* accept_and_close(void* param)
+{
+   UDTSOCKET serv = *(UDTSOCKET*)param;
+
+   UDTSOCKET u;
+   while (UDT::INVALID_SOCK != (u = UDT::accept(serv, NULL, NULL)))
+      UDT::close(u);
+
+   return NULL;
+}
+
+void* connect_and_close(void* param)
+{
+   CChurn* res = (CChurn*)param;
+   res->m_iFailures = 0;
+   res->m_ullTime = 0;
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(sockaddr_in));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(g_Server_Port);
+   inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+   for (int i = 0; i < g_iConnections; ++ i)
+   {
+      // the setup may time out when many connections are made at once, such a connection is counted apart
+      uint64_t t = CTimer::getTime();
+      UDTSOCKET u = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      bool failed = (UDT::ERROR == UDT::connect(u, (sockaddr*)&addr, sizeof(sockaddr_in)));
+      UDT::close(u);
+
+      if (failed)
+         ++ res->m_iFailures;
+      else
+         res->m_ullTime += CTimer::getTime() - t;
+   }
+
+   return NULL;
+}
+
+// the given number of threads connect and close at the same time
+void benchChurn(int threads)
+{
+   vector<pthread_t> cli(threads);
+   vector<CChurn> res(threads);
+
+   uint64_t t = CTimer::getTime();
+
+   for (int i = 0; i < threads; ++ i)
+      pthread_create(&cli[i], NULL, connect_and_close, &res[i]);
+   for (int i = 0; i < threads; ++ i)
+      pthread_join(cli[i], NULL);
+
+   t = CTimer::getTime() - t;
+
+   int failures = 0;
+   uint64_t busy = 0;
+   for (int i = 0; i < threads; ++ i)
+   {
+      failures += res[i].m_iFailures;
+      busy += res[i].m_ullTime;
+   }
+   int done = threads * g_iConnections - failures;
+
+   cout << "connect/close churn, " << threads << " threads: " << done * 1000000.0 / t << " connections/s";
+   if (done > 0)
+      cout << ", " << busy / done << " us per connection";
+   cout << ", " << failures << " timed out" << endl;
+}
+
+// one lookup, as in connect(), and one update, as in close(), for hosts picked at random
+void* lookup_and_update(void* param)
+{
+   unsigned int seed = *(unsigned int*)param;
+
+   for (int i = 0; i < g_iOps; ++ i)
+   {
+      CInfoBlock ib;
+      ib.m_iIPversion = AF_INET;
+      ib.m_piIP[0] = htonl(0x0A000000 + rand_r(&seed) % g_iHosts);
+      ib.m_piIP[1] = ib.m_piIP[2] = ib.m_piIP[3] = 0;
+      if (g_pCache->lookup(&ib) < 0)
+      {
+         ib.m_ullTimeStamp = 0;
+         ib.m_iLossRate = 0;
+         ib.m_iReorderDistance = 0;
+         ib.m_dInterval = 0;
+         ib.m_dCWnd = 0;
+         ib.m_bOpen = false;
+      }
+      ib.m_iRTT = 10000;
+      ib.m_iBandwidth = 1000;
+      g_pCache->update(&ib);
+   }
+
+   return NULL;
+}
+
+// nanoseconds per lookup and update pair
+double benchCache(int threads, int hosts)
+{
+   g_pCache = new CCache<CInfoBlock>(g_CacheSize);
+   g_iHosts = hosts;
+   g_iOps = 1000000;
+
+   vector<pthread_t> th(threads);
+   vector<unsigned int> seed(threads);
+
+   uint64_t t = CTimer::getTime();
+
+   for (int i = 0; i < threads; ++ i)
+   {
+      seed[i] = i + 1;
+      pthread_create(&th[i], NULL, lookup_and_update, &seed[i]);
+   }
+   for (int i = 0; i < threads; ++ i)
+      pthread_join(th[i], NULL);
+
+   t = CTimer::getTime() - t;
+
+   delete g_pCache;
+
+   return t * 1000.0 / (double(threads) * g_iOps);
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc > 1)
+      g_iConnections = atoi(argv[1]);
+   if (g_iConnections <= 0)
+   {
+      cout << "usage: cachebench [connections per thread]" << endl;
+      return -1;
+   }
+
+   const int threads[3] = {1, 4, 8};
+
+   UDT::startup();
+
+   // a closed listener keeps its port until it is removed, so one serves all the runs
+   UDTSOCKET serv = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(sockaddr_in));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(g_Server_Port);
+   if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&addr, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, 1024)))
+   {
+      cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+      return -1;
+   }
+
+   pthread_t srv;
+   pthread_create(&srv, NULL, accept_and_close, &serv);
+
+   for (int k = 0; k < 3; ++ k)
+      benchChurn(threads[k]);
+
+   UDT::close(serv);
+   pthread_join(srv, NULL);
+
+   UDT::cleanup();
+
+   // the best of 3 runs, as other threads of the system get in the way
+   const int hosts[2] = {200, 100000};
+   for (int h = 0; h < 2; ++ h)
+   {
+      for (int k = 0; k < 3; ++ k)
+      {
+         double ns = 1e9;
+         for (int i = 0; i < 3; ++ i)
+            ns = min(ns, benchCache(threads[k], hosts[h]));
+         cout << "cache of " << g_CacheSize << ", " << hosts[h] << " hosts, " << threads[k] << " threads: " << ns << " ns per lookup and update" << endl;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,334 @@
+// Comparison of CCUBICCC and CUDTCC through a bottleneck emulated in the process.
+//
+// A relay thread forwards the packets of each flow from the client to the server through one shared drop-tail queue,
+// drained at the rate of the bottleneck, and adds a fixed delay both ways. Each flow sends as fast as its congestion
+// control allows for the given time; the goodput is taken at the receiver, after the first second. The flows run
+// alone first, then two at a time over the same bottleneck, as CUBIC would share a link with TCP bulk traffic. Each
+// flow reaches the relay at an address of its own, so that the peer cache does not carry one flow over to the next.
+//
+// usage: ccbench [Mbps] [one-way delay, ms] [queue, KB] [seconds], defaults to 50 20 250 10
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "udt.h"
+#include "ccc.h"
+
+using namespace std;
+
+
+// a closed listener keeps its port until it is removed, so each flow gets ports of its own
+const int g_Server_Port = 9300;		// the servers listen from this port up
+const int g_Relay_Port = 9500;		// the relay faces the clients from this port up
+int g_iPorts = 0;			// number of ports of each range given out
+
+double g_dRate = 50;			// bottleneck, Mbps
+int g_iDelay = 20;			// one-way delay, ms
+int g_iQueue = 250;			// queue, KB
+int g_iTime = 10;			// seconds each test runs
+
+volatile bool g_bStop = false;
+
+
+struct CFlow
+{
+   bool m_bCubic;		// CCUBICCC, otherwise CUDTCC
+   int m_iPort;			// offset of the ports of the flow in both ranges
+
+   UDTSOCKET m_Client;
+   UDTSOCKET m_Server;
+   int64_t m_llStart;		// time the goodput is counted from
+   int64_t m_llBytes;		// bytes received since then
+
+   // counted by the relay
+   int64_t m_llQueueDelay;	// total time the packets of the flow waited in the queue, microseconds
+   int m_iQueued;		// number of packets queued
+   int m_iDrops;		// number of packets dropped at the tail of the queue
+};
+
+struct CRelayPacket
+{
+   int64_t m_llTime;		// time to send it
+   int m_iFlow;
+   string m_strData;
+};
+
+
+int64_t now()
+{
+   timeval t;
+   gettimeofday(&t, 0);
+   return t.tv_sec * 1000000LL + t.tv_usec;
+}
+
+// 127.0.0.1 by default, the relay address of a flow is taken further up in 127.0.0.0/8
+sockaddr_in local(int port, int host = 1)
+{
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(sockaddr_in));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port);
+   addr.sin_addr.s_addr = htonl(0x7F000000 + host);
+   return addr;
+}
+
+int relay_host(const CFlow& f)
+{
+   return 0x101 + f.m_iPort;
+}
+
+int udp_socket(int port, int host = 1)
+{
+   int s = socket(AF_INET, SOCK_DGRAM, 0);
+   int size = 8 << 20;
+   setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(int));
+   setsockopt(s, SOL_SOCKET, SO_SNDBUF, &size, sizeof(int));
+   sockaddr_in addr = local(port, host);
+   bind(s, (sockaddr*)&addr, sizeof(sockaddr_in));
+   return s;
+}
+
+// the relay faces the client with one socket per flow and the server with another
+void* relay(void* param)
+{
+   vector<CFlow>& flows = *(vector<CFlow>*)param;
+   int n = flows.size();
+
+   vector<pollfd> fds(2 * n);
+   vector<sockaddr_in> client(n);
+   vector<bool> known(n, false);
+   for (int i = 0; i < n; ++ i)
+   {
+      fds[i].fd = udp_socket(g_Relay_Port + flows[i].m_iPort, relay_host(flows[i]));
+      fds[n + i].fd = udp_socket(0);
+      fds[i].events = fds[n + i].events = POLLIN;
+   }
+
+   // bytes per microsecond out of the bottleneck
+   double rate = g_dRate / 8;
+   int64_t capacity = g_iQueue * 1024LL;
+   int64_t delay = g_iDelay * 1000LL;
+
+   deque<CRelayPacket> forward;
+   deque<CRelayPacket> backward;
+   int64_t busy = 0;		// time the queue drains
+   char buf[65536];
+
+   while (!g_bStop)
+   {
+      int64_t next = now() + 100000;
+      if (!forward.empty() && (forward.front().m_llTime < next))
+         next = forward.front().m_llTime;
+      if (!backward.empty() && (backward.front().m_llTime < next))
+         next = backward.front().m_llTime;
+      int64_t wait = next - now();
+      ::poll(&fds[0], 2 * n, (wait > 0) ? int((wait + 999) / 1000) : 0);
+
+      int64_t t = now();
+      for (int i = 0; i < n; ++ i)
+      {
+         if (fds[i].revents & POLLIN)
+         {
+            socklen_t len = sizeof(sockaddr_in);
+            int size = recvfrom(fds[i].fd, buf, sizeof(buf), 0, (sockaddr*)&client[i], &len);
+            known[i] = true;
+
+            if (busy < t)
+               busy = t;
+            if ((busy - t) * rate + size > capacity)
+            {
+               ++ flows[i].m_iDrops;
+               continue;
+            }
+
+            flows[i].m_llQueueDelay += busy - t;
+            ++ flows[i].m_iQueued;
+            busy += int64_t(size / rate);
+
+            CRelayPacket p = {busy + delay, i, string(buf, size)};
+            forward.push_back(p);
+         }
+
+         // the way back has no bottleneck
+         if (fds[n + i].revents & POLLIN)
+         {
+            int size = recv(fds[n + i].fd, buf, sizeof(buf), 0);
+            if (known[i] && (size > 0))
+            {
+               CRelayPacket p = {t + delay, i, string(buf, size)};
+               backward.push_back(p);
+            }
+         }
+      }
+
+      t = now();
+      while (!forward.empty() && (forward.front().m_llTime <= t))
+      {
+         CRelayPacket& p = forward.front();
+         sockaddr_in addr = local(g_Server_Port + flows[p.m_iFlow].m_iPort);
+         sendto(fds[n + p.m_iFlow].fd, p.m_strData.data(), p.m_strData.size(), 0, (sockaddr*)&addr, sizeof(sockaddr_in));
+         forward.pop_front();
+      }
+      while (!backward.empty() && (backward.front().m_llTime <= t))
+      {
+         CRelayPacket& p = backward.front();
+         sendto(fds[p.m_iFlow].fd, p.m_strData.data(), p.m_strData.size(), 0, (sockaddr*)&client[p.m_iFlow], sizeof(sockaddr_in));
+         backward.pop_front();
+      }
+   }
+
+   for (int i = 0; i < 2 * n; ++ i)
+      close(fds[i].fd);
+
+   return NULL;
+}
+
+void* receive_flow(void* param)
+{
+   CFlow* f = (CFlow*)param;
+
+   char* buf = new char[1 << 20];
+   int size;
+   while ((size = UDT::recv(f->m_Server, buf, 1 << 20, 0)) > 0)
+   {
+      if (now() >= f->m_llStart)
+         f->m_llBytes += size;
+   }
+   delete [] buf;
+
+   return NULL;
+}
+
+void* send_flow(void* param)
+{
+   CFlow* f = (CFlow*)param;
+
+   char* buf = new char[1 << 20];
+   memset(buf, 0, 1 << 20);
+   while (!g_bStop && (UDT::send(f->m_Client, buf, 1 << 20, 0) > 0)) {}
+   delete [] buf;
+
+   return NULL;
+}
+
+// runs the flows together through the bottleneck
+void run(vector<CFlow>& flows)
+{
+   int n = flows.size();
+   g_bStop = false;
+
+   vector<UDTSOCKET> serv(n);
+   for (int i = 0; i < n; ++ i)
+   {
+      CFlow& f = flows[i];
+      f.m_iPort = g_iPorts ++;
+      f.m_llBytes = f.m_llQueueDelay = 0;
+      f.m_iQueued = f.m_iDrops = 0;
+
+      serv[i] = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in addr = local(g_Server_Port + f.m_iPort);
+      UDT::bind(serv[i], (sockaddr*)&addr, sizeof(sockaddr_in));
+      UDT::listen(serv[i], 1);
+   }
+
+   pthread_t relay_thread;
+   pthread_create(&relay_thread, NULL, relay, &flows);
+
+   for (int i = 0; i < n; ++ i)
+   {
+      CFlow& f = flows[i];
+      f.m_Client = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      CCCFactory<CCUBICCC> cubic;
+      if (f.m_bCubic)
+         UDT::setsockopt(f.m_Client, 0, UDT_CC, &cubic, sizeof(CCCFactory<CCUBICCC>));
+      linger l = {0, 0};
+      UDT::setsockopt(f.m_Client, 0, UDT_LINGER, &l, sizeof(linger));
+
+      sockaddr_in addr = local(g_Relay_Port + f.m_iPort, relay_host(f));
+      if (UDT::ERROR == UDT::connect(f.m_Client, (sockaddr*)&addr, sizeof(sockaddr_in)))
+         cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+      f.m_Server = UDT::accept(serv[i], NULL, NULL);
+   }
+
+   int64_t start = now() + 1000000;
+   vector<pthread_t> threads(2 * n);
+   for (int i = 0; i < n; ++ i)
+   {
+      flows[i].m_llStart = start;
+      pthread_create(&threads[i], NULL, receive_flow, &flows[i]);
+      pthread_create(&threads[n + i], NULL, send_flow, &flows[i]);
+   }
+
+   sleep(g_iTime);
+   int64_t end = now();
+   g_bStop = true;
+
+   for (int i = 0; i < n; ++ i)
+   {
+      CFlow& f = flows[i];
+
+      UDT::TRACEINFO perf;
+      UDT::perfmon(f.m_Client, &perf);
+
+      cout << "   " << (f.m_bCubic ? "CUBIC" : "UDTCC") << ": " << f.m_llBytes * 8.0 / (end - start) << " Mbps";
+      cout << ", " << perf.pktRetransTotal * 100.0 / max(perf.pktSentTotal, int64_t(1)) << "% retransmitted";
+      cout << ", queue delay " << f.m_llQueueDelay / max(f.m_iQueued, 1) / 1000.0 << " ms";
+      cout << ", " << f.m_iDrops << " drops" << endl;
+
+      UDT::close(f.m_Client);
+      UDT::close(f.m_Server);
+      UDT::close(serv[i]);
+   }
+
+   for (int i = 0; i < 2 * n; ++ i)
+      pthread_join(threads[i], NULL);
+   pthread_join(relay_thread, NULL);
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc > 1)
+      g_dRate = atof(argv[1]);
+   if (argc > 2)
+      g_iDelay = atoi(argv[2]);
+   if (argc > 3)
+      g_iQueue = atoi(argv[3]);
+   if (argc > 4)
+      g_iTime = atoi(argv[4]);
+   if ((g_dRate <= 0) || (g_iDelay < 0) || (g_iQueue <= 0) || (g_iTime < 2))
+   {
+      cout << "usage: ccbench [Mbps] [one-way delay, ms] [queue, KB] [seconds, at least 2]" << endl;
+      return -1;
+   }
+
+   cout << g_dRate << " Mbps, " << 2 * g_iDelay << " ms RTT, " << g_iQueue << " KB queue, " << g_iTime << " s" << endl;
+
+   UDT::startup();
+
+   // CUBIC alone, UDTCC alone, then both, and each against itself
+   const bool cubic[5][2] = {{true, true}, {false, false}, {true, false}, {true, true}, {false, false}};
+   const int num[5] = {1, 1, 2, 2, 2};
+   for (int k = 0; k < 5; ++ k)
+   {
+      vector<CFlow> flows(num[k]);
+      for (int i = 0; i < num[k]; ++ i)
+         flows[i].m_bCubic = cubic[k][i];
+
+      cout << ((1 == num[k]) ? "alone:" : "shared:") << endl;
+      run(flows);
+   }
+
+   UDT::cleanup();
+
+   return 0;
+}
@@ -0,0 +1,193 @@
+// Benchmark of the sender and receiver loss lists, with 1%, 10% and burst loss patterns.
+//
+// The lists are internal to the library, so this program is linked with the static library. It only uses the
+// interface of CSndLossList and CRcvLossList, and can be built against an older list.cpp for a comparison.
+//
+// usage: lossbench [window], the window defaults to 262144 packets
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "list.h"
+
+using namespace std;
+
+
+// loss runs of one flight: runs[i] > 0 is a run of lost packets starting at packet i
+vector<int> pattern(int percent, bool burst, int num)
+{
+   vector<int> runs(num, 0);
+   srand(7);
+
+   for (int i = 0; i < num; )
+   {
+      int lost;
+      if (burst)
+         lost = (rand() % 1000 < percent) ? 50 + rand() % 50 : 0;
+      else
+         lost = (rand() % 100 < percent) ? 1 : 0;
+
+      if (0 == lost)
+      {
+         ++ i;
+         continue;
+      }
+
+      if (i + lost > num)
+         lost = num - i;
+      runs[i] = lost;
+      i += lost;
+   }
+
+   return runs;
+}
+
+int32_t seqno(int64_t n)
+{
+   return int32_t(n & CSeqNo::m_iMaxSeqNo);
+}
+
+// the receiver detects the losses of a flight, reports them every 1024 packets, then every packet arrives
+double benchReceiver(const vector<int>& runs, int window, int rounds)
+{
+   CRcvLossList list(window);
+   int32_t array[400];
+   int len;
+   int64_t seq = 0;
+   int num = runs.size();
+
+   uint64_t t = CTimer::getTime();
+
+   for (int r = 0; r < rounds; ++ r)
+   {
+      int64_t start = seq;
+
+      for (int i = 0; i < num; )
+      {
+         if (runs[i] > 0)
+         {
+            list.insert(seqno(seq), seqno(seq + runs[i] - 1));
+            seq += runs[i];
+            i += runs[i];
+         }
+         else
+         {
+            ++ seq;
+            ++ i;
+         }
+
+         if (0 == (i & 1023))
+            list.getLossArray(array, len, 350);
+      }
+
+      for (int64_t k = start; k < seq; ++ k)
+         list.remove(seqno(k));
+   }
+
+   return (CTimer::getTime() - t) / 1000000.0;
+}
+
+// the sender gets the losses of a flight, retransmits them one by one, then the flight is acknowledged
+double benchSender(const vector<int>& runs, int window, int rounds)
+{
+   CSndLossList list(window * 2);
+   int64_t seq = 0;
+   int num = runs.size();
+
+   uint64_t t = CTimer::getTime();
+
+   for (int r = 0; r < rounds; ++ r)
+   {
+      for (int i = 0; i < num; )
+      {
+         if (runs[i] > 0)
+         {
+            list.insert(seqno(seq), seqno(seq + runs[i] - 1));
+            seq += runs[i];
+            i += runs[i];
+         }
+         else
+         {
+            ++ seq;
+            ++ i;
+         }
+      }
+
+      while (list.getLostSeq() >= 0) {}
+
+      list.remove(seqno(seq - 1));
+   }
+
+   return (CTimer::getTime() - t) / 1000000.0;
+}
+
+// half a window is lost at once and recovered in random order, with a report every 256 packets
+double benchRecovery(int window, int rounds)
+{
+   CRcvLossList list(window);
+   int32_t array[400];
+   int len;
+   int num = window / 2;
+
+   vector<int> order(num);
+   for (int i = 0; i < num; ++ i)
+      order[i] = i;
+   srand(9);
+   for (int i = num - 1; i > 0; -- i)
+      swap(order[i], order[rand() % (i + 1)]);
+
+   uint64_t t = CTimer::getTime();
+
+   for (int r = 0; r < rounds; ++ r)
+   {
+      list.insert(0, num - 1);
+      for (int i = 0; i < num; ++ i)
+      {
+         list.remove(order[i]);
+         if (0 == (i & 255))
+            list.getLossArray(array, len, 350);
+      }
+   }
+
+   return (CTimer::getTime() - t) / 1000000.0;
+}
+
+int main(int argc, char* argv[])
+{
+   int window = (argc > 1) ? atoi(argv[1]) : 262144;
+   if (window < 1024)
+   {
+      cout << "usage: lossbench [window], at least 1024 packets" << endl;
+      return -1;
+   }
+
+   const char* name[3] = {"1% loss", "10% loss", "burst loss"};
+   int percent[3] = {1, 10, 5};
+   bool burst[3] = {false, false, true};
+
+   cout << "window " << window << " packets, 200 flights of " << window / 2 << " packets" << endl;
+
+   // the best of 5 runs, as other threads of the system get in the way
+   for (int k = 0; k < 3; ++ k)
+   {
+      vector<int> runs = pattern(percent[k], burst[k], window / 2);
+      double rcv = 1e9;
+      double snd = 1e9;
+      for (int i = 0; i < 5; ++ i)
+      {
+         rcv = min(rcv, benchReceiver(runs, window, 200));
+         snd = min(snd, benchSender(runs, window, 200));
+      }
+      cout << name[k] << ": receiver " << rcv << "s, sender " << snd << "s" << endl;
+   }
+
+   double rec = 1e9;
+   for (int i = 0; i < 5; ++ i)
+      rec = min(rec, benchRecovery(window, 5));
+   cout << "burst of " << window / 2 << " losses recovered in random order, 5 times: " << rec << "s" << endl;
+
+   return 0;
+}
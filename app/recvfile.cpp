@@ -1,29 +1,134 @@
 #ifndef WIN32
    #include <arpa/inet.h>
    #include <netdb.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/time.h>
 #else
    #include <winsock2.h>
    #include <ws2tcpip.h>
 #endif
 #include <fstream>
 #include <iostream>
+#include <vector>
 #include <cstdlib>
 #include <cstring>
 #include <udt.h>
 
 using namespace std;
 
-int main(int argc, char* argv[])
+// The file is split into one contiguous range per connection. Each connection requests its own range
+// from the server chunk by chunk; a connection that has finished its range steals the second half of
+// the largest range left, so that all connections stay busy until the end of the file.
+
+struct Range
+{
+   int64_t m_llNext;            // next offset to request
+   int64_t m_llEnd;             // end of the range (exclusive)
+};
+
+struct Stripe
+{
+   UDTSOCKET m_Socket;          // connection of this stripe
+   int m_iID;                   // index of the stripe
+   int64_t m_llRecvd;           // data received by this stripe
+   int m_iSteals;               // number of ranges stolen from other stripes
+   bool m_bFailed;              // the stripe stopped on error
+};
+
+const int64_t g_llChunk = 8 * 1024 * 1024;      // size of data requested at a time
+const char* g_pcFile;                           // local file name
+vector<Range> g_Ranges;
+int64_t g_llRecvd = 0;                          // data received by all stripes
+int g_iDone = 0;                                // number of stripes finished
+double g_dFinish = 0;                           // time when the last stripe finished
+
+#ifndef WIN32
+   pthread_mutex_t g_Lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+   CRITICAL_SECTION g_Lock;
+#endif
+
+#ifndef WIN32
+void* recvfile(void*);
+#else
+DWORD WINAPI recvfile(LPVOID);
+#endif
+
+static void lock()
+{
+   #ifndef WIN32
+      pthread_mutex_lock(&g_Lock);
+   #else
+      EnterCriticalSection(&g_Lock);
+   #endif
+}
+
+static void unlock()
+{
+   #ifndef WIN32
+      pthread_mutex_unlock(&g_Lock);
+   #else
+      LeaveCriticalSection(&g_Lock);
+   #endif
+}
+
+static double now()
+{
+   #ifndef WIN32
+      timeval t;
+      gettimeofday(&t, 0);
+      return t.tv_sec + t.tv_usec / 1000000.0;
+   #else
+      return GetTickCount() / 1000.0;
+   #endif
+}
+
+// pick the next chunk for stripe "id", stealing from another stripe when its own range is done
+static bool nextChunk(Stripe* s, int64_t& offset, int64_t& len)
 {
-   if ((argc != 5) || (0 == atoi(argv[2])))
+   lock();
+
+   Range* r = &g_Ranges[s->m_iID];
+   if (r->m_llNext >= r->m_llEnd)
    {
-      cout << "usage: recvfile server_ip server_port remote_filename local_filename" << endl;
-      return -1;
+      int victim = -1;
+      int64_t left = 0;
+      for (int i = 0; i < (int)g_Ranges.size(); ++ i)
+      {
+         if (g_Ranges[i].m_llEnd - g_Ranges[i].m_llNext > left)
+         {
+            victim = i;
+            left = g_Ranges[i].m_llEnd - g_Ranges[i].m_llNext;
+         }
+      }
+
+      // not worth splitting if the owner will finish it with its next request
+      if ((victim < 0) || (left <= g_llChunk))
+      {
+         unlock();
+         return false;
+      }
+
+      r->m_llNext = g_Ranges[victim].m_llNext + left / 2;
+      r->m_llEnd = g_Ranges[victim].m_llEnd;
+      g_Ranges[victim].m_llEnd = r->m_llNext;
+      ++ s->m_iSteals;
    }
 
-   // use this function to initialize the UDT library
-   UDT::startup();
+   offset = r->m_llNext;
+   len = r->m_llEnd - r->m_llNext;
+   if (len > g_llChunk)
+      len = g_llChunk;
+   r->m_llNext += len;
 
+   unlock();
+
+   return true;
+}
+
+static UDTSOCKET request(const char* ip, const char* port, const char* file, int64_t& size)
+{
    struct addrinfo hints, *peer;
 
    memset(&hints, 0, sizeof(struct addrinfo));
@@ -31,71 +136,238 @@ int main(int argc, char* argv[])
    hints.ai_family = AF_INET;
    hints.ai_socktype = SOCK_STREAM;
 
-   UDTSOCKET fhandle = UDT::socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol);
-
-   if (0 != getaddrinfo(argv[1], argv[2], &hints, &peer))
+   if (0 != getaddrinfo(ip, port, &hints, &peer))
    {
-      cout << "incorrect server/peer address. " << argv[1] << ":" << argv[2] << endl;
-      return -1;
+      cout << "incorrect server/peer address. " << ip << ":" << port << endl;
+      return UDT::INVALID_SOCK;
    }
 
+   UDTSOCKET fhandle = UDT::socket(peer->ai_family, peer->ai_socktype, peer->ai_protocol);
+
    // connect to the server, implict bind
    if (UDT::ERROR == UDT::connect(fhandle, peer->ai_addr, peer->ai_addrlen))
    {
       cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
-      return -1;
+      freeaddrinfo(peer);
+      UDT::close(fhandle);
+      return UDT::INVALID_SOCK;
    }
 
    freeaddrinfo(peer);
 
-
    // send name information of the requested file
-   int len = strlen(argv[3]);
+   int len = strlen(file);
 
-   if (UDT::ERROR == UDT::send(fhandle, (char*)&len, sizeof(int), 0))
+   if ((UDT::ERROR == UDT::send(fhandle, (char*)&len, sizeof(int), 0)) || (UDT::ERROR == UDT::send(fhandle, file, len, 0)))
    {
       cout << "send: " << UDT::getlasterror().getErrorMessage() << endl;
-      return -1;
+      UDT::close(fhandle);
+      return UDT::INVALID_SOCK;
    }
 
-   if (UDT::ERROR == UDT::send(fhandle, argv[3], len, 0))
+   // get size information
+   if (UDT::ERROR == UDT::recv(fhandle, (char*)&size, sizeof(int64_t), 0))
    {
-      cout << "send: " << UDT::getlasterror().getErrorMessage() << endl;
-      return -1;
+      cout << "recv: " << UDT::getlasterror().getErrorMessage() << endl;
+      UDT::close(fhandle);
+      return UDT::INVALID_SOCK;
    }
 
-   // get size information
-   int64_t size;
+   return fhandle;
+}
 
-   if (UDT::ERROR == UDT::recv(fhandle, (char*)&size, sizeof(int64_t), 0))
+int main(int argc, char* argv[])
+{
+   if (((argc != 5) && (argc != 6)) || (0 == atoi(argv[2])) || ((6 == argc) && (0 >= atoi(argv[5]))))
    {
-      cout << "send: " << UDT::getlasterror().getErrorMessage() << endl;
+      cout << "usage: recvfile server_ip server_port remote_filename local_filename [connections]" << endl;
       return -1;
    }
 
-   if (size < 0)
+   int conns = (6 == argc) ? atoi(argv[5]) : 4;
+   g_pcFile = argv[4];
+
+   // use this function to initialize the UDT library
+   UDT::startup();
+
+   #ifdef WIN32
+      InitializeCriticalSection(&g_Lock);
+   #endif
+
+   double start = now();
+
+   vector<Stripe> stripes;
+   int64_t size = -1;
+
+   for (int i = 0; i < conns; ++ i)
    {
-      cout << "no such file " << argv[3] << " on the server\n";
-      return -1;
+      int64_t s;
+      UDTSOCKET fhandle = request(argv[1], argv[2], argv[3], s);
+      if (UDT::INVALID_SOCK == fhandle)
+      {
+         if (0 == i)
+            return -1;
+         break;
+      }
+
+      if (s < 0)
+      {
+         cout << "no such file " << argv[3] << " on the server\n";
+         return -1;
+      }
+      size = s;
+
+      Stripe stripe = {fhandle, i, 0, 0, false};
+      stripes.push_back(stripe);
    }
 
-   // receive the file
+   // create or truncate the local file; the stripes open their own handles to write at their offsets
    fstream ofs(argv[4], ios::out | ios::binary | ios::trunc);
-   int64_t recvsize; 
-   int64_t offset = 0;
+   ofs.close();
 
-   if (UDT::ERROR == (recvsize = UDT::recvfile(fhandle, ofs, offset, size)))
+   conns = stripes.size();
+   for (int i = 0; i < conns; ++ i)
    {
-      cout << "recvfile: " << UDT::getlasterror().getErrorMessage() << endl;
-      return -1;
+      Range r = {size * i / conns, size * (i + 1) / conns};
+      g_Ranges.push_back(r);
    }
 
-   UDT::close(fhandle);
+   #ifndef WIN32
+      vector<pthread_t> threads(conns);
+      for (int i = 0; i < conns; ++ i)
+         pthread_create(&threads[i], NULL, recvfile, &stripes[i]);
+   #else
+      vector<HANDLE> threads(conns);
+      for (int i = 0; i < conns; ++ i)
+         threads[i] = CreateThread(NULL, 0, recvfile, &stripes[i], 0, NULL);
+   #endif
 
-   ofs.close();
+   // report the progress every second until all stripes are done
+   int64_t last = 0;
+   while (true)
+   {
+      #ifndef WIN32
+         sleep(1);
+      #else
+         Sleep(1000);
+      #endif
+
+      lock();
+      int64_t recvd = g_llRecvd;
+      int done = g_iDone;
+      unlock();
+
+      if (done == conns)
+         break;
+
+      cout << recvd * 100 / (size > 0 ? size : 1) << "% " << (recvd - last) * 8.0 / 1000000.0 << "Mbits/sec" << endl;
+      last = recvd;
+   }
+
+   for (int i = 0; i < conns; ++ i)
+   {
+      #ifndef WIN32
+         pthread_join(threads[i], NULL);
+      #else
+         WaitForSingleObject(threads[i], INFINITE);
+         CloseHandle(threads[i]);
+      #endif
+   }
+
+   double duration = g_dFinish - start;
+
+   bool failed = false;
+   for (int i = 0; i < conns; ++ i)
+   {
+      cout << "connection " << i << ": " << stripes[i].m_llRecvd << " bytes, " << stripes[i].m_iSteals << " steals" << endl;
+      failed = failed || stripes[i].m_bFailed;
+   }
+
+   cout << "received " << g_llRecvd << " of " << size << " bytes over " << conns << " connections in " << duration << " seconds, speed = "
+        << ((duration > 0) ? g_llRecvd * 8.0 / 1000000.0 / duration : 0) << "Mbits/sec" << endl;
+
+   #ifdef WIN32
+      DeleteCriticalSection(&g_Lock);
+   #endif
 
    // use this function to release the UDT library
    UDT::cleanup();
 
-   return 0;
+   return (failed || (g_llRecvd != size)) ? -1 : 0;
+}
+
+#ifndef WIN32
+void* recvfile(void* param)
+#else
+DWORD WINAPI recvfile(LPVOID param)
+#endif
+{
+   Stripe* s = (Stripe*)param;
+
+   #ifndef WIN32
+      int fd = open(g_pcFile, O_WRONLY);
+      if (fd < 0)
+      {
+         cout << "cannot open " << g_pcFile << endl;
+         s->m_bFailed = true;
+      }
+   #else
+      fstream ofs(g_pcFile, ios::in | ios::out | ios::binary);
+   #endif
+
+   int64_t range[2];
+
+   while (!s->m_bFailed && nextChunk(s, range[0], range[1]))
+   {
+      if (UDT::ERROR == UDT::send(s->m_Socket, (char*)range, sizeof(range), 0))
+      {
+         cout << "send: " << UDT::getlasterror().getErrorMessage() << endl;
+         s->m_bFailed = true;
+         break;
+      }
+
+      int64_t offset = range[0];
+      int64_t recvsize;
+
+      #ifndef WIN32
+         recvsize = UDT::recvfile(s->m_Socket, fd, offset, range[1]);
+      #else
+         recvsize = UDT::recvfile(s->m_Socket, ofs, offset, range[1]);
+      #endif
+
+      if (UDT::ERROR == recvsize)
+      {
+         cout << "recvfile: " << UDT::getlasterror().getErrorMessage() << endl;
+         s->m_bFailed = true;
+         break;
+      }
+
+      lock();
+      s->m_llRecvd += recvsize;
+      g_llRecvd += recvsize;
+      unlock();
+   }
+
+   // an empty range tells the server the transfer is done
+   range[0] = range[1] = 0;
+   UDT::send(s->m_Socket, (char*)range, sizeof(range), 0);
+   UDT::close(s->m_Socket);
+
+   #ifndef WIN32
+      if (fd >= 0)
+         close(fd);
+   #else
+      ofs.close();
+   #endif
+
+   lock();
+   ++ g_iDone;
+   g_dFinish = now();
+   unlock();
+
+   #ifndef WIN32
+      return NULL;
+   #else
+      return 0;
+   #endif
 }
@@ -0,0 +1,175 @@
+// Benchmark of select() and selectEx() over many idle connections.
+//
+// For each call it measures a call with a 1 ms timeout, the CPU time taken by an idle call of 2 seconds, and how long
+// a blocked call takes to return once one of the sockets receives a byte.
+//
+// usage: selectbench [connections], defaults to 1000
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "udt.h"
+
+using namespace std;
+
+
+const int g_Server_Port = 9200;
+const int g_Client_Port = 9201;
+
+UDTSOCKET g_Sender;
+volatile int64_t g_llSendTime;
+
+
+int64_t now()
+{
+   timeval t;
+   gettimeofday(&t, 0);
+   return t.tv_sec * 1000000LL + t.tv_usec;
+}
+
+// CPU time of the calling thread, the one of the library threads is left out
+int64_t cpu()
+{
+   rusage r;
+#ifdef LINUX
+   getrusage(RUSAGE_THREAD, &r);
+#else
+   getrusage(RUSAGE_SELF, &r);
+#endif
+   return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000000LL + r.ru_utime.tv_usec + r.ru_stime.tv_usec;
+}
+
+void* send_later(void*)
+{
+   usleep(200000);
+   g_llSendTime = now();
+   UDT::send(g_Sender, "x", 1, 0);
+   return NULL;
+}
+
+// waits for any of the sockets to be readable, for ms milliseconds at most
+int wait(const vector<UDTSOCKET>& socks, bool ex, int ms)
+{
+   if (ex)
+   {
+      vector<UDTSOCKET> readfds;
+      return UDT::selectEx(socks, &readfds, NULL, NULL, ms);
+   }
+
+   UDT::UDSET readfds;
+   UD_ZERO(&readfds);
+   for (vector<UDTSOCKET>::const_iterator i = socks.begin(); i != socks.end(); ++ i)
+      UD_SET(*i, &readfds);
+   timeval tv;
+   tv.tv_sec = ms / 1000;
+   tv.tv_usec = (ms % 1000) * 1000;
+   return UDT::select(0, &readfds, NULL, NULL, &tv);
+}
+
+void bench(const vector<UDTSOCKET>& cli, const vector<UDTSOCKET>& srv, bool ex)
+{
+   const char* name = ex ? "selectEx" : "select";
+   int n = srv.size();
+
+   int64_t t = now();
+   int64_t c = cpu();
+   for (int i = 0; i < 20; ++ i)
+      wait(srv, ex, 1);
+   cout << name << ", call with 1 ms timeout: " << (now() - t) / 20000.0 << " ms, " << (cpu() - c) / 20000.0 << " ms CPU" << endl;
+
+   c = cpu();
+   wait(srv, ex, 2000);
+   cout << name << ", idle call of 2 s: " << (cpu() - c) / 1000.0 << " ms CPU" << endl;
+
+   int64_t latency = 0;
+   char buf[16];
+   for (int i = 0; i < 5; ++ i)
+   {
+      int k = rand() % n;
+      g_Sender = cli[k];
+      pthread_t t;
+      pthread_create(&t, NULL, send_later, NULL);
+      if (wait(srv, ex, 1000) <= 0)
+         cout << name << ": the byte sent was not seen" << endl;
+      latency += now() - g_llSendTime;
+      pthread_join(t, NULL);
+      UDT::recv(srv[k], buf, sizeof(buf), 0);
+   }
+   cout << name << ", wakeup of a blocked call: " << latency / 5000.0 << " ms" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+   int n = (argc > 1) ? atoi(argv[1]) : 1000;
+   if (n <= 0)
+   {
+      cout << "usage: selectbench [connections]" << endl;
+      return -1;
+   }
+
+   UDT::startup();
+
+   // small buffers, as there are many connections
+   int buf = 64 * 1500;
+   int fc = 64;
+
+   sockaddr_in serv_addr;
+   memset(&serv_addr, 0, sizeof(sockaddr_in));
+   serv_addr.sin_family = AF_INET;
+   serv_addr.sin_port = htons(g_Server_Port);
+   inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+   sockaddr_in cli_addr = serv_addr;
+   cli_addr.sin_port = htons(g_Client_Port);
+
+   UDTSOCKET serv = UDT::socket(AF_INET, SOCK_STREAM, 0);
+   UDT::setsockopt(serv, 0, UDT_SNDBUF, &buf, sizeof(int));
+   UDT::setsockopt(serv, 0, UDT_RCVBUF, &buf, sizeof(int));
+   UDT::setsockopt(serv, 0, UDT_FC, &fc, sizeof(int));
+   if ((UDT::ERROR == UDT::bind(serv, (sockaddr*)&serv_addr, sizeof(sockaddr_in))) || (UDT::ERROR == UDT::listen(serv, 1024)))
+   {
+      cout << "listen: " << UDT::getlasterror().getErrorMessage() << endl;
+      return -1;
+   }
+
+   // the clients share one UDP port
+   vector<UDTSOCKET> cli;
+   vector<UDTSOCKET> srv;
+   for (int i = 0; i < n; ++ i)
+   {
+      UDTSOCKET u = UDT::socket(AF_INET, SOCK_STREAM, 0);
+      UDT::setsockopt(u, 0, UDT_SNDBUF, &buf, sizeof(int));
+      UDT::setsockopt(u, 0, UDT_RCVBUF, &buf, sizeof(int));
+      UDT::setsockopt(u, 0, UDT_FC, &fc, sizeof(int));
+      UDT::bind(u, (sockaddr*)&cli_addr, sizeof(sockaddr_in));
+      if (UDT::ERROR == UDT::connect(u, (sockaddr*)&serv_addr, sizeof(sockaddr_in)))
+      {
+         cout << "connect: " << UDT::getlasterror().getErrorMessage() << endl;
+         return -1;
+      }
+      cli.push_back(u);
+      srv.push_back(UDT::accept(serv, NULL, NULL));
+   }
+
+   cout << n << " connections" << endl;
+   sleep(1);
+
+   bench(cli, srv, false);
+   bench(cli, srv, true);
+
+   for (int i = 0; i < n; ++ i)
+   {
+      UDT::close(cli[i]);
+      UDT::close(srv[i]);
+   }
+   UDT::close(serv);
+   UDT::cleanup();
+
+   return 0;
+}
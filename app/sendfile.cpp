@@ -1,6 +1,8 @@
 #ifndef WIN32
    #include <cstdlib>
    #include <netdb.h>
+   #include <fcntl.h>
+   #include <unistd.h>
 #else
    #include <winsock2.h>
    #include <ws2tcpip.h>
@@ -123,44 +125,67 @@ DWORD WINAPI sendfile(LPVOID usocket)
       return 0;
    }
 
-   if (UDT::ERROR == UDT::recv(fhandle, file, len, 0))
+   if ((len < 0) || (len >= (int)sizeof(file)) || (UDT::ERROR == UDT::recv(fhandle, file, len, 0)))
    {
       cout << "recv: " << UDT::getlasterror().getErrorMessage() << endl;
       return 0;
    }
    file[len] = '\0';
 
-   // open the file
-   fstream ifs(file, ios::in | ios::binary);
-
-   ifs.seekg(0, ios::end);
-   int64_t size = ifs.tellg();
-   ifs.seekg(0, ios::beg);
+   // open the file, every connection of a striped transfer has its own handle
+   #ifndef WIN32
+      int fd = open(file, O_RDONLY);
+      int64_t size = (fd < 0) ? -1 : lseek(fd, 0, SEEK_END);
+   #else
+      fstream ifs(file, ios::in | ios::binary);
+      ifs.seekg(0, ios::end);
+      int64_t size = ifs.fail() ? -1 : (int64_t)ifs.tellg();
+   #endif
 
    // send file size information
    if (UDT::ERROR == UDT::send(fhandle, (char*)&size, sizeof(int64_t), 0))
    {
       cout << "send: " << UDT::getlasterror().getErrorMessage() << endl;
-      return 0;
+      size = -1;
    }
 
    UDT::TRACEINFO trace;
    UDT::perfmon(fhandle, &trace);
 
-   // send the file
-   int64_t offset = 0;
-   if (UDT::ERROR == UDT::sendfile(fhandle, ifs, offset, size))
+   // send the ranges requested by the client, until an empty range is requested
+   int64_t total = 0;
+   int64_t range[2];
+
+   while ((size >= 0) && (UDT::ERROR != UDT::recv(fhandle, (char*)range, sizeof(range), 0)) && (range[1] > 0))
    {
-      cout << "sendfile: " << UDT::getlasterror().getErrorMessage() << endl;
-      return 0;
+      int64_t offset = range[0];
+
+      #ifndef WIN32
+         int64_t sent = UDT::sendfile(fhandle, fd, offset, range[1]);
+      #else
+         int64_t sent = UDT::sendfile(fhandle, ifs, offset, range[1]);
+      #endif
+
+      if (UDT::ERROR == sent)
+      {
+         cout << "sendfile: " << UDT::getlasterror().getErrorMessage() << endl;
+         break;
+      }
+
+      total += sent;
    }
 
    UDT::perfmon(fhandle, &trace);
-   cout << "speed = " << trace.mbpsSendRate << "Mbits/sec" << endl;
+   cout << "sent " << total << " bytes, speed = " << trace.mbpsSendRate << "Mbits/sec" << endl;
 
    UDT::close(fhandle);
 
-   ifs.close();
+   #ifndef WIN32
+      if (fd >= 0)
+         close(fd);
+   #else
+      ifs.close();
+   #endif
 
    #ifndef WIN32
       return NULL;
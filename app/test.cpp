@@ -2,6 +2,7 @@
    #include <cstdlib>
    #include <cstring>
    #include <netdb.h>
+   #include <poll.h>
    #include <signal.h>
    #include <unistd.h>
 #else
@@ -10,6 +11,7 @@
    #include <wspiapi.h>
 #endif
 #include <algorithm>
+#include <ctime>
 #include <iostream>
 
 #include "udt.h"
@@ -23,14 +25,14 @@ const char g_Localhost[] = "127.0.0.1";
 const int g_Server_Port = 9000;
 
 
-int createUDTSocket(UDTSOCKET& usock, int port = 0, bool rendezvous = false)
+int createUDTSocket(UDTSOCKET& usock, int port = 0, bool rendezvous = false, int type = g_Socket_Type)
 {
    addrinfo hints;
    addrinfo* res;
    memset(&hints, 0, sizeof(struct addrinfo));
    hints.ai_flags = AI_PASSIVE;
    hints.ai_family = g_IP_Version;
-   hints.ai_socktype = g_Socket_Type;
+   hints.ai_socktype = type;
 
    char service[16];
    sprintf(service, "%d", port);
@@ -690,9 +692,581 @@ DWORD WINAPI Test_4_Cli(LPVOID)
 }
 
 
+
+// Test scatter/gather data transfer.
+
+const int g_FrameNum = 1000;
+const int g_PayloadSize = 100;
+
+#ifndef WIN32
+void* Test_5_Srv(void* param)
+#else
+DWORD WINAPI Test_5_Srv(LPVOID param)
+#endif
+{
+   cout << "Testing scatter/gather data transfer.\n";
+
+   UDTSOCKET serv;
+   if (createUDTSocket(serv, g_Server_Port) < 0)
+      return NULL;
+
+   UDT::listen(serv, 1024);
+   sockaddr_storage clientaddr;
+   int addrlen = sizeof(clientaddr);
+   UDTSOCKET new_sock = UDT::accept(serv, (sockaddr*)&clientaddr, &addrlen);
+   UDT::close(serv);
+
+   if (new_sock == UDT::INVALID_SOCK)
+   {
+      return NULL;
+   }
+
+   // each frame is a 4-byte header (frame number) followed by the payload
+   for (int i = 0; i < g_FrameNum; ++ i)
+   {
+      int32_t header;
+      char payload[g_PayloadSize];
+
+      iovec iov[2];
+      iov[0].iov_base = (char*)&header;
+      iov[0].iov_len = sizeof(int32_t);
+      iov[1].iov_base = payload;
+      iov[1].iov_len = g_PayloadSize;
+
+      while (iov[1].iov_len > 0)
+      {
+         int rcvd = UDT::recvv(new_sock, iov, 2, 0);
+         if (rcvd < 0)
+         {
+            cout << "recvv: " << UDT::getlasterror().getErrorMessage() << endl;
+            return NULL;
+         }
+
+         // skip the part already received
+         for (int j = 0; j < 2; ++ j)
+         {
+            int size = ((int)iov[j].iov_len < rcvd) ? (int)iov[j].iov_len : rcvd;
+            iov[j].iov_base = (char*)iov[j].iov_base + size;
+            iov[j].iov_len -= size;
+            rcvd -= size;
+         }
+      }
+
+      if ((header != i) || (payload[0] != char(i)) || (payload[g_PayloadSize - 1] != char(i)))
+      {
+         cout << "DATA ERROR " << i << " " << header << endl;
+         break;
+      }
+   }
+
+   UDT::close(new_sock);
+
+   return NULL;
+}
+
+#ifndef WIN32
+void* Test_5_Cli(void* param)
+#else
+DWORD WINAPI Test_5_Cli(LPVOID param)
+#endif
+{
+   UDTSOCKET client;
+   if (createUDTSocket(client, 0) < 0)
+      return NULL;
+
+   connect(client, g_Server_Port);
+
+   for (int i = 0; i < g_FrameNum; ++ i)
+   {
+      int32_t header = i;
+      char payload[g_PayloadSize];
+      memset(payload, char(i), g_PayloadSize);
+
+      iovec iov[2];
+      iov[0].iov_base = (char*)&header;
+      iov[0].iov_len = sizeof(int32_t);
+      iov[1].iov_base = payload;
+      iov[1].iov_len = g_PayloadSize;
+
+      while (iov[1].iov_len > 0)
+      {
+         int sent = UDT::sendv(client, iov, 2, 0);
+         if (sent < 0)
+         {
+            cout << "sendv: " << UDT::getlasterror().getErrorMessage() << endl;
+            return NULL;
+         }
+
+         for (int j = 0; j < 2; ++ j)
+         {
+            int size = ((int)iov[j].iov_len < sent) ? (int)iov[j].iov_len : sent;
+            iov[j].iov_base = (char*)iov[j].iov_base + size;
+            iov[j].iov_len -= size;
+            sent -= size;
+         }
+      }
+   }
+
+   UDT::close(client);
+   return NULL;
+}
+
+// Test edge triggered events of epoll_uwait(), its timeout, the wakeups shared with epoll_wait(), and the release.
+
+struct EPollWaiter
+{
+   int eid;
+   bool legacy;		// waits in epoll_wait() for writes only, on sockets watched for reads
+   int result;
+   int error;
+};
+
+void sleep_ms(int ms)
+{
+#ifndef WIN32
+   usleep(ms * 1000);
+#else
+   Sleep(ms);
+#endif
+}
+
+#ifndef WIN32
+void* epoll_waiter(void* param)
+#else
+DWORD WINAPI epoll_waiter(LPVOID param)
+#endif
+{
+   EPollWaiter* w = (EPollWaiter*)param;
+
+   if (w->legacy)
+   {
+      set<UDTSOCKET> writefds;
+      w->result = UDT::epoll_wait(w->eid, NULL, &writefds, -1);
+   }
+   else
+   {
+      UDT::EPOLLEVENT events[4];
+      w->result = UDT::epoll_uwait(w->eid, events, 4, -1);
+   }
+   w->error = UDT::getlasterror_code();
+
+   return NULL;
+}
+
+// one byte tells the other side to go on
+int go_on(UDTSOCKET sock)
+{
+   char c = 0;
+   return UDT::send(sock, &c, 1, 0);
+}
+
+int drain(UDTSOCKET sock, int size)
+{
+   char buf[16];
+   while (size > 0)
+   {
+      int rcvd = UDT::recv(sock, buf, size, 0);
+      if (rcvd <= 0)
+         return -1;
+      size -= rcvd;
+   }
+   return 0;
+}
+
+// an event expected must wake the wait up long before the timeout, as it is found again when the wait times out
+int check_uwait(int eid, UDTSOCKET sock, int64_t timeout, int expected, const char* what)
+{
+   UDT::EPOLLEVENT events[4];
+   time_t start = time(NULL);
+   int res = UDT::epoll_uwait(eid, events, 4, timeout);
+   if ((res != expected) || ((1 == res) && ((events[0].sock != sock) || (events[0].events != UDT_EPOLL_IN))))
+   {
+      cout << "epoll_uwait " << what << ": " << res << " events, " << expected << " expected" << endl;
+      return -1;
+   }
+   if ((expected > 0) && (time(NULL) - start >= 2))
+   {
+      cout << "epoll_uwait " << what << ": woken up by the timeout" << endl;
+      return -1;
+   }
+   return 0;
+}
+
+// the events of one edge triggered socket, with a client sending one byte each time it is told to go on
+int check_edges(int eid, UDTSOCKET sock)
+{
+   // the first byte is one edge, reported once; nothing else makes the wait time out with 0
+   if ((check_uwait(eid, sock, 3000, 1, "on new data") < 0) || (check_uwait(eid, sock, 100, 0, "after the edge") < 0))
+      return -1;
+
+   // more data while the event is still on is no new edge
+   go_on(sock);
+   sleep_ms(100);
+   if ((check_uwait(eid, sock, 100, 0, "on more data") < 0) || (drain(sock, 2) < 0))
+      return -1;
+
+   // the event turns off and back on
+   go_on(sock);
+   if ((check_uwait(eid, sock, 3000, 1, "on data after the drain") < 0) || (drain(sock, 1) < 0))
+      return -1;
+
+   return 0;
+}
+
+#ifndef WIN32
+void* Test_6_Srv(void* param)
+#else
+DWORD WINAPI Test_6_Srv(LPVOID param)
+#endif
+{
+   cout << "Testing edge triggered epoll events.\n";
+
+   UDTSOCKET serv;
+   if (createUDTSocket(serv, g_Server_Port) < 0)
+      return NULL;
+
+   UDT::listen(serv, 1024);
+   sockaddr_storage clientaddr;
+   int addrlen = sizeof(clientaddr);
+   UDTSOCKET new_sock = UDT::accept(serv, (sockaddr*)&clientaddr, &addrlen);
+   UDT::close(serv);
+
+   if (new_sock == UDT::INVALID_SOCK)
+   {
+      return NULL;
+   }
+
+   int eid = UDT::epoll_create();
+   int events = UDT_EPOLL_IN | UDT_EPOLL_ET;
+   UDT::epoll_add_usock(eid, new_sock, &events);
+
+   // a waiter in epoll_wait() on the same epoll reports none of the events, it must not take their wakeups; another
+   // waiter in epoll_uwait() joins it once the events are checked, and the release makes both fail
+   EPollWaiter w[2];
+   w[0].eid = w[1].eid = eid;
+   w[0].legacy = true;
+   w[1].legacy = false;
+
+#ifndef WIN32
+   pthread_t waiter[2];
+   pthread_create(&waiter[0], NULL, epoll_waiter, &w[0]);
+   sleep_ms(100);
+   check_edges(eid, new_sock);
+   pthread_create(&waiter[1], NULL, epoll_waiter, &w[1]);
+   sleep_ms(100);
+   UDT::epoll_release(eid);
+   pthread_join(waiter[0], NULL);
+   pthread_join(waiter[1], NULL);
+#else
+   HANDLE waiter[2];
+   waiter[0] = CreateThread(NULL, 0, epoll_waiter, &w[0], 0, NULL);
+   sleep_ms(100);
+   check_edges(eid, new_sock);
+   waiter[1] = CreateThread(NULL, 0, epoll_waiter, &w[1], 0, NULL);
+   sleep_ms(100);
+   UDT::epoll_release(eid);
+   WaitForSingleObject(waiter[0], INFINITE);
+   WaitForSingleObject(waiter[1], INFINITE);
+#endif
+
+   for (int i = 0; i < 2; ++ i)
+   {
+      if ((w[i].result >= 0) || (w[i].error != 5013))
+         cout << "epoll released: " << w[i].result << " error " << w[i].error << endl;
+   }
+
+   UDT::close(new_sock);
+
+   return NULL;
+}
+
+#ifndef WIN32
+void* Test_6_Cli(void* param)
+#else
+DWORD WINAPI Test_6_Cli(LPVOID param)
+#endif
+{
+   UDTSOCKET client;
+   if (createUDTSocket(client, 0) < 0)
+      return NULL;
+
+   connect(client, g_Server_Port);
+
+   // one byte now, one more each time the server says so
+   char c;
+   go_on(client);
+   while (UDT::recv(client, &c, 1, 0) > 0)
+      go_on(client);
+
+   UDT::close(client);
+   return NULL;
+}
+
+
+// Test the system descriptor of an epoll.
+
+#ifndef WIN32
+int check_readable(int fd, int timeout, int expected, const char* what)
+{
+   pollfd p;
+   p.fd = fd;
+   p.events = POLLIN;
+   p.revents = 0;
+   int res = poll(&p, 1, timeout);
+   if (res != expected)
+   {
+      cout << "epoll_getfd " << what << ": " << (res > 0 ? "readable" : "not readable") << endl;
+      return -1;
+   }
+   return 0;
+}
+
+// the descriptors of a level and an edge triggered epoll on one socket, with a client sending one byte each time it
+// is told to go on
+int check_signals(int lt, int et, UDTSOCKET sock)
+{
+   int ltfd = UDT::epoll_getfd(lt);
+   int etfd = UDT::epoll_getfd(et);
+   UDT::EPOLLEVENT events[4];
+
+   // both turn readable on new data, the edge triggered one resets once its event is taken
+   if ((check_readable(ltfd, 3000, 1, "level triggered, on new data") < 0) || (check_readable(etfd, 3000, 1, "edge triggered, on new data") < 0))
+      return -1;
+   if ((1 != UDT::epoll_uwait(et, events, 4, 0)) || (check_readable(etfd, 0, 0, "edge triggered, after the event") < 0))
+      return -1;
+
+   // the level triggered one resets once the data is drained
+   if ((check_readable(ltfd, 0, 1, "level triggered, before the drain") < 0) || (drain(sock, 1) < 0) || (check_readable(ltfd, 100, 0, "level triggered, after the drain") < 0))
+      return -1;
+
+   // and both turn readable again on more data
+   go_on(sock);
+   if ((check_readable(ltfd, 3000, 1, "level triggered, on more data") < 0) || (check_readable(etfd, 3000, 1, "edge triggered, on more data") < 0))
+      return -1;
+
+   return 0;
+}
+#endif
+
+#ifndef WIN32
+void* Test_7_Srv(void* param)
+#else
+DWORD WINAPI Test_7_Srv(LPVOID param)
+#endif
+{
+   cout << "Testing the system descriptor of an epoll.\n";
+
+   UDTSOCKET serv;
+   if (createUDTSocket(serv, g_Server_Port) < 0)
+      return NULL;
+
+   UDT::listen(serv, 1024);
+   sockaddr_storage clientaddr;
+   int addrlen = sizeof(clientaddr);
+   UDTSOCKET new_sock = UDT::accept(serv, (sockaddr*)&clientaddr, &addrlen);
+   UDT::close(serv);
+
+   if (new_sock == UDT::INVALID_SOCK)
+   {
+      return NULL;
+   }
+
+   int res = 0;
+
+   // there is no such descriptor on Windows
+#ifndef WIN32
+   int lt = UDT::epoll_create();
+   int et = UDT::epoll_create();
+   int events = UDT_EPOLL_IN;
+   UDT::epoll_add_usock(lt, new_sock, &events);
+   events |= UDT_EPOLL_ET;
+   UDT::epoll_add_usock(et, new_sock, &events);
+
+   res = check_signals(lt, et, new_sock);
+
+   UDT::epoll_release(lt);
+   UDT::epoll_release(et);
+#endif
+
+   UDT::close(new_sock);
+
+   // a failure is shown in the summary of the test
+#ifndef WIN32
+   return (res < 0) ? (void*)-1 : NULL;
+#else
+   return (res < 0) ? 1 : 0;
+#endif
+}
+
+// Test sending and receiving messages in batches.
+
+const int g_BatchNum = 20;
+const int g_BatchMsgSize = 3000;
+
+// messages taken by the two batches of the client, -1 until sent
+volatile int g_iBatchSent[2] = {-1, -1};
+
+// the first batch has three messages, cut short by an empty one; the second is more than the buffers hold, so the
+// client takes part of it only
+int check_batches(UDTSOCKET sock)
+{
+   char buf[4][g_BatchMsgSize];
+   iovec msgs[4];
+   int lens[4];
+   for (int i = 0; i < 4; ++ i)
+   {
+      msgs[i].iov_base = buf[i];
+      msgs[i].iov_len = g_BatchMsgSize;
+   }
+
+   // all the messages of the first batch are in by now, and come out of one call each in one buffer of its own
+   sleep_ms(200);
+   const int size[3] = {100, g_BatchMsgSize, 1};
+   int num = UDT::recvmsg_batch(sock, msgs, 4, lens);
+   if ((g_iBatchSent[0] != 3) || (num != 3))
+   {
+      cout << "first batch: " << g_iBatchSent[0] << " messages sent, " << num << " received, 3 expected" << endl;
+      return -1;
+   }
+   for (int i = 0; i < 3; ++ i)
+   {
+      const char* m = (const char*)msgs[i].iov_base;
+      if ((lens[i] != size[i]) || (m[0] != 'a' + i) || (m[lens[i] - 1] != 'a' + i))
+      {
+         cout << "first batch: message " << i << " of " << lens[i] << " bytes, " << size[i] << " expected" << endl;
+         return -1;
+      }
+   }
+
+   UDT::sendmsg(sock, "g", 1);
+   for (int i = 0; (i < 300) && (g_iBatchSent[1] < 0); ++ i)
+      sleep_ms(10);
+   if ((g_iBatchSent[1] <= 0) || (g_iBatchSent[1] >= g_BatchNum))
+   {
+      cout << "second batch: " << g_iBatchSent[1] << " messages of " << g_BatchNum << " taken" << endl;
+      return -1;
+   }
+
+   // the messages taken come in order, and none after them
+   num = 0;
+   while (num < g_iBatchSent[1])
+   {
+      int n = UDT::recvmsg_batch(sock, msgs, 4, lens);
+      if (n <= 0)
+      {
+         cout << "second batch: " << num << " messages received of " << g_iBatchSent[1] << endl;
+         return -1;
+      }
+      for (int i = 0; i < n; ++ i, ++ num)
+      {
+         const char* m = (const char*)msgs[i].iov_base;
+         if ((lens[i] != g_BatchMsgSize) || (m[0] != char(num)) || (m[lens[i] - 1] != char(num)))
+         {
+            cout << "second batch: message " << num << " of " << lens[i] << " bytes, starting with " << int(m[0]) << endl;
+            return -1;
+         }
+      }
+   }
+
+   bool block = false;
+   UDT::setsockopt(sock, 0, UDT_RCVSYN, &block, sizeof(bool));
+   sleep_ms(200);
+   if (UDT::ERROR != UDT::recvmsg_batch(sock, msgs, 4, lens))
+   {
+      cout << "second batch: more messages than taken" << endl;
+      return -1;
+   }
+
+   return 0;
+}
+
+#ifndef WIN32
+void* Test_8_Srv(void* param)
+#else
+DWORD WINAPI Test_8_Srv(LPVOID param)
+#endif
+{
+   cout << "Testing messages sent and received in batches.\n";
+
+   UDTSOCKET serv;
+   if (createUDTSocket(serv, g_Server_Port, false, SOCK_DGRAM) < 0)
+      return NULL;
+
+   UDT::listen(serv, 1024);
+   sockaddr_storage clientaddr;
+   int addrlen = sizeof(clientaddr);
+   UDTSOCKET new_sock = UDT::accept(serv, (sockaddr*)&clientaddr, &addrlen);
+   UDT::close(serv);
+
+   if (new_sock == UDT::INVALID_SOCK)
+   {
+      return NULL;
+   }
+
+   int res = check_batches(new_sock);
+
+   // the client waits for this before it closes
+   UDT::sendmsg(new_sock, "d", 1);
+   UDT::close(new_sock);
+
+   // a failure is shown in the summary of the test
+#ifndef WIN32
+   return (res < 0) ? (void*)-1 : NULL;
+#else
+   return (res < 0) ? 1 : 0;
+#endif
+}
+
+#ifndef WIN32
+void* Test_8_Cli(void* param)
+#else
+DWORD WINAPI Test_8_Cli(LPVOID param)
+#endif
+{
+   UDTSOCKET client;
+   if (createUDTSocket(client, 0, false, SOCK_DGRAM) < 0)
+      return NULL;
+
+   connect(client, g_Server_Port);
+
+   char* data = new char[g_BatchNum * g_BatchMsgSize];
+   iovec msgs[g_BatchNum];
+
+   // the empty message ends the batch, the one after it is not sent
+   const int size[5] = {100, g_BatchMsgSize, 1, 0, 10};
+   for (int i = 0; i < 5; ++ i)
+   {
+      msgs[i].iov_base = data + i * g_BatchMsgSize;
+      msgs[i].iov_len = size[i];
+      memset(msgs[i].iov_base, 'a' + i, g_BatchMsgSize);
+   }
+   g_iBatchSent[0] = UDT::sendmsg_batch(client, msgs, 5, -1, true);
+
+   // the server does not read while the second batch is sent, and the sending does not block
+   char c;
+   UDT::recvmsg(client, &c, 1);
+
+   for (int i = 0; i < g_BatchNum; ++ i)
+   {
+      msgs[i].iov_base = data + i * g_BatchMsgSize;
+      msgs[i].iov_len = g_BatchMsgSize;
+      memset(msgs[i].iov_base, i, g_BatchMsgSize);
+   }
+   bool block = false;
+   UDT::setsockopt(client, 0, UDT_SNDSYN, &block, sizeof(bool));
+   g_iBatchSent[1] = UDT::sendmsg_batch(client, msgs, g_BatchNum, -1, true);
+
+   UDT::recvmsg(client, &c, 1);
+
+   delete [] data;
+   UDT::close(client);
+   return NULL;
+}
+
+
 int main()
 {
-   const int test_case = 4;
+   const int test_case = 8;
 
 #ifndef WIN32
    void* (*Test_Srv[test_case])(void*);
@@ -710,28 +1284,42 @@ int main()
    Test_Cli[2] = Test_3_Cli;
    Test_Srv[3] = Test_4_Srv;
    Test_Cli[3] = Test_4_Cli;
+   Test_Srv[4] = Test_5_Srv;
+   Test_Cli[4] = Test_5_Cli;
+   Test_Srv[5] = Test_6_Srv;
+   Test_Cli[5] = Test_6_Cli;
+   Test_Srv[6] = Test_7_Srv;
+   Test_Cli[6] = Test_6_Cli;
+   Test_Srv[7] = Test_8_Srv;
+   Test_Cli[7] = Test_8_Cli;
 
    for (int i = 0; i < test_case; ++ i)
    {
       cout << "Start Test # " << i + 1 << endl;
       UDT::startup();
 
+      // a server returning other than 0 has found the test failed
 #ifndef WIN32
       pthread_t srv, cli;
+      void* res = NULL;
       pthread_create(&srv, NULL, Test_Srv[i], NULL);
       pthread_create(&cli, NULL, Test_Cli[i], NULL);
-      pthread_join(srv, NULL);
+      pthread_join(srv, &res);
       pthread_join(cli, NULL);
+      bool failed = (NULL != res);
 #else
       HANDLE srv, cli;
+      DWORD res = 0;
       srv = CreateThread(NULL, 0, Test_Srv[i], NULL, 0, NULL);
       cli = CreateThread(NULL, 0, Test_Cli[i], NULL, 0, NULL);
       WaitForSingleObject(srv, INFINITE);
       WaitForSingleObject(cli, INFINITE);
+      GetExitCodeThread(srv, &res);
+      bool failed = (0 != res);
 #endif
 
       UDT::cleanup();
-      cout << "Test # " << i + 1 << " completed." << endl;
+      cout << "Test # " << i + 1 << (failed ? " failed." : " completed.") << endl;
    }
 
    return 0;
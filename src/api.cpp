@@ -46,7 +46,9 @@ written by
    #endif
 #else
    #include <unistd.h>
+   #include <fcntl.h>
 #endif
+#include <algorithm>
 #include <cstring>
 #include "api.h"
 #include "core.h"
@@ -114,6 +116,70 @@ CUDTSocket::~CUDTSocket()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+CSocketTable::CSocketTable()
+{
+   for (int i = 0; i < m_iShardNum; ++ i)
+      CGuard::createMutex(m_pShard[i].m_Lock);
+}
+
+CSocketTable::~CSocketTable()
+{
+   for (int i = 0; i < m_iShardNum; ++ i)
+      CGuard::releaseMutex(m_pShard[i].m_Lock);
+}
+
+CUDTSocket* CSocketTable::find(const UDTSOCKET u)
+{
+   CShard& s = m_pShard[u & (m_iShardNum - 1)];
+   CGuard cg(s.m_Lock);
+
+   map<UDTSOCKET, CUDTSocket*>::iterator i = s.m_Sockets.find(u);
+   if (i == s.m_Sockets.end())
+      return NULL;
+
+   return i->second;
+}
+
+void CSocketTable::insert(CUDTSocket* s)
+{
+   CShard& h = m_pShard[s->m_SocketID & (m_iShardNum - 1)];
+   CGuard cg(h.m_Lock);
+
+   h.m_Sockets[s->m_SocketID] = s;
+}
+
+void CSocketTable::erase(const UDTSOCKET u)
+{
+   CShard& s = m_pShard[u & (m_iShardNum - 1)];
+   CGuard cg(s.m_Lock);
+
+   s.m_Sockets.erase(u);
+}
+
+void CSocketTable::list(vector<CUDTSocket*>& sockets)
+{
+   // no lock, the caller holds the control lock and nobody else changes the table
+   sockets.clear();
+   for (int i = 0; i < m_iShardNum; ++ i)
+   {
+      for (map<UDTSOCKET, CUDTSocket*>::iterator j = m_pShard[i].m_Sockets.begin(); j != m_pShard[i].m_Sockets.end(); ++ j)
+         sockets.push_back(j->second);
+   }
+}
+
+void CSocketTable::clear()
+{
+   for (int i = 0; i < m_iShardNum; ++ i)
+   {
+      CGuard cg(m_pShard[i].m_Lock);
+      m_pShard[i].m_Sockets.clear();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int CUDTUnited::m_iCacheSaveInterval = 60;
+
 CUDTUnited::CUDTUnited():
 m_Sockets(),
 m_ControlLock(),
@@ -123,6 +189,9 @@ m_TLSError(),
 m_mMultiplexer(),
 m_MultiplexerLock(),
 m_pCache(NULL),
+m_CacheFile(),
+m_iCacheTTL(3600),
+m_CacheFileLock(),
 m_bClosing(false),
 m_GCStopLock(),
 m_GCStopCond(),
@@ -130,7 +199,11 @@ m_InitLock(),
 m_iInstanceCount(0),
 m_bGCStatus(false),
 m_GCThread(),
-m_ClosedSockets()
+m_ClosedSockets(),
+m_GCQueue(),
+m_GCDeadline(),
+m_ullGCWakeTime(0),
+m_SelectLock()
 {
    // Socket ID MUST start from a random value
    srand((unsigned int)CTimer::getTime());
@@ -140,10 +213,14 @@ m_ClosedSockets()
       pthread_mutex_init(&m_ControlLock, NULL);
       pthread_mutex_init(&m_IDLock, NULL);
       pthread_mutex_init(&m_InitLock, NULL);
+      pthread_mutex_init(&m_CacheFileLock, NULL);
+      pthread_mutex_init(&m_SelectLock, NULL);
    #else
       m_ControlLock = CreateMutex(NULL, false, NULL);
       m_IDLock = CreateMutex(NULL, false, NULL);
       m_InitLock = CreateMutex(NULL, false, NULL);
+      m_CacheFileLock = CreateMutex(NULL, false, NULL);
+      m_SelectLock = CreateMutex(NULL, false, NULL);
    #endif
 
    #ifndef WIN32
@@ -162,10 +239,14 @@ CUDTUnited::~CUDTUnited()
       pthread_mutex_destroy(&m_ControlLock);
       pthread_mutex_destroy(&m_IDLock);
       pthread_mutex_destroy(&m_InitLock);
+      pthread_mutex_destroy(&m_CacheFileLock);
+      pthread_mutex_destroy(&m_SelectLock);
    #else
       CloseHandle(m_ControlLock);
       CloseHandle(m_IDLock);
       CloseHandle(m_InitLock);
+      CloseHandle(m_CacheFileLock);
+      CloseHandle(m_SelectLock);
    #endif
 
    #ifndef WIN32
@@ -200,7 +281,16 @@ int CUDTUnited::startup()
    if (m_bGCStatus)
       return true;
 
+   // connections to the peers known from the previous run start warm
+   CGuard::enterCS(m_CacheFileLock);
+   if (!m_CacheFile.empty())
+      CInfoBlock::load(m_pCache, m_CacheFile.c_str(), m_iCacheTTL);
+   CGuard::leaveCS(m_CacheFileLock);
+
    m_bClosing = false;
+   m_GCQueue.clear();
+   m_GCDeadline.clear();
+   m_ullGCWakeTime = 0;
    #ifndef WIN32
       pthread_mutex_init(&m_GCStopLock, NULL);
       pthread_cond_init(&m_GCStopCond, NULL);
@@ -231,7 +321,9 @@ int CUDTUnited::cleanup()
 
    m_bClosing = true;
    #ifndef WIN32
+      pthread_mutex_lock(&m_GCStopLock);
       pthread_cond_signal(&m_GCStopCond);
+      pthread_mutex_unlock(&m_GCStopLock);
       pthread_join(m_GCThread, NULL);
       pthread_mutex_destroy(&m_GCStopLock);
       pthread_cond_destroy(&m_GCStopCond);
@@ -245,6 +337,9 @@ int CUDTUnited::cleanup()
 
    m_bGCStatus = false;
 
+   // all the connections have been closed and have left their state in the cache
+   saveCache();
+
    // Global destruction code
    #ifdef WIN32
       WSACleanup();
@@ -253,6 +348,31 @@ int CUDTUnited::cleanup()
    return 0;
 }
 
+int CUDTUnited::setCacheFile(const char* file, int ttl)
+{
+   if (ttl <= 0)
+      throw CUDTException(5, 3, 0);
+
+   CGuard gcinit(m_InitLock);
+   CGuard cacheguard(m_CacheFileLock);
+
+   m_CacheFile = (NULL != file) ? file : "";
+   m_iCacheTTL = ttl;
+
+   if (m_bGCStatus && !m_CacheFile.empty())
+      CInfoBlock::load(m_pCache, m_CacheFile.c_str(), m_iCacheTTL);
+
+   return 0;
+}
+
+void CUDTUnited::saveCache()
+{
+   CGuard cacheguard(m_CacheFileLock);
+
+   if (!m_CacheFile.empty())
+      CInfoBlock::save(m_pCache, m_CacheFile.c_str(), m_iCacheTTL);
+}
+
 UDTSOCKET CUDTUnited::newSocket(int af, int type)
 {
    if ((type != SOCK_STREAM) && (type != SOCK_DGRAM))
@@ -296,7 +416,7 @@ UDTSOCKET CUDTUnited::newSocket(int af, int type)
    CGuard::enterCS(m_ControlLock);
    try
    {
-      m_Sockets[ns->m_SocketID] = ns;
+      m_Sockets.insert(ns);
    }
    catch (...)
    {
@@ -350,6 +470,10 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
          hs->m_iFlightFlagSize = ns->m_pUDT->m_iFlightFlagSize;
          hs->m_iReqType = -1;
          hs->m_iID = ns->m_SocketID;
+         hs->m_iMaxACKSpacing = (ns->m_pUDT->m_iACKSpacingLimit > 0) ? ns->m_pUDT->m_iMaxACKSpacing : 0;
+         hs->m_iFECGroup = (ns->m_pUDT->m_iPeerFECGroup >= 0) ? ns->m_pUDT->m_iFECGroup : -1;
+         hs->m_iDelayReport = ns->m_pUDT->m_bPeerDelayReport ? 1 : 0;
+         hs->m_iECNReport = ns->m_pUDT->m_bPeerECNReport ? 1 : 0;
 
          return 0;
 
@@ -424,7 +548,7 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
    CGuard::enterCS(m_ControlLock);
    try
    {
-      m_Sockets[ns->m_SocketID] = ns;
+      m_Sockets.insert(ns);
       m_PeerRec[(ns->m_PeerID << 30) + ns->m_iISN].insert(ns->m_SocketID);
    }
    catch (...)
@@ -445,7 +569,7 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
    CGuard::leaveCS(ls->m_AcceptLock);
 
    // acknowledge users waiting for new connections on the listening socket
-   m_EPoll.update_events(listen, ls->m_pUDT->m_sPollID, UDT_EPOLL_IN, true);
+   ls->m_pUDT->updateEPoll(UDT_EPOLL_IN, true);
 
    CTimer::triggerEvent();
 
@@ -473,36 +597,34 @@ int CUDTUnited::newConnection(const UDTSOCKET listen, const sockaddr* peer, CHan
 
 CUDT* CUDTUnited::lookup(const UDTSOCKET u)
 {
-   // protects the m_Sockets structure
-   CGuard cg(m_ControlLock);
-
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
+   // a socket found stays valid for a while after it is closed, see removeSocket()
+   CUDTSocket* s = m_Sockets.find(u);
 
-   if ((i == m_Sockets.end()) || (i->second->m_Status == CLOSED))
+   if ((NULL == s) || (s->m_Status == CLOSED))
       throw CUDTException(5, 4, 0);
 
-   return i->second->m_pUDT;
+   return s->m_pUDT;
 }
 
 UDTSTATUS CUDTUnited::getStatus(const UDTSOCKET u)
 {
-   // protects the m_Sockets structure
-   CGuard cg(m_ControlLock);
-
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
+   CUDTSocket* s = m_Sockets.find(u);
 
-   if (i == m_Sockets.end())
+   if (NULL == s)
    {
+      // protects the m_ClosedSockets structure
+      CGuard cg(m_ControlLock);
+
       if (m_ClosedSockets.find(u) != m_ClosedSockets.end())
          return CLOSED;
 
       return NONEXIST;
    }
 
-   if (i->second->m_pUDT->m_bBroken)
+   if (s->m_pUDT->m_bBroken)
       return BROKEN;
 
-   return i->second->m_Status;   
+   return s->m_Status;   
 }
 
 int CUDTUnited::bind(const UDTSOCKET u, const sockaddr* name, int namelen)
@@ -672,7 +794,7 @@ UDTSOCKET CUDTUnited::accept(const UDTSOCKET listen, sockaddr* addr, int* addrle
             pthread_cond_wait(&(ls->m_AcceptCond), &(ls->m_AcceptLock));
 
          if (ls->m_pQueuedSockets->empty())
-            m_EPoll.update_events(listen, ls->m_pUDT->m_sPollID, UDT_EPOLL_IN, false);
+            ls->m_pUDT->updateEPoll(UDT_EPOLL_IN, false);
 
          pthread_mutex_unlock(&(ls->m_AcceptLock));
       }
@@ -705,7 +827,7 @@ UDTSOCKET CUDTUnited::accept(const UDTSOCKET listen, sockaddr* addr, int* addrle
          }
 
          if (ls->m_pQueuedSockets->empty())
-            m_EPoll.update_events(listen, ls->m_pUDT->m_sPollID, UDT_EPOLL_IN, false);
+            ls->m_pUDT->updateEPoll(UDT_EPOLL_IN, false);
       }
    #endif
 
@@ -831,6 +953,7 @@ int CUDTUnited::close(const UDTSOCKET u)
 
       s->m_TimeStamp = CTimer::getTime();
       s->m_pUDT->m_bBroken = true;
+      scheduleGC(u, s->m_TimeStamp + 3000000);
 
       // broadcast all "accept" waiting
       #ifndef WIN32
@@ -850,10 +973,9 @@ int CUDTUnited::close(const UDTSOCKET u)
    CGuard manager_cg(m_ControlLock);
 
    // since "s" is located before m_ControlLock, locate it again in case it became invalid
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
-   if ((i == m_Sockets.end()) || (i->second->m_Status == CLOSED))
+   s = m_Sockets.find(u);
+   if ((NULL == s) || (s->m_Status == CLOSED))
       return 0;
-   s = i->second;
 
    s->m_Status = CLOSED;
 
@@ -865,6 +987,9 @@ int CUDTUnited::close(const UDTSOCKET u)
    m_Sockets.erase(s->m_SocketID);
    m_ClosedSockets.insert(pair<UDTSOCKET, CUDTSocket*>(s->m_SocketID, s));
 
+   // a lingering socket is looked at at once, to set its next check
+   scheduleGC(s->m_SocketID, (s->m_pUDT->m_ullLingerExpiration > 0) ? 0 : s->m_TimeStamp + 1000001);
+
    CTimer::triggerEvent();
 
    return 0;
@@ -975,34 +1100,70 @@ int CUDTUnited::select(ud_set* readfds, ud_set* writefds, ud_set* exceptfds, con
             eu.push_back(s);
       }
 
-   do
+   // the sockets are all queried once; if none is ready, the call watches them and from then on only queries
+   // those with events turned on, see watchSelect()
+   CSelectWaiter w;
+   w.m_vNodes.resize(ru.size() + wu.size());
+   vector<CSelectNode*> query, pending, ready;
+   query.reserve(w.m_vNodes.size());
+   pending.reserve(w.m_vNodes.size());
+   ready.reserve(w.m_vNodes.size());
+   for (vector<CSelectNode>::size_type k = 0; k < w.m_vNodes.size(); ++ k)
+   {
+      CSelectNode* n = &w.m_vNodes[k];
+      n->m_pSocket = (k < ru.size()) ? ru[k] : wu[k - ru.size()];
+      n->m_iID = n->m_pSocket->m_SocketID;
+      n->m_iEvents = ((k < ru.size()) ? UDT_EPOLL_IN : UDT_EPOLL_OUT) | UDT_EPOLL_ERR;
+      n->m_bQueued = false;
+      query.push_back(n);
+   }
+
+   bool watching = false;
+   while (true)
    {
-      // query read sockets
-      for (vector<CUDTSocket*>::iterator j1 = ru.begin(); j1 != ru.end(); ++ j1)
+      pending.clear();
+
+      // query read and write sockets
+      for (vector<CSelectNode*>::iterator j = query.begin(); j != query.end(); ++ j)
       {
-         s = *j1;
+         CSelectNode* n = *j;
+         n->m_bQueued = false;
+         s = locate(n->m_iID);
+         n->m_pSocket = s;
 
-         if ((s->m_pUDT->m_bConnected && (s->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && ((s->m_pUDT->m_iSockType == UDT_STREAM) || (s->m_pUDT->m_pRcvBuffer->getRcvMsgNum() > 0)))
-            || (!s->m_pUDT->m_bListening && (s->m_pUDT->m_bBroken || !s->m_pUDT->m_bConnected))
-            || (s->m_pUDT->m_bListening && (s->m_pQueuedSockets->size() > 0))
-            || (s->m_Status == CLOSED))
+         bool on;
+         if (NULL == s)
          {
-            rs.insert(s->m_SocketID);
-            ++ count;
+            // closed or deleted meanwhile
+            on = true;
+         }
+         else if (n->m_iEvents & UDT_EPOLL_IN)
+         {
+            on = (s->m_pUDT->m_bConnected && (s->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && ((s->m_pUDT->m_iSockType == UDT_STREAM) || (s->m_pUDT->m_pRcvBuffer->getRcvMsgNum() > 0)))
+               || (!s->m_pUDT->m_bListening && (s->m_pUDT->m_bBroken || !s->m_pUDT->m_bConnected))
+               || (s->m_pUDT->m_bListening && (s->m_pQueuedSockets->size() > 0))
+               || (s->m_Status == CLOSED);
+         }
+         else
+         {
+            on = (s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufSize))
+               || s->m_pUDT->m_bBroken || !s->m_pUDT->m_bConnected || (s->m_Status == CLOSED);
          }
-      }
-
-      // query write sockets
-      for (vector<CUDTSocket*>::iterator j2 = wu.begin(); j2 != wu.end(); ++ j2)
-      {
-         s = *j2;
 
-         if ((s->m_pUDT->m_bConnected && (s->m_pUDT->m_pSndBuffer->getCurrBufSize() < s->m_pUDT->m_iSndBufSize))
-            || s->m_pUDT->m_bBroken || !s->m_pUDT->m_bConnected || (s->m_Status == CLOSED))
+         if (on)
          {
-            ws.insert(s->m_SocketID);
+            if (n->m_iEvents & UDT_EPOLL_IN)
+               rs.insert(n->m_iID);
+            else
+               ws.insert(n->m_iID);
             ++ count;
          }
+         else if (watching && (s->m_pUDT->m_iEPollEvents & n->m_iEvents))
+         {
+            // the events are on but not enough yet, e.g., with part of a message only, and they do not turn on again
+            n->m_bQueued = true;
+            pending.push_back(n);
+         }
       }
 
       // query exceptions on sockets
@@ -1014,8 +1175,33 @@ int CUDTUnited::select(ud_set* readfds, ud_set* writefds, ud_set* exceptfds, con
       if (0 < count)
          break;
 
-      CTimer::waitForEvent();
-   } while (to > CTimer::getTime() - entertime);
+      if (to <= CTimer::getTime() - entertime)
+         break;
+
+      if (!watching)
+      {
+         // the sockets are queried again once watched, so that no event in between is missed
+         watchSelect(w);
+         watching = true;
+         continue;
+      }
+
+      // the pending sockets are looked at again as often as CTimer::waitForEvent() returns
+      uint64_t deadline = (0xFFFFFFFFFFFFFFFFULL == to) ? to : entertime + to;
+      if (!pending.empty())
+         deadline = min(deadline, CTimer::getTime() + 10000);
+      waitSelect(w, deadline, ready);
+
+      query.swap(pending);
+      for (vector<CSelectNode*>::iterator k = ready.begin(); k != ready.end(); ++ k)
+      {
+         if (!(*k)->m_bQueued)
+            query.push_back(*k);
+      }
+   }
+
+   if (watching)
+      unwatchSelect(w);
 
    if (NULL != readfds)
       *readfds = rs;
@@ -1048,22 +1234,55 @@ int CUDTUnited::selectEx(const vector<UDTSOCKET>& fds, vector<UDTSOCKET>* readfd
    if (NULL != exceptfds)
       exceptfds->clear();
 
-   do
+   // the sockets are all queried once; if none is ready, the call watches them and from then on only queries
+   // those with events turned on, see watchSelect()
+   int mask = 0;
+   if (NULL != readfds)
+      mask |= UDT_EPOLL_IN;
+   if (NULL != writefds)
+      mask |= UDT_EPOLL_OUT;
+   if (NULL != exceptfds)
+      mask |= UDT_EPOLL_ERR;
+   CSelectWaiter w;
+   w.m_vNodes.resize(fds.size());
+   vector<CSelectNode*> query, pending, ready;
+   query.reserve(w.m_vNodes.size());
+   pending.reserve(w.m_vNodes.size());
+   ready.reserve(w.m_vNodes.size());
+   for (vector<UDTSOCKET>::size_type k = 0; k < fds.size(); ++ k)
+   {
+      CSelectNode* n = &w.m_vNodes[k];
+      n->m_iID = fds[k];
+      n->m_pSocket = NULL;
+      n->m_iEvents = mask;
+      n->m_bQueued = false;
+      query.push_back(n);
+   }
+
+   bool watching = false;
+   while (true)
    {
-      for (vector<UDTSOCKET>::const_iterator i = fds.begin(); i != fds.end(); ++ i)
+      pending.clear();
+
+      for (vector<CSelectNode*>::iterator i = query.begin(); i != query.end(); ++ i)
       {
-         CUDTSocket* s = locate(*i);
+         CSelectNode* n = *i;
+         n->m_bQueued = false;
+         CUDTSocket* s = locate(n->m_iID);
+         n->m_pSocket = s;
 
          if ((NULL == s) || s->m_pUDT->m_bBroken || (s->m_Status == CLOSED))
          {
             if (NULL != exceptfds)
             {
-               exceptfds->push_back(*i);
+               exceptfds->push_back(n->m_iID);
                ++ count;
             }
             continue;
          }
 
+         int found = count;
+
          if (NULL != readfds)
          {
             if ((s->m_pUDT->m_bConnected && (s->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && ((s->m_pUDT->m_iSockType == UDT_STREAM) || (s->m_pUDT->m_pRcvBuffer->getRcvMsgNum() > 0)))
@@ -1082,17 +1301,211 @@ int CUDTUnited::selectEx(const vector<UDTSOCKET>& fds, vector<UDTSOCKET>* readfd
                ++ count;
             }
          }
+
+         if (watching && (found == count) && (s->m_pUDT->m_iEPollEvents & n->m_iEvents))
+         {
+            // the events are on but not enough yet, e.g., with part of a message only, and they do not turn on again
+            n->m_bQueued = true;
+            pending.push_back(n);
+         }
       }
 
       if (count > 0)
          break;
 
-      CTimer::waitForEvent();
-   } while (to > CTimer::getTime() - entertime);
+      if (to <= CTimer::getTime() - entertime)
+         break;
+
+      if (!watching)
+      {
+         // the sockets are queried again once watched, so that no event in between is missed
+         watchSelect(w);
+         watching = true;
+         continue;
+      }
+
+      // the pending sockets are looked at again as often as CTimer::waitForEvent() returns
+      uint64_t deadline = (0xFFFFFFFFFFFFFFFFULL == to) ? to : entertime + to;
+      if (!pending.empty())
+         deadline = min(deadline, CTimer::getTime() + 10000);
+      waitSelect(w, deadline, ready);
+
+      query.swap(pending);
+      for (vector<CSelectNode*>::iterator k = ready.begin(); k != ready.end(); ++ k)
+      {
+         if (!(*k)->m_bQueued)
+            query.push_back(*k);
+      }
+   }
+
+   if (watching)
+      unwatchSelect(w);
 
    return count;
 }
 
+void CUDTUnited::watchSelect(CSelectWaiter& w)
+{
+   #ifndef WIN32
+      pthread_cond_init(&w.m_ReadyCond, NULL);
+   #else
+      w.m_ReadyCond = CreateEvent(NULL, false, false, NULL);
+   #endif
+
+   // reserved, so that notifySelect() does not allocate
+   w.m_vReady.reserve(w.m_vNodes.size());
+
+   CGuard sg(m_SelectLock);
+
+   for (vector<CSelectNode>::iterator i = w.m_vNodes.begin(); i != w.m_vNodes.end(); ++ i)
+   {
+      CSelectNode* n = &*i;
+      n->m_pUDT = (NULL != n->m_pSocket) ? n->m_pSocket->m_pUDT : NULL;
+      n->m_bReady = false;
+      n->m_pWaiter = &w;
+      n->m_pPrev = NULL;
+      n->m_pNext = NULL;
+
+      if ((NULL == n->m_pUDT) || (0 == n->m_iEvents))
+         continue;
+
+      n->m_pNext = n->m_pUDT->m_pSelectNodes;
+      if (NULL != n->m_pNext)
+         n->m_pNext->m_pPrev = n;
+      n->m_pUDT->m_pSelectNodes = n;
+
+      // the count is raised before the caller queries the socket again, and the socket turns an event on before
+      // it reads the count, so that either the query or the node sees it
+      CAtomic::add(&n->m_pUDT->m_iSelectCount, 1);
+   }
+}
+
+void CUDTUnited::unwatchSelect(CSelectWaiter& w)
+{
+   {
+      CGuard sg(m_SelectLock);
+
+      for (vector<CSelectNode>::iterator i = w.m_vNodes.begin(); i != w.m_vNodes.end(); ++ i)
+      {
+         CSelectNode* n = &*i;
+
+         // not linked, or unlinked by dropSelect()
+         if ((NULL == n->m_pUDT) || (0 == n->m_iEvents))
+            continue;
+
+         if (NULL != n->m_pPrev)
+            n->m_pPrev->m_pNext = n->m_pNext;
+         else
+            n->m_pUDT->m_pSelectNodes = n->m_pNext;
+         if (NULL != n->m_pNext)
+            n->m_pNext->m_pPrev = n->m_pPrev;
+
+         CAtomic::add(&n->m_pUDT->m_iSelectCount, -1);
+      }
+   }
+
+   #ifndef WIN32
+      pthread_cond_destroy(&w.m_ReadyCond);
+   #else
+      CloseHandle(w.m_ReadyCond);
+   #endif
+}
+
+void CUDTUnited::waitSelect(CSelectWaiter& w, uint64_t deadline, vector<CSelectNode*>& ready)
+{
+   ready.clear();
+
+   CGuard sg(m_SelectLock);
+
+   if (w.m_vReady.empty())
+   {
+      uint64_t now = CTimer::getTime();
+
+      #ifndef WIN32
+         if (0xFFFFFFFFFFFFFFFFULL == deadline)
+         {
+            pthread_cond_wait(&w.m_ReadyCond, &m_SelectLock);
+         }
+         else if (deadline > now)
+         {
+            timeval tv;
+            timespec timeout;
+            gettimeofday(&tv, 0);
+            uint64_t wakeup = tv.tv_usec + (deadline - now);
+            timeout.tv_sec = tv.tv_sec + wakeup / 1000000;
+            timeout.tv_nsec = (wakeup % 1000000) * 1000;
+            pthread_cond_timedwait(&w.m_ReadyCond, &m_SelectLock, &timeout);
+         }
+      #else
+         if (deadline > now)
+         {
+            CGuard::leaveCS(m_SelectLock);
+            WaitForSingleObject(w.m_ReadyCond, (0xFFFFFFFFFFFFFFFFULL == deadline) ? INFINITE : DWORD((deadline - now + 999) / 1000));
+            CGuard::enterCS(m_SelectLock);
+         }
+      #endif
+   }
+
+   // the ready list keeps its capacity
+   ready.insert(ready.end(), w.m_vReady.begin(), w.m_vReady.end());
+   w.m_vReady.clear();
+   for (vector<CSelectNode*>::iterator i = ready.begin(); i != ready.end(); ++ i)
+      (*i)->m_bReady = false;
+}
+
+void CUDTUnited::notifySelect(CUDT* u, const int events)
+{
+   CGuard sg(m_SelectLock);
+
+   for (CSelectNode* n = u->m_pSelectNodes; NULL != n; n = n->m_pNext)
+   {
+      if ((0 == (n->m_iEvents & events)) || n->m_bReady)
+         continue;
+
+      n->m_bReady = true;
+      n->m_pWaiter->m_vReady.push_back(n);
+
+      #ifndef WIN32
+         pthread_cond_signal(&n->m_pWaiter->m_ReadyCond);
+      #else
+         SetEvent(n->m_pWaiter->m_ReadyCond);
+      #endif
+   }
+}
+
+void CUDTUnited::dropSelect(CUDT* u)
+{
+   CGuard sg(m_SelectLock);
+
+   CSelectNode* n = u->m_pSelectNodes;
+   while (NULL != n)
+   {
+      CSelectNode* next = n->m_pNext;
+
+      // the call finds the node gone once it wakes up
+      n->m_pUDT = NULL;
+      n->m_pPrev = NULL;
+      n->m_pNext = NULL;
+
+      if (!n->m_bReady)
+      {
+         n->m_bReady = true;
+         n->m_pWaiter->m_vReady.push_back(n);
+
+         #ifndef WIN32
+            pthread_cond_signal(&n->m_pWaiter->m_ReadyCond);
+         #else
+            SetEvent(n->m_pWaiter->m_ReadyCond);
+         #endif
+      }
+
+      n = next;
+   }
+
+   u->m_pSelectNodes = NULL;
+   u->m_iSelectCount = 0;
+}
+
 int CUDTUnited::epoll_create()
 {
    return m_EPoll.create();
@@ -1147,6 +1560,16 @@ int CUDTUnited::epoll_wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET
    return m_EPoll.wait(eid, readfds, writefds, msTimeOut, lrfds, lwfds);
 }
 
+int CUDTUnited::epoll_uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut)
+{
+   return m_EPoll.uwait(eid, events, maxevents, msTimeOut);
+}
+
+int CUDTUnited::epoll_getfd(const int eid)
+{
+   return m_EPoll.getfd(eid);
+}
+
 int CUDTUnited::epoll_release(const int eid)
 {
    return m_EPoll.release(eid);
@@ -1154,14 +1577,12 @@ int CUDTUnited::epoll_release(const int eid)
 
 CUDTSocket* CUDTUnited::locate(const UDTSOCKET u)
 {
-   CGuard cg(m_ControlLock);
+   CUDTSocket* s = m_Sockets.find(u);
 
-   map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.find(u);
-
-   if ((i == m_Sockets.end()) || (i->second->m_Status == CLOSED))
+   if ((NULL == s) || (s->m_Status == CLOSED))
       return NULL;
 
-   return i->second;
+   return s;
 }
 
 CUDTSocket* CUDTUnited::locate(const sockaddr* peer, const UDTSOCKET id, int32_t isn)
@@ -1174,96 +1595,173 @@ CUDTSocket* CUDTUnited::locate(const sockaddr* peer, const UDTSOCKET id, int32_t
 
    for (set<UDTSOCKET>::iterator j = i->second.begin(); j != i->second.end(); ++ j)
    {
-      map<UDTSOCKET, CUDTSocket*>::iterator k = m_Sockets.find(*j);
+      CUDTSocket* s = m_Sockets.find(*j);
       // this socket might have been closed and moved m_ClosedSockets
-      if (k == m_Sockets.end())
+      if (NULL == s)
          continue;
 
-      if (CIPAddress::ipcmp(peer, k->second->m_pPeerAddr, k->second->m_iIPversion))
-         return k->second;
+      if (CIPAddress::ipcmp(peer, s->m_pPeerAddr, s->m_iIPversion))
+         return s;
    }
 
    return NULL;
 }
 
+void CUDTUnited::scheduleGC(const UDTSOCKET u, uint64_t deadline)
+{
+   CGuard gcguard(m_GCStopLock);
+
+   // a socket is in the queue once, at its earliest deadline
+   map<UDTSOCKET, uint64_t>::iterator i = m_GCDeadline.find(u);
+   if (i != m_GCDeadline.end())
+   {
+      if (i->second <= deadline)
+         return;
+      m_GCQueue.erase(pair<uint64_t, UDTSOCKET>(i->second, u));
+   }
+
+   m_GCDeadline[u] = deadline;
+   m_GCQueue.insert(pair<uint64_t, UDTSOCKET>(deadline, u));
+
+   // wake the GC up if it sleeps beyond the new deadline
+   if (deadline < m_ullGCWakeTime)
+   {
+      #ifndef WIN32
+         pthread_cond_signal(&m_GCStopCond);
+      #else
+         SetEvent(m_GCStopCond);
+      #endif
+   }
+}
+
 void CUDTUnited::checkBrokenSockets()
 {
-   CGuard cg(m_ControlLock);
+   // take the sockets due, those changing state meanwhile are queued again
+   vector<UDTSOCKET> due;
+   uint64_t currtime = CTimer::getTime();
+
+   CGuard::enterCS(m_GCStopLock);
+   while (!m_GCQueue.empty() && (m_GCQueue.begin()->first <= currtime))
+   {
+      due.push_back(m_GCQueue.begin()->second);
+      m_GCDeadline.erase(m_GCQueue.begin()->second);
+      m_GCQueue.erase(m_GCQueue.begin());
+   }
+   CGuard::leaveCS(m_GCStopLock);
+
+   if (due.empty())
+      return;
+
+   vector<CUDTSocket*> removed;
+   vector<CMultiplexer> closed;
 
-   // set of sockets To Be Closed and To Be Removed
-   vector<UDTSOCKET> tbc;
-   vector<UDTSOCKET> tbr;
+   CGuard::enterCS(m_ControlLock);
+   for (vector<UDTSOCKET>::iterator i = due.begin(); i != due.end(); ++ i)
+   {
+      uint64_t next = checkBrokenSocket(*i);
+      if (next > 0)
+         scheduleGC(*i, next);
+   }
+   removed.swap(m_vRemovedSockets);
+   closed.swap(m_vClosedMux);
+   CGuard::leaveCS(m_ControlLock);
+
+   // new connections need m_ControlLock, so the sockets and their multiplexers are deleted out of it
+   for (vector<CUDTSocket*>::iterator s = removed.begin(); s != removed.end(); ++ s)
+   {
+      (*s)->m_pUDT->close();
+      delete *s;
+   }
+
+   // a receiving thread looks at its flag every 10 ms, so all of them are stopped before the first one is waited for
+   for (vector<CMultiplexer>::iterator m = closed.begin(); m != closed.end(); ++ m)
+      m->m_pRcvQueue->m_bClosing = true;
+   for (vector<CMultiplexer>::iterator m = closed.begin(); m != closed.end(); ++ m)
+   {
+      m->m_pChannel->close();
+      delete m->m_pSndQueue;
+      delete m->m_pRcvQueue;
+      delete m->m_pTimer;
+      delete m->m_pChannel;
+   }
+}
+
+uint64_t CUDTUnited::checkBrokenSocket(const UDTSOCKET u)
+{
+   uint64_t currtime = CTimer::getTime();
 
-   // cleanup֮m_SocketsgarbageCollectᱻǿ
-   for (map<UDTSOCKET, CUDTSocket*>::iterator i = m_Sockets.begin(); i != m_Sockets.end(); ++ i)
+   CUDTSocket* s = m_Sockets.find(u);
+   if (NULL != s)
    {
       // check broken connection
-      if (i->second->m_pUDT->m_bBroken)
+      if (!s->m_pUDT->m_bBroken)
+         return 0;
+
+      if (s->m_Status == LISTENING)
       {
-         if (i->second->m_Status == LISTENING)
-         {
-            // for a listening socket, it should wait an extra 3 seconds in case a client is connecting
-            if (CTimer::getTime() - i->second->m_TimeStamp < 3000000)
-               continue;
-         }
-         else if ((i->second->m_pUDT->m_pRcvBuffer != NULL) && (i->second->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && (i->second->m_pUDT->m_iBrokenCounter -- > 0))
-         {
-            // if there is still data in the receiver buffer, wait longer
-            continue;
-         }
+         // for a listening socket, it should wait an extra 3 seconds in case a client is connecting
+         if (currtime - s->m_TimeStamp < 3000000)
+            return s->m_TimeStamp + 3000000;
+      }
+      else if ((s->m_pUDT->m_pRcvBuffer != NULL) && (s->m_pUDT->m_pRcvBuffer->getRcvDataSize() > 0) && (s->m_pUDT->m_iBrokenCounter -- > 0))
+      {
+         // if there is still data in the receiver buffer, wait longer
+         return currtime + 1000000;
+      }
 
-         //close broken connections and start removal timer
-         i->second->m_Status = CLOSED;
-         i->second->m_TimeStamp = CTimer::getTime();
-         tbc.push_back(i->first);
-         m_ClosedSockets[i->first] = i->second;
+      //close broken connections and start removal timer
+      s->m_Status = CLOSED;
+      s->m_TimeStamp = currtime;
+      m_ClosedSockets[u] = s;
+      m_Sockets.erase(u);
 
-         // remove from listener's queue
-         map<UDTSOCKET, CUDTSocket*>::iterator ls = m_Sockets.find(i->second->m_ListenSocket);
-         if (ls == m_Sockets.end())
-         {
-            ls = m_ClosedSockets.find(i->second->m_ListenSocket);
-            if (ls == m_ClosedSockets.end())
-               continue;
-         }
+      // remove from listener's queue
+      CUDTSocket* ls = m_Sockets.find(s->m_ListenSocket);
+      if (NULL == ls)
+      {
+         map<UDTSOCKET, CUDTSocket*>::iterator cls = m_ClosedSockets.find(s->m_ListenSocket);
+         if (cls != m_ClosedSockets.end())
+            ls = cls->second;
+      }
 
-         CGuard::enterCS(ls->second->m_AcceptLock);
-         ls->second->m_pQueuedSockets->erase(i->second->m_SocketID);
-         ls->second->m_pAcceptSockets->erase(i->second->m_SocketID);
-         CGuard::leaveCS(ls->second->m_AcceptLock);
+      if (NULL != ls)
+      {
+         CGuard::enterCS(ls->m_AcceptLock);
+         ls->m_pQueuedSockets->erase(u);
+         ls->m_pAcceptSockets->erase(u);
+         CGuard::leaveCS(ls->m_AcceptLock);
       }
    }
 
-   // ر׽֡cleanupǿ׽ֽ뵽ر״̬
-   for (map<UDTSOCKET, CUDTSocket*>::iterator j = m_ClosedSockets.begin(); j != m_ClosedSockets.end(); ++ j)
+   map<UDTSOCKET, CUDTSocket*>::iterator j = m_ClosedSockets.find(u);
+   if (j == m_ClosedSockets.end())
+      return 0;
+
+   if (j->second->m_pUDT->m_ullLingerExpiration > 0)
    {
-      if (j->second->m_pUDT->m_ullLingerExpiration > 0)
+      // asynchronous close: wait until the data are sent or the linger time expires
+      if ((NULL == j->second->m_pUDT->m_pSndBuffer) || (0 == j->second->m_pUDT->m_pSndBuffer->getCurrBufSize()) || (j->second->m_pUDT->m_ullLingerExpiration <= currtime))
       {
-         // asynchronous close: 
-         // 첽رյ׽֣ûдݻȴͳʱ
-         if ((NULL == j->second->m_pUDT->m_pSndBuffer) || (0 == j->second->m_pUDT->m_pSndBuffer->getCurrBufSize()) || (j->second->m_pUDT->m_ullLingerExpiration <= CTimer::getTime()))
-         {
-            j->second->m_pUDT->m_ullLingerExpiration = 0;
-            j->second->m_pUDT->m_bClosing = true;
-            j->second->m_TimeStamp = CTimer::getTime();
-         }
+         j->second->m_pUDT->m_ullLingerExpiration = 0;
+         j->second->m_pUDT->m_bClosing = true;
+         j->second->m_TimeStamp = currtime;
       }
-
-      // timeout 1 second to destroy a socket AND it has been removed from RcvUList
-      // socket1sҴrecv queueĽնбɾ
-      if ((CTimer::getTime() - j->second->m_TimeStamp > 1000000) && ((NULL == j->second->m_pUDT->m_pRNode) || !j->second->m_pUDT->m_pRNode->m_bOnList))
+      else
       {
-         tbr.push_back(j->first);
+         // draining the buffer is not signalled, look again in a while
+         return min(j->second->m_pUDT->m_ullLingerExpiration, currtime + 1000000);
       }
    }
 
-   // move closed sockets to the ClosedSockets structure
-   for (vector<UDTSOCKET>::iterator k = tbc.begin(); k != tbc.end(); ++ k)
-      m_Sockets.erase(*k);
+   // timeout 1 second to destroy a socket AND it has been removed from RcvUList
+   if (currtime - j->second->m_TimeStamp <= 1000000)
+      return j->second->m_TimeStamp + 1000001;
+   if ((NULL != j->second->m_pUDT->m_pRNode) && j->second->m_pUDT->m_pRNode->m_bOnList)
+      return currtime + 100000;
 
-   // remove those timeout sockets
-   for (vector<UDTSOCKET>::iterator l = tbr.begin(); l != tbr.end(); ++ l)
-      removeSocket(*l);
+   removeSocket(u);
+
+   return 0;
 }
 
 void CUDTUnited::removeSocket(const UDTSOCKET u)
@@ -1285,12 +1783,17 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
       // if it is a listener, close all un-accepted sockets in its queue and remove them later
       for (set<UDTSOCKET>::iterator q = i->second->m_pQueuedSockets->begin(); q != i->second->m_pQueuedSockets->end(); ++ q)
       {
-         m_Sockets[*q]->m_pUDT->m_bBroken = true;
-         m_Sockets[*q]->m_pUDT->close();
-         m_Sockets[*q]->m_TimeStamp = CTimer::getTime();
-         m_Sockets[*q]->m_Status = CLOSED;
-         m_ClosedSockets[*q] = m_Sockets[*q];
+         CUDTSocket* qs = m_Sockets.find(*q);
+         if (NULL == qs)
+            continue;
+
+         qs->m_pUDT->m_bBroken = true;
+         qs->m_pUDT->close();
+         qs->m_TimeStamp = CTimer::getTime();
+         qs->m_Status = CLOSED;
+         m_ClosedSockets[*q] = qs;
          m_Sockets.erase(*q);
+         scheduleGC(*q, qs->m_TimeStamp + 1000001);
       }
 
       CGuard::leaveCS(i->second->m_AcceptLock);
@@ -1305,9 +1808,8 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
          m_PeerRec.erase(j);
    }
 
-   // delete this one
-   i->second->m_pUDT->close();
-   delete i->second;
+   // checkBrokenSockets() deletes this one once m_ControlLock is released
+   m_vRemovedSockets.push_back(i->second);
    m_ClosedSockets.erase(i);
 
    map<int, CMultiplexer>::iterator m;
@@ -1322,11 +1824,8 @@ void CUDTUnited::removeSocket(const UDTSOCKET u)
    m->second.m_iRefCount --;
    if (0 == m->second.m_iRefCount)
    {
-      m->second.m_pChannel->close();
-      delete m->second.m_pSndQueue;
-      delete m->second.m_pRcvQueue;
-      delete m->second.m_pTimer;
-      delete m->second.m_pChannel;
+      // checkBrokenSockets() deletes it once m_ControlLock is released
+      m_vClosedMux.push_back(m->second);
       m_mMultiplexer.erase(m);
    }
 }
@@ -1505,7 +2004,7 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
 {
    CUDTUnited* self = (CUDTUnited*)p;
 
-   CGuard gcguard(self->m_GCStopLock);
+   uint64_t savetime = CTimer::getTime();
 
    // 1sһ
    while (!self->m_bClosing)
@@ -1517,45 +2016,74 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
          self->checkTLSValue();
       #endif
 
-      #ifndef WIN32
-         timeval now;
-         timespec timeout;
-         gettimeofday(&now, 0);
-         timeout.tv_sec = now.tv_sec + 1;
-         timeout.tv_nsec = now.tv_usec * 1000;
+      // the cache is saved now and then, a process that is killed loses no more than the last period
+      if (CTimer::getTime() - savetime > m_iCacheSaveInterval * 1000000ULL)
+      {
+         self->saveCache();
+         savetime = CTimer::getTime();
+      }
 
-         pthread_cond_timedwait(&self->m_GCStopCond, &self->m_GCStopLock, &timeout);
+      // sleep until the next socket is due, or for 1 second at most; scheduleGC() wakes us up for an earlier one
+      CGuard::enterCS(self->m_GCStopLock);
+      uint64_t currtime = CTimer::getTime();
+      self->m_ullGCWakeTime = currtime + 1000000;
+      if (!self->m_GCQueue.empty() && (self->m_GCQueue.begin()->first < self->m_ullGCWakeTime))
+         self->m_ullGCWakeTime = max(self->m_GCQueue.begin()->first, currtime);
+      uint64_t sleeptime = self->m_ullGCWakeTime - currtime;
+
+      #ifndef WIN32
+         if (!self->m_bClosing && (sleeptime > 0))
+         {
+            timeval now;
+            timespec timeout;
+            gettimeofday(&now, 0);
+            uint64_t wakeup = now.tv_usec + sleeptime;
+            timeout.tv_sec = now.tv_sec + wakeup / 1000000;
+            timeout.tv_nsec = (wakeup % 1000000) * 1000;
+
+            pthread_cond_timedwait(&self->m_GCStopCond, &self->m_GCStopLock, &timeout);
+         }
+         self->m_ullGCWakeTime = 0;
+         CGuard::leaveCS(self->m_GCStopLock);
       #else
-         WaitForSingleObject(self->m_GCStopCond, 1000);
+         CGuard::leaveCS(self->m_GCStopLock);
+         if (!self->m_bClosing && (sleeptime > 0))
+            WaitForSingleObject(self->m_GCStopCond, DWORD((sleeptime + 999) / 1000));
+         CGuard::enterCS(self->m_GCStopLock);
+         self->m_ullGCWakeTime = 0;
+         CGuard::leaveCS(self->m_GCStopLock);
       #endif
    }
 
    // remove all sockets and multiplexers
    CGuard::enterCS(self->m_ControlLock);
-   for (map<UDTSOCKET, CUDTSocket*>::iterator i = self->m_Sockets.begin(); i != self->m_Sockets.end(); ++ i)
+   vector<CUDTSocket*> sockets;
+   self->m_Sockets.list(sockets);
+   for (vector<CUDTSocket*>::iterator i = sockets.begin(); i != sockets.end(); ++ i)
    {
       // ϣùرգΪCLOSED¹رʱSocketѹرб
-      i->second->m_pUDT->m_bBroken = true;
-      i->second->m_pUDT->close();
-      i->second->m_Status = CLOSED;
-      i->second->m_TimeStamp = CTimer::getTime();
-      self->m_ClosedSockets[i->first] = i->second;
+      (*i)->m_pUDT->m_bBroken = true;
+      (*i)->m_pUDT->close();
+      (*i)->m_Status = CLOSED;
+      (*i)->m_TimeStamp = CTimer::getTime();
+      self->m_ClosedSockets[(*i)->m_SocketID] = *i;
 
       // remove from listener's queue
       // жϸ׽Ƿĳһ׽ֽģһ׽ֽ
-      map<UDTSOCKET, CUDTSocket*>::iterator ls = self->m_Sockets.find(i->second->m_ListenSocket);
-      if (ls == self->m_Sockets.end())
+      CUDTSocket* ls = self->m_Sockets.find((*i)->m_ListenSocket);
+      if (NULL == ls)
       {
-         ls = self->m_ClosedSockets.find(i->second->m_ListenSocket);
-         if (ls == self->m_ClosedSockets.end())
+         map<UDTSOCKET, CUDTSocket*>::iterator cls = self->m_ClosedSockets.find((*i)->m_ListenSocket);
+         if (cls == self->m_ClosedSockets.end())
             continue;
+         ls = cls->second;
       }
 
       // lsΪ׽֣ls׽ֶȥ׽
-      CGuard::enterCS(ls->second->m_AcceptLock);
-      ls->second->m_pQueuedSockets->erase(i->second->m_SocketID);
-      ls->second->m_pAcceptSockets->erase(i->second->m_SocketID);
-      CGuard::leaveCS(ls->second->m_AcceptLock);
+      CGuard::enterCS(ls->m_AcceptLock);
+      ls->m_pQueuedSockets->erase((*i)->m_SocketID);
+      ls->m_pAcceptSockets->erase((*i)->m_SocketID);
+      CGuard::leaveCS(ls->m_AcceptLock);
    }
    self->m_Sockets.clear();
 
@@ -1563,6 +2091,7 @@ void CUDTUnited::updateMux(CUDTSocket* s, const CUDTSocket* ls)
    for (map<UDTSOCKET, CUDTSocket*>::iterator j = self->m_ClosedSockets.begin(); j != self->m_ClosedSockets.end(); ++ j)
    {
       j->second->m_TimeStamp = 0;
+      self->scheduleGC(j->first, 0);
    }
    CGuard::leaveCS(self->m_ControlLock);
 
@@ -1599,6 +2128,19 @@ int CUDT::cleanup()
    return s_UDTUnited.cleanup();
 }
 
+int CUDT::setcachefile(const char* file, int ttl)
+{
+   try
+   {
+      return s_UDTUnited.setCacheFile(file, ttl);
+   }
+   catch (CUDTException& e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+}
+
 UDTSOCKET CUDT::socket(int af, int type, int)
 {
    if (!s_UDTUnited.m_bGCStatus)
@@ -1915,6 +2457,82 @@ int CUDT::recvmsg(UDTSOCKET u, char* buf, int len)
    }
 }
 
+int CUDT::sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->sendv(iov, iovcnt);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->recvv(iov, iovcnt);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::sendmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int ttl, bool inorder)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->sendmsg_batch(msgs, num, ttl, inorder);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::recvmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int* lens)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->recvmsg_batch(msgs, num, lens);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int64_t CUDT::sendfile(UDTSOCKET u, fstream& ifs, int64_t& offset, int64_t size, int block)
 {
    try
@@ -1939,6 +2557,30 @@ int64_t CUDT::sendfile(UDTSOCKET u, fstream& ifs, int64_t& offset, int64_t size,
    }
 }
 
+int64_t CUDT::sendfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->sendfile(fd, offset, size, block);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (bad_alloc&)
+   {
+      s_UDTUnited.setError(new CUDTException(3, 2, 0));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int64_t CUDT::recvfile(UDTSOCKET u, fstream& ofs, int64_t& offset, int64_t size, int block)
 {
    try
@@ -1958,6 +2600,25 @@ int64_t CUDT::recvfile(UDTSOCKET u, fstream& ofs, int64_t& offset, int64_t size,
    }
 }
 
+int64_t CUDT::recvfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block)
+{
+   try
+   {
+      CUDT* udt = s_UDTUnited.lookup(u);
+      return udt->recvfile(fd, offset, size, block);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int CUDT::select(int, ud_set* readfds, ud_set* writefds, ud_set* exceptfds, const timeval* timeout)
 {
    if ((NULL == readfds) && (NULL == writefds) && (NULL == exceptfds))
@@ -2124,6 +2785,42 @@ int CUDT::epoll_wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* wri
    }
 }
 
+int CUDT::epoll_uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut)
+{
+   try
+   {
+      return s_UDTUnited.epoll_uwait(eid, events, maxevents, msTimeOut);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
+int CUDT::epoll_getfd(const int eid)
+{
+   try
+   {
+      return s_UDTUnited.epoll_getfd(eid);
+   }
+   catch (CUDTException e)
+   {
+      s_UDTUnited.setError(new CUDTException(e));
+      return ERROR;
+   }
+   catch (...)
+   {
+      s_UDTUnited.setError(new CUDTException(-1, 0, 0));
+      return ERROR;
+   }
+}
+
 int CUDT::epoll_release(const int eid)
 {
    try
@@ -2208,6 +2905,11 @@ int cleanup()
    return CUDT::cleanup();
 }
 
+int setcachefile(const char* file, int ttl)
+{
+   return CUDT::setcachefile(file, ttl);
+}
+
 UDTSOCKET socket(int af, int type, int protocol)
 {
    return CUDT::socket(af, type, protocol);
@@ -2283,29 +2985,73 @@ int recvmsg(UDTSOCKET u, char* buf, int len)
    return CUDT::recvmsg(u, buf, len);
 }
 
+int sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags)
+{
+   return CUDT::sendv(u, iov, iovcnt, flags);
+}
+
+int recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags)
+{
+   return CUDT::recvv(u, iov, iovcnt, flags);
+}
+
+int sendmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int ttl, bool inorder)
+{
+   return CUDT::sendmsg_batch(u, msgs, num, ttl, inorder);
+}
+
+int recvmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int* lens)
+{
+   return CUDT::recvmsg_batch(u, msgs, num, lens);
+}
+
 int64_t sendfile(UDTSOCKET u, fstream& ifs, int64_t& offset, int64_t size, int block)
 {
    return CUDT::sendfile(u, ifs, offset, size, block);
 }
 
+int64_t sendfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block)
+{
+   return CUDT::sendfile(u, fd, offset, size, block);
+}
+
 int64_t recvfile(UDTSOCKET u, fstream& ofs, int64_t& offset, int64_t size, int block)
 {
    return CUDT::recvfile(u, ofs, offset, size, block);
 }
 
+int64_t recvfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block)
+{
+   return CUDT::recvfile(u, fd, offset, size, block);
+}
+
 int64_t sendfile2(UDTSOCKET u, const char* path, int64_t* offset, int64_t size, int block)
 {
+#ifndef WIN32
+   int fd = ::open(path, O_RDONLY);
+   int64_t ret = CUDT::sendfile(u, fd, *offset, size, block);
+   if (fd >= 0)
+      ::close(fd);
+#else
    fstream ifs(path, ios::binary | ios::in);
    int64_t ret = CUDT::sendfile(u, ifs, *offset, size, block);
    ifs.close();
+#endif
    return ret;
 }
 
 int64_t recvfile2(UDTSOCKET u, const char* path, int64_t* offset, int64_t size, int block)
 {
+#ifndef WIN32
+   int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   int64_t ret = CUDT::recvfile(u, fd, *offset, size, block);
+   if (fd >= 0)
+      ::close(fd);
+#else
    fstream ofs(path, ios::binary | ios::out);
    int64_t ret = CUDT::recvfile(u, ofs, *offset, size, block);
    ofs.close();
+#endif
    return ret;
 }
 
@@ -2399,6 +3145,16 @@ int epoll_wait2(int eid, UDTSOCKET* readfds, int* rnum, UDTSOCKET* writefds, int
    return ret;
 }
 
+int epoll_uwait(int eid, EPOLLEVENT* events, int maxevents, int64_t msTimeOut)
+{
+   return CUDT::epoll_uwait(eid, events, maxevents, msTimeOut);
+}
+
+int epoll_getfd(int eid)
+{
+   return CUDT::epoll_getfd(eid);
+}
+
 int epoll_release(int eid)
 {
    return CUDT::epoll_release(eid);
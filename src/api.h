@@ -51,6 +51,31 @@ written by
 #include "epoll.h"
 
 class CUDT;
+class CUDTSocket;
+struct CSelectWaiter;
+
+// A select() or selectEx() call that has to wait links one node per socket and set to the socket, and the events
+// turning on are sent to the nodes, so that the call only looks at the sockets that changed.
+
+struct CSelectNode
+{
+   UDTSOCKET m_iID;                          // UDT socket ID
+   CUDTSocket* m_pSocket;                    // socket watched
+   CUDT* m_pUDT;                             // UDT entity of the socket, NULL once it is deleted
+   int m_iEvents;                            // events watched
+   bool m_bReady;                            // if the node is in the ready list of the waiter
+   bool m_bQueued;                           // if the node is to be queried, used by the waiting thread only
+   CSelectWaiter* m_pWaiter;                 // call watching the socket
+   CSelectNode* m_pPrev;                     // previous node watching the same socket
+   CSelectNode* m_pNext;                     // next node watching the same socket
+};
+
+struct CSelectWaiter
+{
+   std::vector<CSelectNode> m_vNodes;        // nodes of the sockets watched
+   std::vector<CSelectNode*> m_vReady;       // nodes with events turned on since the last wait
+   pthread_cond_t m_ReadyCond;               // signalled when a node gets ready
+};
 
 class CUDTSocket
 {
@@ -93,6 +118,81 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// The table of the open sockets is split in shards by socket ID, each with its own lock, so that the API calls on
+// different sockets do not wait for each other. A reader takes the lock of one shard only; the writers also hold
+// the control lock of CUDTUnited, so that it is enough for walking through the whole table.
+
+class CSocketTable
+{
+public:
+   CSocketTable();
+   ~CSocketTable();
+
+public:
+
+      // Functionality:
+      //    find a socket.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    Pointer to the socket, or NULL if not in the table.
+
+   CUDTSocket* find(const UDTSOCKET u);
+
+      // Functionality:
+      //    add a socket, the caller holds the control lock.
+      // Parameters:
+      //    0) [in] s: the socket.
+      // Returned value:
+      //    None.
+
+   void insert(CUDTSocket* s);
+
+      // Functionality:
+      //    remove a socket, the caller holds the control lock.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      // Returned value:
+      //    None.
+
+   void erase(const UDTSOCKET u);
+
+      // Functionality:
+      //    copy all the sockets in the table, the caller holds the control lock.
+      // Parameters:
+      //    0) [out] sockets: storage for the sockets.
+      // Returned value:
+      //    None.
+
+   void list(std::vector<CUDTSocket*>& sockets);
+
+      // Functionality:
+      //    remove all sockets, the caller holds the control lock.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void clear();
+
+private:
+   struct CShard
+   {
+      pthread_mutex_t m_Lock;				// lock of the shard
+      std::map<UDTSOCKET, CUDTSocket*> m_Sockets;	// sockets whose IDs fall in the shard
+      char m_pcPad[64];					// keeps the locks of neighbour shards off the same cache line
+   };
+
+   static const int m_iShardNum = 64;			// socket IDs are consecutive, their low bits select the shard
+   CShard m_pShard[m_iShardNum];
+
+private:
+   CSocketTable(const CSocketTable&);
+   CSocketTable& operator=(const CSocketTable&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class CUDTUnited
 {
 friend class CUDT;
@@ -122,6 +222,16 @@ public:
 
    int cleanup();
 
+      // Functionality:
+      //    set the file the network information cache is kept in between two runs, and load it if started.
+      // Parameters:
+      //    0) [in] file: name of the file, NULL to keep the cache in memory only.
+      //    1) [in] ttl: information older than this is dropped, in seconds.
+      // Returned value:
+      //    0 if success, otherwise -1 is returned.
+
+   int setCacheFile(const char* file, int ttl);
+
       // Functionality:
       //    Create a new UDT socket.
       // Parameters:
@@ -179,6 +289,8 @@ public:
    int epoll_remove_usock(const int eid, const UDTSOCKET u);
    int epoll_remove_ssock(const int eid, const SYSSOCKET s);
    int epoll_wait(const int eid, std::set<UDTSOCKET>* readfds, std::set<UDTSOCKET>* writefds, int64_t msTimeOut, std::set<SYSSOCKET>* lrfds = NULL, std::set<SYSSOCKET>* lwfds = NULL);
+   int epoll_uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut);
+   int epoll_getfd(const int eid);
    int epoll_release(const int eid);
 
       // Functionality:
@@ -203,9 +315,9 @@ private:
 //   void init();
 
 private:
-   std::map<UDTSOCKET, CUDTSocket*> m_Sockets;       // stores all the socket structures
+   CSocketTable m_Sockets;                           // stores all the socket structures
 
-   pthread_mutex_t m_ControlLock;                    // used to synchronize UDT API
+   pthread_mutex_t m_ControlLock;                    // used to synchronize UDT API and the changes of m_Sockets
 
    pthread_mutex_t m_IDLock;                         // used to synchronize ID generation
    UDTSOCKET m_SocketID;                             // seed to generate a new unique socket ID
@@ -231,10 +343,19 @@ private:
 
 private:
    std::map<int, CMultiplexer> m_mMultiplexer;		// UDP multiplexer
+   std::vector<CUDTSocket*> m_vRemovedSockets;		// sockets removed, deleted by the GC out of m_ControlLock
+   std::vector<CMultiplexer> m_vClosedMux;		// multiplexers no longer used, deleted after the sockets
    pthread_mutex_t m_MultiplexerLock;
 
 private:
    CCache<CInfoBlock>* m_pCache;			// UDT network information cache
+   std::string m_CacheFile;				// file the cache is saved to, empty if none
+   int m_iCacheTTL;					// age beyond which the saved information is dropped, in seconds
+   pthread_mutex_t m_CacheFileLock;			// used to synchronize the access to the file
+
+   static const int m_iCacheSaveInterval;		// period of saving the cache, in seconds
+
+   void saveCache();
 
 private:
    volatile bool m_bClosing;
@@ -254,12 +375,79 @@ private:
 
    std::map<UDTSOCKET, CUDTSocket*> m_ClosedSockets;   // temporarily store closed sockets
 
+   std::set<std::pair<uint64_t, UDTSOCKET> > m_GCQueue;	// sockets for the GC to look at, by deadline, protected by m_GCStopLock
+   std::map<UDTSOCKET, uint64_t> m_GCDeadline;		// deadline of each socket in m_GCQueue
+   uint64_t m_ullGCWakeTime;				// time the GC thread sleeps until, 0 if it is working
+
+      // Functionality:
+      //    queue a socket for the GC to look at, after it is broken or closed; a broken connection is given
+      //    1 second before it is closed, for the application to see why.
+      // Parameters:
+      //    0) [in] u: socket ID.
+      //    1) [in] deadline: the earliest time to look at it, 0 for at once.
+      // Returned value:
+      //    None.
+
+   void scheduleGC(const UDTSOCKET u, uint64_t deadline);
+
    void checkBrokenSockets();
+   uint64_t checkBrokenSocket(const UDTSOCKET u);
    void removeSocket(const UDTSOCKET u);
 
 private:
    CEPoll m_EPoll;                                     // handling epoll data structures and events
 
+private:
+   pthread_mutex_t m_SelectLock;                       // protects the select nodes of all the sockets and the ready lists
+
+      // Functionality:
+      //    link the nodes of a select() call to their sockets.
+      // Parameters:
+      //    0) [in, out] w: the call waiting.
+      // Returned value:
+      //    None.
+
+   void watchSelect(CSelectWaiter& w);
+
+      // Functionality:
+      //    unlink the nodes of a select() call from the sockets that are still there.
+      // Parameters:
+      //    0) [in, out] w: the call waiting.
+      // Returned value:
+      //    None.
+
+   void unwatchSelect(CSelectWaiter& w);
+
+      // Functionality:
+      //    wait for the nodes of a select() call to get ready.
+      // Parameters:
+      //    0) [in, out] w: the call waiting.
+      //    1) [in] deadline: time to wait until, 0xFFFFFFFFFFFFFFFF for ever.
+      //    2) [out] ready: the nodes that got ready, each one once.
+      // Returned value:
+      //    None.
+
+   void waitSelect(CSelectWaiter& w, uint64_t deadline, std::vector<CSelectNode*>& ready);
+
+      // Functionality:
+      //    tell the select() calls watching a socket that some events are turned on.
+      // Parameters:
+      //    0) [in] u: UDT entity of the socket.
+      //    1) [in] events: events turned on.
+      // Returned value:
+      //    None.
+
+   void notifySelect(CUDT* u, const int events);
+
+      // Functionality:
+      //    unlink the nodes of a socket being deleted and report it to the select() calls watching it.
+      // Parameters:
+      //    0) [in] u: UDT entity of the socket.
+      // Returned value:
+      //    None.
+
+   void dropSelect(CUDT* u);
+
 private:
    CUDTUnited(const CUDTUnited&);
    CUDTUnited& operator=(const CUDTUnited&);
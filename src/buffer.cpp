@@ -38,18 +38,56 @@ written by
    Yunhong Gu, last updated 03/12/2011
 *****************************************************************************/
 
+#ifndef WIN32
+   #include <unistd.h>
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+#else
+   #include <io.h>
+#endif
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include "buffer.h"
 
 using namespace std;
 
+// Copy "len" bytes between "buf" and an iovec array, from/to the position (i, off) of the array,
+// which is moved forward accordingly. An element may hold 2^31 bytes or more, so the offset in it is a size_t.
+static void iovcopy(const iovec* iov, int iovcnt, int& i, size_t& off, char* buf, int len, bool fromiov)
+{
+   while ((len > 0) && (i < iovcnt))
+   {
+      size_t left = iov[i].iov_len - off;
+      int size = (left > size_t(len)) ? len : int(left);
+
+      if (fromiov)
+         memcpy(buf, (char*)iov[i].iov_base + off, size);
+      else
+         memcpy((char*)iov[i].iov_base + off, buf, size);
+
+      buf += size;
+      len -= size;
+      off += size;
+
+      if (off == iov[i].iov_len)
+      {
+         ++ i;
+         off = 0;
+      }
+   }
+}
+
 CSndBuffer::CSndBuffer(int size, int mss):
 m_BufLock(),
+m_pRetiredMapping(NULL),
 m_pBlock(NULL),
 m_pFirstBlock(NULL),
 m_pCurrBlock(NULL),
 m_pLastBlock(NULL),
+m_pTailBlock(NULL),
 m_pBuffer(NULL),
 m_iNextMsgNo(1),
 m_iSize(size),
@@ -83,6 +121,8 @@ m_iCount(0)
    for (int i = 0; i < m_iSize; ++ i)
    {
       pb->m_pcData = pc;
+      pb->m_pcMapped = NULL;
+      pb->m_pMapping = NULL;
       pb = pb->m_pNext;
       pc += m_iMSS;
    }
@@ -107,10 +147,16 @@ CSndBuffer::~CSndBuffer()
    {
       Block* temp = pb;
       pb = pb->m_pNext;
+      if (NULL != temp->m_pMapping)
+         releaseMapping(temp->m_pMapping);
       delete temp;
    }
+   if (NULL != m_pBlock->m_pMapping)
+      releaseMapping(m_pBlock->m_pMapping);
    delete m_pBlock;
 
+   unmapRetired();
+
    while (m_pBuffer != NULL)
    {
       Buffer* temp = m_pBuffer;
@@ -128,6 +174,21 @@ CSndBuffer::~CSndBuffer()
 
 void CSndBuffer::addBuffer(const char* data, int len, int ttl, bool order)
 {
+   iovec iov;
+   iov.iov_base = (char*)data;
+   iov.iov_len = len;
+
+   addBuffer(&iov, 1, 0, len, ttl, order);
+}
+
+void CSndBuffer::addBuffer(const iovec* iov, int iovcnt, int offset, int len, int ttl, bool order)
+{
+   // locate the starting position in the iovec array
+   int idx = 0;
+   size_t off = offset;
+   while ((idx < iovcnt) && (off >= iov[idx].iov_len))
+      off -= iov[idx ++].iov_len;
+
    int size = len / m_iMSS;
    if ((len % m_iMSS) != 0)
       size ++;
@@ -141,13 +202,14 @@ void CSndBuffer::addBuffer(const char* data, int len, int ttl, bool order)
    inorder <<= 29;
 
    Block* s = m_pLastBlock;
+   Block* tail = m_pTailBlock;
    for (int i = 0; i < size; ++ i)
    {
       int pktlen = len - i * m_iMSS;
       if (pktlen > m_iMSS)
          pktlen = m_iMSS;
 
-      memcpy(s->m_pcData, data + i * m_iMSS, pktlen);
+      iovcopy(iov, iovcnt, idx, off, s->m_pcData, pktlen, true);
       s->m_iLength = pktlen;
 
       s->m_iMsgNo = m_iNextMsgNo | inorder;
@@ -159,11 +221,13 @@ void CSndBuffer::addBuffer(const char* data, int len, int ttl, bool order)
       s->m_OriginTime = time;
       s->m_iTTL = ttl;
 
+      tail = s;
       s = s->m_pNext;
    }
-   m_pLastBlock = s;
 
    CGuard::enterCS(m_BufLock);
+   m_pTailBlock = tail;
+   m_pLastBlock = s;
    m_iCount += size;
    CGuard::leaveCS(m_BufLock);
 
@@ -182,7 +246,10 @@ int CSndBuffer::addBufferFromFile(fstream& ifs, int len)
    while (size + m_iCount >= m_iSize)
       increase();
 
+   uint64_t time = CTimer::getTime();
+
    Block* s = m_pLastBlock;
+   Block* tail = m_pTailBlock;
    int total = 0;
    for (int i = 0; i < size; ++ i)
    {
@@ -205,14 +272,17 @@ int CSndBuffer::addBufferFromFile(fstream& ifs, int len)
          s->m_iMsgNo |= 0x40000000;
 
       s->m_iLength = pktlen;
+      s->m_OriginTime = time;
       s->m_iTTL = -1;
+      tail = s;
       s = s->m_pNext;
 
       total += pktlen;
    }
-   m_pLastBlock = s;
 
    CGuard::enterCS(m_BufLock);
+   m_pTailBlock = tail;
+   m_pLastBlock = s;
    m_iCount += size;
    CGuard::leaveCS(m_BufLock);
 
@@ -223,14 +293,160 @@ int CSndBuffer::addBufferFromFile(fstream& ifs, int len)
    return total;
 }
 
+int CSndBuffer::addBufferFromFile(int fd, int64_t offset, int len)
+{
+   int size = len / m_iMSS;
+   if ((len % m_iMSS) != 0)
+      size ++;
+
+   // dynamically increase sender buffer
+   while (size + m_iCount >= m_iSize)
+      increase();
+
+   uint64_t time = CTimer::getTime();
+
+   // point the blocks to the mapped file region if possible, otherwise read the data into the blocks
+   char* mapped = NULL;
+   Mapping* map = mapFile(fd, offset, len, mapped);
+
+   Block* s = m_pLastBlock;
+   Block* tail = m_pTailBlock;
+   int total = 0;
+   int count = 0;
+   for (int i = 0; i < size; ++ i)
+   {
+      int pktlen = len - i * m_iMSS;
+      if (pktlen > m_iMSS)
+         pktlen = m_iMSS;
+
+      bool eof = false;
+      if (NULL != map)
+      {
+         s->m_pcMapped = mapped + total;
+         s->m_pMapping = map;
+      }
+      else
+      {
+         #ifndef WIN32
+            int rs = pread(fd, s->m_pcData, pktlen, offset + total);
+         #else
+            int rs = -1;
+            if (_lseeki64(fd, offset + total, SEEK_SET) >= 0)
+               rs = _read(fd, s->m_pcData, pktlen);
+         #endif
+
+         if (rs <= 0)
+         {
+            if ((rs < 0) && (0 == total))
+               return -1;
+            break;
+         }
+
+         eof = rs < pktlen;
+         pktlen = rs;
+      }
+
+      // currently file transfer is only available in streaming mode, message is always in order, ttl = infinite
+      s->m_iMsgNo = m_iNextMsgNo | 0x20000000;
+      if (i == 0)
+         s->m_iMsgNo |= 0x80000000;
+      if ((i == size - 1) || eof)
+         s->m_iMsgNo |= 0x40000000;
+
+      s->m_iLength = pktlen;
+      s->m_OriginTime = time;
+      s->m_iTTL = -1;
+      tail = s;
+      s = s->m_pNext;
+
+      total += pktlen;
+      ++ count;
+
+      if (eof)
+         break;
+   }
+
+   if (0 == count)
+      return 0;
+
+   CGuard::enterCS(m_BufLock);
+   if (NULL != map)
+      map->m_iRefCount = count;
+   m_pTailBlock = tail;
+   m_pLastBlock = s;
+   m_iCount += count;
+   CGuard::leaveCS(m_BufLock);
+
+   m_iNextMsgNo ++;
+   if (m_iNextMsgNo == CMsgNo::m_iMaxMsgNo)
+      m_iNextMsgNo = 1;
+
+   return total;
+}
+
+void CSndBuffer::copyMapped()
+{
+   CGuard bufferguard(m_BufLock);
+
+   // the blocks read for sending but not acknowledged yet are copied as well, for the retransmissions
+   for (Block* p = m_pFirstBlock; p != m_pLastBlock; p = p->m_pNext)
+   {
+      if (NULL == p->m_pMapping)
+         continue;
+
+      memcpy(p->m_pcData, p->m_pcMapped, p->m_iLength);
+      releaseMapping(p->m_pMapping);
+      p->m_pMapping = NULL;
+      p->m_pcMapped = NULL;
+   }
+}
+
+int CSndBuffer::appendTail(const iovec* iov, int iovcnt, int len, bool& partial)
+{
+   CGuard bufferguard(m_BufLock);
+
+   partial = false;
+
+   // the tail block can only grow before it is read for sending
+   if ((m_pCurrBlock == m_pLastBlock) || (m_pTailBlock->m_iLength >= m_iMSS) || (NULL != m_pTailBlock->m_pMapping))
+      return 0;
+
+   int size = m_iMSS - m_pTailBlock->m_iLength;
+   if (size > len)
+      size = len;
+
+   int idx = 0;
+   size_t offset = 0;
+   iovcopy(iov, iovcnt, idx, offset, m_pTailBlock->m_pcData + m_pTailBlock->m_iLength, size, true);
+   m_pTailBlock->m_iLength += size;
+   partial = (m_pTailBlock->m_iLength < m_iMSS);
+
+   return size;
+}
+
+uint64_t CSndBuffer::getPartialTailTime()
+{
+   CGuard bufferguard(m_BufLock);
+
+   if ((m_pCurrBlock == m_pLastBlock) || (m_pCurrBlock != m_pTailBlock) || (m_pCurrBlock->m_iLength >= m_iMSS) || (NULL != m_pCurrBlock->m_pMapping))
+      return 0;
+
+   return m_pCurrBlock->m_OriginTime;
+}
+
 // ȡ
 int CSndBuffer::readData(char** data, int32_t& msgno)
 {
+   CGuard bufferguard(m_BufLock);
+
+   // packets from the retired mappings have all been sent out by now
+   unmapRetired();
+
    // No data to read
    if (m_pCurrBlock == m_pLastBlock)
       return 0;
 
-   *data = m_pCurrBlock->m_pcData;
+   *data = (NULL != m_pCurrBlock->m_pcMapped) ? m_pCurrBlock->m_pcMapped : m_pCurrBlock->m_pcData;
    int readlen = m_pCurrBlock->m_iLength;
    msgno = m_pCurrBlock->m_iMsgNo;
 
@@ -245,6 +461,8 @@ int CSndBuffer::readData(char** data, const int offset, int32_t& msgno, int& msg
 {
    CGuard bufferguard(m_BufLock);
 
+   unmapRetired();
+
    Block* p = m_pFirstBlock;
 
    for (int i = 0; i < offset; ++ i)
@@ -272,7 +490,7 @@ int CSndBuffer::readData(char** data, const int offset, int32_t& msgno, int& msg
       return -1;
    }
 
-   *data = p->m_pcData;
+   *data = (NULL != p->m_pcMapped) ? p->m_pcMapped : p->m_pcData;
    int readlen = p->m_iLength;
    msgno = p->m_iMsgNo;
 
@@ -280,16 +498,28 @@ int CSndBuffer::readData(char** data, const int offset, int32_t& msgno, int& msg
 }
 
 // ȷϵı[m_pFirstBlock, m_pFirstBlock + offset)m_pFirstBlock = m_pFirstBlock + offset
-void CSndBuffer::ackData(int offset)
+int CSndBuffer::ackData(int offset)
 {
    CGuard bufferguard(m_BufLock);
 
+   int size = 0;
    for (int i = 0; i < offset; ++ i)
+   {
+      size += m_pFirstBlock->m_iLength;
+      if (NULL != m_pFirstBlock->m_pMapping)
+      {
+         releaseMapping(m_pFirstBlock->m_pMapping);
+         m_pFirstBlock->m_pMapping = NULL;
+         m_pFirstBlock->m_pcMapped = NULL;
+      }
       m_pFirstBlock = m_pFirstBlock->m_pNext;
+   }
 
    m_iCount -= offset;
 
    CTimer::triggerEvent();
+
+   return size;
 }
 
 int CSndBuffer::getCurrBufSize() const
@@ -349,6 +579,8 @@ void CSndBuffer::increase()
    for (int i = 0; i < unitsize; ++ i)
    {
       pb->m_pcData = pc;
+      pb->m_pcMapped = NULL;
+      pb->m_pMapping = NULL;
       pb = pb->m_pNext;
       pc += m_iMSS;
    }
@@ -356,6 +588,61 @@ void CSndBuffer::increase()
    m_iSize += unitsize;
 }
 
+CSndBuffer::Mapping* CSndBuffer::mapFile(int fd, int64_t offset, int len, char*& data)
+{
+   #ifndef WIN32
+      // only map regular files, and never beyond the end of file, which would raise SIGBUS on access
+      struct stat st;
+      if ((fstat(fd, &st) < 0) || !S_ISREG(st.st_mode) || (offset + len > (int64_t)st.st_size))
+         return NULL;
+
+      int64_t pagesize = sysconf(_SC_PAGESIZE);
+      int64_t start = offset - offset % pagesize;
+      int64_t maplen = offset + len - start;
+
+      void* addr = mmap(NULL, (size_t)maplen, PROT_READ, MAP_SHARED, fd, (off_t)start);
+      if (MAP_FAILED == addr)
+         return NULL;
+
+      madvise(addr, (size_t)maplen, MADV_WILLNEED);
+
+      Mapping* m = new Mapping;
+      m->m_pcAddr = (char*)addr;
+      m->m_llLength = maplen;
+      m->m_iRefCount = 0;
+      m->m_pNext = NULL;
+
+      data = m->m_pcAddr + (offset - start);
+      return m;
+   #else
+      return NULL;
+   #endif
+}
+
+void CSndBuffer::releaseMapping(Mapping* m)
+{
+   if (-- m->m_iRefCount > 0)
+      return;
+
+   // the sending thread may still be using the data of the last packet read, so do not unmap it here
+   m->m_pNext = m_pRetiredMapping;
+   m_pRetiredMapping = m;
+}
+
+void CSndBuffer::unmapRetired()
+{
+   while (NULL != m_pRetiredMapping)
+   {
+      Mapping* m = m_pRetiredMapping;
+      m_pRetiredMapping = m->m_pNext;
+
+      #ifndef WIN32
+         munmap(m->m_pcAddr, (size_t)m->m_llLength);
+      #endif
+      delete m;
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 CRcvBuffer::CRcvBuffer(CUnitQueue* queue, int bufsize):
@@ -405,6 +692,18 @@ int CRcvBuffer::addData(CUnit* unit, int offset)
 
 int CRcvBuffer::readBuffer(char* data, int len)
 {
+   iovec iov;
+   iov.iov_base = data;
+   iov.iov_len = len;
+
+   return readBuffer(&iov, 1, len);
+}
+
+int CRcvBuffer::readBuffer(const iovec* iov, int iovcnt, int len)
+{
+   int idx = 0;
+   size_t offset = 0;
+
    // m_iStartPos һζȡλ
    int p = m_iStartPos; // ָ
    int lastack = m_iLastAckPos; // дָ
@@ -420,8 +719,7 @@ int CRcvBuffer::readBuffer(char* data, int len)
       // rs ʣҪȡĴС
       // unitsize ԪҪȡĴС
 
-      memcpy(data, m_pUnit[p]->m_Packet.m_pcData + m_iNotch, unitsize);
-      data += unitsize;
+      iovcopy(iov, iovcnt, idx, offset, m_pUnit[p]->m_Packet.m_pcData + m_iNotch, unitsize, false);
 
       if ((rs > unitsize) || (rs == m_pUnit[p]->m_Packet.getLength() - m_iNotch))
       {
@@ -485,6 +783,45 @@ int CRcvBuffer::readBufferToFile(fstream& ofs, int len)
    return len - rs;
 }
 
+int CRcvBuffer::readUnits(CUnit** units, iovec* iov, int num, int len)
+{
+   int p = m_iStartPos;
+   int lastack = m_iLastAckPos;
+   int n = 0;
+
+   while ((p != lastack) && (n < num))
+   {
+      int unitsize = m_pUnit[p]->m_Packet.getLength() - m_iNotch;
+      if (unitsize > len)
+         break;
+
+      units[n] = m_pUnit[p];
+      iov[n].iov_base = m_pUnit[p]->m_Packet.m_pcData + m_iNotch;
+      iov[n].iov_len = unitsize;
+      m_pUnit[p] = NULL;
+
+      if (++ p == m_iSize)
+         p = 0;
+
+      m_iNotch = 0;
+      len -= unitsize;
+      ++ n;
+   }
+
+   m_iStartPos = p;
+
+   return n;
+}
+
+void CRcvBuffer::releaseUnits(CUnit** units, int num)
+{
+   for (int i = 0; i < num; ++ i)
+   {
+      units[i]->m_iFlag = 0;
+      -- m_pUnitQueue->m_iCount;
+   }
+}
+
 void CRcvBuffer::ackData(int len)
 {
    m_iLastAckPos = (m_iLastAckPos + len) % m_iSize;
@@ -695,3 +1032,418 @@ contain multiple UDT packets.
 
    return found;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int CRcvFileWriter::m_iBatchSize = 64;
+const int CRcvFileWriter::m_iDirectAlign = 4096;
+
+CRcvFileWriter::CRcvFileWriter(CRcvBuffer* buffer, int fd, int64_t offset, int capacity):
+m_pRcvBuffer(buffer),
+m_iFD(fd),
+m_llOffset(offset),
+m_pUnit(NULL),
+m_pIOV(NULL),
+m_iCapacity(capacity),
+m_iHead(0),
+m_iCount(0),
+m_pcStage(NULL),
+m_iStageSize(0),
+m_iStaged(0),
+m_llBytes(0),
+m_llDuration(0),
+m_bClosing(false),
+m_bFlushing(false),
+m_bFailed(false),
+m_WorkerThread()
+{
+   if (m_iCapacity < m_iBatchSize)
+      m_iCapacity = m_iBatchSize;
+
+   m_pUnit = new CUnit* [m_iCapacity];
+   m_pIOV = new iovec [m_iCapacity];
+
+   #if !defined(WIN32) && defined(O_DIRECT)
+      // a file opened with O_DIRECT can only be written in aligned blocks, so the payload is staged first
+      int flags = fcntl(m_iFD, F_GETFL);
+      if ((flags >= 0) && (0 != (flags & O_DIRECT)))
+      {
+         void* stage;
+         if (0 == posix_memalign(&stage, m_iDirectAlign, m_iDirectAlign * 256))
+         {
+            m_pcStage = (char*)stage;
+            m_iStageSize = m_iDirectAlign * 256;
+         }
+      }
+   #endif
+
+   CGuard::createMutex(m_Lock);
+   CGuard::createCond(m_DataCond);
+   CGuard::createCond(m_SpaceCond);
+   #ifdef WIN32
+      CGuard::createCond(m_ExitCond);
+   #endif
+}
+
+CRcvFileWriter::~CRcvFileWriter()
+{
+   CGuard::enterCS(m_Lock);
+   m_bClosing = true;
+   #ifndef WIN32
+      pthread_cond_signal(&m_DataCond);
+   #else
+      SetEvent(m_DataCond);
+   #endif
+   CGuard::leaveCS(m_Lock);
+
+   #ifndef WIN32
+      if (0 != m_WorkerThread)
+         pthread_join(m_WorkerThread, NULL);
+   #else
+      if (NULL != m_WorkerThread)
+      {
+         WaitForSingleObject(m_ExitCond, INFINITE);
+         CloseHandle(m_WorkerThread);
+      }
+      CGuard::releaseCond(m_ExitCond);
+   #endif
+
+   // units never written still belong to the unit queue
+   for (int i = 0; i < m_iCount; ++ i)
+      m_pRcvBuffer->releaseUnits(m_pUnit + (m_iHead + i) % m_iCapacity, 1);
+
+   CGuard::releaseCond(m_SpaceCond);
+   CGuard::releaseCond(m_DataCond);
+   CGuard::releaseMutex(m_Lock);
+
+   delete [] m_pUnit;
+   delete [] m_pIOV;
+   #ifndef WIN32
+      free(m_pcStage);
+   #endif
+}
+
+void CRcvFileWriter::start()
+{
+   #ifndef WIN32
+      if (0 != pthread_create(&m_WorkerThread, NULL, CRcvFileWriter::worker, this))
+      {
+         m_WorkerThread = 0;
+         throw CUDTException(3, 1);
+      }
+   #else
+      DWORD threadID;
+      m_WorkerThread = CreateThread(NULL, 0, CRcvFileWriter::worker, this, 0, &threadID);
+      if (NULL == m_WorkerThread)
+         throw CUDTException(3, 1);
+   #endif
+}
+
+int CRcvFileWriter::push(CUnit** units, const iovec* iov, int num)
+{
+   #ifndef WIN32
+      pthread_mutex_lock(&m_Lock);
+      while (!m_bFailed && (m_iCapacity - m_iCount < num))
+         pthread_cond_wait(&m_SpaceCond, &m_Lock);
+   #else
+      WaitForSingleObject(m_Lock, INFINITE);
+      while (!m_bFailed && (m_iCapacity - m_iCount < num))
+      {
+         ReleaseMutex(m_Lock);
+         WaitForSingleObject(m_SpaceCond, INFINITE);
+         WaitForSingleObject(m_Lock, INFINITE);
+      }
+   #endif
+
+   if (m_bFailed)
+   {
+      CGuard::leaveCS(m_Lock);
+      m_pRcvBuffer->releaseUnits(units, num);
+      return -1;
+   }
+
+   for (int i = 0; i < num; ++ i)
+   {
+      int p = (m_iHead + m_iCount + i) % m_iCapacity;
+      m_pUnit[p] = units[i];
+      m_pIOV[p] = iov[i];
+   }
+   m_iCount += num;
+
+   #ifndef WIN32
+      pthread_cond_signal(&m_DataCond);
+   #else
+      SetEvent(m_DataCond);
+   #endif
+   CGuard::leaveCS(m_Lock);
+
+   return 0;
+}
+
+int CRcvFileWriter::flush()
+{
+   #ifndef WIN32
+      pthread_mutex_lock(&m_Lock);
+      m_bFlushing = true;
+      pthread_cond_signal(&m_DataCond);
+      while (!m_bFailed && ((m_iCount > 0) || (m_iStaged > 0)))
+         pthread_cond_wait(&m_SpaceCond, &m_Lock);
+   #else
+      WaitForSingleObject(m_Lock, INFINITE);
+      m_bFlushing = true;
+      SetEvent(m_DataCond);
+      while (!m_bFailed && ((m_iCount > 0) || (m_iStaged > 0)))
+      {
+         ReleaseMutex(m_Lock);
+         WaitForSingleObject(m_SpaceCond, INFINITE);
+         WaitForSingleObject(m_Lock, INFINITE);
+      }
+   #endif
+
+   m_bFlushing = false;
+   bool failed = m_bFailed;
+   CGuard::leaveCS(m_Lock);
+
+   return failed ? -1 : 0;
+}
+
+int CRcvFileWriter::write(const char* data, int len)
+{
+   if (m_bFailed)
+      return -1;
+
+   uint64_t start = CTimer::getTime();
+   int res = writeBuffered(data, len);
+
+   CGuard::enterCS(m_Lock);
+   if (res < 0)
+      m_bFailed = true;
+   else
+   {
+      m_llBytes += len;
+      m_llDuration += CTimer::getTime() - start;
+   }
+   CGuard::leaveCS(m_Lock);
+
+   return res;
+}
+
+void CRcvFileWriter::getStats(int64_t& bytes, int64_t& usec)
+{
+   CGuard::enterCS(m_Lock);
+   bytes = m_llBytes;
+   usec = m_llDuration;
+   m_llBytes = m_llDuration = 0;
+   CGuard::leaveCS(m_Lock);
+}
+
+#ifndef WIN32
+   void* CRcvFileWriter::worker(void* param)
+#else
+   DWORD WINAPI CRcvFileWriter::worker(LPVOID param)
+#endif
+{
+   CRcvFileWriter* self = (CRcvFileWriter*)param;
+
+   CUnit* units[m_iBatchSize];
+   iovec iov[m_iBatchSize];
+
+   while (true)
+   {
+      #ifndef WIN32
+         pthread_mutex_lock(&self->m_Lock);
+         while (!self->m_bClosing && (0 == self->m_iCount) && !(self->m_bFlushing && (self->m_iStaged > 0)))
+            pthread_cond_wait(&self->m_DataCond, &self->m_Lock);
+      #else
+         WaitForSingleObject(self->m_Lock, INFINITE);
+         while (!self->m_bClosing && (0 == self->m_iCount) && !(self->m_bFlushing && (self->m_iStaged > 0)))
+         {
+            ReleaseMutex(self->m_Lock);
+            WaitForSingleObject(self->m_DataCond, INFINITE);
+            WaitForSingleObject(self->m_Lock, INFINITE);
+         }
+      #endif
+
+      if (self->m_bClosing)
+      {
+         CGuard::leaveCS(self->m_Lock);
+         break;
+      }
+
+      // take a contiguous run of the queue; the entries stay counted until they are written
+      int num = self->m_iCount;
+      if (num > m_iBatchSize)
+         num = m_iBatchSize;
+      if (num > self->m_iCapacity - self->m_iHead)
+         num = self->m_iCapacity - self->m_iHead;
+      for (int i = 0; i < num; ++ i)
+      {
+         units[i] = self->m_pUnit[self->m_iHead + i];
+         iov[i] = self->m_pIOV[self->m_iHead + i];
+      }
+      bool last = self->m_bFlushing && (num == self->m_iCount);
+      CGuard::leaveCS(self->m_Lock);
+
+      uint64_t start = CTimer::getTime();
+      int64_t written = self->m_llOffset;
+      int res = 0;
+
+      if (NULL == self->m_pcStage)
+         res = self->writeIOV(iov, num);
+      else
+      {
+         for (int i = 0; (i < num) && (res >= 0); ++ i)
+         {
+            const char* data = (const char*)iov[i].iov_base;
+            int len = (int)iov[i].iov_len;
+            while ((len > 0) && (res >= 0))
+            {
+               int size = self->m_iStageSize - self->m_iStaged;
+               if (size > len)
+                  size = len;
+               memcpy(self->m_pcStage + self->m_iStaged, data, size);
+               self->m_iStaged += size;
+               data += size;
+               len -= size;
+
+               if (self->m_iStaged == self->m_iStageSize)
+                  res = self->writeStage(false);
+            }
+         }
+
+         if ((res >= 0) && last)
+            res = self->writeStage(true);
+      }
+
+      // units are free for new packets as soon as their payload is on disk or staged
+      self->m_pRcvBuffer->releaseUnits(units, num);
+
+      CGuard::enterCS(self->m_Lock);
+      self->m_llBytes += self->m_llOffset - written;
+      self->m_llDuration += CTimer::getTime() - start;
+      self->m_iHead = (self->m_iHead + num) % self->m_iCapacity;
+      self->m_iCount -= num;
+      if (res < 0)
+         self->m_bFailed = true;
+      #ifndef WIN32
+         pthread_cond_signal(&self->m_SpaceCond);
+      #else
+         SetEvent(self->m_SpaceCond);
+      #endif
+      CGuard::leaveCS(self->m_Lock);
+   }
+
+   #ifndef WIN32
+      return NULL;
+   #else
+      SetEvent(self->m_ExitCond);
+      return 0;
+   #endif
+}
+
+int CRcvFileWriter::writeIOV(iovec* iov, int num)
+{
+   while (num > 0)
+   {
+      #ifndef WIN32
+         #ifdef LINUX
+            ssize_t size = pwritev(m_iFD, iov, num, m_llOffset);
+         #else
+            ssize_t size = pwrite(m_iFD, iov[0].iov_base, iov[0].iov_len, m_llOffset);
+         #endif
+      #else
+         int size = -1;
+         if (_lseeki64(m_iFD, m_llOffset, SEEK_SET) >= 0)
+            size = _write(m_iFD, iov[0].iov_base, (unsigned int)iov[0].iov_len);
+      #endif
+
+      if (size < 0)
+      {
+         if (EINTR == errno)
+            continue;
+         return -1;
+      }
+      else if (0 == size)
+         return -1;
+
+      m_llOffset += size;
+
+      // skip what has been written, a short write may stop in the middle of a buffer
+      while ((size > 0) && (num > 0))
+      {
+         if ((size_t)size >= iov->iov_len)
+         {
+            size -= iov->iov_len;
+            ++ iov;
+            -- num;
+         }
+         else
+         {
+            iov->iov_base = (char*)iov->iov_base + size;
+            iov->iov_len -= size;
+            size = 0;
+         }
+      }
+   }
+
+   return 0;
+}
+
+int CRcvFileWriter::writeStage(bool final)
+{
+   // the head of the data, up to the first aligned file position, cannot be written directly
+   int lead = int((m_iDirectAlign - m_llOffset % m_iDirectAlign) % m_iDirectAlign);
+   if (lead > m_iStaged)
+      lead = m_iStaged;
+   if (lead > 0)
+   {
+      if (writeBuffered(m_pcStage, lead) < 0)
+         return -1;
+      m_iStaged -= lead;
+      memmove(m_pcStage, m_pcStage + lead, m_iStaged);
+   }
+
+   int aligned = m_iStaged / m_iDirectAlign * m_iDirectAlign;
+   if (aligned > 0)
+   {
+      iovec iov;
+      iov.iov_base = m_pcStage;
+      iov.iov_len = aligned;
+      if (writeIOV(&iov, 1) < 0)
+         return -1;
+      m_iStaged -= aligned;
+      memmove(m_pcStage, m_pcStage + aligned, m_iStaged);
+   }
+
+   // so is the tail of the file data
+   if (final && (m_iStaged > 0))
+   {
+      if (writeBuffered(m_pcStage, m_iStaged) < 0)
+         return -1;
+      m_iStaged = 0;
+   }
+
+   return 0;
+}
+
+int CRcvFileWriter::writeBuffered(const char* data, int len)
+{
+   #if !defined(WIN32) && defined(O_DIRECT)
+      int flags = fcntl(m_iFD, F_GETFL);
+      bool direct = (flags >= 0) && (0 != (flags & O_DIRECT));
+      if (direct)
+         fcntl(m_iFD, F_SETFL, flags & ~O_DIRECT);
+   #endif
+
+   iovec iov;
+   iov.iov_base = (char*)data;
+   iov.iov_len = len;
+   int res = writeIOV(&iov, 1);
+
+   #if !defined(WIN32) && defined(O_DIRECT)
+      if (direct)
+         fcntl(m_iFD, F_SETFL, flags);
+   #endif
+
+   return res;
+}
@@ -65,6 +65,20 @@ public:
 
    void addBuffer(const char* data, int len, int ttl = -1, bool order = false);
 
+      // Functionality:
+      //    Insert the data of an iovec array into the sending list, as one block.
+      // Parameters:
+      //    0) [in] iov: the user data blocks.
+      //    1) [in] iovcnt: number of blocks in "iov".
+      //    2) [in] offset: position in the iovec array to start from.
+      //    3) [in] len: size of data to be inserted.
+      //    4) [in] ttl: time to live in milliseconds
+      //    5) [in] order: if the block should be delivered in order, for DGRAM only
+      // Returned value:
+      //    None.
+
+   void addBuffer(const iovec* iov, int iovcnt, int offset, int len, int ttl = -1, bool order = false);
+
       // Functionality:
       //    Read a block of data from file and insert it into the sending list.
       // Parameters:
@@ -75,6 +89,49 @@ public:
 
    int addBufferFromFile(std::fstream& ifs, int len);
 
+      // Functionality:
+      //    Insert a region of a file into the sending list. Regular files are memory mapped and the
+      //    blocks point to the mapped pages directly; otherwise the data is read into the blocks.
+      // Parameters:
+      //    0) [in] fd: file descriptor.
+      //    1) [in] offset: position in the file to start from.
+      //    2) [in] len: size of the region.
+      // Returned value:
+      //    actual size of data added from the file, -1 on read error.
+
+   int addBufferFromFile(int fd, int64_t offset, int len);
+
+      // Functionality:
+      //    Copy the data of the blocks still pointing to mapped file pages into the blocks, so that the
+      //    file is no longer read once the sendfile() call that added them returns.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void copyMapped();
+
+      // Functionality:
+      //    Append data to the last block, if it is partially filled and has not been read yet.
+      // Parameters:
+      //    0) [in] iov: the user data blocks.
+      //    1) [in] iovcnt: number of blocks in "iov".
+      //    2) [in] len: size of data available in "iov".
+      //    3) [out] partial: if the last block is still partially filled and unread after the call.
+      // Returned value:
+      //    size of data appended, taken from the beginning of "iov".
+
+   int appendTail(const iovec* iov, int iovcnt, int len, bool& partial);
+
+      // Functionality:
+      //    Check if the next block to be read is a partially filled last block.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    original request time of the block, or 0 if it is full or followed by more data.
+
+   uint64_t getPartialTailTime();
+
       // Functionality:
       //    Find data position to pack a DATA packet from the furthest reading point.
       // Parameters:
@@ -102,9 +159,9 @@ public:
       // Parameters:
       //    0) [in] offset: number of packets acknowledged.
       // Returned value:
-      //    None.
+      //    Size of the data acknowledged, in bytes.
 
-   void ackData(int offset);
+   int ackData(int offset);
 
       // Functionality:
       //    Read size of data still in the sending list.
@@ -121,22 +178,38 @@ private:
 private:
    pthread_mutex_t m_BufLock;           // used to synchronize buffer operation
 
+   struct Mapping
+   {
+      char* m_pcAddr;                   // start of the mapped (page aligned) region
+      int64_t m_llLength;               // length of the mapped region
+      int m_iRefCount;                  // number of blocks still pointing into the region
+      Mapping* m_pNext;                 // next mapping on the retired list
+   } *m_pRetiredMapping;                // fully acknowledged mappings, to be unmapped by the sending thread
+
+   Mapping* mapFile(int fd, int64_t offset, int len, char*& data);
+   void releaseMapping(Mapping* m);
+   void unmapRetired();
+
    struct Block
    {
       char* m_pcData;                   // pointer to the data block
       int m_iLength;                    // length of the block
 
+      char* m_pcMapped;                 // pointer to the mapped file data, used instead of m_pcData if not NULL
+      Mapping* m_pMapping;              // the file mapping m_pcMapped points into
+
       int32_t m_iMsgNo;                 // message number
       uint64_t m_OriginTime;            // original request time
       int m_iTTL;                       // time to live (milliseconds)
 
       Block* m_pNext;                   // next block
-   } *m_pBlock, *m_pFirstBlock, *m_pCurrBlock, *m_pLastBlock;
+   } *m_pBlock, *m_pFirstBlock, *m_pCurrBlock, *m_pLastBlock, *m_pTailBlock;
 
    // m_pBlock:         The head pointer
    // m_pFirstBlock:    The first block
    // m_pCurrBlock:	The current block
    // m_pLastBlock:     The last block (if first == last, buffer is empty)
+   // m_pTailBlock:     The block written most recently, just before m_pLastBlock
 
    struct Buffer
    {
@@ -185,6 +258,17 @@ public:
 
    int readBuffer(char* data, int len);
 
+      // Functionality:
+      //    Read data into the user buffers of an iovec array, filled in order.
+      // Parameters:
+      //    0) [in] iov: user buffers.
+      //    1) [in] iovcnt: number of buffers in "iov".
+      //    2) [in] len: total length of the user buffers.
+      // Returned value:
+      //    size of data read.
+
+   int readBuffer(const iovec* iov, int iovcnt, int len);
+
       // Functionality:
       //    Read data directly into file.
       // Parameters:
@@ -195,6 +279,29 @@ public:
 
    int readBufferToFile(std::fstream& ofs, int len);
 
+      // Functionality:
+      //    Hand over complete, in-order units to the caller without copying their payload.
+      //    The units are removed from the buffer but stay occupied until releaseUnits() is called.
+      // Parameters:
+      //    0) [out] units: units taken from the buffer.
+      //    1) [out] iov: payload of each unit taken.
+      //    2) [in] num: maximum number of units to take.
+      //    3) [in] len: maximum size of data to take; a unit is never split.
+      // Returned value:
+      //    number of units taken.
+
+   int readUnits(CUnit** units, iovec* iov, int num, int len);
+
+      // Functionality:
+      //    Return units taken by readUnits() to the unit queue.
+      // Parameters:
+      //    0) [in] units: units to release.
+      //    1) [in] num: number of units.
+      // Returned value:
+      //    None.
+
+   void releaseUnits(CUnit** units, int num);
+
       // Functionality:
       //    Update the ACK point of the buffer.
       // Parameters:
@@ -271,5 +378,120 @@ private:
    CRcvBuffer& operator=(const CRcvBuffer&);
 };
 
+class CRcvFileWriter
+{
+public:
+   CRcvFileWriter(CRcvBuffer* buffer, int fd, int64_t offset, int capacity);
+   ~CRcvFileWriter();
+
+      // Functionality:
+      //    Start the writer thread.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void start();
+
+      // Functionality:
+      //    Queue units taken from the receiver buffer to be written at the current end of the file data,
+      //    blocking while the writer is full.
+      // Parameters:
+      //    0) [in] units: units to write; they are released by the writer.
+      //    1) [in] iov: payload of each unit.
+      //    2) [in] num: number of units, no more than the writer capacity.
+      // Returned value:
+      //    0 on success, -1 if a previous disk write has failed.
+
+   int push(CUnit** units, const iovec* iov, int num);
+
+      // Functionality:
+      //    Wait until all queued data has been written to disk.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    0 on success, -1 on disk write failure.
+
+   int flush();
+
+      // Functionality:
+      //    Write data from the caller directly, after flush().
+      // Parameters:
+      //    0) [in] data: pointer to the data.
+      //    1) [in] len: size of the data.
+      // Returned value:
+      //    0 on success, -1 on disk write failure.
+
+   int write(const char* data, int len);
+
+      // Functionality:
+      //    Read and reset the disk statistics accumulated since the last call.
+      // Parameters:
+      //    0) [out] bytes: size of data written to disk.
+      //    1) [out] usec: time spent in disk writes, in microseconds.
+      // Returned value:
+      //    None.
+
+   void getStats(int64_t& bytes, int64_t& usec);
+
+      // Functionality:
+      //    Query the file position where the next data will be written.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    the file offset following the data written so far.
+
+   int64_t getOffset() const {return m_llOffset;}
+
+private:
+#ifndef WIN32
+   static void* worker(void* param);
+#else
+   static DWORD WINAPI worker(LPVOID param);
+#endif
+
+   int writeIOV(iovec* iov, int num);
+   int writeStage(bool final);
+   int writeBuffered(const char* data, int len);
+
+private:
+   static const int m_iBatchSize;       // maximum number of units per disk write
+   static const int m_iDirectAlign;     // alignment of O_DIRECT writes
+
+   CRcvBuffer* m_pRcvBuffer;            // owner of the units being written
+   int m_iFD;                           // destination file
+   int64_t m_llOffset;                  // file position of the next byte to write
+
+   CUnit** m_pUnit;                     // queued units, circular
+   iovec* m_pIOV;                       // payload of the queued units
+   int m_iCapacity;                     // size of the queue
+   int m_iHead;                         // first queued unit
+   int m_iCount;                        // number of queued units, including those being written
+
+   char* m_pcStage;                     // aligned staging buffer, used with O_DIRECT only
+   int m_iStageSize;                    // size of the staging buffer
+   int m_iStaged;                       // size of the data in the staging buffer
+
+   int64_t m_llBytes;                   // size of data written since last getStats()
+   int64_t m_llDuration;                // time spent writing since last getStats()
+
+   volatile bool m_bClosing;            // stop the writer thread
+   volatile bool m_bFlushing;           // write out the staging buffer even if it is not full
+   volatile bool m_bFailed;             // a disk write has failed
+
+   pthread_t m_WorkerThread;
+   pthread_mutex_t m_Lock;
+   pthread_cond_t m_DataCond;           // signaled when units are queued
+   pthread_cond_t m_SpaceCond;          // signaled when units are written
+#ifdef WIN32
+   pthread_cond_t m_ExitCond;
+#endif
+
+private:
+   CRcvFileWriter();
+   CRcvFileWriter(const CRcvFileWriter&);
+   CRcvFileWriter& operator=(const CRcvFileWriter&);
+};
+
 
 #endif
@@ -46,15 +46,56 @@ written by
    #endif
 #endif
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
 #include "cache.h"
 #include "core.h"
 
 using namespace std;
 
+// A saved cache is a header followed by an array of fixed size records, in host byte order, so that the file can be
+// mapped in memory as it is. The records keep the age of the items rather than their time stamps, as the clock of
+// the library is not the wall clock on every system.
+
+struct CInfoFileHeader
+{
+   char m_pcMagic[4];		// "UDTC"
+   uint32_t m_iVersion;		// version of the format, a file of another version (or byte order) is ignored
+   uint32_t m_iRecordSize;	// size of a record, in bytes
+   uint32_t m_iCount;		// number of records, the most recently updated first
+   int64_t m_llSaveTime;	// wall clock time when the file was written, seconds since the epoch
+};
+
+struct CInfoRecord
+{
+   uint32_t m_piIP[4];		// IP address, as in CInfoBlock
+   int32_t m_iIPversion;	// IP version
+   int32_t m_iRTT;		// RTT
+   int32_t m_iBandwidth;	// estimated bandwidth
+   int32_t m_iLossRate;		// average loss rate
+   int32_t m_iReorderDistance;	// packet reordering distance
+   int32_t m_iReserved;		// 0, aligns the fields below
+   int64_t m_llAge;		// age of the item when the file was written, microseconds
+   double m_dInterval;		// inter-packet time
+   double m_dCWnd;		// congestion window size
+};
+
+static const char g_pcInfoMagic[4] = {'U', 'D', 'T', 'C'};
+static const uint32_t g_iInfoVersion = 1;
+static const uint32_t g_iInfoMaxCount = 1 << 20;	// a file with more records than this is not a saved cache
+
+static bool newerInfo(const CInfoBlock& a, const CInfoBlock& b)
+{
+   return a.m_ullTimeStamp > b.m_ullTimeStamp;
+}
+
 CInfoBlock& CInfoBlock::operator=(const CInfoBlock& obj)
 {
-   std::copy(obj.m_piIP, obj.m_piIP + 3, m_piIP);
+   std::copy(obj.m_piIP, obj.m_piIP + 4, m_piIP);
    m_iIPversion = obj.m_iIPversion;
    m_ullTimeStamp = obj.m_ullTimeStamp;
    m_iRTT = obj.m_iRTT;
@@ -63,6 +104,7 @@ CInfoBlock& CInfoBlock::operator=(const CInfoBlock& obj)
    m_iReorderDistance = obj.m_iReorderDistance;
    m_dInterval = obj.m_dInterval;
    m_dCWnd = obj.m_dCWnd;
+   m_bOpen = obj.m_bOpen;
 
    return *this;
 }
@@ -88,7 +130,7 @@ CInfoBlock* CInfoBlock::clone()
 {
    CInfoBlock* obj = new CInfoBlock;
 
-   std::copy(m_piIP, m_piIP + 3, obj->m_piIP);
+   std::copy(m_piIP, m_piIP + 4, obj->m_piIP);
    obj->m_iIPversion = m_iIPversion;
    obj->m_ullTimeStamp = m_ullTimeStamp;
    obj->m_iRTT = m_iRTT;
@@ -97,6 +139,7 @@ CInfoBlock* CInfoBlock::clone()
    obj->m_iReorderDistance = m_iReorderDistance;
    obj->m_dInterval = m_dInterval;
    obj->m_dCWnd = m_dCWnd;
+   obj->m_bOpen = m_bOpen;
 
    return obj;
 }
@@ -121,3 +164,130 @@ void CInfoBlock::convert(const sockaddr* addr, int ver, uint32_t ip[])
       memcpy((char*)ip, (char*)((sockaddr_in6*)addr)->sin6_addr.s6_addr, 16);
    }
 }
+
+int CInfoBlock::load(CCache<CInfoBlock>* cache, const char* file, int ttl)
+{
+   fstream ifs(file, ios::in | ios::binary);
+   if (ifs.fail())
+      return -1;
+
+   CInfoFileHeader hdr;
+   ifs.read((char*)&hdr, sizeof(CInfoFileHeader));
+   if (ifs.fail() || (0 != memcmp(hdr.m_pcMagic, g_pcInfoMagic, 4)) || (hdr.m_iVersion != g_iInfoVersion) || (hdr.m_iRecordSize != sizeof(CInfoRecord)))
+      return -1;
+
+   // the count comes from the disk, it must fit in the bound and match the size of the file before anything is allocated
+   if (hdr.m_iCount > g_iInfoMaxCount)
+      return -1;
+   ifs.seekg(0, ios::end);
+   int64_t size = ifs.tellg();
+   if (ifs.fail() || (size != int64_t(sizeof(CInfoFileHeader) + uint64_t(hdr.m_iCount) * sizeof(CInfoRecord))))
+      return -1;
+   ifs.seekg(sizeof(CInfoFileHeader), ios::beg);
+
+   vector<CInfoRecord> records(hdr.m_iCount);
+   if (hdr.m_iCount > 0)
+      ifs.read((char*)&records[0], hdr.m_iCount * sizeof(CInfoRecord));
+   if (ifs.fail())
+      return -1;
+
+   // the time the file has been lying there counts in the age of its items
+   int64_t idle = (int64_t)time(NULL) - hdr.m_llSaveTime;
+   if (idle < 0)
+      idle = 0;
+   uint64_t currtime = CTimer::getTime();
+
+   // the oldest first, so that the cache keeps the order of the updates
+   int loaded = 0;
+   for (uint32_t i = hdr.m_iCount; i > 0; -- i)
+   {
+      const CInfoRecord& r = records[i - 1];
+      if ((AF_INET != r.m_iIPversion) && (AF_INET6 != r.m_iIPversion))
+         continue;
+
+      int64_t age = r.m_llAge + idle * 1000000;
+      if ((age < 0) || (age > ttl * 1000000LL))
+         continue;
+
+      CInfoBlock ib;
+      std::copy(r.m_piIP, r.m_piIP + 4, ib.m_piIP);
+      ib.m_iIPversion = r.m_iIPversion;
+      ib.m_ullTimeStamp = ((uint64_t)age < currtime) ? currtime - age : 0;
+      ib.m_iRTT = r.m_iRTT;
+      ib.m_iBandwidth = r.m_iBandwidth;
+      ib.m_iLossRate = r.m_iLossRate;
+      ib.m_iReorderDistance = r.m_iReorderDistance;
+      ib.m_dInterval = r.m_dInterval;
+      ib.m_dCWnd = r.m_dCWnd;
+      ib.m_bOpen = false;
+
+      cache->update(&ib);
+      ++ loaded;
+   }
+
+   return loaded;
+}
+
+int CInfoBlock::save(CCache<CInfoBlock>* cache, const char* file, int ttl)
+{
+   vector<CInfoBlock> items;
+   cache->list(items);
+
+   // the cache keeps the order of use per shard only
+   std::stable_sort(items.begin(), items.end(), newerInfo);
+
+   uint64_t currtime = CTimer::getTime();
+   vector<CInfoRecord> records;
+   for (vector<CInfoBlock>::iterator i = items.begin(); i != items.end(); ++ i)
+   {
+      int64_t age = (currtime > i->m_ullTimeStamp) ? currtime - i->m_ullTimeStamp : 0;
+      if (age > ttl * 1000000LL)
+         continue;
+
+      CInfoRecord r;
+      memset(&r, 0, sizeof(CInfoRecord));
+      std::copy(i->m_piIP, i->m_piIP + 4, r.m_piIP);
+      r.m_iIPversion = i->m_iIPversion;
+      r.m_iRTT = i->m_iRTT;
+      r.m_iBandwidth = i->m_iBandwidth;
+      r.m_iLossRate = i->m_iLossRate;
+      r.m_iReorderDistance = i->m_iReorderDistance;
+      r.m_llAge = age;
+      r.m_dInterval = i->m_dInterval;
+      r.m_dCWnd = i->m_dCWnd;
+      records.push_back(r);
+   }
+
+   CInfoFileHeader hdr;
+   memcpy(hdr.m_pcMagic, g_pcInfoMagic, 4);
+   hdr.m_iVersion = g_iInfoVersion;
+   hdr.m_iRecordSize = sizeof(CInfoRecord);
+   hdr.m_iCount = records.size();
+   hdr.m_llSaveTime = time(NULL);
+
+   // written aside and renamed, a process starting meanwhile never reads half a file
+   string tmp = string(file) + ".tmp";
+   fstream ofs(tmp.c_str(), ios::out | ios::binary | ios::trunc);
+   if (ofs.fail())
+      return -1;
+   ofs.write((char*)&hdr, sizeof(CInfoFileHeader));
+   if (!records.empty())
+      ofs.write((char*)&records[0], records.size() * sizeof(CInfoRecord));
+   ofs.close();
+   if (ofs.fail())
+   {
+      remove(tmp.c_str());
+      return -1;
+   }
+
+   #ifdef WIN32
+      remove(file);
+   #endif
+   if (0 != rename(tmp.c_str(), file))
+   {
+      remove(tmp.c_str());
+      return -1;
+   }
+
+   return records.size();
+}
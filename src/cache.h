@@ -41,7 +41,6 @@ written by
 #ifndef __UDT_CACHE_H__
 #define __UDT_CACHE_H__
 
-#include <list>
 #include <vector>
 
 #include "common.h"
@@ -68,11 +67,11 @@ public:
    virtual CCacheItem* clone() = 0;
 
       // Functionality:
-      //    get a random key value between 0 and MAX_INT to be used for the hash in cache
+      //    get a key value to be used for the hash in cache, equal items must have equal keys
       // Parameters:
       //    None.
       // Returned value:
-      //    A random hash key.
+      //    The hash key.
 
    virtual int getKey() = 0;
 
@@ -81,22 +80,39 @@ public:
    virtual void release() {}
 };
 
+// The cache is split in shards by the hash of the keys, each with its own lock, so that connections to different
+// hosts do not wait for each other. A shard keeps its items in a doubly linked list in the order of use, and in a
+// flat array of hash buckets chained through the items themselves; finding, moving and evicting an item takes no
+// allocation and no search beyond its bucket.
+
 template<typename T> class CCache
 {
 public:
    CCache(int size = 1024):
    m_iMaxSize(size),
-   m_iHashSize(size * 3),
-   m_iCurrSize(0)
+   m_iShardNum(1),
+   m_pShard(NULL)
    {
-      m_vHashPtr.resize(m_iHashSize);
-      CGuard::createMutex(m_Lock);
+      while ((m_iShardNum < m_iMaxShardNum) && (m_iShardNum * 2 <= size))
+         m_iShardNum *= 2;
+
+      m_pShard = new CShard[m_iShardNum];
+      for (int i = 0; i < m_iShardNum; ++ i)
+      {
+         m_pShard[i].m_pHead = m_pShard[i].m_pTail = NULL;
+         m_pShard[i].m_iCurrSize = 0;
+         CGuard::createMutex(m_pShard[i].m_Lock);
+      }
+
+      setSizeLimit(size);
    }
 
    ~CCache()
    {
       clear();
-      CGuard::releaseMutex(m_Lock);
+      for (int i = 0; i < m_iShardNum; ++ i)
+         CGuard::releaseMutex(m_pShard[i].m_Lock);
+      delete [] m_pShard;
    }
 
 public:
@@ -109,26 +125,22 @@ public:
 
    int lookup(T* data)
    {
-      CGuard cacheguard(m_Lock);
+      uint32_t hash = getHash(data);
+      CShard& s = m_pShard[hash & (m_iShardNum - 1)];
+
+      CGuard cacheguard(s.m_Lock);
 
-      int key = data->getKey();
-      if (key < 0)
+      CEntry* e = find(s, hash, data);
+      if (NULL == e)
          return -1;
-      if (key >= m_iMaxSize)
-         key %= m_iHashSize;
 
-      const ItemPtrList& item_list = m_vHashPtr[key];
-      for (typename ItemPtrList::const_iterator i = item_list.begin(); i != item_list.end(); ++ i)
-      {
-         if (*data == ***i)
-         {
-            // copy the cached info
-            *data = ***i;
-            return 0;
-         }
-      }
+      // copy the cached info
+      *data = *e->m_pData;
+
+      unlink(s, e);
+      pushFront(s, e);
 
-      return -1;
+      return 0;
    }
 
       // Functionality:
@@ -140,70 +152,69 @@ public:
 
    int update(T* data)
    {
-      CGuard cacheguard(m_Lock);
-
-      int key = data->getKey();
-      if (key < 0)
-         return -1;
-      if (key >= m_iMaxSize)
-         key %= m_iHashSize;
+      uint32_t hash = getHash(data);
+      CShard& s = m_pShard[hash & (m_iShardNum - 1)];
 
-      T* curr = NULL;
+      CGuard cacheguard(s.m_Lock);
 
-      ItemPtrList& item_list = m_vHashPtr[key];
-      for (typename ItemPtrList::iterator i = item_list.begin(); i != item_list.end(); ++ i)
+      CEntry* e = find(s, hash, data);
+      if (NULL != e)
       {
-         if (*data == ***i)
-         {
-            // update the existing entry with the new value
-            ***i = *data;
-            curr = **i;
-
-            // remove the current entry
-            m_StorageList.erase(*i);
-            item_list.erase(i);
+         // update the existing entry with the new value and move it to the front
+         *e->m_pData = *data;
+         unlink(s, e);
+         pushFront(s, e);
+         return 0;
+      }
 
-            // re-insert to the front
-            m_StorageList.push_front(curr);
-            item_list.push_front(m_StorageList.begin());
+      T* curr = data->clone();
+      if (NULL == curr)
+         return -1;
 
-            return 0;
-         }
+      if (s.m_iCurrSize >= s.m_iMaxSize)
+      {
+         // shard overflow, the least recently used entry makes room for the new one
+         e = s.m_pTail;
+         unlink(s, e);
+         unchain(s, e);
+         e->m_pData->release();
+         delete e->m_pData;
+      }
+      else
+      {
+         e = new CEntry;
+         ++ s.m_iCurrSize;
       }
 
-      // create new entry and insert to front
-      curr = data->clone();
-      m_StorageList.push_front(curr);
-      item_list.push_front(m_StorageList.begin());
+      e->m_pData = curr;
+      e->m_iHash = hash;
+      chain(s, e);
+      pushFront(s, e);
 
-      ++ m_iCurrSize;
-      if (m_iCurrSize >= m_iMaxSize)
-      {
-         // Cache overflow, remove oldest entry.
-         T* last_data = m_StorageList.back();
-         int last_key = last_data->getKey() % m_iHashSize;
+      return 0;
+   }
 
-         item_list = m_vHashPtr[last_key];
-         for (typename ItemPtrList::iterator i = item_list.begin(); i != item_list.end(); ++ i)
-         {
-            if (*last_data == ***i)
-            {
-               item_list.erase(i);
-               break;
-            }
-         }
+      // Functionality:
+      //    copy all the items in the cache, the most recently used first within each shard.
+      // Parameters:
+      //    0) [out] data: storage for the copies.
+      // Returned value:
+      //    None.
 
-         last_data->release();
-         delete last_data;
-         m_StorageList.pop_back();
-         -- m_iCurrSize;
-      }
+   void list(std::vector<T>& data)
+   {
+      data.clear();
+      for (int i = 0; i < m_iShardNum; ++ i)
+      {
+         CGuard cacheguard(m_pShard[i].m_Lock);
 
-      return 0;
+         for (CEntry* e = m_pShard[i].m_pHead; NULL != e; e = e->m_pNext)
+            data.push_back(*e->m_pData);
+      }
    }
 
       // Functionality:
-      //    Specify the cache size (i.e., max number of items).
+      //    Specify the cache size (i.e., max number of items), rounded up to a multiple of the number of shards.
       // Parameters:
       //    0) [in] size: max cache size.
       // Returned value:
@@ -212,8 +223,34 @@ public:
    void setSizeLimit(int size)
    {
       m_iMaxSize = size;
-      m_iHashSize = size * 3;
-      m_vHashPtr.resize(m_iHashSize);
+
+      for (int i = 0; i < m_iShardNum; ++ i)
+      {
+         CShard& s = m_pShard[i];
+         CGuard cacheguard(s.m_Lock);
+
+         s.m_iMaxSize = (size + m_iShardNum - 1) / m_iShardNum;
+         if (s.m_iMaxSize < 1)
+            s.m_iMaxSize = 1;
+
+         while (s.m_iCurrSize > s.m_iMaxSize)
+         {
+            CEntry* e = s.m_pTail;
+            unlink(s, e);
+            e->m_pData->release();
+            delete e->m_pData;
+            delete e;
+            -- s.m_iCurrSize;
+         }
+
+         // at most half full buckets, a power of 2 in number
+         int buckets = 1;
+         while (buckets < s.m_iMaxSize * 2)
+            buckets *= 2;
+         s.m_vBucket.assign(buckets, (CEntry*)NULL);
+         for (CEntry* e = s.m_pHead; NULL != e; e = e->m_pNext)
+            chain(s, e);
+      }
    }
 
       // Functionality:
@@ -225,28 +262,117 @@ public:
 
    void clear()
    {
-      for (typename std::list<T*>::iterator i = m_StorageList.begin(); i != m_StorageList.end(); ++ i)
+      for (int i = 0; i < m_iShardNum; ++ i)
       {
-         (*i)->release();
-         delete *i;
+         CShard& s = m_pShard[i];
+         CGuard cacheguard(s.m_Lock);
+
+         for (CEntry* e = s.m_pHead; NULL != e;)
+         {
+            CEntry* next = e->m_pNext;
+            e->m_pData->release();
+            delete e->m_pData;
+            delete e;
+            e = next;
+         }
+         s.m_pHead = s.m_pTail = NULL;
+         s.m_vBucket.assign(s.m_vBucket.size(), (CEntry*)NULL);
+         s.m_iCurrSize = 0;
       }
-      m_StorageList.clear();
-      for (typename std::vector<ItemPtrList>::iterator i = m_vHashPtr.begin(); i != m_vHashPtr.end(); ++ i)
-         i->clear();
-      m_iCurrSize = 0;
    }
 
 private:
-   std::list<T*> m_StorageList;
-   typedef typename std::list<T*>::iterator ItemPtr;
-   typedef std::list<ItemPtr> ItemPtrList;
-   std::vector<ItemPtrList> m_vHashPtr;
+   struct CEntry
+   {
+      T* m_pData;			// the cached item
+      uint32_t m_iHash;		// hash of the item key
+      CEntry* m_pPrev;		// previous (more recently used) entry
+      CEntry* m_pNext;		// next (less recently used) entry
+      CEntry* m_pChain;		// next entry in the same hash bucket
+   };
+
+   struct CShard
+   {
+      pthread_mutex_t m_Lock;		// lock of the shard
+      CEntry* m_pHead;			// most recently used entry
+      CEntry* m_pTail;			// least recently used entry
+      std::vector<CEntry*> m_vBucket;	// hash buckets
+      int m_iCurrSize;			// number of entries
+      int m_iMaxSize;			// max number of entries
+      char m_pcPad[64];			// keeps the locks of neighbour shards off the same cache line
+   };
+
+   static const int m_iMaxShardNum = 16;
 
    int m_iMaxSize;
-   int m_iHashSize;
-   int m_iCurrSize;
+   int m_iShardNum;
+   CShard* m_pShard;
 
-   pthread_mutex_t m_Lock;
+private:
+   static uint32_t getHash(T* data)
+   {
+      // the keys need not be random (e.g., IPv4 addresses), mix all the bits in the low ones
+      uint32_t h = data->getKey();
+      h ^= h >> 16;
+      h *= 0x85ebca6b;
+      h ^= h >> 13;
+      h *= 0xc2b2ae35;
+      h ^= h >> 16;
+      return h;
+   }
+
+   CEntry*& bucket(CShard& s, uint32_t hash)
+   {
+      return s.m_vBucket[(hash / m_iShardNum) & (s.m_vBucket.size() - 1)];
+   }
+
+   CEntry* find(CShard& s, uint32_t hash, T* data)
+   {
+      for (CEntry* e = bucket(s, hash); NULL != e; e = e->m_pChain)
+      {
+         if ((e->m_iHash == hash) && (*data == *e->m_pData))
+            return e;
+      }
+      return NULL;
+   }
+
+   void chain(CShard& s, CEntry* e)
+   {
+      CEntry*& b = bucket(s, e->m_iHash);
+      e->m_pChain = b;
+      b = e;
+   }
+
+   void unchain(CShard& s, CEntry* e)
+   {
+      CEntry** p = &bucket(s, e->m_iHash);
+      while (*p != e)
+         p = &(*p)->m_pChain;
+      *p = e->m_pChain;
+   }
+
+   void pushFront(CShard& s, CEntry* e)
+   {
+      e->m_pPrev = NULL;
+      e->m_pNext = s.m_pHead;
+      if (NULL != s.m_pHead)
+         s.m_pHead->m_pPrev = e;
+      else
+         s.m_pTail = e;
+      s.m_pHead = e;
+   }
+
+   void unlink(CShard& s, CEntry* e)
+   {
+      if (NULL != e->m_pPrev)
+         e->m_pPrev->m_pNext = e->m_pNext;
+      else
+         s.m_pHead = e->m_pNext;
+      if (NULL != e->m_pNext)
+         e->m_pNext->m_pPrev = e->m_pPrev;
+      else
+         s.m_pTail = e->m_pPrev;
+   }
 
 private:
    CCache(const CCache&);
@@ -265,7 +391,8 @@ public:
    int m_iLossRate;		// average loss rate
    int m_iReorderDistance;	// packet reordering distance
    double m_dInterval;		// inter-packet time, congestion control
-   double m_dCWnd;		// congestion window size, congestion control
+   double m_dCWnd;		// congestion window size, congestion control, 0 if unknown
+   bool m_bOpen;		// if the state was taken from a connection still open
 
 public:
    virtual ~CInfoBlock() {}
@@ -287,6 +414,28 @@ public:
       //    None.
 
    static void convert(const sockaddr* addr, int ver, uint32_t ip[]);
+
+      // Functionality:
+      //    load the items saved in a file into a cache.
+      // Parameters:
+      //    0) [in] cache: the cache to fill.
+      //    1) [in] file: name of the file.
+      //    2) [in] ttl: items older than this are skipped, in seconds.
+      // Returned value:
+      //    Number of items loaded, or -1 if the file cannot be read or is of another format or version.
+
+   static int load(CCache<CInfoBlock>* cache, const char* file, int ttl);
+
+      // Functionality:
+      //    save the items of a cache to a file, replacing it as a whole.
+      // Parameters:
+      //    0) [in] cache: the cache to save.
+      //    1) [in] file: name of the file.
+      //    2) [in] ttl: items older than this are left out, in seconds.
+      // Returned value:
+      //    Number of items saved, or -1 if the file cannot be written.
+
+   static int save(CCache<CInfoBlock>* cache, const char* file, int ttl);
 };
 
 
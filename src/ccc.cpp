@@ -54,6 +54,14 @@ m_iMSS(),
 m_iSndCurrSeqNo(),
 m_iRcvRate(),
 m_iRTT(),
+m_iDeliveredSize(0),
+m_iDeliveryInterval(0),
+m_iRTTSample(0),
+m_bAppLimited(false),
+m_iOneWayDelay(0),
+m_bOneWayDelay(false),
+m_dCachedPktSndPeriod(0),
+m_dCachedCWndSize(0),
 m_pcParam(NULL),
 m_iPSize(0),
 m_UDT(),
@@ -143,6 +151,26 @@ void CCC::setRTT(int rtt)
    m_iRTT = rtt;
 }
 
+void CCC::setDeliveryRate(int size, int interval, int rtt, bool applimited)
+{
+   m_iDeliveredSize = size;
+   m_iDeliveryInterval = interval;
+   m_iRTTSample = rtt;
+   m_bAppLimited = applimited;
+}
+
+void CCC::setOneWayDelay(int32_t delay)
+{
+   m_iOneWayDelay = delay;
+   m_bOneWayDelay = true;
+}
+
+void CCC::setCachedState(double period, double cwnd)
+{
+   m_dCachedPktSndPeriod = period;
+   m_dCachedCWndSize = cwnd;
+}
+
 void CCC::setUserParam(const char* param, int size)
 {
    delete [] m_pcParam;
@@ -184,6 +212,16 @@ void CUDTCC::init()
 
    m_dCWndSize = 16;
    m_dPktSndPeriod = 1;
+
+   // earlier connections to the peer have found the rate already, continue from it rather than from slow start; the
+   // window of a slow start that has not ended tells the data sent, not the path
+   if ((m_dCachedCWndSize > 0) && (m_dCachedPktSndPeriod > 0))
+   {
+      m_bSlowStart = false;
+      m_dCWndSize = m_dCachedCWndSize;
+      m_dPktSndPeriod = m_dCachedPktSndPeriod;
+      m_dLastDecPeriod = m_dPktSndPeriod;
+   }
 }
 
 // ӣ
@@ -356,6 +394,27 @@ void CUDTCC::onLoss(const int32_t* losslist, int)
    }
 }
 
+void CUDTCC::onECN(int32_t ack, int)
+{
+   // a mark costs no retransmission, the rate is decreased once per congestion period and not any further
+   if (CSeqNo::seqcmp(CSeqNo::decseq(ack), m_iLastDecSeq) <= 0)
+      return;
+
+   if (m_bSlowStart)
+   {
+      m_bSlowStart = false;
+      if (m_iRcvRate > 0)
+         m_dPktSndPeriod = 1000000.0 / m_iRcvRate;
+      else
+         m_dPktSndPeriod = m_dCWndSize / (m_iRTT + m_iRCInterval);
+   }
+
+   m_bLoss = true;
+   m_dLastDecPeriod = m_dPktSndPeriod;
+   m_dPktSndPeriod = ceil(m_dPktSndPeriod * 1.125);
+   m_iLastDecSeq = m_iSndCurrSeqNo;
+}
+
 void CUDTCC::onTimeout()
 {
    // ӳ
@@ -387,3 +446,647 @@ void CUDTCC::onTimeout()
       */
    }
 }
+
+//
+const double CBBRCC::m_pdCycleGain[CBBRCC::m_iCycleLength] = {1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+
+CBBRCC::CBBRCC():
+m_State(STARTUP),
+m_dPacingGain(),
+m_dCWndGain(),
+m_iPayloadSize(),
+m_dBtlBw(),
+m_iMinRTT(),
+m_ullMinRTTTime(),
+m_bMinRTTExpired(),
+m_iLastAck(),
+m_iRoundEnd(),
+m_iRound(),
+m_bRoundStart(),
+m_iRoundAcked(),
+m_iRoundLost(),
+m_dFullBW(),
+m_iFullBWCount(),
+m_bFilledPipe(),
+m_iCycleIndex(),
+m_ullCycleTime(),
+m_iRandState(),
+m_ullProbeRTTDone(),
+m_bProbeRTTRound(),
+m_dPriorCWnd()
+{
+   memset(m_pdBW, 0, sizeof(m_pdBW));
+}
+
+void CBBRCC::init()
+{
+   // the delivered data is counted in bytes, the rate and the window in full packets
+   m_iPayloadSize = m_iMSS - 28 - CPacket::m_iPktHdrSize;
+
+   memset(m_pdBW, 0, sizeof(m_pdBW));
+   m_dBtlBw = 0;
+   m_iMinRTT = m_iRTT;
+   m_ullMinRTTTime = CTimer::getTime();
+   m_bMinRTTExpired = false;
+
+   m_iLastAck = m_iSndCurrSeqNo;
+   m_iRoundEnd = m_iSndCurrSeqNo;
+   m_iRound = 0;
+   m_bRoundStart = false;
+   m_iRoundAcked = 0;
+   m_iRoundLost = 0;
+
+   m_dFullBW = 0;
+   m_iFullBWCount = 0;
+   m_bFilledPipe = false;
+
+   m_iCycleIndex = 0;
+   m_ullCycleTime = 0;
+   // the initial seq no is random, the time tells apart sockets that happen to share it
+   m_iRandState = uint32_t(m_iSndCurrSeqNo) ^ uint32_t(CTimer::getTime());
+   m_ullProbeRTTDone = 0;
+   m_bProbeRTTRound = false;
+   m_dPriorCWnd = 0;
+
+   // 2/ln2 doubles the delivery rate every round trip
+   m_State = STARTUP;
+   m_dPacingGain = 2.885;
+   m_dCWndGain = 2.885;
+
+   // until the first delivery rate sample, the initial window is paced out over one RTT
+   m_dCWndSize = 16;
+   m_dPktSndPeriod = m_iRTT / (m_dPacingGain * m_dCWndSize);
+}
+
+void CBBRCC::onACK(int32_t ack)
+{
+   uint64_t currtime = CTimer::getTime();
+
+   updateModel(ack, currtime);
+   updateState(ack, currtime);
+   updateControl(ack);
+
+   m_iLastAck = ack;
+}
+
+void CBBRCC::onLoss(const int32_t* losslist, int size)
+{
+   // the loss does not change the model, it only tells when the startup has filled a shallow buffer
+   for (int i = 0; i < size; ++ i)
+   {
+      if (0 != (losslist[i] & 0x80000000))
+      {
+         m_iRoundLost += CSeqNo::seqlen(losslist[i] & 0x7FFFFFFF, losslist[i + 1]);
+         ++ i;
+      }
+      else
+         ++ m_iRoundLost;
+   }
+}
+
+void CBBRCC::onTimeout()
+{
+   // nothing is known to be in flight any more, the window is rebuilt by the ACKs that follow
+   // the window is kept, for PROBE_RTT to give it back as it does with its own
+   if (m_dPriorCWnd < m_dCWndSize)
+      m_dPriorCWnd = m_dCWndSize;
+   m_dCWndSize = 4;
+}
+
+void CBBRCC::updateModel(int32_t ack, uint64_t currtime)
+{
+   // a round trip ends when a packet sent after it started is acknowledged
+   m_bRoundStart = false;
+   if (CSeqNo::seqoff(m_iLastAck, ack) > 0)
+      m_iRoundAcked += CSeqNo::seqoff(m_iLastAck, ack);
+   if (CSeqNo::seqcmp(ack, m_iRoundEnd) > 0)
+   {
+      m_iRoundEnd = m_iSndCurrSeqNo;
+      ++ m_iRound;
+      m_bRoundStart = true;
+      m_pdBW[m_iRound % m_iBWRounds] = 0;
+   }
+
+   // the minimum RTT is taken again if it has not been seen for 10 seconds, the route may have changed
+   m_bMinRTTExpired = (currtime > m_ullMinRTTTime + 10000000);
+   if ((m_iRTTSample > 0) && ((m_iRTTSample <= m_iMinRTT) || m_bMinRTTExpired))
+   {
+      m_iMinRTT = m_iRTTSample;
+      m_ullMinRTTTime = currtime;
+   }
+
+   // a sample shorter than the RTT only shows how fast the ACKs came back
+   if ((m_iDeliveryInterval <= 0) || (m_iDeliveryInterval < m_iMinRTT))
+      return;
+
+   // the bottleneck bandwidth is the maximum delivery rate of the last round trips, a rate limited by the application
+   // only counts if it is higher than that
+   double bw = double(m_iDeliveredSize) / m_iPayloadSize * 1000000.0 / m_iDeliveryInterval;
+   if (m_bAppLimited && (bw < m_dBtlBw))
+      return;
+
+   if (bw > m_pdBW[m_iRound % m_iBWRounds])
+      m_pdBW[m_iRound % m_iBWRounds] = bw;
+
+   m_dBtlBw = 0;
+   for (int i = 0; i < m_iBWRounds; ++ i)
+   {
+      if (m_pdBW[i] > m_dBtlBw)
+         m_dBtlBw = m_pdBW[i];
+   }
+}
+
+void CBBRCC::updateState(int32_t ack, uint64_t currtime)
+{
+   int inflight = CSeqNo::seqlen(ack, m_iSndCurrSeqNo);
+
+   // the pipe is full when the bandwidth has not grown by a quarter for three round trips, or when more than 2% of
+   // the data sent in a round trip is lost, as the buffer is too shallow to hold the queue built up in the startup
+   if (!m_bFilledPipe && m_bRoundStart && (m_iRoundLost * 50 > m_iRoundAcked + m_iRoundLost))
+      m_bFilledPipe = true;
+
+   if (!m_bFilledPipe && m_bRoundStart && !m_bAppLimited)
+   {
+      if (m_dBtlBw >= m_dFullBW * 1.25)
+      {
+         m_dFullBW = m_dBtlBw;
+         m_iFullBWCount = 0;
+      }
+      else if (++ m_iFullBWCount >= 3)
+         m_bFilledPipe = true;
+   }
+
+   if (m_bRoundStart)
+      m_iRoundAcked = m_iRoundLost = 0;
+
+   if ((STARTUP == m_State) && m_bFilledPipe)
+   {
+      // drain the queue built up in the startup
+      m_State = DRAIN;
+      m_dPacingGain = 1 / 2.885;
+      m_dCWndGain = 2.885;
+   }
+
+   if ((DRAIN == m_State) && (inflight <= getBDP()))
+   {
+      // start the probing cycle at a random phase other than the draining one, so that flows do not probe together
+      m_State = PROBE_BW;
+      m_dCWndGain = 2;
+      m_iRandState = m_iRandState * 1103515245 + 12345;
+      m_iCycleIndex = 2 + (m_iRandState >> 16) % (m_iCycleLength - 2);
+      m_ullCycleTime = currtime;
+      m_dPacingGain = m_pdCycleGain[m_iCycleIndex];
+   }
+
+   if (PROBE_BW == m_State)
+   {
+      // a phase lasts a minimum RTT, the probing phase until the extra data is in flight, the draining phase until
+      // it has left the queue
+      bool full = currtime - m_ullCycleTime > (uint64_t)m_iMinRTT;
+      bool next = full;
+      if (m_dPacingGain > 1)
+         next = full && (inflight >= m_dPacingGain * getBDP());
+      else if (m_dPacingGain < 1)
+         next = inflight <= getBDP();
+
+      if (next)
+      {
+         m_iCycleIndex = (m_iCycleIndex + 1) % m_iCycleLength;
+         m_ullCycleTime = currtime;
+         m_dPacingGain = m_pdCycleGain[m_iCycleIndex];
+      }
+   }
+
+   if ((PROBE_RTT != m_State) && m_bMinRTTExpired)
+   {
+      // empty the queue for a while, so that the minimum RTT can be seen again
+      m_State = PROBE_RTT;
+      m_dPacingGain = 1;
+      m_dCWndGain = 1;
+      if (m_dPriorCWnd < m_dCWndSize)
+         m_dPriorCWnd = m_dCWndSize;
+      m_ullProbeRTTDone = 0;
+   }
+
+   if (PROBE_RTT == m_State)
+   {
+      if ((0 == m_ullProbeRTTDone) && (inflight <= 4))
+      {
+         // stay at least 200ms and one round trip with the queue drained
+         m_ullProbeRTTDone = currtime + 200000;
+         m_bProbeRTTRound = false;
+         m_iRoundEnd = m_iSndCurrSeqNo;
+      }
+      else if (0 != m_ullProbeRTTDone)
+      {
+         if (m_bRoundStart)
+            m_bProbeRTTRound = true;
+
+         if (m_bProbeRTTRound && (currtime > m_ullProbeRTTDone))
+         {
+            m_ullMinRTTTime = currtime;
+            if (m_dCWndSize < m_dPriorCWnd)
+               m_dCWndSize = m_dPriorCWnd;
+            m_dPriorCWnd = 0;
+
+            if (m_bFilledPipe)
+            {
+               m_State = PROBE_BW;
+               m_dCWndGain = 2;
+               m_iCycleIndex = 2;
+               m_ullCycleTime = currtime;
+               m_dPacingGain = m_pdCycleGain[m_iCycleIndex];
+            }
+            else
+            {
+               m_State = STARTUP;
+               m_dPacingGain = 2.885;
+               m_dCWndGain = 2.885;
+            }
+         }
+      }
+   }
+}
+
+void CBBRCC::updateControl(int32_t ack)
+{
+   if (m_dBtlBw <= 0)
+      return;
+
+   // the sending rate is not lowered before the pipe is known to be full
+   double period = 1000000.0 / (m_dPacingGain * m_dBtlBw);
+   if (m_bFilledPipe || (period < m_dPktSndPeriod))
+      m_dPktSndPeriod = period;
+
+   // the window follows the data acknowledged up to its target, it may grow beyond it in the startup
+   // ACKs come back every SYN, the window has to cover the data sent between them as well
+   double target = m_dCWndGain * getBDP() + m_dBtlBw * m_iSYNInterval / 1000000.0 + 4;
+   int acked = CSeqNo::seqoff(m_iLastAck, ack);
+   if (acked > 0)
+   {
+      if (m_bFilledPipe)
+         m_dCWndSize = (m_dCWndSize + acked < target) ? m_dCWndSize + acked : target;
+      else if (m_dCWndSize < target)
+         m_dCWndSize += acked;
+   }
+
+   if (m_dCWndSize < 4)
+      m_dCWndSize = 4;
+   if ((PROBE_RTT == m_State) && (m_dCWndSize > 4))
+      m_dCWndSize = 4;
+   if (m_dCWndSize > m_dMaxCWndSize)
+      m_dCWndSize = m_dMaxCWndSize;
+}
+
+double CBBRCC::getBDP() const
+{
+   return m_dBtlBw * m_iMinRTT / 1000000.0;
+}
+
+//
+const double CCUBICCC::m_dC = 0.4;
+const double CCUBICCC::m_dBeta = 0.7;
+
+CCUBICCC::CCUBICCC():
+m_bSlowStart(),
+m_dSSThresh(),
+m_iLastAck(),
+m_iLastDecSeq(),
+m_dWMax(),
+m_dK(),
+m_ullEpochStart(),
+m_dWEst(),
+m_iRoundEnd(),
+m_iLastRoundMinRTT(),
+m_iRoundMinRTT(),
+m_iRoundSamples()
+{
+}
+
+void CCUBICCC::init()
+{
+   m_bSlowStart = true;
+   m_dSSThresh = m_dMaxCWndSize;
+   m_iLastAck = m_iSndCurrSeqNo;
+   m_iLastDecSeq = CSeqNo::decseq(m_iLastAck);
+
+   m_dWMax = 0;
+   m_dK = 0;
+   m_ullEpochStart = 0;
+   m_dWEst = 0;
+
+   m_iRoundEnd = m_iSndCurrSeqNo;
+   m_iLastRoundMinRTT = 0;
+   m_iRoundMinRTT = 0;
+   m_iRoundSamples = 0;
+
+   m_dCWndSize = 16;
+
+   // earlier connections to the peer have found the window already, avoid congestion from it rather than slow start
+   if (m_dCachedCWndSize > m_dCWndSize)
+   {
+      m_bSlowStart = false;
+      m_dCWndSize = m_dCachedCWndSize;
+      m_dSSThresh = m_dCWndSize;
+      m_dWMax = m_dCWndSize;
+   }
+
+   updatePacing();
+}
+
+void CCUBICCC::onACK(int32_t ack)
+{
+   int acked = CSeqNo::seqoff(m_iLastAck, ack);
+   if (acked <= 0)
+      return;
+   m_iLastAck = ack;
+
+   if (m_bSlowStart)
+   {
+      hyStart(ack);
+
+      if (m_bSlowStart)
+      {
+         m_dCWndSize += acked;
+         if (m_dCWndSize >= m_dSSThresh)
+            m_bSlowStart = false;
+      }
+   }
+   else
+      updateCWnd(acked);
+
+   if (m_dCWndSize > m_dMaxCWndSize)
+      m_dCWndSize = m_dMaxCWndSize;
+
+   updatePacing();
+}
+
+void CCUBICCC::onLoss(const int32_t* losslist, int)
+{
+   // the window is reduced once per congestion event, i.e., for the losses of the data sent before the last reduction
+   if (CSeqNo::seqcmp(losslist[0] & 0x7FFFFFFF, m_iLastDecSeq) <= 0)
+      return;
+   m_iLastDecSeq = m_iSndCurrSeqNo;
+   m_bSlowStart = false;
+
+   // fast convergence: a flow whose window keeps shrinking gives up bandwidth to the newer ones
+   if (m_dCWndSize < m_dWMax)
+      m_dWMax = m_dCWndSize * (1 + m_dBeta) / 2;
+   else
+      m_dWMax = m_dCWndSize;
+
+   m_dCWndSize *= m_dBeta;
+   if (m_dCWndSize < 2)
+      m_dCWndSize = 2;
+   m_dSSThresh = m_dCWndSize;
+   m_ullEpochStart = 0;
+
+   updatePacing();
+}
+
+void CCUBICCC::onECN(int32_t ack, int)
+{
+   // a mark is answered as a loss of the data acknowledged with it
+   int32_t seqno = CSeqNo::decseq(ack);
+   onLoss(&seqno, 1);
+}
+
+void CCUBICCC::onTimeout()
+{
+   // nothing is known to be in flight any more, slow start again up to the reduced window; the losses of the data
+   // already sent are part of this event
+   if (m_dCWndSize > 4)
+   {
+      m_dWMax = m_dCWndSize;
+      m_dSSThresh = m_dCWndSize * m_dBeta;
+   }
+   m_iLastDecSeq = m_iSndCurrSeqNo;
+   m_bSlowStart = true;
+   m_ullEpochStart = 0;
+
+   m_dCWndSize = 4;
+   updatePacing();
+}
+
+void CCUBICCC::hyStart(int32_t ack)
+{
+   // a round trip ends when a packet sent after it started is acknowledged
+   if (CSeqNo::seqcmp(ack, m_iRoundEnd) > 0)
+   {
+      if (m_iRoundSamples >= m_iHyStartSamples)
+         m_iLastRoundMinRTT = m_iRoundMinRTT;
+      m_iRoundMinRTT = 0;
+      m_iRoundSamples = 0;
+      m_iRoundEnd = m_iSndCurrSeqNo;
+   }
+
+   if (m_iRTTSample <= 0)
+      return;
+
+   ++ m_iRoundSamples;
+   if ((0 == m_iRoundMinRTT) || (m_iRTTSample < m_iRoundMinRTT))
+      m_iRoundMinRTT = m_iRTTSample;
+
+   // the slow start ends before the losses, as soon as the RTT shows that the queue has started to grow: the minimum
+   // RTT of this round trip exceeds that of the last one by 1/8 of it, but at least 4ms and at most 16ms
+   if ((m_dCWndSize < 16) || (m_iRoundSamples < m_iHyStartSamples) || (0 == m_iLastRoundMinRTT))
+      return;
+
+   int eta = m_iLastRoundMinRTT / 8;
+   if (eta < 4000)
+      eta = 4000;
+   else if (eta > 16000)
+      eta = 16000;
+
+   if (m_iRoundMinRTT >= m_iLastRoundMinRTT + eta)
+   {
+      m_bSlowStart = false;
+      m_dSSThresh = m_dCWndSize;
+   }
+}
+
+void CCUBICCC::updateCWnd(int acked)
+{
+   uint64_t currtime = CTimer::getTime();
+
+   // a new epoch starts from the current window, the cubic function reaches the window before the last congestion event
+   // after K seconds and grows beyond it from there
+   if (0 == m_ullEpochStart)
+   {
+      m_ullEpochStart = currtime;
+      if (m_dCWndSize < m_dWMax)
+         m_dK = pow((m_dWMax - m_dCWndSize) / m_dC, 1.0 / 3);
+      else
+      {
+         m_dK = 0;
+         m_dWMax = m_dCWndSize;
+      }
+      m_dWEst = m_dCWndSize;
+   }
+
+   // the window is moved toward where the cubic function will be one RTT later, by at most half of it per RTT
+   double t = (currtime - m_ullEpochStart + m_iRTT) / 1000000.0;
+   double target = m_dC * (t - m_dK) * (t - m_dK) * (t - m_dK) + m_dWMax;
+   if (target > m_dCWndSize * 1.5)
+      target = m_dCWndSize * 1.5;
+
+   // a standard TCP flow would grow by 3(1 - beta)/(1 + beta) packet per RTT, the window never grows slower than that
+   m_dWEst += acked * 3 * (1 - m_dBeta) / (1 + m_dBeta) / m_dCWndSize;
+
+   if (m_dWEst > target)
+      m_dCWndSize = m_dWEst;
+   else if (target > m_dCWndSize)
+      m_dCWndSize += (target - m_dCWndSize) / m_dCWndSize * acked;
+}
+
+void CCUBICCC::updatePacing()
+{
+   // the window is paced out over the RTT, faster than it is consumed so that the window keeps the control
+   m_dPktSndPeriod = m_iRTT / ((m_bSlowStart ? 2 : 1.2) * m_dCWndSize);
+}
+
+//
+CLEDBATCC::CLEDBATCC():
+m_bSlowStart(),
+m_iLastAck(),
+m_iLastDecSeq(),
+m_iBaseCount(),
+m_ullBaseTime(),
+m_iCurrentCount()
+{
+   memset(m_piBaseDelay, 0, sizeof(m_piBaseDelay));
+   memset(m_piCurrentDelay, 0, sizeof(m_piCurrentDelay));
+}
+
+void CLEDBATCC::init()
+{
+   m_bSlowStart = true;
+   m_iLastAck = m_iSndCurrSeqNo;
+   m_iLastDecSeq = CSeqNo::decseq(m_iLastAck);
+
+   m_iBaseCount = 0;
+   m_ullBaseTime = 0;
+   m_iCurrentCount = 0;
+
+   m_dCWndSize = 2;
+   updatePacing();
+}
+
+void CLEDBATCC::onACK(int32_t ack)
+{
+   int acked = CSeqNo::seqoff(m_iLastAck, ack);
+   if (acked <= 0)
+      return;
+   m_iLastAck = ack;
+
+   // the one-way delay leaves out the queues on the way back, the RTT of the packet acknowledged is used if the peer
+   // does not report it
+   if (m_bOneWayDelay)
+      addDelay(m_iOneWayDelay);
+   else if (m_iRTTSample > 0)
+      addDelay(m_iRTTSample);
+
+   if (0 == m_iCurrentCount)
+      return;
+
+   int queuing = getQueuingDelay();
+
+   // the slow start ends before the queue reaches the target
+   if (m_bSlowStart && (queuing > m_iTarget * 3 / 4))
+      m_bSlowStart = false;
+
+   // below the target, the window grows by at most a packet per RTT, in proportion to the distance to the target;
+   // above it, it shrinks in proportion to its size, by up to a half per RTT, so that it yields to competing flows
+   // quickly (LEDBAT++); it does not grow while it is not used
+   double off = double(m_iTarget - queuing) / m_iTarget;
+   if (off < 0)
+      m_dCWndSize += acked * (1 / m_dCWndSize - ((-off < 0.5) ? -off : 0.5));
+   else if (!m_bAppLimited)
+      m_dCWndSize += m_bSlowStart ? acked : off * acked / m_dCWndSize;
+
+   if (m_dCWndSize < 2)
+      m_dCWndSize = 2;
+   if (m_dCWndSize > m_dMaxCWndSize)
+      m_dCWndSize = m_dMaxCWndSize;
+
+   updatePacing();
+}
+
+void CLEDBATCC::onLoss(const int32_t* losslist, int)
+{
+   // the window is halved once per congestion event, as TCP does
+   if (CSeqNo::seqcmp(losslist[0] & 0x7FFFFFFF, m_iLastDecSeq) <= 0)
+      return;
+   m_iLastDecSeq = m_iSndCurrSeqNo;
+   m_bSlowStart = false;
+
+   m_dCWndSize /= 2;
+   if (m_dCWndSize < 2)
+      m_dCWndSize = 2;
+
+   updatePacing();
+}
+
+void CLEDBATCC::onECN(int32_t ack, int)
+{
+   // a mark is answered as a loss of the data acknowledged with it
+   int32_t seqno = CSeqNo::decseq(ack);
+   onLoss(&seqno, 1);
+}
+
+void CLEDBATCC::onTimeout()
+{
+   m_iLastDecSeq = m_iSndCurrSeqNo;
+   m_bSlowStart = false;
+
+   m_dCWndSize = 2;
+   updatePacing();
+}
+
+void CLEDBATCC::addDelay(int32_t delay)
+{
+   // the base delay is the minimum of the last 10 minutes, kept per minute so that it follows a change of route
+   uint64_t currtime = CTimer::getTime();
+   if ((0 == m_iBaseCount) || (currtime - m_ullBaseTime > 60000000))
+   {
+      if (m_iBaseCount == m_iBaseHistory)
+         memmove(m_piBaseDelay, m_piBaseDelay + 1, (m_iBaseHistory - 1) * sizeof(int32_t));
+      else
+         ++ m_iBaseCount;
+      m_piBaseDelay[m_iBaseCount - 1] = delay;
+      m_ullBaseTime = currtime;
+   }
+   else if (delay - m_piBaseDelay[m_iBaseCount - 1] < 0)
+      m_piBaseDelay[m_iBaseCount - 1] = delay;
+
+   m_piCurrentDelay[m_iCurrentCount % m_iCurrentFilter] = delay;
+   ++ m_iCurrentCount;
+}
+
+int CLEDBATCC::getQueuingDelay() const
+{
+   // the delays may be offset by the difference between the clocks, only their differences are used
+   int32_t base = m_piBaseDelay[0];
+   for (int i = 1; i < m_iBaseCount; ++ i)
+   {
+      if (m_piBaseDelay[i] - base < 0)
+         base = m_piBaseDelay[i];
+   }
+
+   // the current delay is the minimum of the last samples, a single late packet does not stand for the queue
+   int n = (m_iCurrentCount < m_iCurrentFilter) ? m_iCurrentCount : m_iCurrentFilter;
+   int32_t current = m_piCurrentDelay[0];
+   for (int i = 1; i < n; ++ i)
+   {
+      if (m_piCurrentDelay[i] - current < 0)
+         current = m_piCurrentDelay[i];
+   }
+
+   return current - base;
+}
+
+void CLEDBATCC::updatePacing()
+{
+   // the queue is kept short, the window is spread over the RTT rather than sent in bursts
+   m_dPktSndPeriod = m_iRTT / ((m_bSlowStart ? 2 : 1.2) * m_dCWndSize);
+}
@@ -108,6 +108,16 @@ public:
 
    virtual void onTimeout() {}
 
+      // Functionality:
+      //    Callback function to be called when the peer reports data packets marked congestion experienced (CE).
+      // Parameters:
+      //    0) [in] ack: the acknowledged sequence number of the ACK carrying the report.
+      //    1) [in] marks: number of packets marked since the last report.
+      // Returned value:
+      //    None.
+
+   virtual void onECN(int32_t, int) {}
+
       // Functionality:
       //    Callback function to be called when a data is sent.
       // Parameters:
@@ -201,6 +211,9 @@ private:
    void setSndCurrSeqNo(int32_t seqno);
    void setRcvRate(int rcvrate);
    void setRTT(int rtt);
+   void setDeliveryRate(int size, int interval, int rtt, bool applimited);
+   void setOneWayDelay(int32_t delay);
+   void setCachedState(double period, double cwnd);
 
 protected:
    const int32_t& m_iSYNInterval;	// UDT constant parameter, SYN
@@ -216,6 +229,19 @@ protected:
    int m_iRcvRate;			// packet arrive rate at receiver side, packets per second
    int m_iRTT;				// current estimated RTT, microsecond
 
+      // delivery rate sample taken by the ACK that onACK() is called for, m_iDeliveryInterval is 0 if there is none
+   int m_iDeliveredSize;		// data delivered during the sample, in bytes
+   int m_iDeliveryInterval;		// duration of the sample, microseconds
+   int m_iRTTSample;			// RTT of the last packet acknowledged, microseconds, 0 if it was retransmitted
+   bool m_bAppLimited;			// if the sender ran out of data during the sample
+
+   int32_t m_iOneWayDelay;		// one-way delay reported by the last ACK, microseconds, offset by the difference between the clocks
+   bool m_bOneWayDelay;			// if the peer reports one-way delays
+
+      // congestion state of the earlier connections to the same host, aged, known before init(), 0 if there is none
+   double m_dCachedPktSndPeriod;	// packet sending period, in microseconds
+   double m_dCachedCWndSize;		// congestion window size, in packets
+
    char* m_pcParam;			// user defined parameter
    int m_iPSize;			// size of m_pcParam
 
@@ -260,6 +286,7 @@ public:
    virtual void onACK(int32_t);
    virtual void onLoss(const int32_t*, int);
    virtual void onTimeout();
+   virtual void onECN(int32_t, int);
 
 private:
    int m_iRCInterval;			// UDT Rate control interval
@@ -275,4 +302,131 @@ private:
    int m_iDecCount;			// number of decreases in a congestion epoch
 };
 
+class UDT_API CBBRCC: public CCC
+{
+public:
+   CBBRCC();
+
+public:
+   virtual void init();
+   virtual void onACK(int32_t);
+   virtual void onLoss(const int32_t*, int);
+   virtual void onTimeout();
+
+private:
+   void updateModel(int32_t ack, uint64_t currtime);
+   void updateState(int32_t ack, uint64_t currtime);
+   void updateControl(int32_t ack);
+   double getBDP() const;
+
+private:
+   enum State {STARTUP, DRAIN, PROBE_BW, PROBE_RTT};
+
+   static const int m_iBWRounds = 10;	// number of round trips the bottleneck bandwidth is remembered
+   static const int m_iCycleLength = 8;	// number of phases in a bandwidth probing cycle
+   static const double m_pdCycleGain[m_iCycleLength];	// pacing gain of each phase
+
+   State m_State;			// current state
+   double m_dPacingGain;		// sending rate relative to the bottleneck bandwidth
+   double m_dCWndGain;			// congestion window relative to the bandwidth-delay product
+
+   int m_iPayloadSize;			// data carried by a full packet, in bytes
+   double m_pdBW[m_iBWRounds];		// maximum delivery rate of each of the last round trips, packets per second
+   double m_dBtlBw;			// estimated bottleneck bandwidth, packets per second
+   int m_iMinRTT;			// minimum RTT seen, microseconds
+   uint64_t m_ullMinRTTTime;		// time when m_iMinRTT was taken
+   bool m_bMinRTTExpired;		// if m_iMinRTT had not been refreshed for 10 seconds before the last ACK
+
+   int32_t m_iLastAck;			// last ACKed seq no
+   int32_t m_iRoundEnd;			// the current round trip ends when this packet is acknowledged
+   int m_iRound;			// number of round trips so far
+   bool m_bRoundStart;			// if the last ACK started a new round trip
+   int m_iRoundAcked;			// number of packets acknowledged in the current round trip
+   int m_iRoundLost;			// number of packets reported lost in the current round trip
+
+   double m_dFullBW;			// bottleneck bandwidth when the pipe was last found to grow
+   int m_iFullBWCount;			// number of round trips without growth of the bandwidth
+   bool m_bFilledPipe;			// if the bottleneck bandwidth has been reached
+
+   int m_iCycleIndex;			// current phase of the probing cycle
+   uint64_t m_ullCycleTime;		// time when the current phase started
+   uint32_t m_iRandState;		// state of the generator of the first phase, kept apart from rand()
+
+   uint64_t m_ullProbeRTTDone;		// time when PROBE_RTT may end, 0 if the window has not drained yet
+   bool m_bProbeRTTRound;		// if a round trip has passed since the window drained in PROBE_RTT
+   double m_dPriorCWnd;			// congestion window before PROBE_RTT or a timeout
+};
+
+class UDT_API CCUBICCC: public CCC
+{
+public:
+   CCUBICCC();
+
+public:
+   virtual void init();
+   virtual void onACK(int32_t);
+   virtual void onLoss(const int32_t*, int);
+   virtual void onTimeout();
+   virtual void onECN(int32_t, int);
+
+private:
+   void hyStart(int32_t ack);
+   void updateCWnd(int acked);
+   void updatePacing();
+
+private:
+   static const double m_dC;		// scaling of the cubic function
+   static const double m_dBeta;		// window kept on a congestion event
+   static const int m_iHyStartSamples = 3;	// number of RTT samples a round trip needs before HyStart compares it
+
+   bool m_bSlowStart;			// if in slow start phase
+   double m_dSSThresh;			// window where slow start ends, in packets
+   int32_t m_iLastAck;			// last ACKed seq no
+   int32_t m_iLastDecSeq;		// max pkt seq no sent out when last decrease happened
+
+   double m_dWMax;			// window before the last congestion event, in packets
+   double m_dK;				// time the cubic function takes to get back to m_dWMax, in seconds
+   uint64_t m_ullEpochStart;		// time when the current congestion avoidance epoch started, 0 if not started
+   double m_dWEst;			// window a standard TCP would have in the current epoch, in packets
+
+   int32_t m_iRoundEnd;			// the current round trip ends when this packet is acknowledged
+   int m_iLastRoundMinRTT;		// minimum RTT sampled in the last round trip, microseconds, 0 if none
+   int m_iRoundMinRTT;			// minimum RTT sampled in the current round trip, microseconds, 0 if none
+   int m_iRoundSamples;			// number of RTT samples in the current round trip
+};
+
+class UDT_API CLEDBATCC: public CCC
+{
+public:
+   CLEDBATCC();
+
+public:
+   virtual void init();
+   virtual void onACK(int32_t);
+   virtual void onLoss(const int32_t*, int);
+   virtual void onTimeout();
+   virtual void onECN(int32_t, int);
+
+private:
+   void addDelay(int32_t delay);
+   int getQueuingDelay() const;
+   void updatePacing();
+
+private:
+   static const int m_iTarget = 25000;		// queuing delay the window is kept at, microseconds
+   static const int m_iBaseHistory = 10;	// number of minutes the base delay is remembered
+   static const int m_iCurrentFilter = 4;	// number of delay samples the current delay is the minimum of
+
+   bool m_bSlowStart;			// if in slow start phase
+   int32_t m_iLastAck;			// last ACKed seq no
+   int32_t m_iLastDecSeq;		// max pkt seq no sent out when last decrease happened
+
+   int32_t m_piBaseDelay[m_iBaseHistory];	// minimum delay of each of the last minutes
+   int m_iBaseCount;			// number of minutes in m_piBaseDelay
+   uint64_t m_ullBaseTime;		// time when the current minute started
+
+   int32_t m_piCurrentDelay[m_iCurrentFilter];	// last delay samples
+   int m_iCurrentCount;			// number of samples taken so far
+};
+
 #endif
@@ -164,6 +164,15 @@ void CChannel::setUDPSockOpt()
          throw CUDTException(1, 3, NET_ERROR);
    #endif
 
+   #ifdef LINUX
+      // the ECN field of the IP header comes with the data received, see recvfrom()
+      int on = 1;
+      if (AF_INET == m_iIPversion)
+         ::setsockopt(m_iSocket, IPPROTO_IP, IP_RECVTOS, (char*)&on, sizeof(int));
+      else
+         ::setsockopt(m_iSocket, IPPROTO_IPV6, IPV6_RECVTCLASS, (char*)&on, sizeof(int));
+   #endif
+
    timeval tv;
    tv.tv_sec = 0;
    #if defined (BSD) || defined (OSX)
@@ -263,6 +272,21 @@ int CChannel::sendto(const sockaddr* addr, CPacket& packet) const
       mh.msg_controllen = 0;
       mh.msg_flags = 0;
 
+      #ifdef LINUX
+         // the ECN field is set packet by packet, the connections sharing the channel do not all use it
+         char control[CMSG_SPACE(sizeof(int))];
+         if (0 != packet.m_iECN)
+         {
+            mh.msg_control = control;
+            mh.msg_controllen = sizeof(control);
+            cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+            cm->cmsg_len = CMSG_LEN(sizeof(int));
+            cm->cmsg_level = (AF_INET == m_iIPversion) ? IPPROTO_IP : IPPROTO_IPV6;
+            cm->cmsg_type = (AF_INET == m_iIPversion) ? IP_TOS : IPV6_TCLASS;
+            *(int*)CMSG_DATA(cm) = packet.m_iECN;
+         }
+      #endif
+
       int res = ::sendmsg(m_iSocket, &mh, 0);
    #else
       DWORD size = CPacket::m_iPktHdrSize + packet.getLength();
@@ -304,6 +328,12 @@ int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
       mh.msg_controllen = 0;
       mh.msg_flags = 0;
 
+      #ifdef LINUX
+         char control[CMSG_SPACE(sizeof(int))];
+         mh.msg_control = control;
+         mh.msg_controllen = sizeof(control);
+      #endif
+
       #ifdef UNIX
          fd_set set;
          timeval tv;
@@ -332,6 +362,18 @@ int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
 
    packet.setLength(res - CPacket::m_iPktHdrSize);
 
+   // the TOS byte (IPv4) or the traffic class (IPv6) ends with the ECN field
+   packet.m_iECN = 0;
+   #ifdef LINUX
+      for (cmsghdr* cm = CMSG_FIRSTHDR(&mh); NULL != cm; cm = CMSG_NXTHDR(&mh, cm))
+      {
+         if ((IPPROTO_IP == cm->cmsg_level) && (IP_TOS == cm->cmsg_type))
+            packet.m_iECN = *(unsigned char*)CMSG_DATA(cm) & 3;
+         else if ((IPPROTO_IPV6 == cm->cmsg_level) && (IPV6_TCLASS == cm->cmsg_type))
+            packet.m_iECN = *(int*)CMSG_DATA(cm) & 3;
+      }
+   #endif
+
    // convert back into local host order
    //for (int i = 0; i < 4; ++ i)
    //   packet.m_nHeader[i] = ntohl(packet.m_nHeader[i]);
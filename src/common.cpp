@@ -200,18 +200,23 @@ void CTimer::sleepto(uint64_t nexttime)
          #endif
       #else
          #ifndef WIN32
+            // wake up no later than the scheduled time, a paced sender would otherwise send in bursts of 10ms
+            uint64_t wait = (m_ullSchedTime - t) / s_ullCPUFrequency;
+            if (wait > 10000)
+               wait = 10000;
+
             timeval now;
             timespec timeout;
             gettimeofday(&now, 0);
-            if (now.tv_usec < 990000)
+            if (now.tv_usec + wait < 1000000)
             {
                timeout.tv_sec = now.tv_sec;
-               timeout.tv_nsec = (now.tv_usec + 10000) * 1000;
+               timeout.tv_nsec = (now.tv_usec + wait) * 1000;
             }
             else
             {
                timeout.tv_sec = now.tv_sec + 1;
-               timeout.tv_nsec = (now.tv_usec + 10000 - 1000000) * 1000;
+               timeout.tv_nsec = (now.tv_usec + wait - 1000000) * 1000;
             }
             pthread_mutex_lock(&m_TickLock);
             pthread_cond_timedwait(&m_TickCond, &m_TickLock, &timeout);
@@ -207,6 +207,45 @@ private:
    CGuard& operator=(const CGuard&);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Atomic operations on 32-bit integers, all are full memory barriers
+
+// cas: set the value to newval if it is oldval, return true if it is set
+// add: add inc to the value, return the new value
+// load: read the value
+
+class CAtomic
+{
+public:
+   inline static bool cas(volatile int32_t* value, int32_t oldval, int32_t newval)
+   {
+   #ifndef WIN32
+      return __sync_bool_compare_and_swap(value, oldval, newval);
+   #else
+      return InterlockedCompareExchange((volatile LONG*)value, newval, oldval) == oldval;
+   #endif
+   }
+
+   inline static int32_t add(volatile int32_t* value, int32_t inc)
+   {
+   #ifndef WIN32
+      return __sync_add_and_fetch(value, inc);
+   #else
+      return InterlockedExchangeAdd((volatile LONG*)value, inc) + inc;
+   #endif
+   }
+
+   inline static int32_t load(volatile int32_t* value)
+   {
+   #ifndef WIN32
+      return __sync_fetch_and_add(value, 0);
+   #else
+      return InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+   #endif
+   }
+};
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -261,10 +300,14 @@ public:
 class CAckNo
 {
 public:
+   inline static int ackcmp(int32_t ackno1, int32_t ackno2)
+   {return (abs(ackno1 - ackno2) < m_iAckNoTH) ? (ackno1 - ackno2) : (ackno2 - ackno1);}
+
    inline static int32_t incack(int32_t ackno)
    {return (ackno == m_iMaxAckSeqNo) ? 0 : ackno + 1;}
 
 public:
+   static const int32_t m_iAckNoTH;             // threshold for comparing ACK sub-sequence numbers
    static const int32_t m_iMaxAckSeqNo;         // maximum ACK sub-sequence number used in UDT
 };
 
@@ -40,6 +40,7 @@ written by
 
 #ifndef WIN32
    #include <unistd.h>
+   #include <fcntl.h>
    #include <netdb.h>
    #include <arpa/inet.h>
    #include <cerrno>
@@ -70,6 +71,7 @@ const int UDT::ERROR = CUDT::ERROR;
 
 const int32_t CSeqNo::m_iSeqNoTH = 0x3FFFFFFF;
 const int32_t CSeqNo::m_iMaxSeqNo = 0x7FFFFFFF;
+const int32_t CAckNo::m_iAckNoTH = 0x3FFFFFFF;
 const int32_t CAckNo::m_iMaxAckSeqNo = 0x7FFFFFFF;
 const int32_t CMsgNo::m_iMsgNoTH = 0xFFFFFFF;
 const int32_t CMsgNo::m_iMaxMsgNo = 0x1FFFFFFF;
@@ -77,6 +79,10 @@ const int32_t CMsgNo::m_iMaxMsgNo = 0x1FFFFFFF;
 const int CUDT::m_iVersion = 4;
 const int CUDT::m_iSYNInterval = 10000;
 const int CUDT::m_iSelfClockInterval = 64;
+const int CUDT::m_iCoalesceDelay = 5000;
+const int CUDT::m_iCacheInterval = 100000;
+const int CUDT::m_iCacheHalfLife = 1000000;
+const int CUDT::m_iMaxSACKBlocks;                // initialized in the class, as it sizes m_piSACKBlock
 
 
 CUDT::CUDT()
@@ -85,6 +91,13 @@ CUDT::CUDT()
    m_pRcvBuffer = NULL;
    m_pSndLossList = NULL;
    m_pRcvLossList = NULL;
+   m_piSndTime = NULL;
+   m_pllSndDelivered = NULL;
+   m_piSndDeliveredTime = NULL;
+   m_piSndFirstTime = NULL;
+   m_pbSndRetrans = NULL;
+   m_pSndFEC = NULL;
+   m_pRcvFEC = NULL;
    m_pACKWindow = NULL;
    m_pSndTimeWindow = NULL;
    m_pRcvTimeWindow = NULL;
@@ -116,6 +129,14 @@ CUDT::CUDT()
    m_iRcvTimeOut = -1;
    m_bReuseAddr = true;
    m_llMaxBW = -1;
+   m_bNoDelay = true;
+   m_bSACK = true;
+   m_iArrWindowSize = 16;
+   m_iProbeWindowSize = 64;
+   m_iMaxACKSpacing = 1024;
+   m_iFECGroup = 0;
+   m_iFECParity = 1;
+   m_bECN = true;
 
    m_pCCFactory = new CCCFactory<CUDTCC>;
    m_pCC = NULL;
@@ -131,6 +152,11 @@ CUDT::CUDT()
    m_bBroken = false;
    m_bPeerHealth = true;
    m_ullLingerExpiration = 0;
+
+   m_iEPollEvents = 0;
+   m_iEPollCount = 0;
+   m_pSelectNodes = NULL;
+   m_iSelectCount = 0;
 }
 
 CUDT::CUDT(const CUDT& ancestor)
@@ -139,6 +165,13 @@ CUDT::CUDT(const CUDT& ancestor)
    m_pRcvBuffer = NULL;
    m_pSndLossList = NULL;
    m_pRcvLossList = NULL;
+   m_piSndTime = NULL;
+   m_pllSndDelivered = NULL;
+   m_piSndDeliveredTime = NULL;
+   m_piSndFirstTime = NULL;
+   m_pbSndRetrans = NULL;
+   m_pSndFEC = NULL;
+   m_pRcvFEC = NULL;
    m_pACKWindow = NULL;
    m_pSndTimeWindow = NULL;
    m_pRcvTimeWindow = NULL;
@@ -169,6 +202,14 @@ CUDT::CUDT(const CUDT& ancestor)
    m_iRcvTimeOut = ancestor.m_iRcvTimeOut;
    m_bReuseAddr = true;	// this must be true, because all accepted sockets shared the same port with the listener
    m_llMaxBW = ancestor.m_llMaxBW;
+   m_bNoDelay = ancestor.m_bNoDelay;
+   m_bSACK = ancestor.m_bSACK;
+   m_iArrWindowSize = ancestor.m_iArrWindowSize;
+   m_iProbeWindowSize = ancestor.m_iProbeWindowSize;
+   m_iMaxACKSpacing = ancestor.m_iMaxACKSpacing;
+   m_iFECGroup = ancestor.m_iFECGroup;
+   m_iFECParity = ancestor.m_iFECParity;
+   m_bECN = ancestor.m_bECN;
 
    m_pCCFactory = ancestor.m_pCCFactory->clone();
    m_pCC = NULL;
@@ -184,10 +225,19 @@ CUDT::CUDT(const CUDT& ancestor)
    m_bBroken = false;
    m_bPeerHealth = true;
    m_ullLingerExpiration = 0;
+
+   m_iEPollEvents = 0;
+   m_iEPollCount = 0;
+   m_pSelectNodes = NULL;
+   m_iSelectCount = 0;
 }
 
 CUDT::~CUDT()
 {
+   // the select() calls still watching this socket must not reach it any more
+   if (CAtomic::load(&m_iSelectCount) > 0)
+      s_UDTUnited.dropSelect(this);
+
    // release mutex/condtion variables
    destroySynch();
 
@@ -196,6 +246,13 @@ CUDT::~CUDT()
    delete m_pRcvBuffer;
    delete m_pSndLossList;
    delete m_pRcvLossList;
+   delete [] m_piSndTime;
+   delete [] m_pllSndDelivered;
+   delete [] m_piSndDeliveredTime;
+   delete [] m_piSndFirstTime;
+   delete [] m_pbSndRetrans;
+   delete m_pSndFEC;
+   delete m_pRcvFEC;
    delete m_pACKWindow;
    delete m_pSndTimeWindow;
    delete m_pRcvTimeWindow;
@@ -345,6 +402,71 @@ void CUDT::setOpt(UDTOpt optName, const void* optval, int)
    case UDT_MAXBW:
       m_llMaxBW = *(int64_t*)optval;
       break;
+
+   case UDT_NODELAY:
+      m_bNoDelay = *(bool*)optval;
+      break;
+
+   case UDT_SACK:
+      m_bSACK = *(bool*)optval;
+      break;
+
+   case UDT_ARRWND:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if (*(int*)optval < 1)
+         throw CUDTException(5, 3, 0);
+
+      m_iArrWindowSize = *(int*)optval;
+      break;
+
+   case UDT_PROBEWND:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if (*(int*)optval < 1)
+         throw CUDTException(5, 3, 0);
+
+      m_iProbeWindowSize = *(int*)optval;
+      break;
+
+   case UDT_ACKSPACING:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if (*(int*)optval < 0)
+         throw CUDTException(5, 3, 0);
+
+      m_iMaxACKSpacing = *(int*)optval;
+      break;
+
+   case UDT_FECGROUP:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if ((*(int*)optval < 0) || (*(int*)optval > CGF256::m_iMaxCols))
+         throw CUDTException(5, 3, 0);
+
+      m_iFECGroup = *(int*)optval;
+      break;
+
+   case UDT_FECPARITY:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      if ((*(int*)optval < 1) || (*(int*)optval > CGF256::m_iMaxRows))
+         throw CUDTException(5, 3, 0);
+
+      m_iFECParity = *(int*)optval;
+      break;
+
+   case UDT_ECN:
+      if (m_bConnecting || m_bConnected)
+         throw CUDTException(5, 2, 0);
+
+      m_bECN = *(bool*)optval;
+      break;
     
    default:
       throw CUDTException(5, 0, 0);
@@ -438,6 +560,46 @@ void CUDT::getOpt(UDTOpt optName, void* optval, int& optlen)
       optlen = sizeof(int64_t);
       break;
 
+   case UDT_NODELAY:
+      *(bool*)optval = m_bNoDelay;
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_SACK:
+      *(bool*)optval = m_bSACK;
+      optlen = sizeof(bool);
+      break;
+
+   case UDT_ARRWND:
+      *(int*)optval = m_iArrWindowSize;
+      optlen = sizeof(int);
+      break;
+
+   case UDT_PROBEWND:
+      *(int*)optval = m_iProbeWindowSize;
+      optlen = sizeof(int);
+      break;
+
+   case UDT_ACKSPACING:
+      *(int*)optval = m_iMaxACKSpacing;
+      optlen = sizeof(int);
+      break;
+
+   case UDT_FECGROUP:
+      *(int*)optval = m_iFECGroup;
+      optlen = sizeof(int);
+      break;
+
+   case UDT_FECPARITY:
+      *(int*)optval = m_iFECParity;
+      optlen = sizeof(int);
+      break;
+
+   case UDT_ECN:
+      *(bool*)optval = m_bECN;
+      optlen = sizeof(bool);
+      break;
+
    case UDT_STATE:
       *(int32_t*)optval = s_UDTUnited.getStatus(m_SocketID);
       optlen = sizeof(int32_t);
@@ -501,6 +663,8 @@ void CUDT::open()
    m_LastSampleTime = CTimer::getTime();
    m_llTraceSent = m_llTraceRecv = m_iTraceSndLoss = m_iTraceRcvLoss = m_iTraceRetrans = m_iSentACK = m_iRecvACK = m_iSentNAK = m_iRecvNAK = 0;
    m_llSndDuration = m_llSndDurationTotal = 0;
+   m_llTraceDiskWrite = m_llDiskWriteDuration = m_llDiskWriteTotal = 0;
+   m_iTraceRcvCE = m_iRcvCETotal = 0;
 
    // structures for queue
    if (NULL == m_pSNode)
@@ -538,9 +702,42 @@ void CUDT::open()
 
    m_iPktCount = 0;
    m_iLightACKCount = 1;
+   m_iACKSpacing = m_iSelfClockInterval;
+   m_iACKSpacingLimit = 0;
+   m_ullLastSpacingTime = currtime;
 
    m_ullTargetTime = 0;
    m_ullTimeDiff = 0;
+   m_ullHoldTime = 0;
+
+   m_iRACKTime = 0;
+   m_ullNextRACKTime = currtime + m_ullSYNInt;
+   m_ullNextCacheTime = currtime + m_iCacheInterval * m_ullCPUFrequency;
+   m_ullTLPTime = 0;
+   m_iTLPAck = -1;
+   m_iTLPSeqNo = -1;
+
+   m_llSndDelivered = 0;
+   m_iSndDeliveredTime = 0;
+   m_iSndFirstTime = 0;
+   m_iSndClockOffset = 0;
+   m_iAppLimitedSeq = -1;
+
+   m_iSndFECGroup = 0;
+   m_iPeerFECGroup = -1;
+   m_iFECLossRate = 0;
+   m_iFECRcvCount = 0;
+   m_iFECLossCount = 0;
+   m_iFECNakSeq = -1;
+   m_ullFECNakTime = 0;
+
+   m_bPeerDelayReport = false;
+   m_iRcvDelay = 0;
+   m_bRcvDelayReset = true;
+
+   m_bPeerECNReport = false;
+   m_iRcvCECount = 0;
+   m_iSndCECount = 0;
 
    // Now UDT is opened.
    m_bOpened = true;
@@ -603,6 +800,12 @@ void CUDT::connect(const sockaddr* serv_addr)
    m_ConnReq.m_iID = m_SocketID;
    CIPAddress::ntop(serv_addr, m_ConnReq.m_piPeerIP, m_iIPversion); // PeerIPserverIP
 
+   // a listener only takes the extension once its cookie response has shown it knows it, a rendezvous peer always does
+   m_ConnReq.m_iMaxACKSpacing = m_bRendezvous ? m_iMaxACKSpacing : 0;
+   m_ConnReq.m_iFECGroup = m_bRendezvous ? m_iFECGroup : -1;
+   m_ConnReq.m_iDelayReport = m_bRendezvous ? 1 : 0;
+   m_ConnReq.m_iECNReport = m_bRendezvous ? 1 : 0;
+
    // Random Initial Sequence Number
    srand((unsigned int)CTimer::getTime());
    m_iISN = m_ConnReq.m_iISN = (int32_t)(CSeqNo::m_iMaxSeqNo * (double(rand()) / RAND_MAX));
@@ -612,6 +815,7 @@ void CUDT::connect(const sockaddr* serv_addr)
    m_iSndLastDataAck = m_iISN;
    m_iSndCurrSeqNo = m_iISN - 1;
    m_iSndLastAck2 = m_iISN;
+   m_iSACKBlockNum = 0;
    m_ullSndLastAck2Time = CTimer::getTime();
 
    // Inform the server my configurations.
@@ -650,6 +854,7 @@ void CUDT::connect(const sockaddr* serv_addr)
       // avoid sending too many requests, at most 1 request per 250ms
       if (CTimer::getTime() - m_llLastReqTime > 250000)
       {
+         hs_size = m_iPayloadSize;
          m_ConnReq.serialize(reqdata, hs_size);
          request.setLength(hs_size);
          if (m_bRendezvous)
@@ -745,6 +950,13 @@ int CUDT::connect(const CPacket& response) throw ()
       {
          m_ConnReq.m_iReqType = -1;
          m_ConnReq.m_iCookie = m_ConnRes.m_iCookie;
+         if ((0 != m_ConnRes.m_iMaxACKSpacing) || (m_ConnRes.m_iFECGroup >= 0))
+         {
+            m_ConnReq.m_iMaxACKSpacing = m_iMaxACKSpacing;
+            m_ConnReq.m_iFECGroup = m_iFECGroup;
+            m_ConnReq.m_iDelayReport = 1;
+            m_ConnReq.m_iECNReport = 1;
+         }
          m_llLastReqTime = 0;
          return 1;
       }
@@ -767,6 +979,20 @@ POST_CONNECT:
    m_iRcvCurrSeqNo = m_ConnRes.m_iISN - 1;
    m_PeerID = m_ConnRes.m_iID;
 
+   // the light ACK spacing may only grow when both sides have asked for it
+   if ((m_ConnReq.m_iMaxACKSpacing > 0) && (m_ConnRes.m_iMaxACKSpacing > 0))
+      m_iACKSpacingLimit = (m_ConnReq.m_iMaxACKSpacing < m_ConnRes.m_iMaxACKSpacing) ? m_ConnReq.m_iMaxACKSpacing : m_ConnRes.m_iMaxACKSpacing;
+
+   // each side protects the data it sends with its own group size, if the peer knows FEC at all
+   m_iPeerFECGroup = m_ConnRes.m_iFECGroup;
+   m_iSndFECGroup = (m_ConnRes.m_iFECGroup >= 0) ? m_iFECGroup : 0;
+
+   // the ACKs carry the one-way delay when the peer knows where to find it
+   m_bPeerDelayReport = (1 == m_ConnRes.m_iDelayReport);
+
+   // the data is only marked ECN capable if the peer counts the marks in its ACKs
+   m_bPeerECNReport = (1 == m_ConnRes.m_iECNReport);
+
    // c/sģʽ£յserverĵ4ֱģm_ConnRes.m_piPeerIPΪserver˿ĶԶ˵ַҲcһ·ɵַ
    // m_piSelfIP s˿cַ
    memcpy(m_piSelfIP, m_ConnRes.m_piPeerIP, 16);
@@ -776,13 +1002,27 @@ POST_CONNECT:
    {
       // UDTʵӵиԵķͻ桢ջԼʧ
       // ʵӵзͶУUDTʵնУUDTʵͨ
-      m_pSndBuffer = new CSndBuffer(32, m_iPayloadSize);
+      // the parity header of the FEC packets comes out of the data payload
+      m_pSndBuffer = new CSndBuffer(32, (m_iSndFECGroup > 0) ? m_iPayloadSize - CSndFEC::m_iHdrSize : m_iPayloadSize);
       m_pRcvBuffer = new CRcvBuffer(&(m_pRcvQueue->m_UnitQueue), m_iRcvBufSize);
+      if (m_iSndFECGroup > 0)
+         m_pSndFEC = new CSndFEC(m_iPayloadSize - CSndFEC::m_iHdrSize, m_iSndFECGroup, m_iFECParity);
+      if (m_iPeerFECGroup > 0)
+         m_pRcvFEC = new CRcvFEC(m_iPayloadSize - CSndFEC::m_iHdrSize, m_iPeerFECGroup);
       // after introducing lite ACK, the sndlosslist may not be cleared in time, so it requires twice space.
       m_pSndLossList = new CSndLossList(m_iFlowWindowSize * 2);
+      // a power of 2 divides the seq. no. space, so the slot of a seq. no. does not change when it wraps
+      m_iSndTimeSize = 64;
+      while (m_iSndTimeSize < m_iFlowWindowSize * 2)
+         m_iSndTimeSize <<= 1;
+      m_piSndTime = new int32_t [m_iSndTimeSize];
+      m_pllSndDelivered = new int64_t [m_iSndTimeSize];
+      m_piSndDeliveredTime = new int32_t [m_iSndTimeSize];
+      m_piSndFirstTime = new int32_t [m_iSndTimeSize];
+      m_pbSndRetrans = new bool [m_iSndTimeSize];
       m_pRcvLossList = new CRcvLossList(m_iFlightFlagSize);
       m_pACKWindow = new CACKWindow(1024);
-      m_pRcvTimeWindow = new CPktTimeWindow(16, 64);
+      m_pRcvTimeWindow = new CPktTimeWindow(m_iArrWindowSize, m_iProbeWindowSize);
       m_pSndTimeWindow = new CPktTimeWindow();
    }
    catch (...)
@@ -793,7 +1033,8 @@ POST_CONNECT:
    CInfoBlock ib;
    ib.m_iIPversion = m_iIPversion;
    CInfoBlock::convert(m_pPeerAddr, m_iIPversion, ib.m_piIP);
-   if (m_pCache->lookup(&ib) >= 0)
+   bool cached = (m_pCache->lookup(&ib) >= 0);
+   if (cached)
    {
       m_iRTT = ib.m_iRTT;
       m_iBandwidth = ib.m_iBandwidth;
@@ -807,6 +1048,8 @@ POST_CONNECT:
    m_pCC->setRcvRate(m_iDeliveryRate);
    m_pCC->setRTT(m_iRTT);
    m_pCC->setBandwidth(m_iBandwidth);
+   if (cached)
+      warmStart(ib);
    m_pCC->init();
 
    m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
@@ -824,7 +1067,7 @@ POST_CONNECT:
    s_UDTUnited.connect_complete(m_SocketID);
 
    // acknowledde any waiting epolls to write
-   s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, true);
+   updateEPoll(UDT_EPOLL_OUT, true);
 
    return 0;
 }
@@ -855,6 +1098,24 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    m_PeerID = hs->m_iID;
    hs->m_iID = m_SocketID;
 
+   // the light ACK spacing may only grow when both sides have asked for it
+   if ((hs->m_iMaxACKSpacing > 0) && (m_iMaxACKSpacing > 0))
+      m_iACKSpacingLimit = (hs->m_iMaxACKSpacing < m_iMaxACKSpacing) ? hs->m_iMaxACKSpacing : m_iMaxACKSpacing;
+   hs->m_iMaxACKSpacing = (hs->m_iMaxACKSpacing > 0) ? m_iMaxACKSpacing : 0;
+
+   // each side protects the data it sends with its own group size, if the peer knows FEC at all
+   m_iPeerFECGroup = hs->m_iFECGroup;
+   m_iSndFECGroup = (hs->m_iFECGroup >= 0) ? m_iFECGroup : 0;
+   hs->m_iFECGroup = (hs->m_iFECGroup >= 0) ? m_iFECGroup : -1;
+
+   // the ACKs carry the one-way delay when the peer knows where to find it
+   m_bPeerDelayReport = (1 == hs->m_iDelayReport);
+   hs->m_iDelayReport = m_bPeerDelayReport ? 1 : 0;
+
+   // the data is only marked ECN capable if the peer counts the marks in its ACKs
+   m_bPeerECNReport = (1 == hs->m_iECNReport);
+   hs->m_iECNReport = m_bPeerECNReport ? 1 : 0;
+
    // use peer's ISN and send it back for security check
    m_iISN = hs->m_iISN;
 
@@ -863,6 +1124,7 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    m_iSndLastDataAck = m_iISN;
    m_iSndCurrSeqNo = m_iISN - 1;
    m_iSndLastAck2 = m_iISN;
+   m_iSACKBlockNum = 0;
    m_ullSndLastAck2Time = CTimer::getTime();
 
    // this is a reponse handshake
@@ -881,12 +1143,26 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    // Prepare all structures
    try
    {
-      m_pSndBuffer = new CSndBuffer(32, m_iPayloadSize);
+      // the parity header of the FEC packets comes out of the data payload
+      m_pSndBuffer = new CSndBuffer(32, (m_iSndFECGroup > 0) ? m_iPayloadSize - CSndFEC::m_iHdrSize : m_iPayloadSize);
       m_pRcvBuffer = new CRcvBuffer(&(m_pRcvQueue->m_UnitQueue), m_iRcvBufSize);
+      if (m_iSndFECGroup > 0)
+         m_pSndFEC = new CSndFEC(m_iPayloadSize - CSndFEC::m_iHdrSize, m_iSndFECGroup, m_iFECParity);
+      if (m_iPeerFECGroup > 0)
+         m_pRcvFEC = new CRcvFEC(m_iPayloadSize - CSndFEC::m_iHdrSize, m_iPeerFECGroup);
       m_pSndLossList = new CSndLossList(m_iFlowWindowSize * 2);
+      // a power of 2 divides the seq. no. space, so the slot of a seq. no. does not change when it wraps
+      m_iSndTimeSize = 64;
+      while (m_iSndTimeSize < m_iFlowWindowSize * 2)
+         m_iSndTimeSize <<= 1;
+      m_piSndTime = new int32_t [m_iSndTimeSize];
+      m_pllSndDelivered = new int64_t [m_iSndTimeSize];
+      m_piSndDeliveredTime = new int32_t [m_iSndTimeSize];
+      m_piSndFirstTime = new int32_t [m_iSndTimeSize];
+      m_pbSndRetrans = new bool [m_iSndTimeSize];
       m_pRcvLossList = new CRcvLossList(m_iFlightFlagSize);
       m_pACKWindow = new CACKWindow(1024);
-      m_pRcvTimeWindow = new CPktTimeWindow(16, 64);
+      m_pRcvTimeWindow = new CPktTimeWindow(m_iArrWindowSize, m_iProbeWindowSize);
       m_pSndTimeWindow = new CPktTimeWindow();
    }
    catch (...)
@@ -897,7 +1173,8 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    CInfoBlock ib;
    ib.m_iIPversion = m_iIPversion;
    CInfoBlock::convert(peer, m_iIPversion, ib.m_piIP);
-   if (m_pCache->lookup(&ib) >= 0)
+   bool cached = (m_pCache->lookup(&ib) >= 0);
+   if (cached)
    {
       m_iRTT = ib.m_iRTT;
       m_iBandwidth = ib.m_iBandwidth;
@@ -911,6 +1188,8 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
    m_pCC->setRcvRate(m_iDeliveryRate);
    m_pCC->setRTT(m_iRTT);
    m_pCC->setBandwidth(m_iBandwidth);
+   if (cached)
+      warmStart(ib);
    m_pCC->init();
 
    m_ullInterval = (uint64_t)(m_pCC->m_dPktSndPeriod * m_ullCPUFrequency);
@@ -928,7 +1207,7 @@ void CUDT::connect(const sockaddr* peer, CHandShake* hs)
 
    //send the response to the peer, see listen() for more discussions about this
    CPacket response;
-   int size = CHandShake::m_iContentSize;
+   int size = CHandShake::m_iExtContentSize;
    char* buffer = new char[size];
    hs->serialize(buffer, size);
    response.pack(0, NULL, buffer, size);
@@ -1000,12 +1279,15 @@ void CUDT::close()
       m_pSndQueue->m_pSndUList->remove(this);
 
    // trigger any pending IO events.
-   s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_ERR, true);
+   updateEPoll(UDT_EPOLL_ERR, true);
    // then remove itself from all epoll monitoring
+   CGuard::enterCS(s_UDTUnited.m_EPoll.m_EPollLock);
+   set<int> eids = m_sPollID;
+   CGuard::leaveCS(s_UDTUnited.m_EPoll.m_EPollLock);
    try
    {
-      for (set<int>::iterator i = m_sPollID.begin(); i != m_sPollID.end(); ++ i)
-         s_UDTUnited.m_EPoll.remove_usock(*i, m_SocketID);
+      for (set<int>::iterator i = eids.begin(); i != eids.end(); ++ i)
+         s_UDTUnited.m_EPoll.remove_usock(*i, m_SocketID, true);
    }
    catch (...)
    {
@@ -1040,12 +1322,7 @@ void CUDT::close()
       m_pCC->close();
 
       // Store current connection information.
-      CInfoBlock ib;
-      ib.m_iIPversion = m_iIPversion;
-      CInfoBlock::convert(m_pPeerAddr, m_iIPversion, ib.m_piIP);
-      ib.m_iRTT = m_iRTT;
-      ib.m_iBandwidth = m_iBandwidth;
-      m_pCache->update(&ib);
+      updateCache(false);
 
       m_bConnected = false;
    }
@@ -1058,7 +1335,80 @@ void CUDT::close()
    m_bOpened = false;
 }
 
+void CUDT::warmStart(const CInfoBlock& ib)
+{
+   if ((ib.m_dCWnd <= 0) || (CTimer::getTime() - ib.m_ullTimeStamp > s_UDTUnited.m_iCacheTTL * 1000000ULL))
+      return;
+
+   // the state is taken at half for each half-life it has not been refreshed, as TCP halves an idle window each RTO,
+   // but not below a quarter: the queues along the path are soon unknown, its capacity much later, and the entry
+   // goes at last with the TTL of the cache; and at half again when a connection still open shares the path
+   double share = pow(0.5, double(CTimer::getTime() - ib.m_ullTimeStamp) / m_iCacheHalfLife);
+   if (share < 0.25)
+      share = 0.25;
+   if (ib.m_bOpen)
+      share *= 0.5;
+   double cwnd = ib.m_dCWnd * share;
+   if (cwnd > m_iFlowWindowSize)
+      cwnd = m_iFlowWindowSize;
+
+   // no better than the initial window of slow start
+   if (cwnd <= 16)
+      return;
+
+   // a period of 1us is that of a control that does not pace, in slow start for instance, the rate is not known then
+   double period = (ib.m_dInterval > 1) ? ib.m_dInterval / share : 0;
+
+   // the receiver is expected to deliver the window each RTT, until it tells its own rate
+   if (period > 0)
+   {
+      m_iDeliveryRate = int(cwnd * 1000000.0 / (m_iRTT + m_iSYNInterval));
+      m_pCC->setRcvRate(m_iDeliveryRate);
+   }
+   m_pCC->setCachedState(period, cwnd);
+}
+
+void CUDT::updateCache(bool open)
+{
+   CInfoBlock ib;
+   ib.m_iIPversion = m_iIPversion;
+   CInfoBlock::convert(m_pPeerAddr, m_iIPversion, ib.m_piIP);
+   if (m_pCache->lookup(&ib) < 0)
+   {
+      ib.m_ullTimeStamp = CTimer::getTime();
+      ib.m_iLossRate = 0;
+      ib.m_iReorderDistance = 0;
+      ib.m_dInterval = 0;
+      ib.m_dCWnd = 0;
+      ib.m_bOpen = false;
+   }
+
+   ib.m_iRTT = m_iRTT;
+   ib.m_iBandwidth = m_iBandwidth;
+
+   // the congestion state tells nothing until more than the initial window of data has been sent, a connection
+   // that mostly receives keeps the state left by the others
+   if (m_llSentTotal > 16)
+   {
+      ib.m_ullTimeStamp = CTimer::getTime();
+      ib.m_dInterval = m_pCC->m_dPktSndPeriod;
+      ib.m_dCWnd = m_pCC->m_dCWndSize;
+      ib.m_bOpen = open;
+   }
+
+   m_pCache->update(&ib);
+}
+
 int CUDT::send(const char* data, int len)
+{
+   iovec iov;
+   iov.iov_base = (char*)data;
+   iov.iov_len = (len > 0) ? len : 0;
+
+   return sendv(&iov, 1);
+}
+
+int CUDT::sendv(const iovec* iov, int iovcnt)
 {
    if (UDT_DGRAM == m_iSockType)
       throw CUDTException(5, 10, 0);
@@ -1069,9 +1419,16 @@ int CUDT::send(const char* data, int len)
    else if (!m_bConnected)
       throw CUDTException(2, 2, 0);
 
-   if (len <= 0)
+   // the total is added up in 64 bits, a call moves no more than 2^31 - 1 bytes
+   uint64_t total = 0;
+   for (int i = 0; i < iovcnt; ++ i)
+      total += iov[i].iov_len;
+
+   if (0 == total)
       return 0;
 
+   int len = (total > 0x7FFFFFFFULL) ? 0x7FFFFFFF : int(total);
+
    CGuard sendguard(m_SendLock);
 
    if (m_pSndBuffer->getCurrBufSize() == 0)
@@ -1154,22 +1511,40 @@ int CUDT::send(const char* data, int len)
    if (0 == m_pSndBuffer->getCurrBufSize())
       m_llSndDurationCounter = CTimer::getTime();
 
+   // with UDT_NODELAY off, top up the unsent partial tail packet first
+   int merged = 0;
+   bool partial = false;
+   if (!m_bNoDelay)
+      merged = m_pSndBuffer->appendTail(iov, iovcnt, size, partial);
+
    // insert the user buffer into the sening list
-   m_pSndBuffer->addBuffer(data, size);
+   if (size > merged)
+      m_pSndBuffer->addBuffer(iov, iovcnt, merged, size - merged);
 
-   // insert this socket to snd list if it is not on the list yet
-   m_pSndQueue->m_pSndUList->update(this, false);
+   // insert this socket to snd list if it is not on the list yet; a socket holding back its tail packet is checked
+   // again at once when the write completes the tail, and keeps its schedule while the tail is still partial
+   if (!partial)
+      m_pSndQueue->m_pSndUList->update(this, false);
 
    if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, false);
+      updateEPoll(UDT_EPOLL_OUT, false);
    }
 
    return size;
 }
 
 int CUDT::recv(char* data, int len)
+{
+   iovec iov;
+   iov.iov_base = data;
+   iov.iov_len = (len > 0) ? len : 0;
+
+   return recvv(&iov, 1);
+}
+
+int CUDT::recvv(const iovec* iov, int iovcnt)
 {
    if (UDT_DGRAM == m_iSockType)
       throw CUDTException(5, 10, 0);
@@ -1180,9 +1555,16 @@ int CUDT::recv(char* data, int len)
    else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
       throw CUDTException(2, 1, 0);
 
-   if (len <= 0)
+   // the total is added up in 64 bits, a call moves no more than 2^31 - 1 bytes
+   uint64_t total = 0;
+   for (int i = 0; i < iovcnt; ++ i)
+      total += iov[i].iov_len;
+
+   if (0 == total)
       return 0;
 
+   int len = (total > 0x7FFFFFFFULL) ? 0x7FFFFFFF : int(total);
+
    CGuard recvguard(m_RecvLock);
 
    if (0 == m_pRcvBuffer->getRcvDataSize())
@@ -1242,12 +1624,12 @@ int CUDT::recv(char* data, int len)
    else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
       throw CUDTException(2, 1, 0);
 
-   int res = m_pRcvBuffer->readBuffer(data, len);
+   int res = m_pRcvBuffer->readBuffer(iov, iovcnt, len);
 
    if (m_pRcvBuffer->getRcvDataSize() <= 0)
    {
       // read is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, false);
+      updateEPoll(UDT_EPOLL_IN, false);
    }
 
    if ((res <= 0) && (m_iRcvTimeOut >= 0))
@@ -1257,6 +1639,18 @@ int CUDT::recv(char* data, int len)
 }
 
 int CUDT::sendmsg(const char* data, int len, int msttl, bool inorder)
+{
+   iovec msg;
+   msg.iov_base = (char*)data;
+   msg.iov_len = (len > 0) ? len : 0;
+
+   if (sendmsg_batch(&msg, 1, msttl, inorder) <= 0)
+      return 0;
+
+   return (int)msg.iov_len;
+}
+
+int CUDT::sendmsg_batch(const iovec* msgs, int num, int msttl, bool inorder)
 {
    if (UDT_STREAM == m_iSockType)
       throw CUDTException(5, 9, 0);
@@ -1267,11 +1661,14 @@ int CUDT::sendmsg(const char* data, int len, int msttl, bool inorder)
    else if (!m_bConnected)
       throw CUDTException(2, 2, 0);
 
-   if (len <= 0)
+   if (num <= 0)
       return 0;
 
-   if (len > m_iSndBufSize * m_iPayloadSize)
-      throw CUDTException(5, 12, 0);
+   for (int i = 0; i < num; ++ i)
+   {
+      if (uint64_t(msgs[i].iov_len) > uint64_t(m_iSndBufSize) * m_iPayloadSize)
+         throw CUDTException(5, 12, 0);
+   }
 
    CGuard sendguard(m_SendLock);
 
@@ -1283,70 +1680,83 @@ int CUDT::sendmsg(const char* data, int len, int msttl, bool inorder)
       m_ullLastRspTime = currtime;
    }
 
-   if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
+   int count = 0;
+   for (; count < num; ++ count)
    {
-      if (!m_bSynSending)
-         throw CUDTException(6, 1, 0);
-      else
+      // an empty message is not sent, as in sendmsg(), and ends the batch
+      int len = (int)msgs[count].iov_len;
+      if (len <= 0)
+         break;
+
+      if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
       {
-         // wait here during a blocking sending
-         #ifndef WIN32
-            pthread_mutex_lock(&m_SendBlockLock);
-            if (m_iSndTimeOut < 0)
-            {
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
-                  pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
-            }
-            else
-            {
-               uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
-               timespec locktime;
+         // only the first message may block, the rest of the batch goes as far as the buffer allows
+         if (count > 0)
+            break;
 
-               locktime.tv_sec = exptime / 1000000;
-               locktime.tv_nsec = (exptime % 1000000) * 1000;
+         if (!m_bSynSending)
+            throw CUDTException(6, 1, 0);
+         else
+         {
+            // wait here during a blocking sending
+            #ifndef WIN32
+               pthread_mutex_lock(&m_SendBlockLock);
+               if (m_iSndTimeOut < 0)
+               {
+                  while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
+                     pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
+               }
+               else
+               {
+                  uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
+                  timespec locktime;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
-                  pthread_cond_timedwait(&m_SendBlockCond, &m_SendBlockLock, &locktime);
-            }
-            pthread_mutex_unlock(&m_SendBlockLock);
-         #else
-            if (m_iSndTimeOut < 0)
-            {
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
-                  WaitForSingleObject(m_SendBlockCond, INFINITE);
-            }
-            else
-            {
-               uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
+                  locktime.tv_sec = exptime / 1000000;
+                  locktime.tv_nsec = (exptime % 1000000) * 1000;
 
-               while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
-                  WaitForSingleObject(m_SendBlockCond, DWORD((exptime - CTimer::getTime()) / 1000));
-            }
-         #endif
+                  while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
+                     pthread_cond_timedwait(&m_SendBlockCond, &m_SendBlockLock, &locktime);
+               }
+               pthread_mutex_unlock(&m_SendBlockLock);
+            #else
+               if (m_iSndTimeOut < 0)
+               {
+                  while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len))
+                     WaitForSingleObject(m_SendBlockCond, INFINITE);
+               }
+               else
+               {
+                  uint64_t exptime = CTimer::getTime() + m_iSndTimeOut * 1000ULL;
 
-         // check the connection status
-         if (m_bBroken || m_bClosing)
-            throw CUDTException(2, 1, 0);
-         else if (!m_bConnected)
-            throw CUDTException(2, 2, 0);
+                  while (!m_bBroken && m_bConnected && !m_bClosing && ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len) && (CTimer::getTime() < exptime))
+                     WaitForSingleObject(m_SendBlockCond, DWORD((exptime - CTimer::getTime()) / 1000));
+               }
+            #endif
+
+            // check the connection status
+            if (m_bBroken || m_bClosing)
+               throw CUDTException(2, 1, 0);
+            else if (!m_bConnected)
+               throw CUDTException(2, 2, 0);
+         }
       }
-   }
 
-   // ʣ໺С
-   if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
-   {
-      if (m_iSndTimeOut >= 0)
-         throw CUDTException(6, 3, 0);
+      // ʣ໺С
+      if ((m_iSndBufSize - m_pSndBuffer->getCurrBufSize()) * m_iPayloadSize < len)
+      {
+         if (m_iSndTimeOut >= 0)
+            throw CUDTException(6, 3, 0);
 
-      return 0;
-   }
+         return 0;
+      }
 
-   // record total time used for sending
-   if (0 == m_pSndBuffer->getCurrBufSize())
-      m_llSndDurationCounter = CTimer::getTime();
+      // record total time used for sending
+      if (0 == m_pSndBuffer->getCurrBufSize())
+         m_llSndDurationCounter = CTimer::getTime();
 
-   // insert the user buffer into the sening list
-   m_pSndBuffer->addBuffer(data, len, msttl, inorder);
+      // insert the user buffer into the sening list
+      m_pSndBuffer->addBuffer((const char*)msgs[count].iov_base, len, msttl, inorder);
+   }
 
    // insert this socket to the snd list if it is not on the list yet
    m_pSndQueue->m_pSndUList->update(this, false);
@@ -1354,13 +1764,25 @@ int CUDT::sendmsg(const char* data, int len, int msttl, bool inorder)
    if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, false);
+      updateEPoll(UDT_EPOLL_OUT, false);
    }
 
-   return len;   
+   return count;
 }
 
 int CUDT::recvmsg(char* data, int len)
+{
+   iovec msg;
+   msg.iov_base = data;
+   msg.iov_len = (len > 0) ? len : 0;
+
+   int res = 0;
+   recvmsg_batch(&msg, 1, &res);
+
+   return res;
+}
+
+int CUDT::recvmsg_batch(const iovec* msgs, int num, int* lens)
 {
    if (UDT_STREAM == m_iSockType)
       throw CUDTException(5, 9, 0);
@@ -1369,6 +1791,13 @@ int CUDT::recvmsg(char* data, int len)
    if (!m_bConnected)
       throw CUDTException(2, 2, 0);
 
+   if (num <= 0)
+      return 0;
+
+   // only the first message may block; a buffer of 2^31 bytes or more takes no more than 2^31 - 1 of them
+   char* data = (char*)msgs[0].iov_base;
+   int len = (msgs[0].iov_len > 0x7FFFFFFFULL) ? 0x7FFFFFFF : int(msgs[0].iov_len);
+
    if (len <= 0)
       return 0;
 
@@ -1377,17 +1806,18 @@ int CUDT::recvmsg(char* data, int len)
    if (m_bBroken || m_bClosing)
    {
       int res = m_pRcvBuffer->readMsg(data, len);
+      int count = (0 == res) ? 0 : readMsgBatch(msgs, num, lens, res);
 
       if (m_pRcvBuffer->getRcvMsgNum() <= 0)
       {
          // read is not available any more
-         s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, false);
+         updateEPoll(UDT_EPOLL_IN, false);
       }
 
       if (0 == res)
          throw CUDTException(2, 1, 0);
       else
-         return res;
+         return count;
    }
 
    if (!m_bSynRecving)
@@ -1396,7 +1826,7 @@ int CUDT::recvmsg(char* data, int len)
       if (0 == res)
          throw CUDTException(6, 2, 0);
       else
-         return res;
+         return readMsgBatch(msgs, num, lens, res);
    }
 
    int res = 0;
@@ -1447,16 +1877,39 @@ int CUDT::recvmsg(char* data, int len)
          throw CUDTException(2, 2, 0);
    } while ((0 == res) && !timeout);
 
+   int count = (res > 0) ? readMsgBatch(msgs, num, lens, res) : 0;
+
    if (m_pRcvBuffer->getRcvMsgNum() <= 0)
    {
       // read is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, false);
+      updateEPoll(UDT_EPOLL_IN, false);
    }
 
    if ((res <= 0) && (m_iRcvTimeOut >= 0))
       throw CUDTException(6, 3, 0);
 
-   return res;
+   return count;
+}
+
+int CUDT::readMsgBatch(const iovec* msgs, int num, int* lens, int first)
+{
+   lens[0] = first;
+
+   int count = 1;
+   while (count < num)
+   {
+      int len = (msgs[count].iov_len > 0x7FFFFFFFULL) ? 0x7FFFFFFF : int(msgs[count].iov_len);
+      if (len <= 0)
+         break;
+
+      int res = m_pRcvBuffer->readMsg((char*)msgs[count].iov_base, len);
+      if (0 == res)
+         break;
+
+      lens[count ++] = res;
+   }
+
+   return count;
 }
 
 int64_t CUDT::sendfile(fstream& ifs, int64_t& offset, int64_t size, int block)
@@ -1546,48 +1999,158 @@ int64_t CUDT::sendfile(fstream& ifs, int64_t& offset, int64_t size, int block)
    if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
    {
       // write is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, false);
+      updateEPoll(UDT_EPOLL_OUT, false);
    }
 
    return size - tosend;
 }
 
-int64_t CUDT::recvfile(fstream& ofs, int64_t& offset, int64_t size, int block)
+int64_t CUDT::sendfile(int fd, int64_t& offset, int64_t size, int block)
 {
    if (UDT_DGRAM == m_iSockType)
       throw CUDTException(5, 10, 0);
 
-   if (!m_bConnected)
-      throw CUDTException(2, 2, 0);
-   else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+   if (m_bBroken || m_bClosing)
       throw CUDTException(2, 1, 0);
+   else if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
 
    if (size <= 0)
       return 0;
 
-   CGuard recvguard(m_RecvLock);
+   if ((fd < 0) || (offset < 0))
+      throw CUDTException(4, 1);
 
-   int64_t torecv = size;
-   int unitsize = block;
-   int recvsize;
+   CGuard sendguard(m_SendLock);
 
-   // positioning...
-   try
-   {
-      ofs.seekp((streamoff)offset);
-   }
-   catch (...)
+   if (m_pSndBuffer->getCurrBufSize() == 0)
    {
-      throw CUDTException(4, 3);
+      // delay the EXP timer to avoid mis-fired timeout
+      uint64_t currtime;
+      CTimer::rdtsc(currtime);
+      m_ullLastRspTime = currtime;
    }
 
-   // receiving... "recvfile" is always blocking
-   while (torecv > 0)
-   {
-      if (ofs.fail())
-      {
-         // send the sender a signal so it will not be blocked forever
-         int32_t err_code = CUDTException::EFILE;
+   int64_t tosend = size;
+   int unitsize;
+
+   #ifdef POSIX_FADV_SEQUENTIAL
+      posix_fadvise(fd, offset, size, POSIX_FADV_SEQUENTIAL);
+   #endif
+
+   // the blocks point to the mapped file only while this call runs, see CSndBuffer::copyMapped()
+   try
+   {
+      // sending block by block
+      while (tosend > 0)
+      {
+         unitsize = int((tosend >= block) ? block : tosend);
+
+         #ifdef POSIX_FADV_WILLNEED
+            // read ahead what the congestion window may send out while this block is in flight
+            int64_t ahead = int64_t(m_dCongestionWindow) * m_iPayloadSize;
+            if (ahead < block)
+               ahead = block;
+            if (ahead > tosend - unitsize)
+               ahead = tosend - unitsize;
+            if (ahead > 0)
+               posix_fadvise(fd, offset + unitsize, ahead, POSIX_FADV_WILLNEED);
+         #endif
+
+         #ifndef WIN32
+            pthread_mutex_lock(&m_SendBlockLock);
+            while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+               pthread_cond_wait(&m_SendBlockCond, &m_SendBlockLock);
+            pthread_mutex_unlock(&m_SendBlockLock);
+         #else
+            while (!m_bBroken && m_bConnected && !m_bClosing && (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize()) && m_bPeerHealth)
+               WaitForSingleObject(m_SendBlockCond, INFINITE);
+         #endif
+
+         if (m_bBroken || m_bClosing)
+            throw CUDTException(2, 1, 0);
+         else if (!m_bConnected)
+            throw CUDTException(2, 2, 0);
+         else if (!m_bPeerHealth)
+         {
+            // reset peer health status, once this error returns, the app should handle the situation at the peer side
+            m_bPeerHealth = true;
+            throw CUDTException(7);
+         }
+
+         // record total time used for sending
+         if (0 == m_pSndBuffer->getCurrBufSize())
+            m_llSndDurationCounter = CTimer::getTime();
+
+         int64_t sentsize = m_pSndBuffer->addBufferFromFile(fd, offset, unitsize);
+
+         if (sentsize < 0)
+            throw CUDTException(4, 2);
+
+         tosend -= sentsize;
+         offset += sentsize;
+
+         // insert this socket to snd list if it is not on the list yet
+         m_pSndQueue->m_pSndUList->update(this, false);
+
+         // end of file
+         if (sentsize < unitsize)
+            break;
+      }
+   }
+   catch (...)
+   {
+      m_pSndBuffer->copyMapped();
+      throw;
+   }
+
+   m_pSndBuffer->copyMapped();
+
+   if (m_iSndBufSize <= m_pSndBuffer->getCurrBufSize())
+   {
+      // write is not available any more
+      updateEPoll(UDT_EPOLL_OUT, false);
+   }
+
+   return size - tosend;
+}
+
+int64_t CUDT::recvfile(fstream& ofs, int64_t& offset, int64_t size, int block)
+{
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
+   if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+   else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+      throw CUDTException(2, 1, 0);
+
+   if (size <= 0)
+      return 0;
+
+   CGuard recvguard(m_RecvLock);
+
+   int64_t torecv = size;
+   int unitsize = block;
+   int recvsize;
+
+   // positioning...
+   try
+   {
+      ofs.seekp((streamoff)offset);
+   }
+   catch (...)
+   {
+      throw CUDTException(4, 3);
+   }
+
+   // receiving... "recvfile" is always blocking
+   while (torecv > 0)
+   {
+      if (ofs.fail())
+      {
+         // send the sender a signal so it will not be blocked forever
+         int32_t err_code = CUDTException::EFILE;
          sendCtrl(8, &err_code);
 
          throw CUDTException(4, 4);
@@ -1621,7 +2184,146 @@ int64_t CUDT::recvfile(fstream& ofs, int64_t& offset, int64_t size, int block)
    if (m_pRcvBuffer->getRcvDataSize() <= 0)
    {
       // read is not available any more
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, false);
+      updateEPoll(UDT_EPOLL_IN, false);
+   }
+
+   return size - torecv;
+}
+
+int64_t CUDT::recvfile(int fd, int64_t& offset, int64_t size, int block)
+{
+   if (UDT_DGRAM == m_iSockType)
+      throw CUDTException(5, 10, 0);
+
+   if (!m_bConnected)
+      throw CUDTException(2, 2, 0);
+   else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+      throw CUDTException(2, 1, 0);
+
+   if (size <= 0)
+      return 0;
+
+   if ((fd < 0) || (offset < 0))
+      throw CUDTException(4, 3);
+
+   // units are never split by the writer, so each read must be able to take at least one packet
+   if (block < m_iPayloadSize)
+      block = m_iPayloadSize;
+
+   CGuard recvguard(m_RecvLock);
+
+   // units held by the writer are not counted by the flow window, so limit them to half of the receiver buffer;
+   // a slow disk then stalls the reading here and the sender is throttled by the flow control as usual
+   CRcvFileWriter writer(m_pRcvBuffer, fd, offset, m_iRcvBufSize / 2);
+   writer.start();
+
+   const int batch = 64;
+   CUnit* units[batch];
+   iovec iov[batch];
+
+   int64_t torecv = size;
+   int unitsize;
+   int err = 0;
+   int64_t bytes;
+   int64_t usec;
+
+   // receiving... "recvfile" is always blocking
+   while (torecv > 0)
+   {
+      #ifndef WIN32
+         pthread_mutex_lock(&m_RecvDataLock);
+         while (!m_bBroken && m_bConnected && !m_bClosing && (0 == m_pRcvBuffer->getRcvDataSize()))
+            pthread_cond_wait(&m_RecvDataCond, &m_RecvDataLock);
+         pthread_mutex_unlock(&m_RecvDataLock);
+      #else
+         while (!m_bBroken && m_bConnected && !m_bClosing && (0 == m_pRcvBuffer->getRcvDataSize()))
+            WaitForSingleObject(m_RecvDataCond, INFINITE);
+      #endif
+
+      if (!m_bConnected)
+      {
+         err = 2;
+         break;
+      }
+      else if ((m_bBroken || m_bClosing) && (0 == m_pRcvBuffer->getRcvDataSize()))
+      {
+         err = 1;
+         break;
+      }
+
+      unitsize = int((torecv >= block) ? block : torecv);
+      while (unitsize > 0)
+      {
+         int num = m_pRcvBuffer->readUnits(units, iov, batch, unitsize);
+         if (0 == num)
+            break;
+
+         int recvsize = 0;
+         for (int i = 0; i < num; ++ i)
+            recvsize += (int)iov[i].iov_len;
+
+         if (writer.push(units, iov, num) < 0)
+         {
+            err = 4;
+            break;
+         }
+
+         unitsize -= recvsize;
+         torecv -= recvsize;
+      }
+
+      if (4 == err)
+         break;
+
+      // the last packet is only partially requested, it is copied and written once the writer is done
+      if ((torecv > 0) && (torecv < m_iPayloadSize) && (m_pRcvBuffer->getRcvDataSize() > 0))
+      {
+         char* tail = new char[int(torecv)];
+         int recvsize = m_pRcvBuffer->readBuffer(tail, int(torecv));
+         int res = writer.flush();
+         if (res >= 0)
+            res = writer.write(tail, recvsize);
+         delete [] tail;
+
+         if (res < 0)
+         {
+            err = 4;
+            break;
+         }
+         torecv -= recvsize;
+      }
+
+      writer.getStats(bytes, usec);
+      m_llTraceDiskWrite += bytes;
+      m_llDiskWriteTotal += bytes;
+      m_llDiskWriteDuration += usec;
+   }
+
+   if ((writer.flush() < 0) && (0 == err))
+      err = 4;
+
+   writer.getStats(bytes, usec);
+   m_llTraceDiskWrite += bytes;
+   m_llDiskWriteTotal += bytes;
+   m_llDiskWriteDuration += usec;
+
+   offset = writer.getOffset();
+
+   if (4 == err)
+   {
+      // send the sender a signal so it will not be blocked forever
+      int32_t err_code = CUDTException::EFILE;
+      sendCtrl(8, &err_code);
+
+      throw CUDTException(4, 4);
+   }
+   else if (0 != err)
+      throw CUDTException(2, err, 0);
+
+   if (m_pRcvBuffer->getRcvDataSize() <= 0)
+   {
+      // read is not available any more
+      updateEPoll(UDT_EPOLL_IN, false);
    }
 
    return size - torecv;
@@ -1658,11 +2360,17 @@ void CUDT::sample(CPerfMon* perf, bool clear)
    perf->pktSentNAKTotal = m_iSentNAKTotal;
    perf->pktRecvNAKTotal = m_iRecvNAKTotal;
    perf->usSndDurationTotal = m_llSndDurationTotal;
+   perf->byteDiskWriteTotal = m_llDiskWriteTotal;
+   perf->pktRcvCETotal = m_iRcvCETotal;
+   perf->byteDiskWrite = m_llTraceDiskWrite;
+   perf->usDiskWrite = m_llDiskWriteDuration;
 
    double interval = double(currtime - m_LastSampleTime);
 
    perf->mbpsSendRate = double(m_llTraceSent) * m_iPayloadSize * 8.0 / interval;
    perf->mbpsRecvRate = double(m_llTraceRecv) * m_iPayloadSize * 8.0 / interval;
+   perf->mbpsDiskWrite = (m_llDiskWriteDuration > 0) ? m_llTraceDiskWrite * 8.0 / m_llDiskWriteDuration : 0;
+   perf->pktRcvCE = m_iTraceRcvCE;
 
    perf->usPktSndPeriod = m_ullInterval / double(m_ullCPUFrequency);
    perf->pktFlowWindow = m_iFlowWindowSize;
@@ -1696,6 +2404,8 @@ void CUDT::sample(CPerfMon* perf, bool clear)
    {
       m_llTraceSent = m_llTraceRecv = m_iTraceSndLoss = m_iTraceRcvLoss = m_iTraceRetrans = m_iSentACK = m_iRecvACK = m_iSentNAK = m_iRecvNAK = 0;
       m_llSndDuration = 0;
+      m_llTraceDiskWrite = m_llDiskWriteDuration = 0;
+      m_iTraceRcvCE = 0;
       m_LastSampleTime = currtime;
    }
 }
@@ -1803,7 +2513,12 @@ void CUDT::sendCtrl(int pkttype, void* lparam, void* rparam, int size)
          ack = m_pRcvLossList->getFirstLostSeq();
 
       // ԶѾյACKظ
-      if (ack == m_iRcvLastAckAck)
+      // while packets are missing, the received ranges beyond the ACK point keep telling the sender which of its
+      // retransmissions are lost, even after the ACK point itself is known to the sender; they are only repeated when
+      // data has come since the last one, a silent receiver leaves the sender to its EXP timer
+      bool sack = m_bSACK && (m_pRcvLossList->getLossLength() > 0) && (m_iPktCount > 0);
+
+      if ((ack == m_iRcvLastAckAck) && (!sack || (4 == size)))
          break;
 
       // send out a lite ACK
@@ -1844,7 +2559,7 @@ void CUDT::sendCtrl(int pkttype, void* lparam, void* rparam, int size)
          #endif
 
          // acknowledge any waiting epolls to read
-         s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, true);
+         updateEPoll(UDT_EPOLL_IN, true);
       }
       else if (ack == m_iRcvLastAck)
       {
@@ -1858,9 +2573,9 @@ void CUDT::sendCtrl(int pkttype, void* lparam, void* rparam, int size)
       // Send out the ACK only if has not been received by the sender before
       // m_iRcvLastAckACKк
       // m_iRcvLastAckAckһͶ˳ɹ͵ACKк
-      if (CSeqNo::seqcmp(m_iRcvLastAck, m_iRcvLastAckAck) > 0)
+      if ((CSeqNo::seqcmp(m_iRcvLastAck, m_iRcvLastAckAck) > 0) || sack)
       {
-         int32_t data[6];
+         int32_t data[9 + 2 * m_iMaxSACKBlocks];
 
          m_iAckSeqNo = CAckNo::incack(m_iAckSeqNo);
          data[0] = m_iRcvLastAck;
@@ -1871,20 +2586,59 @@ void CUDT::sendCtrl(int pkttype, void* lparam, void* rparam, int size)
          if (data[3] < 2)
             data[3] = 2;
 
+         // the loss rate of FEC protected data comes before the received ranges, so that the sender sizes the parity
+         int ext = 0;
+         if (NULL != m_pRcvFEC)
+         {
+            int total = m_iFECRcvCount + m_iFECLossCount;
+            if (total > 0)
+            {
+               m_iFECLossRate = (int)((m_iFECLossRate * 7LL + m_iFECLossCount * 1000000LL / total) >> 3);
+               m_iFECRcvCount = m_iFECLossCount = 0;
+            }
+            data[6] = m_iFECLossRate;
+            ext = 4;
+         }
+
+         // then the one-way delay, the last one known if no data has come since the last ACK
+         if (m_bPeerDelayReport)
+         {
+            data[6 + ext / 4] = m_iRcvDelay;
+            m_bRcvDelayReset = true;
+            ext += 4;
+         }
+
+         // and the number of packets marked CE so far, a total rather than a difference so that a lost ACK loses no mark
+         if (m_bPeerECNReport)
+         {
+            data[6 + ext / 4] = m_iRcvCECount;
+            ext += 4;
+         }
+
          // һʿֻԷһհ
+         int blocks = m_bSACK ? getSACKBlocks(data + 6 + ext / 4) : 0;
+
          if (currtime - m_ullLastAckTime > m_ullSYNInt)
          {
             data[4] = m_pRcvTimeWindow->getPktRcvSpeed();
             data[5] = m_pRcvTimeWindow->getBandwidth();
-            ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 24);
+            ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 24 + ext + blocks * 8);
 
             CTimer::rdtsc(m_ullLastAckTime);
          }
+         else if ((blocks > 0) || (ext > 0))
+         {
+            // received ranges follow the rate fields, which are ignored by the sender when they are not positive
+            data[4] = data[5] = 0;
+            ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 24 + ext + blocks * 8);
+         }
          else
          {
             ctrlpkt.pack(pkttype, &m_iAckSeqNo, data, 16);
          }
 
+         // the sender times its delivery rate samples by the ACKs, as they are sent
+         ctrlpkt.m_iTimeStamp = int(CTimer::getTime() - m_StartTime);
          ctrlpkt.m_iID = m_PeerID;
          m_pSndQueue->sendto(m_pPeerAddr, ctrlpkt);
 
@@ -1931,9 +2685,13 @@ void CUDT::sendCtrl(int pkttype, void* lparam, void* rparam, int size)
          // this is periodically NAK report; make sure NAK cannot be sent back too often
 
          // read loss list from the local receiver loss list
+         // only the losses between the two seq. no. in "lparam" when they are given
          int32_t* data = new int32_t[m_iPayloadSize / 4];
          int losslen;
-         m_pRcvLossList->getLossArray(data, losslen, m_iPayloadSize / 4);
+         if (NULL == lparam)
+            m_pRcvLossList->getLossArray(data, losslen, m_iPayloadSize / 4);
+         else
+            m_pRcvLossList->getLossArray(((int32_t *)lparam)[0], ((int32_t *)lparam)[1], data, losslen, m_iPayloadSize / 4);
 
          if (0 < losslen)
          {
@@ -2033,6 +2791,9 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          ack = *(int32_t *)ctrlpkt.m_pcData;
          if (CSeqNo::seqcmp(ack, m_iSndLastAck) >= 0)
          {
+            if (ack != m_iSndLastAck)
+               updateRACKTime(m_iSndLastAck, CSeqNo::decseq(ack));
+
             m_iFlowWindowSize -= CSeqNo::seqoff(m_iSndLastAck, ack);
             m_iSndLastAck = ack;
          }
@@ -2064,14 +2825,26 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          //this should not happen: attack or bug
          m_bBroken = true;
          m_iBrokenCounter = 0;
+         s_UDTUnited.scheduleGC(m_SocketID, CTimer::getTime() + 1000000);
          break;
       }
 
       if (CSeqNo::seqcmp(ack, m_iSndLastAck) >= 0)
       {
          // Update Flow Window Size, must update before and together with m_iSndLastAck
+         if (ack != m_iSndLastAck)
+            updateRACKTime(m_iSndLastAck, CSeqNo::decseq(ack));
+
          m_iFlowWindowSize = *((int32_t *)ctrlpkt.m_pcData + 3);
          m_iSndLastAck = ack;
+
+         // the received ranges describe the current receiver buffer, they replace what an earlier ACK reported
+         // they follow the FEC loss rate when the data sent is protected, the one-way delay and the CE marks when they are reported
+         int first = ((NULL != m_pSndFEC) ? 7 : 6) + (m_bPeerDelayReport ? 1 : 0) + (m_bPeerECNReport ? 1 : 0);
+         processSACKBlocks((int32_t *)ctrlpkt.m_pcData + first, (ctrlpkt.getLength() > first * 4) ? (ctrlpkt.getLength() - first * 4) / 8 : 0);
+
+         // holes left behind packets sent later and delivered are lost, even if their NAK never arrived
+         detectRACKLoss();
       }
 
       // protect packet retransmission
@@ -2089,7 +2862,7 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       }
 
       // acknowledge the sending buffer
-      m_pSndBuffer->ackData(offset);
+      sampleDelivery(ack, m_pSndBuffer->ackData(offset), ctrlpkt.m_iTimeStamp);
 
       // record total time used for sending
       m_llSndDuration += currtime - m_llSndDurationCounter;
@@ -2113,7 +2886,7 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       #endif
 
       // acknowledde any waiting epolls to write
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, true);
+      updateEPoll(UDT_EPOLL_OUT, true);
 
       // insert this socket to snd list if it is not on the list yet
       m_pSndQueue->m_pSndUList->update(this, false);
@@ -2139,6 +2912,26 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
 
          m_pCC->setRcvRate(m_iDeliveryRate);
          m_pCC->setBandwidth(m_iBandwidth);
+
+         // the parity sent per group follows the loss rate seen by the receiver
+         if ((NULL != m_pSndFEC) && (ctrlpkt.getLength() >= 28))
+            m_pSndFEC->setLossRate(*((int32_t *)ctrlpkt.m_pcData + 6));
+
+         int delay = (NULL != m_pSndFEC) ? 7 : 6;
+         if (m_bPeerDelayReport && (ctrlpkt.getLength() >= (delay + 1) * 4))
+            m_pCC->setOneWayDelay(*((int32_t *)ctrlpkt.m_pcData + delay));
+
+         // the peer counts the CE marks from the start, only the marks not seen in an earlier ACK are new
+         int ce = delay + (m_bPeerDelayReport ? 1 : 0);
+         if (m_bPeerECNReport && (ctrlpkt.getLength() >= (ce + 1) * 4))
+         {
+            int marks = *((int32_t *)ctrlpkt.m_pcData + ce) - m_iSndCECount;
+            if (marks > 0)
+            {
+               m_iSndCECount += marks;
+               m_pCC->onECN(ack, marks);
+            }
+         }
       }
 
       // ʵ
@@ -2242,6 +3035,7 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
          //this should not happen: attack or bug
          m_bBroken = true;
          m_iBrokenCounter = 0;
+         s_UDTUnited.scheduleGC(m_SocketID, CTimer::getTime() + 1000000);
          break;
       }
 
@@ -2303,6 +3097,7 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
       m_bClosing = true;
       m_bBroken = true;
       m_iBrokenCounter = 60;
+      s_UDTUnited.scheduleGC(m_SocketID, CTimer::getTime() + 1000000);
 
       // Signal the sender and recver if they are waiting for data.
       releaseSynch();
@@ -2337,6 +3132,88 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
 
       break;
 
+   case 9: //1001 - FEC Parity
+      {
+      // parity is sent ECT(0) as the data, so its congestion experienced marks are counted the same way
+      if (3 == ctrlpkt.m_iECN)
+      {
+         ++ m_iRcvCECount;
+         ++ m_iTraceRcvCE;
+         ++ m_iRcvCETotal;
+      }
+
+      if (NULL == m_pRcvFEC)
+         break;
+
+      int index = ctrlpkt.getExtendedType();
+      int32_t timestamp = ctrlpkt.m_iTimeStamp;
+      int32_t base;
+      int count;
+      int rebuilt = m_pRcvFEC->addParity(ctrlpkt, base, count);
+      if (rebuilt < 0)
+         break;
+      int num = (uint8_t)ctrlpkt.m_pcData[1];
+
+      // the parity may belong to a group already acknowledged, or come from too far ahead
+      int32_t last = CSeqNo::incseq(base, count - 1);
+      if ((CSeqNo::seqoff(m_iRcvLastAck, last) < 0) || (CSeqNo::seqoff(m_iRcvLastAck, last) >= m_pRcvBuffer->getAvailBufSize()))
+         break;
+
+      // the last packets of the group are known to be lost only from its parity
+      if (CSeqNo::seqcmp(last, m_iRcvCurrSeqNo) > 0)
+      {
+         m_pRcvLossList->insert(CSeqNo::incseq(m_iRcvCurrSeqNo), last);
+         m_iFECLossCount += CSeqNo::seqlen(CSeqNo::incseq(m_iRcvCurrSeqNo), last);
+         if (m_iFECNakSeq < 0)
+         {
+            m_iFECNakSeq = CSeqNo::incseq(m_iRcvCurrSeqNo);
+            m_ullFECNakTime = currtime + (getFECDelay() + 2 * m_iSYNInterval) * m_ullCPUFrequency;
+         }
+         m_iRcvCurrSeqNo = last;
+      }
+
+      // the rebuilt packets go into the receiver buffer as if they had arrived; the unit of the parity packet may be reused
+      for (int i = 0; (i < count) && (rebuilt > 0); ++ i)
+      {
+         int32_t seqno = CSeqNo::incseq(base, i);
+         int32_t msgno;
+         const char* data;
+         int len;
+         if (!m_pRcvLossList->find(seqno, seqno) || !m_pRcvFEC->getData(seqno, msgno, data, len))
+            continue;
+
+         int offset = CSeqNo::seqoff(m_iRcvLastAck, seqno);
+         if (offset < 0)
+            continue;
+
+         CUnit* unit = m_pRcvQueue->m_UnitQueue.getNextAvailUnit();
+         if (NULL == unit)
+            break;
+
+         CPacket& packet = unit->m_Packet;
+         packet.m_iSeqNo = seqno;
+         packet.m_iMsgNo = msgno;
+         packet.m_iTimeStamp = timestamp;
+         packet.m_iID = m_SocketID;
+         memcpy(packet.m_pcData, data, len);
+         packet.setLength(len);
+
+         if (m_pRcvBuffer->addData(unit, offset) < 0)
+            continue;
+
+         m_pRcvLossList->remove(seqno);
+
+         // the rebuilt packets may complete a message, acknowledge them at once
+         CTimer::rdtsc(m_ullNextACKTime);
+      }
+
+      // what the group could not rebuild is reported now, unless more of its parity is on the way
+      if ((rebuilt > 0) || (index == num - 1))
+         reportFECLoss(last);
+
+      break;
+      }
+
    case 32767: //0x7FFF - reserved and user defined messages
       m_pCC->processCustomMsg(&ctrlpkt);
       CCUpdate();
@@ -2357,10 +3234,299 @@ void CUDT::processCtrl(CPacket& ctrlpkt)
 // tsUDTһαȵʱ
 // ts = 0 : ͶʧΪյ£ʹͻݷ͡
 // poppackData˴ûпɷݣٰѸUŵUDTбСReceive Queueĳʱ¼жǷдݣУ½U롣
+int CUDT::getSACKBlocks(int32_t* blocks)
+{
+   // without loss, everything received is covered by the ACK itself
+   int losslen = m_pRcvLossList->getLossLength();
+   if (0 == losslen)
+      return 0;
+
+   int32_t losses[2 * m_iMaxSACKBlocks + 2];
+   int len;
+   m_pRcvLossList->getLossArray(losses, len, 2 * m_iMaxSACKBlocks + 2);
+
+   // the received ranges are the gaps between the loss ranges, the first loss being the ACK point
+   int num = 0;
+   int listed = 0;
+   int32_t seqno = m_iRcvLastAck;
+
+   for (int i = 0; (i < len) && (num < m_iMaxSACKBlocks); ++ i)
+   {
+      int32_t first = losses[i] & 0x7FFFFFFF;
+      int32_t last = (0 != (losses[i] & 0x80000000)) ? losses[++ i] : first;
+
+      if (CSeqNo::seqcmp(first, seqno) > 0)
+      {
+         blocks[2 * num] = seqno;
+         blocks[2 * num + 1] = CSeqNo::decseq(first);
+         ++ num;
+      }
+
+      seqno = CSeqNo::incseq(last);
+      listed += CSeqNo::seqlen(first, last);
+   }
+
+   // what follows the last listed loss is only known to be received if no loss is left out
+   if ((num < m_iMaxSACKBlocks) && (listed == losslen) && (CSeqNo::seqcmp(seqno, m_iRcvCurrSeqNo) <= 0))
+   {
+      blocks[2 * num] = seqno;
+      blocks[2 * num + 1] = m_iRcvCurrSeqNo;
+      ++ num;
+   }
+
+   return num;
+}
+
+void CUDT::processSACKBlocks(const int32_t* blocks, int num)
+{
+   if (num > m_iMaxSACKBlocks)
+      num = m_iMaxSACKBlocks;
+
+   // accept the ranges only in order, each one after a hole, and within what has been sent
+   m_iSACKBlockNum = 0;
+   int32_t seqno = m_iSndLastAck;
+
+   for (int i = 0; i < num; ++ i)
+   {
+      int32_t first = blocks[2 * i];
+      int32_t last = blocks[2 * i + 1];
+
+      if ((first < 0) || (last < 0) || (CSeqNo::seqcmp(first, seqno) <= 0) || (CSeqNo::seqcmp(first, last) > 0) || (CSeqNo::seqcmp(last, m_iSndCurrSeqNo) > 0))
+         break;
+
+      m_piSACKBlock[2 * i] = first;
+      m_piSACKBlock[2 * i + 1] = last;
+      ++ m_iSACKBlockNum;
+
+      // the last packet of a range is normally the latest one sent in it
+      updateRACKTime(last, last);
+
+      // packets reported lost earlier may have arrived since
+      m_pSndLossList->remove(first, last);
+
+      seqno = CSeqNo::incseq(last);
+   }
+}
+
+void CUDT::updateACKSpacing()
+{
+   // a congestion control that asks for its own ACK interval is self-clocked by it, keep the light ACKs as they are
+   if ((0 == m_iACKSpacingLimit) || (m_pCC->m_iACKInterval > 0))
+   {
+      m_iACKSpacing = m_iSelfClockInterval;
+      return;
+   }
+
+   // average arrival rate since the last full ACK; the arrival window measures the rate within bursts, which can be much higher
+   uint64_t currtime;
+   CTimer::rdtsc(currtime);
+   uint64_t period = (currtime - m_ullLastSpacingTime) / m_ullCPUFrequency;
+   m_ullLastSpacingTime = currtime;
+   if (0 == period)
+      return;
+
+   // send about 8 light ACKs per RTT, and per 1/8 of the free receiver buffer so that the sender is not stalled by the flow window
+   int64_t spacing = int64_t(m_iPktCount) * m_iRTT / int64_t(period * 8);
+
+   int avail = m_pRcvBuffer->getAvailBufSize() / 8;
+   if (spacing > avail)
+      spacing = avail;
+
+   if (spacing > m_iACKSpacingLimit)
+      spacing = m_iACKSpacingLimit;
+   if (spacing < m_iSelfClockInterval)
+      spacing = m_iSelfClockInterval;
+
+   m_iACKSpacing = (int)spacing;
+}
+
+void CUDT::updateRACKTime(int32_t seqno1, int32_t seqno2)
+{
+   // only the packets still recorded in the send time ring are looked at
+   if (CSeqNo::seqlen(seqno1, seqno2) > m_iSndTimeSize)
+      seqno1 = CSeqNo::incseq(seqno1, CSeqNo::seqlen(seqno1, seqno2) - m_iSndTimeSize);
+
+   for (int32_t i = seqno1; ; i = CSeqNo::incseq(i))
+   {
+      int32_t t = m_piSndTime[i % m_iSndTimeSize];
+      if ((int32_t)((uint32_t)t - (uint32_t)m_iRACKTime) > 0)
+         m_iRACKTime = t;
+
+      if (i == seqno2)
+         break;
+   }
+}
+
+void CUDT::detectRACKLoss()
+{
+   // without the received ranges, the packets after the ACK point are not known to be delivered
+   if (0 == m_iSACKBlockNum)
+      return;
+
+   // a packet in a hole is lost if a packet sent after it has been delivered and it has been in flight longer than
+   // an RTT plus a reordering window, and the SYN interval the ACK that reports it may be held back
+   int32_t now = int(CTimer::getTime() - m_StartTime);
+   int window = m_iRTT + (m_iRTT >> 2) + m_iSYNInterval;
+
+   int32_t losses[4 * m_iMaxSACKBlocks];
+   int len = 0;
+   int num = 0;
+
+   int32_t seqno = m_iSndLastAck;
+   for (int i = 0; i < m_iSACKBlockNum; ++ i)
+   {
+      int32_t end = m_piSACKBlock[2 * i];
+      int32_t first = -1;
+
+      for (; CSeqNo::seqcmp(seqno, end) < 0; seqno = CSeqNo::incseq(seqno))
+      {
+         int32_t t = m_piSndTime[seqno % m_iSndTimeSize];
+         bool lost = (CSeqNo::seqoff(m_iSndLastAck, seqno) < m_iSndTimeSize)
+            && ((int32_t)((uint32_t)m_iRACKTime - (uint32_t)t) > 0)
+            && ((int32_t)((uint32_t)now - (uint32_t)t) >= window);
+
+         if (lost && (first < 0))
+            first = seqno;
+
+         if ((first < 0) || (lost && (CSeqNo::incseq(seqno) != end)))
+            continue;
+
+         int32_t last = lost ? seqno : CSeqNo::decseq(seqno);
+         int n = m_pSndLossList->insert(first, last);
+
+         // report only the losses not known yet, in the format of a loss report
+         if ((n > 0) && (len + 2 <= 4 * m_iMaxSACKBlocks))
+         {
+            if (first == last)
+               losses[len ++] = first;
+            else
+            {
+               losses[len ++] = first | 0x80000000;
+               losses[len ++] = last;
+            }
+         }
+
+         num += n;
+         first = -1;
+      }
+
+      if (CSeqNo::seqcmp(m_piSACKBlock[2 * i + 1], seqno) >= 0)
+         seqno = CSeqNo::incseq(m_piSACKBlock[2 * i + 1]);
+   }
+
+   if (0 == num)
+      return;
+
+   m_iTraceSndLoss += num;
+   m_iSndLossTotal += num;
+
+   m_pCC->onLoss(losses, len);
+   CCUpdate();
+
+   // the lost packets should be sent out immediately
+   m_pSndQueue->m_pSndUList->update(this);
+}
+
+void CUDT::sampleDelivery(int32_t ack, int size, int32_t acktime)
+{
+   int32_t now = int(CTimer::getTime() - m_StartTime);
+   m_llSndDelivered += size;
+
+   // the ACKs are timed by the peer, so that the delay and the processing on the way back do not disturb the rate,
+   // a peer that does not time them leaves the timestamp 0
+   if (0 == acktime)
+      acktime = now;
+   m_iSndDeliveredTime = acktime;
+   m_iSndClockOffset = acktime - now;
+
+   // the sample is ended by the last packet acknowledged, it covers what has been delivered since that packet was sent
+   int32_t seqno = CSeqNo::decseq(ack);
+   if (CSeqNo::seqoff(seqno, m_iSndCurrSeqNo) >= m_iSndTimeSize)
+   {
+      m_pCC->setDeliveryRate(0, 0, 0, false);
+      return;
+   }
+
+   int i = seqno % m_iSndTimeSize;
+   m_iSndFirstTime = m_piSndTime[i];
+
+   // the data cannot have been delivered faster than it was sent: a burst of ACKs, e.g., after a hole is repaired,
+   // is measured against the time taken to send the data
+   int sndinterval = m_piSndTime[i] - m_piSndFirstTime[i];
+   int ackinterval = acktime - m_piSndDeliveredTime[i];
+
+   bool applimited = (m_iAppLimitedSeq >= 0) && (CSeqNo::seqcmp(seqno, m_iAppLimitedSeq) <= 0);
+   if ((m_iAppLimitedSeq >= 0) && (CSeqNo::seqcmp(seqno, m_iAppLimitedSeq) >= 0))
+      m_iAppLimitedSeq = -1;
+
+   // the RTT of a retransmitted packet is ambiguous, the ACK may be for the original
+   int rtt = m_pbSndRetrans[i] ? 0 : now - m_piSndTime[i];
+
+   m_pCC->setDeliveryRate(int(m_llSndDelivered - m_pllSndDelivered[i]), (sndinterval > ackinterval) ? sndinterval : ackinterval, rtt, applimited);
+}
+
+void CUDT::reportFECLoss(int32_t seqno)
+{
+   if ((m_iFECNakSeq < 0) || (CSeqNo::seqcmp(seqno, m_iFECNakSeq) < 0))
+      return;
+
+   int32_t range[2];
+   range[0] = m_iFECNakSeq;
+   range[1] = seqno;
+   sendCtrl(3, range);
+
+   // losses after "seqno" wait for the parity of their own group
+   if ((CSeqNo::seqcmp(seqno, m_iRcvCurrSeqNo) < 0) && m_pRcvLossList->find(CSeqNo::incseq(seqno), m_iRcvCurrSeqNo))
+   {
+      uint64_t currtime;
+      CTimer::rdtsc(currtime);
+      m_iFECNakSeq = CSeqNo::incseq(seqno);
+      m_ullFECNakTime = currtime + (getFECDelay() + 2 * m_iSYNInterval) * m_ullCPUFrequency;
+   }
+   else
+      m_iFECNakSeq = -1;
+}
+
+uint64_t CUDT::getFECDelay() const
+{
+   // a group is closed early when the data stops, so that its losses do not wait much longer than the NAK would have
+   return (m_iRTT / 4 > m_iSYNInterval) ? m_iRTT / 4 : m_iSYNInterval;
+}
+
+int CUDT::packParity(CPacket& packet, uint64_t entertime, uint64_t& ts)
+{
+   int size = m_pSndFEC->packParity(packet);
+   if (size <= 0)
+      return 0;
+
+   packet.m_iTimeStamp = int(CTimer::getTime() - m_StartTime);
+   packet.m_iID = m_PeerID;
+
+   // paced like a data packet, though the congestion control does not count it
+   #ifndef NO_BUSY_WAITING
+      ts = entertime + m_ullInterval;
+   #else
+      if (m_ullTimeDiff >= m_ullInterval)
+      {
+         ts = entertime;
+         m_ullTimeDiff -= m_ullInterval;
+      }
+      else
+      {
+         ts = entertime + m_ullInterval - m_ullTimeDiff;
+         m_ullTimeDiff = 0;
+      }
+   #endif
+   m_ullTargetTime = ts;
+
+   return size;
+}
+
 int CUDT::packData(CPacket& packet, uint64_t& ts)
 {
    int payload = 0;
    bool probe = false;
+   bool retrans = false;
 
    uint64_t entertime;
    CTimer::rdtsc(entertime);
@@ -2368,6 +3534,26 @@ int CUDT::packData(CPacket& packet, uint64_t& ts)
    if ((0 != m_ullTargetTime) && (entertime > m_ullTargetTime))
       m_ullTimeDiff += entertime - m_ullTargetTime;
 
+   // data and parity are sent ECT(0), routers may then mark them CE instead of dropping them
+   packet.m_iECN = (m_bECN && m_bPeerECNReport) ? 2 : 0;
+
+   // tail loss probe: nothing has been acknowledged since the tail of the data was sent, resend its last packet so that
+   // the receiver reports what it is missing, long before the EXP timer
+   m_ullHoldTime = 0;
+   if ((0 != m_ullTLPTime) && (entertime >= m_ullTLPTime))
+   {
+      m_ullTLPTime = 0;
+      if ((m_iSndLastAck == m_iTLPAck) && (CSeqNo::incseq(m_iSndCurrSeqNo) != m_iSndLastAck) && (0 == m_pSndLossList->getLossLength()))
+      {
+         m_pSndLossList->insert(m_iSndCurrSeqNo, m_iSndCurrSeqNo);
+         m_iTLPSeqNo = m_iSndCurrSeqNo;
+      }
+   }
+
+   // an FEC group is not held open for long, the receiver holds back the report of its losses until the parity comes
+   if ((NULL != m_pSndFEC) && (0 != m_pSndFEC->getGroupTime()) && (CTimer::getTime() >= m_pSndFEC->getGroupTime() + getFECDelay()))
+      m_pSndFEC->close();
+
    // Loss retransmission always has higher priority.
    if ((packet.m_iSeqNo = m_pSndLossList->getLostSeq()) >= 0)
    {
@@ -2416,7 +3602,11 @@ m_iSndCurrSeqNo
 
       ++ m_iTraceRetrans;
       ++ m_iRetransTotal;
+      retrans = true;
    }
+   // then the parity of a closed FEC group, but not between the two packets of a probing pair
+   else if ((NULL != m_pSndFEC) && (0 != (m_iSndCurrSeqNo & 0xF)) && ((payload = packParity(packet, entertime, ts)) > 0))
+      return payload;
    else
    {
       // If no loss, pack a new packet.
@@ -2428,6 +3618,21 @@ m_iSndCurrSeqNo
       int cwnd = (m_iFlowWindowSize < (int)m_dCongestionWindow) ? m_iFlowWindowSize : (int)m_dCongestionWindow;
       if (cwnd >= CSeqNo::seqlen(m_iSndLastAck, CSeqNo::incseq(m_iSndCurrSeqNo)))
       {
+         // hold back a partial tail packet for a short while, so that following small writes can fill it
+         if (!m_bNoDelay && (UDT_STREAM == m_iSockType))
+         {
+            uint64_t origintime = m_pSndBuffer->getPartialTailTime();
+            uint64_t now = CTimer::getTime();
+            if ((origintime > 0) && (now < origintime + m_iCoalesceDelay))
+            {
+               m_ullHoldTime = entertime + (origintime + m_iCoalesceDelay - now) * m_ullCPUFrequency;
+               m_ullTargetTime = 0;
+               m_ullTimeDiff = 0;
+               ts = 0;
+               return 0;
+            }
+         }
+
          if (0 != (payload = m_pSndBuffer->readData(&(packet.m_pcData), packet.m_iMsgNo)))
          {
             m_iSndCurrSeqNo = CSeqNo::incseq(m_iSndCurrSeqNo);
@@ -2435,12 +3640,41 @@ m_iSndCurrSeqNo
 
             packet.m_iSeqNo = m_iSndCurrSeqNo;
 
+            if (NULL != m_pSndFEC)
+               m_pSndFEC->addData(packet.m_iSeqNo, packet.m_iMsgNo, packet.m_pcData, payload);
+
+            // the tail has moved on, a probe is armed again when there is nothing more to send
+            m_ullTLPTime = 0;
+
             // every 16 (0xF) packets, a packet pair is sent
             if (0 == (packet.m_iSeqNo & 0xF))
                probe = true;
          }
          else
          {
+            // the data has stopped, the open group will not grow soon: its parity goes now, so that a loss at the
+            // end of a message is repaired as early as possible
+            if (NULL != m_pSndFEC)
+            {
+               m_pSndFEC->close();
+               if ((payload = packParity(packet, entertime, ts)) > 0)
+                  return payload;
+            }
+
+            // the rate measured until this packet is acknowledged is what the application gave, not what the network can carry
+            m_iAppLimitedSeq = m_iSndCurrSeqNo;
+
+            // the tail of the data is in flight, come back to probe for its loss if it is not acknowledged in time
+            if ((CSeqNo::incseq(m_iSndCurrSeqNo) != m_iSndLastAck) && (m_iTLPSeqNo != m_iSndCurrSeqNo))
+            {
+               if ((0 == m_ullTLPTime) || (m_iTLPAck != m_iSndLastAck))
+               {
+                  m_ullTLPTime = entertime + (2 * m_iRTT + m_iSYNInterval) * m_ullCPUFrequency;
+                  m_iTLPAck = m_iSndLastAck;
+               }
+               m_ullHoldTime = m_ullTLPTime;
+            }
+
             m_ullTargetTime = 0;
             m_ullTimeDiff = 0;
             ts = 0;
@@ -2458,6 +3692,19 @@ m_iSndCurrSeqNo
 
    packet.m_iTimeStamp = int(CTimer::getTime() - m_StartTime);
    packet.m_iID = m_PeerID;
+   m_piSndTime[packet.m_iSeqNo % m_iSndTimeSize] = packet.m_iTimeStamp;
+
+   // the delivery rate sample this packet will end starts from what had been delivered when it was sent,
+   // or from now if nothing was in flight
+   if ((packet.m_iSeqNo == m_iSndLastAck) && (packet.m_iSeqNo == m_iSndCurrSeqNo))
+   {
+      m_iSndFirstTime = packet.m_iTimeStamp;
+      m_iSndDeliveredTime = packet.m_iTimeStamp + m_iSndClockOffset;
+   }
+   m_pllSndDelivered[packet.m_iSeqNo % m_iSndTimeSize] = m_llSndDelivered;
+   m_piSndDeliveredTime[packet.m_iSeqNo % m_iSndTimeSize] = m_iSndDeliveredTime;
+   m_piSndFirstTime[packet.m_iSeqNo % m_iSndTimeSize] = m_iSndFirstTime;
+   m_pbSndRetrans[packet.m_iSeqNo % m_iSndTimeSize] = retrans;
    packet.setLength(payload);
 
    m_pCC->onPktSent(&packet);
@@ -2517,6 +3764,25 @@ int CUDT::processData(CUnit* unit)
 
    m_pCC->onPktReceived(&packet);
    ++ m_iPktCount;
+
+   // the one-way delay is taken against the clock of the sender, the offset between the clocks is left to the peer,
+   // which only compares delays with each other
+   if (m_bPeerDelayReport)
+   {
+      int32_t delay = int(CTimer::getTime() - m_StartTime) - packet.m_iTimeStamp;
+      if (m_bRcvDelayReset || (delay - m_iRcvDelay < 0))
+         m_iRcvDelay = delay;
+      m_bRcvDelayReset = false;
+   }
+
+   // congestion experienced marks are counted for the ACKs, those of the parity in processCtrl()
+   if (3 == packet.m_iECN)
+   {
+      ++ m_iRcvCECount;
+      ++ m_iTraceRcvCE;
+      ++ m_iRcvCETotal;
+   }
+
    // update time information
    m_pRcvTimeWindow->onPktArrival();
 
@@ -2541,6 +3807,13 @@ int CUDT::processData(CUnit* unit)
    if (m_pRcvBuffer->addData(unit, offset) < 0)
       return -1;
 
+   // keep a copy until the parity of the group has come, in case another packet of the group is lost
+   if (NULL != m_pRcvFEC)
+   {
+      m_pRcvFEC->addData(packet.m_iSeqNo, packet.m_iMsgNo, packet.m_pcData, packet.getLength());
+      ++ m_iFECRcvCount;
+   }
+
    // Loss detection.
    // յкŴ(ϴյ+1)˵мжʧ
 
@@ -2560,23 +3833,36 @@ int CUDT::processData(CUnit* unit)
       // If loss found, insert them to the receiver loss list
       m_pRcvLossList->insert(CSeqNo::incseq(m_iRcvCurrSeqNo), CSeqNo::decseq(packet.m_iSeqNo));
 
-      // pack loss list for NAK
-      int32_t lossdata[2];
-      lossdata[0] = CSeqNo::incseq(m_iRcvCurrSeqNo) | 0x80000000;
-      lossdata[1] = CSeqNo::decseq(packet.m_iSeqNo);
-
-      // Generate loss report immediately.
-      sendCtrl(3, NULL, lossdata, (CSeqNo::incseq(m_iRcvCurrSeqNo) == CSeqNo::decseq(packet.m_iSeqNo)) ? 1 : 2);
-
       int loss = CSeqNo::seqlen(m_iRcvCurrSeqNo, packet.m_iSeqNo) - 2;
       m_iTraceRcvLoss += loss;
       m_iRcvLossTotal += loss;
+
+      if (NULL == m_pRcvFEC)
+      {
+         // pack loss list for NAK
+         int32_t lossdata[2];
+         lossdata[0] = CSeqNo::incseq(m_iRcvCurrSeqNo) | 0x80000000;
+         lossdata[1] = CSeqNo::decseq(packet.m_iSeqNo);
+
+         // Generate loss report immediately.
+         sendCtrl(3, NULL, lossdata, (CSeqNo::incseq(m_iRcvCurrSeqNo) == CSeqNo::decseq(packet.m_iSeqNo)) ? 1 : 2);
+      }
+      else
+      {
+         // the report waits for the parity of the group, which may rebuild the lost packets
+         m_iFECLossCount += loss;
+         if (m_iFECNakSeq < 0)
+         {
+            m_iFECNakSeq = CSeqNo::incseq(m_iRcvCurrSeqNo);
+            m_ullFECNakTime = currtime + (getFECDelay() + 2 * m_iSYNInterval) * m_ullCPUFrequency;
+         }
+      }
    }
 
    // This is not a regular fixed size packet...   
    // an irregular sized packet usually indicates the end of a message, so send an ACK immediately
    // طֳֻڴݴ
-   if (packet.getLength() != m_iPayloadSize)   
+   if (packet.getLength() != ((NULL != m_pRcvFEC) ? m_iPayloadSize - CSndFEC::m_iHdrSize : m_iPayloadSize))
       CTimer::rdtsc(m_ullNextACKTime); 
 
    // Update the current largest sequence number that has been received.
@@ -2595,7 +3881,7 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
    if (m_bClosing)
       return 1002;
 
-   if (packet.getLength() != CHandShake::m_iContentSize)
+   if (packet.getLength() < CHandShake::m_iContentSize)
       return 1004;
 
    CHandShake hs;
@@ -2628,9 +3914,15 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
    if (1 == hs.m_iReqType)
    {
       hs.m_iCookie = *(int*)cookie;
+      // tell the client that the extension fields are understood
+      hs.m_iMaxACKSpacing = m_iMaxACKSpacing;
+      hs.m_iFECGroup = m_iFECGroup;
+      hs.m_iDelayReport = 1;
+      hs.m_iECNReport = 1;
       packet.m_iID = hs.m_iID;
-      int size = packet.getLength();
+      int size = CHandShake::m_iExtContentSize;
       hs.serialize(packet.m_pcData, size);
+      packet.setLength(size);
       m_pSndQueue->sendto(addr, packet);
       return 0;
    }
@@ -2638,7 +3930,9 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
    {
       if (hs.m_iCookie != *(int*)cookie)
       {
+         // the cookie may have been given out in the previous minute
          timestamp --;
+         cookiestr.str("");
          cookiestr << clienthost << ":" << clientport << ":" << timestamp;
          CMD5::compute(cookiestr.str().c_str(), cookie);
 
@@ -2657,7 +3951,12 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
          // mismatch, reject the request
          hs.m_iReqType = 1002;
          int size = CHandShake::m_iContentSize;
+         hs.m_iMaxACKSpacing = 0;
+         hs.m_iFECGroup = -1;
+         hs.m_iDelayReport = 0;
+         hs.m_iECNReport = 0;
          hs.serialize(packet.m_pcData, size);
+         packet.setLength(size);
          packet.m_iID = id;
          m_pSndQueue->sendto(addr, packet);
       }
@@ -2671,15 +3970,16 @@ int CUDT::listen(sockaddr* addr, CPacket& packet)
          // new connection response should be sent in connect()
          if (result != 1)
          {
-            int size = CHandShake::m_iContentSize;
+            int size = CHandShake::m_iExtContentSize;
             hs.serialize(packet.m_pcData, size);
+            packet.setLength(size);
             packet.m_iID = id;
             m_pSndQueue->sendto(addr, packet);
          }
          else
          {
             // a new connection has been created, enable epoll for write 
-            s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, true);
+            updateEPoll(UDT_EPOLL_OUT, true);
          }
       }
    }
@@ -2713,17 +4013,37 @@ void CUDT::checkTimers()
       else
          m_ullNextACKTime = currtime + m_ullACKInt;
 
+      updateACKSpacing();
+
       m_iPktCount = 0;
       m_iLightACKCount = 1;
    }
    // ͨCCCõӦʱӦǳڲԼһACK
-   else if (m_iSelfClockInterval * m_iLightACKCount <= m_iPktCount)
+   else if (m_iACKSpacing * m_iLightACKCount <= m_iPktCount)
    {
       //send a "light" ACK
       sendCtrl(2, NULL, NULL, 4);
       ++ m_iLightACKCount;
    }
 
+   // holes reported by the last ACK may have outlived their reordering window since
+   if (currtime > m_ullNextRACKTime)
+   {
+      detectRACKLoss();
+      m_ullNextRACKTime = currtime + m_ullSYNInt;
+   }
+
+   // the parity of the groups with losses is late or lost too, let the sender retransmit
+   if ((m_iFECNakSeq >= 0) && (currtime > m_ullFECNakTime))
+      reportFECLoss(m_iRcvCurrSeqNo);
+
+   // connections opened to the same host meanwhile start from the current state of this one
+   if (currtime > m_ullNextCacheTime)
+   {
+      updateCache(true);
+      m_ullNextCacheTime = currtime + m_iCacheInterval * m_ullCPUFrequency;
+   }
+
    // we are not sending back repeated NAK anymore and rely on the sender's EXP for retransmission
    //if ((m_pRcvLossList->getLossLength() > 0) && (currtime > m_ullNextNAKTime))
    //{
@@ -2772,6 +4092,7 @@ void CUDT::checkTimers()
          m_bClosing = true;
          m_bBroken = true;
          m_iBrokenCounter = 30;
+         s_UDTUnited.scheduleGC(m_SocketID, CTimer::getTime() + 1000000);
 
          // UDTʵ m_bBroken ѱãһʱᱻ
          // update snd U list to remove this socket
@@ -2781,7 +4102,7 @@ void CUDT::checkTimers()
          releaseSynch();
 
          // app can call any UDT API to learn the connection_broken error
-         s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN | UDT_EPOLL_OUT | UDT_EPOLL_ERR, true);
+         updateEPoll(UDT_EPOLL_IN | UDT_EPOLL_OUT | UDT_EPOLL_ERR, true);
 
          // ¼(select selectEx epoll ڵȴ¼)
          CTimer::triggerEvent();
@@ -2803,7 +4124,21 @@ void CUDT::checkTimers()
 
             // m_iSndLastAckԶȷ
             int32_t csn = m_iSndCurrSeqNo;
-            int num = m_pSndLossList->insert(m_iSndLastAck, csn);
+            int num = 0;
+
+            // skip what the receiver has reported as received
+            int32_t seqno = m_iSndLastAck;
+            for (int i = 0; i < m_iSACKBlockNum; ++ i)
+            {
+               if (CSeqNo::seqcmp(m_piSACKBlock[2 * i + 1], seqno) < 0)
+                  continue;
+               if (CSeqNo::seqcmp(m_piSACKBlock[2 * i], seqno) > 0)
+                  num += m_pSndLossList->insert(seqno, CSeqNo::decseq(m_piSACKBlock[2 * i]));
+               seqno = CSeqNo::incseq(m_piSACKBlock[2 * i + 1]);
+            }
+            if (CSeqNo::seqcmp(seqno, csn) <= 0)
+               num += m_pSndLossList->insert(seqno, csn);
+
             m_iTraceSndLoss += num;
             m_iSndLossTotal += num;
          }
@@ -2834,21 +4169,27 @@ void CUDT::checkTimers()
 void CUDT::addEPoll(const int eid)
 {
    CGuard::enterCS(s_UDTUnited.m_EPoll.m_EPollLock);
-   m_sPollID.insert(eid);
+   if (m_sPollID.insert(eid).second)
+      CAtomic::add(&m_iEPollCount, 1);
    CGuard::leaveCS(s_UDTUnited.m_EPoll.m_EPollLock);
 
-   if (!m_bConnected || m_bBroken || m_bClosing)
-      return;
-
-   if (((UDT_STREAM == m_iSockType) && (m_pRcvBuffer->getRcvDataSize() > 0)) ||
-      ((UDT_DGRAM == m_iSockType) && (m_pRcvBuffer->getRcvMsgNum() > 0)))
-   {
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_IN, true);
-   }
-   if (m_iSndBufSize > m_pSndBuffer->getCurrBufSize())
+   if (m_bConnected && !m_bBroken && !m_bClosing)
    {
-      s_UDTUnited.m_EPoll.update_events(m_SocketID, m_sPollID, UDT_EPOLL_OUT, true);
+      if (((UDT_STREAM == m_iSockType) && (m_pRcvBuffer->getRcvDataSize() > 0)) ||
+         ((UDT_DGRAM == m_iSockType) && (m_pRcvBuffer->getRcvMsgNum() > 0)))
+      {
+         updateEPoll(UDT_EPOLL_IN, true);
+      }
+      if (m_iSndBufSize > m_pSndBuffer->getCurrBufSize())
+      {
+         updateEPoll(UDT_EPOLL_OUT, true);
+      }
    }
+
+   // the new epoll gets the events on now; a change made meanwhile is published by its own caller, see updateEPoll()
+   set<int> add;
+   add.insert(eid);
+   s_UDTUnited.m_EPoll.publish_events(m_SocketID, add, UDT_EPOLL_IN | UDT_EPOLL_OUT | UDT_EPOLL_ERR, m_iEPollEvents);
 }
 
 void CUDT::removeEPoll(const int eid)
@@ -2860,6 +4201,34 @@ void CUDT::removeEPoll(const int eid)
    s_UDTUnited.m_EPoll.update_events(m_SocketID, remove, UDT_EPOLL_IN | UDT_EPOLL_OUT, false);
 
    CGuard::enterCS(s_UDTUnited.m_EPoll.m_EPollLock);
-   m_sPollID.erase(eid);
+   if (m_sPollID.erase(eid) > 0)
+      CAtomic::add(&m_iEPollCount, -1);
    CGuard::leaveCS(s_UDTUnited.m_EPoll.m_EPollLock);
 }
+
+void CUDT::updateEPoll(const int events, bool enable)
+{
+   // the events already on or off are not published again, so the epoll lock is only taken when one changes
+   int32_t state;
+   int32_t next;
+   do
+   {
+      state = m_iEPollEvents;
+      next = enable ? (state | events) : (state & ~events);
+      if (next == state)
+         return;
+   } while (!CAtomic::cas(&m_iEPollEvents, state, next));
+
+   // select() only waits for events to turn on, see CUDTUnited::select()
+   if ((next & ~state) && (CAtomic::load(&m_iSelectCount) > 0))
+      s_UDTUnited.notifySelect(this, next & ~state);
+
+   // the state is read again under the epoll lock, so that concurrent changes are published in the right order; the
+   // epolls found released are dropped from m_sPollID, and from the count
+   if (CAtomic::load(&m_iEPollCount) > 0)
+   {
+      int lost = s_UDTUnited.m_EPoll.publish_events(m_SocketID, m_sPollID, events, m_iEPollEvents);
+      if (lost > 0)
+         CAtomic::add(&m_iEPollCount, -lost);
+   }
+}
@@ -52,6 +52,7 @@ written by
 #include "api.h"
 #include "ccc.h"
 #include "cache.h"
+#include "fec.h"
 #include "queue.h"
 
 enum UDTSockType {UDT_STREAM = 1, UDT_DGRAM};
@@ -78,6 +79,7 @@ private: // constructor and desctructor
 public: //API
    static int startup();
    static int cleanup();
+   static int setcachefile(const char* file, int ttl);
    static UDTSOCKET socket(int af, int type = SOCK_STREAM, int protocol = 0);
    static int bind(UDTSOCKET u, const sockaddr* name, int namelen);
    static int bind(UDTSOCKET u, UDPSOCKET udpsock);
@@ -93,8 +95,14 @@ public: //API
    static int recv(UDTSOCKET u, char* buf, int len, int flags);
    static int sendmsg(UDTSOCKET u, const char* buf, int len, int ttl = -1, bool inorder = false);
    static int recvmsg(UDTSOCKET u, char* buf, int len);
+   static int sendv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
+   static int recvv(UDTSOCKET u, const iovec* iov, int iovcnt, int flags);
+   static int sendmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int ttl = -1, bool inorder = false);
+   static int recvmsg_batch(UDTSOCKET u, const iovec* msgs, int num, int* lens);
    static int64_t sendfile(UDTSOCKET u, std::fstream& ifs, int64_t& offset, int64_t size, int block = 364000);
+   static int64_t sendfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block = 364000);
    static int64_t recvfile(UDTSOCKET u, std::fstream& ofs, int64_t& offset, int64_t size, int block = 7280000);
+   static int64_t recvfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block = 7280000);
    static int select(int nfds, ud_set* readfds, ud_set* writefds, ud_set* exceptfds, const timeval* timeout);
    static int selectEx(const std::vector<UDTSOCKET>& fds, std::vector<UDTSOCKET>* readfds, std::vector<UDTSOCKET>* writefds, std::vector<UDTSOCKET>* exceptfds, int64_t msTimeOut);
    static int epoll_create();
@@ -103,6 +111,8 @@ public: //API
    static int epoll_remove_usock(const int eid, const UDTSOCKET u);
    static int epoll_remove_ssock(const int eid, const SYSSOCKET s);
    static int epoll_wait(const int eid, std::set<UDTSOCKET>* readfds, std::set<UDTSOCKET>* writefds, int64_t msTimeOut, std::set<SYSSOCKET>* lrfds = NULL, std::set<SYSSOCKET>* wrfds = NULL);
+   static int epoll_uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut);
+   static int epoll_getfd(const int eid);
    static int epoll_release(const int eid);
    static CUDTException& getlasterror();
    static int perfmon(UDTSOCKET u, CPerfMon* perf, bool clear = true);
@@ -209,6 +219,49 @@ private:
 
    int recvmsg(char* data, int len);
 
+      // Functionality:
+      //    Request UDT to send out the data blocks of an iovec array as one stream write.
+      // Parameters:
+      //    0) [in] iov: The data blocks to be sent.
+      //    1) [in] iovcnt: The number of blocks in "iov".
+      // Returned value:
+      //    Actual size of data sent.
+
+   int sendv(const iovec* iov, int iovcnt);
+
+      // Functionality:
+      //    Request UDT to receive data into the buffers of an iovec array, filled in order.
+      // Parameters:
+      //    0) [in] iov: The buffers to receive the data.
+      //    1) [in] iovcnt: The number of buffers in "iov".
+      // Returned value:
+      //    Actual size of data received.
+
+   int recvv(const iovec* iov, int iovcnt);
+
+      // Functionality:
+      //    Send a batch of messages, one message per iovec entry.
+      // Parameters:
+      //    0) [in] msgs: The messages to be sent.
+      //    1) [in] num: The number of messages in "msgs".
+      //    2) [in] ttl: the time-to-live of the messages.
+      //    3) [in] inorder: if the messages should be delivered in order.
+      // Returned value:
+      //    Number of messages sent; only the first one may block.
+
+   int sendmsg_batch(const iovec* msgs, int num, int ttl, bool inorder);
+
+      // Functionality:
+      //    Receive a batch of messages, one message per iovec entry.
+      // Parameters:
+      //    0) [in] msgs: The buffers to receive the messages.
+      //    1) [in] num: The number of buffers in "msgs".
+      //    2) [out] lens: The size of each message received.
+      // Returned value:
+      //    Number of messages received; only the first one may block.
+
+   int recvmsg_batch(const iovec* msgs, int num, int* lens);
+
       // Functionality:
       //    Request UDT to send out a file described as "fd", starting from "offset", with size of "size".
       // Parameters:
@@ -221,6 +274,19 @@ private:
 
    int64_t sendfile(std::fstream& ifs, int64_t& offset, int64_t size, int block = 366000);
 
+      // Functionality:
+      //    Request UDT to send out a file described by a file descriptor, starting from "offset", with size of "size".
+      //    The file data is memory mapped rather than copied when possible.
+      // Parameters:
+      //    0) [in] fd: The input file descriptor.
+      //    1) [in, out] offset: From where to read and send data; output is the new offset when the call returns.
+      //    2) [in] size: How many data to be sent.
+      //    3) [in] block: size of block per read from disk
+      // Returned value:
+      //    Actual size of data sent.
+
+   int64_t sendfile(int fd, int64_t& offset, int64_t size, int block = 366000);
+
       // Functionality:
       //    Request UDT to receive data into a file described as "fd", starting from "offset", with expected size of "size".
       // Parameters:
@@ -233,6 +299,20 @@ private:
 
    int64_t recvfile(std::fstream& ofs, int64_t& offset, int64_t size, int block = 7320000);
 
+      // Functionality:
+      //    Request UDT to receive data into a file described by a file descriptor, starting from "offset",
+      //    with expected size of "size". Received packets are handed to a writer thread without copying,
+      //    so that disk writes overlap with network receiving.
+      // Parameters:
+      //    0) [in] fd: The output file descriptor, may be opened with O_DIRECT.
+      //    1) [in, out] offset: From where to write data; output is the new offset when the call returns.
+      //    2) [in] size: How many data to be received.
+      //    3) [in] block: size of data handed to the writer per read from the receiver buffer
+      // Returned value:
+      //    Actual size of data received.
+
+   int64_t recvfile(int fd, int64_t& offset, int64_t size, int block = 7320000);
+
       // Functionality:
       //    Configure UDT options.
       // Parameters:
@@ -298,11 +378,26 @@ private: // Options
    int m_iRcvTimeOut;                           // receiving timeout in milliseconds
    bool m_bReuseAddr;				// reuse an exiting port or not, for UDP multiplexer
    int64_t m_llMaxBW;				// maximum data transfer rate (threshold)
+   bool m_bNoDelay;				// if false, small stream writes are coalesced before sending
+   bool m_bSACK;				// if true, ACKs carry the received ranges beyond the ACK point
+   int m_iArrWindowSize;			// size of the packet arrival history window
+   int m_iProbeWindowSize;			// size of the packet pair history window
+   int m_iMaxACKSpacing;			// largest light ACK spacing this side accepts, in packets, 0: fixed spacing
+   int m_iFECGroup;				// number of data packets per FEC group sent by this side, 0: no FEC
+   int m_iFECParity;				// largest number of parity packets per FEC group
+   bool m_bECN;					// mark the data sent ECN capable
 
 private: // congestion control
    CCCVirtualFactory* m_pCCFactory;             // Factory class to create a specific CC instance
    CCC* m_pCC;                                  // congestion control class
    CCache<CInfoBlock>* m_pCache;		// network information cache
+   uint64_t m_ullNextCacheTime;			// next time the state of the connection is shared through the cache
+
+   static const int m_iCacheInterval;		// period of sharing the state of open connections, microseconds
+   static const int m_iCacheHalfLife;		// age at which the congestion state in the cache is taken at half, microseconds
+
+   void warmStart(const CInfoBlock& ib);
+   void updateCache(bool open);
 
 private: // Status
    volatile bool m_bListening;                  // If the UDT entit is listening to connection
@@ -345,6 +440,28 @@ private: // Sending related data
    int32_t m_iSndLastAck2;                      // Last ACK2 sent back
    uint64_t m_ullSndLastAck2Time;               // The time when last ACK2 was sent back
 
+   static const int m_iMaxSACKBlocks = 16;      // Maximum number of received ranges carried by an ACK
+   int32_t m_piSACKBlock[2 * m_iMaxSACKBlocks]; // Received ranges beyond m_iSndLastAck reported by the last ACK, [start, end] pairs
+   int m_iSACKBlockNum;                         // Number of ranges in m_piSACKBlock
+
+   int32_t* m_piSndTime;                        // Time of the last transmission of each packet in flight, indexed by seq. no. modulo m_iSndTimeSize
+   int m_iSndTimeSize;                          // Size of m_piSndTime, a power of 2 not below twice the flow window
+   int32_t m_iRACKTime;                         // Latest transmission time of a packet known to be delivered
+   uint64_t m_ullNextRACKTime;                  // Next time the unacknowledged packets are checked for loss
+   uint64_t m_ullTLPTime;                       // Time when a tail loss probe is sent, 0 if none is armed
+   int32_t m_iTLPAck;                           // m_iSndLastAck when the tail loss probe was armed
+   int32_t m_iTLPSeqNo;                         // Last packet sent as a tail loss probe
+
+   int64_t m_llSndDelivered;                    // Data acknowledged so far, in bytes
+   int32_t m_iSndDeliveredTime;                 // Time when m_llSndDelivered last grew, taken by the peer when it sent the ACK
+   int32_t m_iSndClockOffset;                   // Peer time minus local time at the last ACK that acknowledged new data
+   int32_t m_iSndFirstTime;                     // Transmission time of the last packet that ended a delivery rate sample
+   int32_t m_iAppLimitedSeq;                    // Last packet sent before the sending buffer ran empty, -1 if the data has kept up since
+   int64_t* m_pllSndDelivered;                  // m_llSndDelivered at the last transmission of each packet in flight, indexed like m_piSndTime
+   int32_t* m_piSndDeliveredTime;               // m_iSndDeliveredTime at the last transmission of each packet in flight
+   int32_t* m_piSndFirstTime;                   // m_iSndFirstTime at the last transmission of each packet in flight
+   bool* m_pbSndRetrans;                        // If the last transmission of each packet in flight was a retransmission
+
    int32_t m_iISN;                              // Initial Sequence Number
 
    void CCUpdate();
@@ -365,6 +482,28 @@ private: // Receiving related data
 
    int32_t m_iPeerISN;                          // Initial Sequence Number of the peer side
 
+   bool m_bPeerDelayReport;			// if one-way delays are reported in the ACKs, both ways
+   int32_t m_iRcvDelay;				// minimum one-way delay of the data received since the last ACK, microseconds, offset by the clocks
+   bool m_bRcvDelayReset;			// if no data has been received since the last ACK
+   bool m_bPeerECNReport;			// if CE marks are counted in the ACKs, both ways
+   int32_t m_iRcvCECount;			// number of data and parity packets received marked CE, wraps around
+   int32_t m_iSndCECount;			// number of CE marks last reported by the peer
+
+private: // Forward error correction
+   CSndFEC* m_pSndFEC;				// parity of the data sent, NULL if not protected
+   CRcvFEC* m_pRcvFEC;				// recent data received, to rebuild lost packets, NULL if the peer does not protect its data
+   int m_iSndFECGroup;				// FEC group size agreed for the data sent, 0: no FEC
+   int m_iPeerFECGroup;				// FEC group size of the peer, 0: no FEC, -1: the peer does not know FEC
+
+   int m_iFECLossRate;				// smoothed loss rate of the data received, in packets per million, reported to the peer
+   int m_iFECRcvCount;				// number of data packets received since the last ACK
+   int m_iFECLossCount;				// number of data packets found lost since the last ACK
+   int32_t m_iFECNakSeq;			// first lost seq. no. whose report waits for the parity of its group, -1 if none
+   uint64_t m_ullFECNakTime;			// time when the waiting losses are reported anyway
+
+   void reportFECLoss(int32_t seqno);
+   uint64_t getFECDelay() const;
+
 private: // synchronization: mutexes and conditions
    pthread_mutex_t m_ConnectionLock;            // used to synchronize connection operation
 
@@ -387,8 +526,16 @@ private: // Generation and processing of packets
    void sendCtrl(int pkttype, void* lparam = NULL, void* rparam = NULL, int size = 0);
    void processCtrl(CPacket& ctrlpkt);
    int packData(CPacket& packet, uint64_t& ts);
+   int packParity(CPacket& packet, uint64_t entertime, uint64_t& ts);
    int processData(CUnit* unit);
    int listen(sockaddr* addr, CPacket& packet);
+   int readMsgBatch(const iovec* msgs, int num, int* lens, int first);
+   int getSACKBlocks(int32_t* blocks);
+   void processSACKBlocks(const int32_t* blocks, int num);
+   void updateACKSpacing();
+   void updateRACKTime(int32_t seqno1, int32_t seqno2);
+   void detectRACKLoss();
+   void sampleDelivery(int32_t ack, int size, int32_t acktime);
 
 private: // Trace
    uint64_t m_StartTime;                        // timestamp when the UDT entity is started
@@ -402,6 +549,8 @@ private: // Trace
    int m_iSentNAKTotal;                         // total number of sent NAK packets
    int m_iRecvNAKTotal;                         // total number of received NAK packets
    int64_t m_llSndDurationTotal;		// total real time for sending
+   int64_t m_llDiskWriteTotal;                  // total size of data written to disk by recvfile
+   int m_iRcvCETotal;                           // total number of data and parity packets received marked CE
 
    uint64_t m_LastSampleTime;                   // last performance sample time
    int64_t m_llTraceSent;                       // number of pakctes sent in the last trace interval
@@ -415,12 +564,16 @@ private: // Trace
    int m_iRecvNAK;                              // number of NAKs received in the last trace interval
    int64_t m_llSndDuration;			// real time for sending
    int64_t m_llSndDurationCounter;		// timers to record the sending duration
+   int64_t m_llTraceDiskWrite;                  // size of data written to disk in the last trace interval
+   int64_t m_llDiskWriteDuration;               // time spent writing to disk in the last trace interval
+   int m_iTraceRcvCE;                           // number of data packets received marked CE in the last trace interval
 
 private: // Timers
    uint64_t m_ullCPUFrequency;                  // CPU clock frequency, used for Timer, ticks per microsecond
 
    static const int m_iSYNInterval;             // Periodical Rate Control Interval, 10000 microsecond
    static const int m_iSelfClockInterval;       // ACK interval for self-clocking
+   static const int m_iCoalesceDelay;           // Maximum time a partial tail packet is held back when UDT_NODELAY is off, in microseconds
 
    uint64_t m_ullNextACKTime;			// Next ACK time, in CPU clock cycles, same below
    uint64_t m_ullNextNAKTime;			// Next NAK time
@@ -435,8 +588,12 @@ private: // Timers
 
    int m_iPktCount;				// packet counter for ACK
    int m_iLightACKCount;			// light ACK counter
+   int m_iACKSpacing;				// number of packets between light ACKs
+   int m_iACKSpacingLimit;			// upper bound of m_iACKSpacing agreed with the peer, 0 if the spacing is fixed
+   uint64_t m_ullLastSpacingTime;		// last time m_iACKSpacing was updated
 
    uint64_t m_ullTargetTime;			// scheduled time of next packet sending
+   uint64_t m_ullHoldTime;			// time when the sender must be scheduled again though it has nothing to send now, 0 if none
 
    void checkTimers();
 
@@ -450,8 +607,24 @@ private: // for UDP multiplexer
 
 private: // for epoll
    std::set<int> m_sPollID;                     // set of epoll ID to trigger
+   volatile int32_t m_iEPollEvents;             // IO events on, as published to the epolls
+   volatile int32_t m_iEPollCount;              // number of epolls in m_sPollID
    void addEPoll(const int eid);
    void removeEPoll(const int eid);
+
+      // Functionality:
+      //    turn IO events on or off, and publish them to the epolls if they change.
+      // Parameters:
+      //    0) [in] events: combination of events to update.
+      //    1) [in] enable: true -> on, otherwise off.
+      // Returned value:
+      //    None.
+
+   void updateEPoll(const int events, bool enable);
+
+private: // for select
+   CSelectNode* m_pSelectNodes;                 // select() and selectEx() calls watching this socket, see CUDTUnited::select()
+   volatile int32_t m_iSelectCount;             // number of nodes in m_pSelectNodes
 };
 
 
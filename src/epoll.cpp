@@ -37,9 +37,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 written by
    Yunhong Gu, last updated 01/01/2011
 *****************************************************************************/
-
 #ifdef LINUX
    #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+   #include <unistd.h>
+#elif !defined(WIN32)
+   #include <fcntl.h>
    #include <unistd.h>
 #endif
 #include <algorithm>
@@ -61,6 +64,14 @@ m_iIDSeed(0)
 
 CEPoll::~CEPoll()
 {
+   for (map<int, CEPollDesc*>::iterator i = m_mPolls.begin(); i != m_mPolls.end(); ++ i)
+   {
+      freeRemoved(i->second);
+      for (map<UDTSOCKET, CEPollSock*>::iterator j = i->second->m_mUDTSocks.begin(); j != i->second->m_mUDTSocks.end(); ++ j)
+         delete j->second;
+      freeDesc(i->second);
+   }
+
    CGuard::releaseMutex(m_EPollLock);
 }
 
@@ -69,40 +80,93 @@ int CEPoll::create()
    CGuard pg(m_EPollLock);
 
    int localid = 0;
+   int signal[2] = {-1, -1};
 
    #ifdef LINUX
    localid = epoll_create(1024);
    if (localid < 0)
       throw CUDTException(-1, 0, errno);
+
+   // the eventfd is also watched by the local epoll, so that the system sockets can be waited on with the UDT sockets
+   signal[0] = signal[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   epoll_event ev;
+   memset(&ev, 0, sizeof(epoll_event));
+   ev.events = EPOLLIN;
+   ev.data.fd = signal[0];
+   if ((signal[0] < 0) || (::epoll_ctl(localid, EPOLL_CTL_ADD, signal[0], &ev) < 0))
+   {
+      int err = errno;
+      if (signal[0] >= 0)
+         ::close(signal[0]);
+      ::close(localid);
+      throw CUDTException(-1, 0, err);
+   }
    #else
    // on BSD, use kqueue
    // on Solaris, use /dev/poll
    // on Windows, select
+   #ifndef WIN32
+   if (::pipe(signal) < 0)
+      throw CUDTException(-1, 0, errno);
+   for (int i = 0; i < 2; ++ i)
+   {
+      ::fcntl(signal[i], F_SETFL, ::fcntl(signal[i], F_GETFL) | O_NONBLOCK);
+      ::fcntl(signal[i], F_SETFD, FD_CLOEXEC);
+   }
+   #endif
    #endif
 
    if (++ m_iIDSeed >= 0x7FFFFFFF)
       m_iIDSeed = 0;
 
-   CEPollDesc desc;
-   desc.m_iID = m_iIDSeed;
-   desc.m_iLocalID = localid;
-   m_mPolls[desc.m_iID] = desc;
+   CEPollDesc* desc = new CEPollDesc;
+   desc->m_iID = m_iIDSeed;
+   desc->m_iLocalID = localid;
+   desc->m_pReadyHead = desc->m_pReadyTail = NULL;
+   desc->m_iSignalFD = signal[0];
+   desc->m_iSignalWrite = signal[1];
+   desc->m_iWaiters = 0;
+   desc->m_iLegacyWaiters = 0;
+   desc->m_bReleased = false;
+   #ifndef WIN32
+      pthread_cond_init(&desc->m_ReadyCond, NULL);
+   #else
+      desc->m_ReadyCond = CreateEvent(NULL, false, false, NULL);
+   #endif
+   m_mPolls[desc->m_iID] = desc;
 
-   return desc.m_iID;
+   return desc->m_iID;
 }
 
 int CEPoll::add_usock(const int eid, const UDTSOCKET& u, const int* events)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
-      throw CUDTException(5, 13);
+   CEPollDesc* d = find(eid);
+
+   // the events are added to those watched already, the mode is that of the last call
+   int watch = (NULL == events) ? (UDT_EPOLL_IN | UDT_EPOLL_OUT) : *events;
+
+   map<UDTSOCKET, CEPollSock*>::iterator i = d->m_mUDTSocks.find(u);
+   if (i != d->m_mUDTSocks.end())
+   {
+      CEPollSock* s = i->second;
+      s->m_iWatch = (s->m_iWatch & ~UDT_EPOLL_ET) | watch;
+      if (s->m_bReady && !isReady(s))
+         popReady(d, s);
+      return 0;
+   }
 
-   if (!events || (*events & UDT_EPOLL_IN))
-      p->second.m_sUDTSocksIn.insert(u);
-   if (!events || (*events & UDT_EPOLL_OUT))
-      p->second.m_sUDTSocksOut.insert(u);
+   // the state is set by the socket itself, after it is added, see CUDT::addEPoll()
+   CEPollSock* s = new CEPollSock;
+   s->m_iID = u;
+   s->m_iWatch = watch;
+   s->m_iState = 0;
+   s->m_iEdge = 0;
+   s->m_bReady = false;
+   s->m_bRemoved = false;
+   s->m_pPrev = s->m_pNext = NULL;
+   d->m_mUDTSocks[u] = s;
 
    return 0;
 }
@@ -111,9 +175,7 @@ int CEPoll::add_ssock(const int eid, const SYSSOCKET& s, const int* events)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
-      throw CUDTException(5, 13);
+   CEPollDesc* d = find(eid);
 
 #ifdef LINUX
    epoll_event ev;
@@ -133,26 +195,49 @@ int CEPoll::add_ssock(const int eid, const SYSSOCKET& s, const int* events)
    }
 
    ev.data.fd = s;
-   if (::epoll_ctl(p->second.m_iLocalID, EPOLL_CTL_ADD, s, &ev) < 0)
+   if (::epoll_ctl(d->m_iLocalID, EPOLL_CTL_ADD, s, &ev) < 0)
       throw CUDTException();
 #endif
 
-   p->second.m_sLocals.insert(s);
+   d->m_sLocals.insert(s);
 
    return 0;
 }
 
-int CEPoll::remove_usock(const int eid, const UDTSOCKET& u)
+int CEPoll::remove_usock(const int eid, const UDTSOCKET& u, bool closing)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
-      throw CUDTException(5, 13);
+   CEPollDesc* d = find(eid);
+
+   map<UDTSOCKET, CEPollSock*>::iterator i = d->m_mUDTSocks.find(u);
+   if (i == d->m_mUDTSocks.end())
+      return 0;
+
+   CEPollSock* s = i->second;
+   d->m_mUDTSocks.erase(i);
+
+   if (closing && s->m_bReady)
+   {
+      // the events of a socket being closed are reported once more, then it is deleted, see wait() and uwait()
+      s->m_bRemoved = true;
+   }
+   else
+   {
+      if (s->m_bReady)
+         popReady(d, s);
+      delete s;
+   }
 
-   p->second.m_sUDTSocksIn.erase(u);
-   p->second.m_sUDTSocksOut.erase(u);
-   p->second.m_sUDTSocksEx.erase(u);
+   // the waiters with no socket left to watch and no timeout fail, rather than wait forever
+   if (d->m_mUDTSocks.empty())
+   {
+      #ifndef WIN32
+         pthread_cond_broadcast(&d->m_ReadyCond);
+      #else
+         SetEvent(d->m_ReadyCond);
+      #endif
+   }
 
    return 0;
 }
@@ -161,17 +246,15 @@ int CEPoll::remove_ssock(const int eid, const SYSSOCKET& s)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-   if (p == m_mPolls.end())
-      throw CUDTException(5, 13);
+   CEPollDesc* d = find(eid);
 
 #ifdef LINUX
    epoll_event ev;  // ev is ignored, for compatibility with old Linux kernel only.
-   if (::epoll_ctl(p->second.m_iLocalID, EPOLL_CTL_DEL, s, &ev) < 0)
+   if (::epoll_ctl(d->m_iLocalID, EPOLL_CTL_DEL, s, &ev) < 0)
       throw CUDTException();
 #endif
 
-   p->second.m_sLocals.erase(s);
+   d->m_sLocals.erase(s);
 
    return 0;
 }
@@ -188,6 +271,13 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
    if (lrfds) lrfds->clear();
    if (lwfds) lwfds->clear();
 
+   // exceptions are reported with both reads and writes
+   int report = 0;
+   if (NULL != readfds)
+      report |= UDT_EPOLL_IN | UDT_EPOLL_ERR;
+   if (NULL != writefds)
+      report |= UDT_EPOLL_OUT | UDT_EPOLL_ERR;
+
    int total = 0;
 
    int64_t entertime = CTimer::getTime();
@@ -195,45 +285,64 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
    {
       CGuard::enterCS(m_EPollLock);
 
-      map<int, CEPollDesc>::iterator p = m_mPolls.find(eid);
-      if (p == m_mPolls.end())
+      CEPollDesc* d;
+      try
       {
-         CGuard::leaveCS(m_EPollLock);
-         throw CUDTException(5, 13);
+         d = find(eid);
       }
-
-      if (p->second.m_sUDTSocksIn.empty() && p->second.m_sUDTSocksOut.empty() && p->second.m_sLocals.empty() && (msTimeOut < 0))
+      catch (...)
       {
-         // no socket is being monitored, this may be a deadlock
          CGuard::leaveCS(m_EPollLock);
-         throw CUDTException(5, 3);
+         throw;
       }
 
-      // Sockets with exceptions are returned to both read and write sets.
-      if ((NULL != readfds) && (!p->second.m_sUDTReads.empty() || !p->second.m_sUDTExcepts.empty()))
-      {
-         *readfds = p->second.m_sUDTReads;
-         for (set<UDTSOCKET>::const_iterator i = p->second.m_sUDTExcepts.begin(); i != p->second.m_sUDTExcepts.end(); ++ i)
-            readfds->insert(*i);
-         total += p->second.m_sUDTReads.size() + p->second.m_sUDTExcepts.size();
-      }
-      if ((NULL != writefds) && (!p->second.m_sUDTWrites.empty() || !p->second.m_sUDTExcepts.empty()))
+      for (CEPollSock* s = d->m_pReadyHead; NULL != s;)
       {
-         *writefds = p->second.m_sUDTWrites;
-         for (set<UDTSOCKET>::const_iterator i = p->second.m_sUDTExcepts.begin(); i != p->second.m_sUDTExcepts.end(); ++ i)
-            writefds->insert(*i);
-         total += p->second.m_sUDTWrites.size() + p->second.m_sUDTExcepts.size();
+         CEPollSock* next = s->m_pNext;
+
+         int events = ((s->m_iWatch & UDT_EPOLL_ET) ? s->m_iEdge : (s->m_iState & s->m_iWatch)) & report;
+         if ((NULL != readfds) && (events & (UDT_EPOLL_IN | UDT_EPOLL_ERR)))
+         {
+            readfds->insert(s->m_iID);
+            ++ total;
+         }
+         if ((NULL != writefds) && (events & (UDT_EPOLL_OUT | UDT_EPOLL_ERR)))
+         {
+            writefds->insert(s->m_iID);
+            ++ total;
+         }
+
+         // the edges reported are consumed
+         if (s->m_iWatch & UDT_EPOLL_ET)
+         {
+            s->m_iEdge &= ~events;
+            if (!isReady(s))
+               popReady(d, s);
+         }
+
+         // a closed socket has had its one chance to be reported, as in uwait(), whatever this call asked for
+         if (s->m_bRemoved)
+         {
+            if (s->m_bReady)
+               popReady(d, s);
+            delete s;
+         }
+
+         s = next;
       }
 
       if (lrfds || lwfds)
       {
          #ifdef LINUX
-         const int max_events = p->second.m_sLocals.size();
+         const int max_events = d->m_sLocals.size() + 1;
          epoll_event ev[max_events];
-         int nfds = ::epoll_wait(p->second.m_iLocalID, ev, max_events, 0);
+         int nfds = ::epoll_wait(d->m_iLocalID, ev, max_events, 0);
 
          for (int i = 0; i < nfds; ++ i)
          {
+            if (ev[i].data.fd == d->m_iSignalFD)
+               continue;
+
             if ((NULL != lrfds) && (ev[i].events & EPOLLIN))
            {
                lrfds->insert(ev[i].data.fd);
@@ -256,7 +365,7 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
          FD_ZERO(&readfds);
          FD_ZERO(&writefds);
 
-         for (set<SYSSOCKET>::const_iterator i = p->second.m_sLocals.begin(); i != p->second.m_sLocals.end(); ++ i)
+         for (set<SYSSOCKET>::const_iterator i = d->m_sLocals.begin(); i != d->m_sLocals.end(); ++ i)
          {
             if (lrfds)
                FD_SET(*i, &readfds);
@@ -269,7 +378,7 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
          tv.tv_usec = 0;
          if (::select(0, &readfds, &writefds, NULL, &tv) > 0)
          {
-            for (set<SYSSOCKET>::const_iterator i = p->second.m_sLocals.begin(); i != p->second.m_sLocals.end(); ++ i)
+            for (set<SYSSOCKET>::const_iterator i = d->m_sLocals.begin(); i != d->m_sLocals.end(); ++ i)
             {
                if (lrfds && FD_ISSET(*i, &readfds))
                {
@@ -286,82 +395,420 @@ int CEPoll::wait(const int eid, set<UDTSOCKET>* readfds, set<UDTSOCKET>* writefd
          #endif
       }
 
+      if (total > 0)
+      {
+         CGuard::leaveCS(m_EPollLock);
+         return total;
+      }
+
+      if (d->m_mUDTSocks.empty() && d->m_sLocals.empty() && (msTimeOut < 0))
+      {
+         // no socket is being monitored, this may be a deadlock
+         CGuard::leaveCS(m_EPollLock);
+         throw CUDTException(5, 3);
+      }
+
+      if ((msTimeOut >= 0) && (int64_t(CTimer::getTime() - entertime) >= msTimeOut * 1000LL))
+      {
+         CGuard::leaveCS(m_EPollLock);
+         throw CUDTException(6, 3, 0);
+      }
+
+      bool locals = (lrfds || lwfds) && !d->m_sLocals.empty();
+
+      #ifndef LINUX
+      if (locals)
+      {
+         // the system sockets give no signal, poll them
+         CGuard::leaveCS(m_EPollLock);
+         CTimer::waitForEvent();
+         continue;
+      }
+      #else
+      if (locals && (NULL != d->m_pReadyHead))
+      {
+         // the eventfd stays readable for the sockets ready with events not asked for, poll instead
+         CGuard::leaveCS(m_EPollLock);
+         CTimer::waitForEvent();
+         continue;
+      }
+      #endif
+
+      bool released = waitReady(d, (msTimeOut >= 0) ? entertime + msTimeOut * 1000LL : -1, true, locals);
       CGuard::leaveCS(m_EPollLock);
+      if (released)
+         throw CUDTException(5, 13);
+   }
+
+   return 0;
+}
+
+int CEPoll::uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut)
+{
+   if ((NULL == events) || (maxevents <= 0))
+      throw CUDTException(5, 3, 0);
+
+   int64_t entertime = CTimer::getTime();
+
+   CGuard pg(m_EPollLock);
+
+   while (true)
+   {
+      CEPollDesc* d = find(eid);
+
+      // the sockets reported level triggered go to the end of the list, so that all get their turn
+      CEPollSock* head = NULL;
+      CEPollSock* tail = NULL;
+
+      int total = 0;
+      while ((NULL != d->m_pReadyHead) && (total < maxevents))
+      {
+         CEPollSock* s = d->m_pReadyHead;
+         popReady(d, s);
+
+         events[total].sock = s->m_iID;
+         if (s->m_bRemoved)
+         {
+            events[total].events = ((s->m_iWatch & UDT_EPOLL_ET) ? s->m_iEdge : s->m_iState & s->m_iWatch) & ~UDT_EPOLL_ET;
+            delete s;
+         }
+         else if (s->m_iWatch & UDT_EPOLL_ET)
+         {
+            events[total].events = s->m_iEdge;
+            s->m_iEdge = 0;
+         }
+         else
+         {
+            events[total].events = s->m_iState & s->m_iWatch & ~UDT_EPOLL_ET;
+
+            s->m_bReady = true;
+            s->m_pPrev = tail;
+            s->m_pNext = NULL;
+            if (NULL != tail)
+               tail->m_pNext = s;
+            else
+               head = s;
+            tail = s;
+         }
+         ++ total;
+      }
+
+      if (NULL != head)
+      {
+         head->m_pPrev = d->m_pReadyTail;
+         if (NULL != d->m_pReadyTail)
+            d->m_pReadyTail->m_pNext = head;
+         else
+         {
+            d->m_pReadyHead = head;
+            setSignal(d, true);
+         }
+         d->m_pReadyTail = tail;
+      }
 
       if (total > 0)
          return total;
 
+      if (d->m_mUDTSocks.empty() && (msTimeOut < 0))
+      {
+         // no socket is being monitored, this may be a deadlock
+         throw CUDTException(5, 3);
+      }
+
       if ((msTimeOut >= 0) && (int64_t(CTimer::getTime() - entertime) >= msTimeOut * 1000LL))
-         throw CUDTException(6, 3, 0);
+         return 0;
 
-      CTimer::waitForEvent();
+      if (waitReady(d, (msTimeOut >= 0) ? entertime + msTimeOut * 1000LL : -1))
+         throw CUDTException(5, 13);
    }
 
    return 0;
 }
 
+int CEPoll::getfd(const int eid)
+{
+   CGuard pg(m_EPollLock);
+
+   #ifndef WIN32
+   return find(eid)->m_iSignalFD;
+   #else
+   // there is no event object that a select() can wait on, an unknown ID is still reported as such
+   find(eid);
+   throw CUDTException(5, 0, 0);
+   #endif
+}
+
 int CEPoll::release(const int eid)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator i = m_mPolls.find(eid);
+   map<int, CEPollDesc*>::iterator i = m_mPolls.find(eid);
    if (i == m_mPolls.end())
       throw CUDTException(5, 13);
 
-   #ifdef LINUX
-   // release local/system epoll descriptor
-   ::close(i->second.m_iLocalID);
-   #endif
+   CEPollDesc* d = i->second;
+
+   freeRemoved(d);
+   for (map<UDTSOCKET, CEPollSock*>::iterator j = d->m_mUDTSocks.begin(); j != d->m_mUDTSocks.end(); ++ j)
+      delete j->second;
+   d->m_mUDTSocks.clear();
+   d->m_pReadyHead = d->m_pReadyTail = NULL;
 
    m_mPolls.erase(i);
 
+   if (d->m_iWaiters > 0)
+   {
+      // the waiters find it released and the last one deletes it; those on the local epoll are woken by the eventfd
+      d->m_bReleased = true;
+      #ifndef WIN32
+         pthread_cond_broadcast(&d->m_ReadyCond);
+      #else
+         SetEvent(d->m_ReadyCond);
+      #endif
+      setSignal(d, true);
+      return 0;
+   }
+
+   freeDesc(d);
+
    return 0;
 }
 
-namespace
+int CEPoll::update_events(const UDTSOCKET& uid, std::set<int>& eids, int events, bool enable)
 {
+   CGuard pg(m_EPollLock);
 
-void update_epoll_sets(const UDTSOCKET& uid, const set<UDTSOCKET>& watch, set<UDTSOCKET>& result, bool enable)
-{
-   if (enable && (watch.find(uid) != watch.end()))
-   {
-      result.insert(uid);
-   }
-   else if (!enable)
-   {
-      result.erase(uid);
-   }
+   return setEvents(uid, eids, events, enable ? events : 0);
 }
 
-}  // namespace
-
-int CEPoll::update_events(const UDTSOCKET& uid, std::set<int>& eids, int events, bool enable)
+int CEPoll::publish_events(const UDTSOCKET& uid, std::set<int>& eids, int events, const volatile int32_t& state)
 {
    CGuard pg(m_EPollLock);
 
-   map<int, CEPollDesc>::iterator p;
+   return setEvents(uid, eids, events, state & events);
+}
 
+int CEPoll::setEvents(const UDTSOCKET& uid, std::set<int>& eids, int events, int state)
+{
    vector<int> lost;
    for (set<int>::iterator i = eids.begin(); i != eids.end(); ++ i)
    {
-      p = m_mPolls.find(*i);
+      map<int, CEPollDesc*>::iterator p = m_mPolls.find(*i);
       if (p == m_mPolls.end())
       {
          lost.push_back(*i);
+         continue;
       }
-      else
+
+      CEPollDesc* d = p->second;
+      map<UDTSOCKET, CEPollSock*>::iterator q = d->m_mUDTSocks.find(uid);
+      if (q == d->m_mUDTSocks.end())
+         continue;
+
+      CEPollSock* s = q->second;
+      int curr = (s->m_iState & ~events) | state;
+      bool newevent = (0 != (curr & ~s->m_iState & s->m_iWatch));
+
+      // only the events turning on are edges, an edge not reported yet is void once the event turns off
+      s->m_iEdge = (s->m_iEdge & curr) | (curr & ~s->m_iState & s->m_iWatch & ~UDT_EPOLL_ET);
+      s->m_iState = curr;
+
+      if (!isReady(s))
       {
-         if ((events & UDT_EPOLL_IN) != 0)
-            update_epoll_sets(uid, p->second.m_sUDTSocksIn, p->second.m_sUDTReads, enable);
-         if ((events & UDT_EPOLL_OUT) != 0)
-            update_epoll_sets(uid, p->second.m_sUDTSocksOut, p->second.m_sUDTWrites, enable);
-         if ((events & UDT_EPOLL_ERR) != 0)
-            update_epoll_sets(uid, p->second.m_sUDTSocksEx, p->second.m_sUDTExcepts, enable);
+         if (s->m_bReady)
+            popReady(d, s);
+         continue;
+      }
+
+      if (!s->m_bReady)
+         pushReady(d, s);
+
+      // one more event to report, one more waiter to wake up; the sockets known to be ready wake nobody
+      if (newevent)
+      {
+         #ifndef WIN32
+            // a waiter in wait() may take the wakeup for an event it does not report and go back to sleep, then all
+            // waiters are woken so that the one this event is for does not miss it
+            if (d->m_iLegacyWaiters > 0)
+               pthread_cond_broadcast(&d->m_ReadyCond);
+            else
+               pthread_cond_signal(&d->m_ReadyCond);
+         #else
+            SetEvent(d->m_ReadyCond);
+         #endif
       }
    }
 
    for (vector<int>::iterator i = lost.begin(); i != lost.end(); ++ i)
       eids.erase(*i);
 
-   return 0;
+   return lost.size();
+}
+
+bool CEPoll::isReady(const CEPollSock* s)
+{
+   if (s->m_iWatch & UDT_EPOLL_ET)
+      return 0 != s->m_iEdge;
+
+   return 0 != (s->m_iState & s->m_iWatch & ~UDT_EPOLL_ET);
+}
+
+void CEPoll::pushReady(CEPollDesc* d, CEPollSock* s)
+{
+   s->m_bReady = true;
+   s->m_pPrev = d->m_pReadyTail;
+   s->m_pNext = NULL;
+   if (NULL != d->m_pReadyTail)
+      d->m_pReadyTail->m_pNext = s;
+   else
+   {
+      d->m_pReadyHead = s;
+      setSignal(d, true);
+   }
+   d->m_pReadyTail = s;
+}
+
+void CEPoll::popReady(CEPollDesc* d, CEPollSock* s)
+{
+   if (NULL != s->m_pPrev)
+      s->m_pPrev->m_pNext = s->m_pNext;
+   else
+      d->m_pReadyHead = s->m_pNext;
+   if (NULL != s->m_pNext)
+      s->m_pNext->m_pPrev = s->m_pPrev;
+   else
+      d->m_pReadyTail = s->m_pPrev;
+   s->m_pPrev = s->m_pNext = NULL;
+   s->m_bReady = false;
+
+   if (NULL == d->m_pReadyHead)
+      setSignal(d, false);
+}
+
+void CEPoll::setSignal(CEPollDesc* d, bool on)
+{
+   // the descriptor is readable as long as the ready list is not empty, it changes only when the list empties or fills
+   #ifdef LINUX
+      uint64_t count = 1;
+      ssize_t res = on ? ::write(d->m_iSignalWrite, &count, sizeof(uint64_t)) : ::read(d->m_iSignalFD, &count, sizeof(uint64_t));
+      (void)res;
+   #elif !defined(WIN32)
+      char buf[64] = {0};
+      if (on)
+      {
+         ssize_t res = ::write(d->m_iSignalWrite, buf, 1);
+         (void)res;
+      }
+      else
+         while (::read(d->m_iSignalFD, buf, sizeof(buf)) > 0) {}
+   #else
+      (void)d;
+      (void)on;
+   #endif
+}
+
+void CEPoll::freeRemoved(CEPollDesc* d)
+{
+   // the sockets removed while closing are only in the ready list
+   for (CEPollSock* s = d->m_pReadyHead; NULL != s;)
+   {
+      CEPollSock* next = s->m_pNext;
+      if (s->m_bRemoved)
+         delete s;
+      s = next;
+   }
+}
+
+void CEPoll::freeDesc(CEPollDesc* d)
+{
+   #ifdef LINUX
+   // release local/system epoll descriptor
+   ::close(d->m_iLocalID);
+   #endif
+
+   #ifndef WIN32
+      if (d->m_iSignalWrite != d->m_iSignalFD)
+         ::close(d->m_iSignalWrite);
+      ::close(d->m_iSignalFD);
+      pthread_cond_destroy(&d->m_ReadyCond);
+   #else
+      CloseHandle(d->m_ReadyCond);
+   #endif
+   delete d;
+}
+
+CEPollDesc* CEPoll::find(const int eid)
+{
+   map<int, CEPollDesc*>::iterator p = m_mPolls.find(eid);
+   if (p == m_mPolls.end())
+      throw CUDTException(5, 13);
+
+   return p->second;
+}
+
+bool CEPoll::waitReady(CEPollDesc* d, int64_t deadline, bool legacy, bool locals)
+{
+   // called with m_EPollLock held, returns true if the epoll has been released meanwhile
+   ++ d->m_iWaiters;
+   if (legacy && !locals)
+      ++ d->m_iLegacyWaiters;
+
+   #ifdef LINUX
+   if (locals)
+   {
+      // the local epoll watches the eventfd too, so it returns for the UDT sockets as well as for the system ones
+      int ms = (deadline < 0) ? -1 : int(max(deadline - int64_t(CTimer::getTime()) + 999, int64_t(0)) / 1000);
+      epoll_event ev;
+      CGuard::leaveCS(m_EPollLock);
+      ::epoll_wait(d->m_iLocalID, &ev, 1, ms);
+      CGuard::enterCS(m_EPollLock);
+   }
+   #endif
+
+   // the system sockets are only waited on with the UDT ones on Linux, see wait()
+   if (!locals)
+   {
+      #ifndef WIN32
+         if (deadline < 0)
+         {
+            pthread_cond_wait(&d->m_ReadyCond, &m_EPollLock);
+         }
+         else
+         {
+            int64_t wait = deadline - CTimer::getTime();
+            if (wait > 0)
+            {
+               timeval now;
+               timespec timeout;
+               gettimeofday(&now, 0);
+               uint64_t wakeup = now.tv_usec + wait;
+               timeout.tv_sec = now.tv_sec + wakeup / 1000000;
+               timeout.tv_nsec = (wakeup % 1000000) * 1000;
+               pthread_cond_timedwait(&d->m_ReadyCond, &m_EPollLock, &timeout);
+            }
+         }
+      #else
+         // an event wakes up one waiter only, a release, or an event taken by a waiter in wait() that does not report
+         // it, is seen by the others within 1 second
+         int64_t wait = (deadline < 0) ? 1000000 : min(deadline - int64_t(CTimer::getTime()), int64_t(1000000));
+         if (wait > 0)
+         {
+            CGuard::leaveCS(m_EPollLock);
+            WaitForSingleObject(d->m_ReadyCond, DWORD((wait + 999) / 1000));
+            CGuard::enterCS(m_EPollLock);
+         }
+      #endif
+   }
+
+   -- d->m_iWaiters;
+   if (legacy && !locals)
+      -- d->m_iLegacyWaiters;
+
+   if (!d->m_bReleased)
+      return false;
+
+   if (0 == d->m_iWaiters)
+      freeDesc(d);
+
+   return true;
 }
@@ -47,19 +47,36 @@ written by
 #include "udt.h"
 
 
+struct CEPollSock
+{
+   UDTSOCKET m_iID;                          // UDT socket ID
+   int m_iWatch;                             // events watched, with UDT_EPOLL_ET if edge triggered
+   int m_iState;                             // events on
+   int m_iEdge;                              // events turned on and not reported yet, if edge triggered
+   bool m_bReady;                            // if the socket is in the ready list
+   bool m_bRemoved;                          // if the socket is closed and only kept in the ready list until reported
+   CEPollSock* m_pPrev;                      // previous socket in the ready list
+   CEPollSock* m_pNext;                      // next socket in the ready list
+};
+
 struct CEPollDesc
 {
    int m_iID;                                // epoll ID
-   std::set<UDTSOCKET> m_sUDTSocksOut;       // set of UDT sockets waiting for write events
-   std::set<UDTSOCKET> m_sUDTSocksIn;        // set of UDT sockets waiting for read events
-   std::set<UDTSOCKET> m_sUDTSocksEx;        // set of UDT sockets waiting for exceptions
+   std::map<UDTSOCKET, CEPollSock*> m_mUDTSocks;   // UDT sockets watched
 
    int m_iLocalID;                           // local system epoll ID
    std::set<SYSSOCKET> m_sLocals;            // set of local (non-UDT) descriptors
 
-   std::set<UDTSOCKET> m_sUDTWrites;         // UDT sockets ready for write
-   std::set<UDTSOCKET> m_sUDTReads;          // UDT sockets ready for read
-   std::set<UDTSOCKET> m_sUDTExcepts;        // UDT sockets with exceptions (connection broken, etc.)
+   CEPollSock* m_pReadyHead;                 // UDT sockets with events to report, in the order they got ready
+   CEPollSock* m_pReadyTail;
+
+   int m_iSignalFD;                          // readable when the ready list is not empty: eventfd on Linux, pipe elsewhere, -1 on Windows
+   int m_iSignalWrite;                       // write end of the pipe, the eventfd itself on Linux
+
+   pthread_cond_t m_ReadyCond;               // signalled when a UDT socket gets ready
+   int m_iWaiters;                           // number of threads waiting on m_ReadyCond
+   int m_iLegacyWaiters;                     // number of them in wait(), which may leave the events asked for by others
+   bool m_bReleased;                         // if the epoll is released, the last waiter deletes it
 };
 
 class CEPoll
@@ -109,10 +126,11 @@ public: // for CUDTUnited API
       // Parameters:
       //    0) [in] eid: EPoll ID.
       //    1) [in] u: UDT socket ID.
+      //    2) [in] closing: if the socket is being closed, then the events it has on are still reported once.
       // Returned value:
       //    0 if success, otherwise an error number.
 
-   int remove_usock(const int eid, const UDTSOCKET& u);
+   int remove_usock(const int eid, const UDTSOCKET& u, bool closing = false);
 
       // Functionality:
       //    remove a system socket event from an EPoll; socket will be removed if no events to watch
@@ -138,6 +156,27 @@ public: // for CUDTUnited API
 
    int wait(const int eid, std::set<UDTSOCKET>* readfds, std::set<UDTSOCKET>* writefds, int64_t msTimeOut, std::set<SYSSOCKET>* lrfds, std::set<SYSSOCKET>* lwfds);
 
+      // Functionality:
+      //    wait for EPoll events on UDT sockets or timeout, in the way of the system epoll_wait.
+      // Parameters:
+      //    0) [in] eid: EPoll ID.
+      //    1) [out] events: array for the sockets ready and their events.
+      //    2) [in] maxevents: size of the array.
+      //    3) [in] msTimeOut: timeout threshold, in milliseconds.
+      // Returned value:
+      //    number of sockets ready, 0 if timeout.
+
+   int uwait(const int eid, CEPollEvent* events, int maxevents, int64_t msTimeOut);
+
+      // Functionality:
+      //    get a system descriptor that is readable when the EPoll has UDT sockets to report.
+      // Parameters:
+      //    0) [in] eid: EPoll ID.
+      // Returned value:
+      //    descriptor to watch with the system poll functions; it belongs to the EPoll and must not be read or closed.
+
+   int getfd(const int eid);
+
       // Functionality:
       //    close and release an EPoll.
       // Parameters:
@@ -157,16 +196,39 @@ public: // for CUDT to acknowledge IO status
       //    1) [in] events: Combination of events to update
       //    1) [in] enable: true -> enable, otherwise disable
       // Returned value:
-      //    0 if success, otherwise an error number
+      //    number of EPoll IDs found released and erased from eids.
 
    int update_events(const UDTSOCKET& uid, std::set<int>& eids, int events, bool enable);
 
+      // Functionality:
+      //    Publish the events of a UDT socket, as they are when the EPoll lock is held.
+      // Parameters:
+      //    0) [in] uid: UDT socket ID.
+      //    1) [in] eids: EPoll IDs to be set
+      //    2) [in] events: Combination of events to publish
+      //    3) [in] state: events on, read with the lock held, so that the last of concurrent calls publishes the last state
+      // Returned value:
+      //    number of EPoll IDs found released and erased from eids.
+
+   int publish_events(const UDTSOCKET& uid, std::set<int>& eids, int events, const volatile int32_t& state);
+
 private:
    int m_iIDSeed;                            // seed to generate a new ID
    pthread_mutex_t m_SeedLock;
 
-   std::map<int, CEPollDesc> m_mPolls;       // all epolls
+   std::map<int, CEPollDesc*> m_mPolls;      // all epolls
    pthread_mutex_t m_EPollLock;
+
+private:
+   static bool isReady(const CEPollSock* s);
+   static void pushReady(CEPollDesc* d, CEPollSock* s);
+   static void popReady(CEPollDesc* d, CEPollSock* s);
+   static void setSignal(CEPollDesc* d, bool on);
+   static void freeRemoved(CEPollDesc* d);
+   static void freeDesc(CEPollDesc* d);
+   CEPollDesc* find(const int eid);
+   int setEvents(const UDTSOCKET& uid, std::set<int>& eids, int events, int state);
+   bool waitReady(CEPollDesc* d, int64_t deadline, bool legacy = false, bool locals = false);
 };
 
 
@@ -0,0 +1,638 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2011, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef WIN32
+   #include <arpa/inet.h>
+#else
+   #include <winsock2.h>
+#endif
+#include <cmath>
+#include <cstring>
+#include "common.h"
+#include "fec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+   #define UDT_FEC_SIMD
+   #include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+   // GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+   struct CGFTables
+   {
+      uint8_t m_pExp[512];
+      uint8_t m_pLog[256];
+      uint8_t m_pCoef[CGF256::m_iMaxRows][CGF256::m_iMaxCols];
+      bool m_bSSSE3;
+      bool m_bAVX2;
+
+      CGFTables()
+      {
+         int x = 1;
+         for (int i = 0; i < 255; ++ i)
+         {
+            m_pExp[i] = m_pExp[i + 255] = (uint8_t)x;
+            m_pLog[x] = (uint8_t)i;
+            x <<= 1;
+            if (x & 0x100)
+               x ^= 0x11D;
+         }
+         m_pExp[510] = m_pExp[511] = m_pExp[0];
+         m_pLog[0] = 0;
+
+         // Cauchy matrix 1 / (x_j + y_i) with x_j = 255 - j and y_i = i, column i scaled by x_0 + y_i
+         for (int j = 0; j < CGF256::m_iMaxRows; ++ j)
+            for (int i = 0; i < CGF256::m_iMaxCols; ++ i)
+               m_pCoef[j][i] = div(255 ^ i, (255 - j) ^ i);
+
+         #ifdef UDT_FEC_SIMD
+            __builtin_cpu_init();
+            m_bSSSE3 = __builtin_cpu_supports("ssse3");
+            m_bAVX2 = __builtin_cpu_supports("avx2");
+         #else
+            m_bSSSE3 = m_bAVX2 = false;
+         #endif
+      }
+
+      uint8_t div(uint8_t a, uint8_t b) const
+      {
+         if (0 == a)
+            return 0;
+         return m_pExp[m_pLog[a] + 255 - m_pLog[b]];
+      }
+   };
+
+   const CGFTables s_GF;
+
+   // multiplication tables by c of the low and high 4 bits of a byte, the product is the XOR of the two
+   void splitTables(uint8_t c, uint8_t* lo, uint8_t* hi)
+   {
+      for (int i = 0; i < 16; ++ i)
+      {
+         lo[i] = CGF256::mul(c, (uint8_t)i);
+         hi[i] = CGF256::mul(c, (uint8_t)(i << 4));
+      }
+   }
+
+   #ifdef UDT_FEC_SIMD
+   __attribute__((target("ssse3")))
+   int mulAddSSSE3(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, int len)
+   {
+      __m128i tlo = _mm_loadu_si128((const __m128i*)lo);
+      __m128i thi = _mm_loadu_si128((const __m128i*)hi);
+      __m128i mask = _mm_set1_epi8(0x0F);
+
+      int i = 0;
+      for (; i + 16 <= len; i += 16)
+      {
+         __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+         __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(x, mask));
+         __m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+         __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+         _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+      }
+
+      return i;
+   }
+
+   __attribute__((target("avx2")))
+   int mulAddAVX2(uint8_t* dst, const uint8_t* src, const uint8_t* lo, const uint8_t* hi, int len)
+   {
+      __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+      __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+      __m256i mask = _mm256_set1_epi8(0x0F);
+
+      int i = 0;
+      for (; i + 32 <= len; i += 32)
+      {
+         __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+         __m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(x, mask));
+         __m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+         __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+         _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+      }
+
+      return i;
+   }
+   #endif
+
+   // the control information is converted to network order word by word by the channel, the parity is a byte
+   // string and has to stay as it is on both sides whatever their byte order
+   void convertParity(CPacket& packet, bool sending)
+   {
+      uint32_t* p = (uint32_t*)packet.m_pcData;
+      for (int i = 0, n = packet.getLength() / 4; i < n; ++ i)
+         p[i] = sending ? ntohl(p[i]) : htonl(p[i]);
+   }
+
+   void encodeHeader(char* sym, int32_t msgno, int len)
+   {
+      for (int i = 0; i < 4; ++ i)
+         sym[i] = (char)(msgno >> (i * 8));
+      sym[4] = (char)len;
+      sym[5] = (char)(len >> 8);
+   }
+
+   void decodeHeader(const char* sym, int32_t& msgno, int& len)
+   {
+      const uint8_t* p = (const uint8_t*)sym;
+      msgno = (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+      len = p[4] | (p[5] << 8);
+   }
+}
+
+uint8_t CGF256::mul(uint8_t a, uint8_t b)
+{
+   if ((0 == a) || (0 == b))
+      return 0;
+   return s_GF.m_pExp[s_GF.m_pLog[a] + s_GF.m_pLog[b]];
+}
+
+uint8_t CGF256::inv(uint8_t a)
+{
+   return s_GF.m_pExp[255 - s_GF.m_pLog[a]];
+}
+
+uint8_t CGF256::coef(int row, int col)
+{
+   return s_GF.m_pCoef[row][col];
+}
+
+void CGF256::mulAdd(char* dst, const char* src, uint8_t c, int len)
+{
+   uint8_t* d = (uint8_t*)dst;
+   const uint8_t* s = (const uint8_t*)src;
+
+   if (0 == c)
+      return;
+
+   int i = 0;
+
+   if (1 == c)
+   {
+      for (; i + 8 <= len; i += 8)
+      {
+         uint64_t x, y;
+         memcpy(&x, s + i, 8);
+         memcpy(&y, d + i, 8);
+         y ^= x;
+         memcpy(d + i, &y, 8);
+      }
+      for (; i < len; ++ i)
+         d[i] ^= s[i];
+      return;
+   }
+
+   uint8_t lo[16], hi[16];
+   splitTables(c, lo, hi);
+
+   #ifdef UDT_FEC_SIMD
+      if (s_GF.m_bAVX2)
+         i = mulAddAVX2(d, s, lo, hi, len);
+      else if (s_GF.m_bSSSE3)
+         i = mulAddSSSE3(d, s, lo, hi, len);
+   #endif
+
+   for (; i < len; ++ i)
+      d[i] ^= lo[s[i] & 0x0F] ^ hi[s[i] >> 4];
+}
+
+bool CGF256::invert(uint8_t* m, int n)
+{
+   uint8_t a[m_iMaxRows * m_iMaxRows * 2];
+   int w = n * 2;
+
+   for (int r = 0; r < n; ++ r)
+      for (int c = 0; c < n; ++ c)
+      {
+         a[r * w + c] = m[r * n + c];
+         a[r * w + n + c] = (r == c) ? 1 : 0;
+      }
+
+   // Gauss-Jordan elimination
+   for (int c = 0; c < n; ++ c)
+   {
+      int p = c;
+      while ((p < n) && (0 == a[p * w + c]))
+         ++ p;
+      if (p == n)
+         return false;
+
+      if (p != c)
+         for (int k = 0; k < w; ++ k)
+         {
+            uint8_t t = a[p * w + k];
+            a[p * w + k] = a[c * w + k];
+            a[c * w + k] = t;
+         }
+
+      uint8_t f = inv(a[c * w + c]);
+      for (int k = 0; k < w; ++ k)
+         a[c * w + k] = mul(a[c * w + k], f);
+
+      for (int r = 0; r < n; ++ r)
+      {
+         if ((r == c) || (0 == a[r * w + c]))
+            continue;
+         uint8_t g = a[r * w + c];
+         for (int k = 0; k < w; ++ k)
+            a[r * w + k] ^= mul(a[c * w + k], g);
+      }
+   }
+
+   for (int r = 0; r < n; ++ r)
+      for (int c = 0; c < n; ++ c)
+         m[r * n + c] = a[r * w + n + c];
+
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int CSndFEC::m_iHdrSize = 8;
+
+CSndFEC::CSndFEC(int payloadsize, int groupsize, int maxparity):
+m_pcParity(NULL),
+m_iPayloadSize(payloadsize),
+m_iGroupSize(groupsize),
+m_iMaxParity(maxparity),
+m_iParityNum(1),
+m_iBase(0),
+m_iCount(0),
+m_iLength(0),
+m_iGroupParity(0),
+m_iNextParity(-1),
+m_ullGroupTime(0)
+{
+   m_pcParity = new char [m_iMaxParity * (m_iHdrSize + m_iPayloadSize)];
+}
+
+CSndFEC::~CSndFEC()
+{
+   delete [] m_pcParity;
+}
+
+void CSndFEC::setLossRate(int rate)
+{
+   // the fewest parity packets that leave less than 1% of the groups with more losses than they can repair
+   double p = rate / 1000000.0;
+   if (p > 0.5)
+      p = 0.5;
+
+   int num = 1;
+   for (; num < m_iMaxParity; ++ num)
+   {
+      int n = m_iGroupSize + num;
+
+      // P(X <= num) for X ~ B(n, p)
+      double term = pow(1 - p, n);
+      double cdf = term;
+      for (int k = 1; k <= num; ++ k)
+      {
+         term *= (n - k + 1) * p / (k * (1 - p));
+         cdf += term;
+      }
+
+      if (1 - cdf < 0.01)
+         break;
+   }
+
+   m_iParityNum = num;
+}
+
+void CSndFEC::addData(int32_t seqno, int32_t msgno, const char* data, int len)
+{
+   // a packet sent while the parity of the last group is still going out is not protected
+   if ((m_iCount > 0) && (m_iNextParity >= 0))
+      return;
+
+   // a group only holds consecutive packets
+   if ((m_iCount > 0) && (seqno != CSeqNo::incseq(m_iBase, m_iCount)))
+      m_iCount = 0;
+
+   if (0 == m_iCount)
+   {
+      m_iBase = seqno;
+      m_iLength = 0;
+      m_iGroupParity = m_iParityNum;
+      m_iNextParity = -1;
+      m_ullGroupTime = CTimer::getTime();
+   }
+
+   char hdr[6];
+   encodeHeader(hdr, msgno, len);
+
+   for (int j = 0; j < m_iGroupParity; ++ j)
+   {
+      char* p = m_pcParity + j * (m_iHdrSize + m_iPayloadSize) + 2;
+
+      // what the longer packet adds to the group starts from zero
+      if (0 == m_iCount)
+         memset(p, 0, 6 + len);
+      else if (len > m_iLength)
+         memset(p + 6 + m_iLength, 0, len - m_iLength);
+
+      uint8_t c = CGF256::coef(j, m_iCount);
+      CGF256::mulAdd(p, hdr, c, 6);
+      CGF256::mulAdd(p + 6, data, c, len);
+   }
+
+   if (len > m_iLength)
+      m_iLength = len;
+
+   if (++ m_iCount == m_iGroupSize)
+      m_iNextParity = 0;
+}
+
+void CSndFEC::close()
+{
+   if ((m_iCount > 0) && (m_iNextParity < 0))
+      m_iNextParity = 0;
+}
+
+int CSndFEC::packParity(CPacket& packet)
+{
+   if ((0 == m_iCount) || (m_iNextParity < 0))
+      return 0;
+
+   char* p = m_pcParity + m_iNextParity * (m_iHdrSize + m_iPayloadSize);
+   p[0] = (char)m_iCount;
+   p[1] = (char)m_iGroupParity;
+
+   int32_t info[2];
+   info[0] = m_iBase;
+   info[1] = m_iNextParity;
+   int size = m_iHdrSize + m_iLength;
+   packet.pack(9, info, p, size);
+   convertParity(packet, true);
+
+   if (++ m_iNextParity == m_iGroupParity)
+      m_iCount = 0;
+
+   return size;
+}
+
+uint64_t CSndFEC::getGroupTime() const
+{
+   return ((m_iCount > 0) && (m_iNextParity < 0)) ? m_ullGroupTime : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+CRcvFEC::CRcvFEC(int payloadsize, int groupsize):
+m_pcData(NULL),
+m_piSeqNo(NULL),
+m_piLength(NULL),
+m_iSize(16),
+m_iSlotSize(6 + payloadsize),
+m_pcParity(NULL),
+m_piParityBase(NULL),
+m_piParityCount(NULL),
+m_piParityIndex(NULL),
+m_piParityLength(NULL),
+m_iParitySize(CGF256::m_iMaxRows),
+m_iParityPtr(0),
+m_pcScratch(NULL),
+m_iPayloadSize(payloadsize)
+{
+   // the packets of a group stay until its parity arrives, right after the group
+   if (groupsize > CGF256::m_iMaxCols)
+      groupsize = CGF256::m_iMaxCols;
+   while (m_iSize < groupsize * 2)
+      m_iSize <<= 1;
+
+   m_pcData = new char [m_iSize * m_iSlotSize];
+   m_piSeqNo = new int32_t [m_iSize];
+   m_piLength = new int [m_iSize];
+   for (int i = 0; i < m_iSize; ++ i)
+      m_piSeqNo[i] = -1;
+
+   m_pcParity = new char [m_iParitySize * m_iSlotSize];
+   m_piParityBase = new int32_t [m_iParitySize];
+   m_piParityCount = new int [m_iParitySize];
+   m_piParityIndex = new int [m_iParitySize];
+   m_piParityLength = new int [m_iParitySize];
+   for (int i = 0; i < m_iParitySize; ++ i)
+      m_piParityBase[i] = -1;
+
+   m_pcScratch = new char [CGF256::m_iMaxRows * m_iSlotSize];
+}
+
+CRcvFEC::~CRcvFEC()
+{
+   delete [] m_pcData;
+   delete [] m_piSeqNo;
+   delete [] m_piLength;
+   delete [] m_pcParity;
+   delete [] m_piParityBase;
+   delete [] m_piParityCount;
+   delete [] m_piParityIndex;
+   delete [] m_piParityLength;
+   delete [] m_pcScratch;
+}
+
+void CRcvFEC::addData(int32_t seqno, int32_t msgno, const char* data, int len)
+{
+   int pos = seqno & (m_iSize - 1);
+
+   // a late copy does not replace a newer packet still needed by its group
+   if ((m_piSeqNo[pos] >= 0) && (CSeqNo::seqcmp(m_piSeqNo[pos], seqno) > 0))
+      return;
+
+   char* p = m_pcData + pos * m_iSlotSize;
+   encodeHeader(p, msgno, len);
+   memcpy(p + 6, data, len);
+   m_piSeqNo[pos] = seqno;
+   m_piLength[pos] = len;
+}
+
+int CRcvFEC::addParity(CPacket& packet, int32_t& base, int& count)
+{
+   convertParity(packet, false);
+
+   int size = packet.getLength() - CSndFEC::m_iHdrSize;
+   const uint8_t* p = (const uint8_t*)packet.m_pcData;
+   base = packet.getAckSeqNo();
+   count = p[0];
+   int num = p[1];
+   int index = packet.getExtendedType();
+
+   if ((size < 0) || (size > m_iPayloadSize) || (base < 0) || (count < 1) || (count > CGF256::m_iMaxCols)
+      || (count > m_iSize / 2) || (num < 1) || (num > CGF256::m_iMaxRows) || (index >= num))
+      return -1;
+
+   // data packets not kept are the ones to rebuild
+   int unknown[CGF256::m_iMaxCols];
+   int missing = 0;
+   for (int i = 0; i < count; ++ i)
+   {
+      int32_t seqno = CSeqNo::incseq(base, i);
+      int32_t held = m_piSeqNo[seqno & (m_iSize - 1)];
+      if (held == seqno)
+         continue;
+
+      // the slot has moved on to a later packet, the group is too old
+      if ((held >= 0) && (CSeqNo::seqcmp(held, seqno) > 0))
+         return 0;
+
+      unknown[missing ++] = i;
+   }
+
+   // keep the parity packet with the others of its group, unless it is a duplicate
+   int found = 0;
+   for (int i = 0; i < m_iParitySize; ++ i)
+   {
+      if ((m_piParityBase[i] != base) || (m_piParityCount[i] != count))
+         continue;
+
+      if (m_piParityIndex[i] == index)
+         return 0;
+
+      if (0 == missing)
+         m_piParityBase[i] = -1;
+      else
+         ++ found;
+   }
+
+   if (0 == missing)
+      return 0;
+
+   int slot = m_iParityPtr;
+   m_iParityPtr = (m_iParityPtr + 1) % m_iParitySize;
+   m_piParityBase[slot] = base;
+   m_piParityCount[slot] = count;
+   m_piParityIndex[slot] = index;
+   m_piParityLength[slot] = 6 + size;
+   memcpy(m_pcParity + slot * m_iSlotSize, p + 2, 6 + size);
+
+   if (found + 1 < missing)
+      return 0;
+
+   return decode(base, count, unknown, missing);
+}
+
+bool CRcvFEC::getData(int32_t seqno, int32_t& msgno, const char*& data, int& len) const
+{
+   int pos = seqno & (m_iSize - 1);
+   if (m_piSeqNo[pos] != seqno)
+      return false;
+
+   int size;
+   decodeHeader(m_pcData + pos * m_iSlotSize, msgno, size);
+   data = m_pcData + pos * m_iSlotSize + 6;
+   len = m_piLength[pos];
+
+   return true;
+}
+
+int CRcvFEC::decode(int32_t base, int count, const int* unknown, int num)
+{
+   // take "num" parity packets of the group
+   int slot[CGF256::m_iMaxRows];
+   int n = 0;
+   int len = m_iSlotSize;
+   for (int i = 0; (i < m_iParitySize) && (n < num); ++ i)
+   {
+      if ((m_piParityBase[i] != base) || (m_piParityCount[i] != count))
+         continue;
+
+      slot[n ++] = i;
+      if (m_piParityLength[i] < len)
+         len = m_piParityLength[i];
+   }
+
+   uint8_t m[CGF256::m_iMaxRows * CGF256::m_iMaxRows];
+   for (int a = 0; a < num; ++ a)
+      for (int b = 0; b < num; ++ b)
+         m[a * num + b] = CGF256::coef(m_piParityIndex[slot[a]], unknown[b]);
+
+   bool solvable = CGF256::invert(m, num);
+
+   // the parity of the missing packets: each parity packet less the known packets it covers
+   for (int a = 0; solvable && (a < num); ++ a)
+   {
+      char* s = m_pcScratch + a * m_iSlotSize;
+      memcpy(s, m_pcParity + slot[a] * m_iSlotSize, len);
+
+      for (int i = 0, u = 0; i < count; ++ i)
+      {
+         if ((u < num) && (unknown[u] == i))
+         {
+            ++ u;
+            continue;
+         }
+
+         int pos = CSeqNo::incseq(base, i) & (m_iSize - 1);
+         int size = 6 + m_piLength[pos];
+         CGF256::mulAdd(s, m_pcData + pos * m_iSlotSize, CGF256::coef(m_piParityIndex[slot[a]], i), (size < len) ? size : len);
+      }
+   }
+
+   for (int a = 0; a < num; ++ a)
+      m_piParityBase[slot[a]] = -1;
+
+   if (!solvable)
+      return 0;
+
+   int recovered = 0;
+   for (int b = 0; b < num; ++ b)
+   {
+      int32_t seqno = CSeqNo::incseq(base, unknown[b]);
+      int pos = seqno & (m_iSize - 1);
+      char* d = m_pcData + pos * m_iSlotSize;
+
+      memset(d, 0, len);
+      for (int a = 0; a < num; ++ a)
+         CGF256::mulAdd(d, m_pcScratch + a * m_iSlotSize, m[b * num + a], len);
+
+      int32_t msgno;
+      int size;
+      decodeHeader(d, msgno, size);
+      if (size + 6 > len)
+      {
+         m_piSeqNo[pos] = -1;
+         continue;
+      }
+
+      m_piSeqNo[pos] = seqno;
+      m_piLength[pos] = size;
+      ++ recovered;
+   }
+
+   return recovered;
+}
@@ -0,0 +1,260 @@
+/*****************************************************************************
+Copyright (c) 2001 - 2011, The Board of Trustees of the University of Illinois.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above
+  copyright notice, this list of conditions and the
+  following disclaimer.
+
+* Redistributions in binary form must reproduce the
+  above copyright notice, this list of conditions
+  and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the University of Illinois
+  nor the names of its contributors may be used to
+  endorse or promote products derived from this
+  software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*****************************************************************************/
+
+#ifndef __UDT_FEC_H__
+#define __UDT_FEC_H__
+
+
+#include "udt.h"
+#include "packet.h"
+
+
+// Arithmetic in GF(2^8) and the coefficients of the FEC code.
+// Parity packet j of a group is the sum of coef(j, i) * data packet i. The coefficients are a Cauchy matrix
+// with its columns scaled so that row 0 is all ones: a single parity packet is the plain XOR of the group,
+// and any k of the k data and m parity packets are enough to rebuild the group.
+
+class CGF256
+{
+public:
+   static const int m_iMaxRows = 16;    // largest number of parity packets per group
+   static const int m_iMaxCols = 64;    // largest number of data packets per group
+
+      // Functionality:
+      //    Multiply two elements.
+      // Parameters:
+      //    0) [in] a: the first element.
+      //    1) [in] b: the second element.
+      // Returned value:
+      //    a * b.
+
+   static uint8_t mul(uint8_t a, uint8_t b);
+
+      // Functionality:
+      //    Invert a non-zero element.
+      // Parameters:
+      //    0) [in] a: the element.
+      // Returned value:
+      //    1 / a.
+
+   static uint8_t inv(uint8_t a);
+
+      // Functionality:
+      //    Read a coefficient of the code.
+      // Parameters:
+      //    0) [in] row: index of the parity packet.
+      //    1) [in] col: index of the data packet in the group.
+      // Returned value:
+      //    the coefficient.
+
+   static uint8_t coef(int row, int col);
+
+      // Functionality:
+      //    Add a multiple of a block to another one, with SSSE3 or AVX2 when the CPU has it.
+      // Parameters:
+      //    0) [in, out] dst: the block added to.
+      //    1) [in] src: the block added.
+      //    2) [in] c: the multiplier.
+      //    3) [in] len: size of the blocks.
+      // Returned value:
+      //    None.
+
+   static void mulAdd(char* dst, const char* src, uint8_t c, int len);
+
+      // Functionality:
+      //    Invert a square matrix.
+      // Parameters:
+      //    0) [in, out] m: the matrix, row by row, replaced by its inverse.
+      //    1) [in] n: number of rows.
+      // Returned value:
+      //    false if the matrix is singular, true otherwise.
+
+   static bool invert(uint8_t* m, int n);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Parity packet: a control packet of type 9, the reserved field holds the index of the parity packet in its group
+// and the additional info the first sequence number of the group. The control information starts with the number
+// of data packets in the group and the number of parity packets of the group, one byte each, followed by the coded
+// message number (4 bytes), payload size (2 bytes) and payload of the data packets, the shorter ones padded with zeros.
+
+class CSndFEC
+{
+public:
+   CSndFEC(int payloadsize, int groupsize, int maxparity);
+   ~CSndFEC();
+
+   static const int m_iHdrSize;                 // size of the parity header, the data payload is reduced by it
+
+      // Functionality:
+      //    Choose the number of parity packets of the next groups from the loss rate seen by the receiver.
+      // Parameters:
+      //    0) [in] rate: loss rate, in packets per million.
+      // Returned value:
+      //    None.
+
+   void setLossRate(int rate);
+
+      // Functionality:
+      //    Add a new data packet to the open group, the group is closed when it is full. The packet is left
+      //    out if the parity of the closed group has not all been sent.
+      // Parameters:
+      //    0) [in] seqno: sequence number of the packet.
+      //    1) [in] msgno: message number field of the packet.
+      //    2) [in] data: payload of the packet.
+      //    3) [in] len: size of the payload.
+      // Returned value:
+      //    None.
+
+   void addData(int32_t seqno, int32_t msgno, const char* data, int len);
+
+      // Functionality:
+      //    Close the open group before it is full, so that its parity packets are sent.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    None.
+
+   void close();
+
+      // Functionality:
+      //    Pack the next parity packet of the closed group.
+      // Parameters:
+      //    0) [out] packet: the parity packet.
+      // Returned value:
+      //    size of the control information, 0 if there is no parity packet to send.
+
+   int packParity(CPacket& packet);
+
+      // Functionality:
+      //    Read the time when the first packet of the open group was added.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    the time in microseconds, 0 if no group is open.
+
+   uint64_t getGroupTime() const;
+
+private:
+   char* m_pcParity;            // parity packets of the current group, m_iMaxParity buffers of m_iHdrSize + m_iPayloadSize
+   int m_iPayloadSize;          // largest data payload
+   int m_iGroupSize;            // number of data packets in a full group
+   int m_iMaxParity;            // largest number of parity packets per group
+   int m_iParityNum;            // number of parity packets of the next group
+
+   int32_t m_iBase;             // first sequence number of the current group
+   int m_iCount;                // number of data packets in the current group
+   int m_iLength;               // largest payload in the current group
+   int m_iGroupParity;          // number of parity packets of the current group
+   int m_iNextParity;           // next parity packet to send, -1 while the group is open
+   uint64_t m_ullGroupTime;     // time when the current group was opened
+
+private:
+   CSndFEC(const CSndFEC&);
+   CSndFEC& operator=(const CSndFEC&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class CRcvFEC
+{
+public:
+   CRcvFEC(int payloadsize, int groupsize);
+   ~CRcvFEC();
+
+      // Functionality:
+      //    Keep a copy of a received data packet until its group is complete.
+      // Parameters:
+      //    0) [in] seqno: sequence number of the packet.
+      //    1) [in] msgno: message number field of the packet.
+      //    2) [in] data: payload of the packet.
+      //    3) [in] len: size of the payload.
+      // Returned value:
+      //    None.
+
+   void addData(int32_t seqno, int32_t msgno, const char* data, int len);
+
+      // Functionality:
+      //    Take a parity packet and rebuild the missing data packets of its group if enough parity has arrived.
+      // Parameters:
+      //    0) [in] packet: the parity packet.
+      //    1) [out] base: first sequence number of the group.
+      //    2) [out] count: number of data packets in the group.
+      // Returned value:
+      //    number of data packets rebuilt, -1 if the parity packet is invalid.
+
+   int addParity(CPacket& packet, int32_t& base, int& count);
+
+      // Functionality:
+      //    Read a data packet kept or rebuilt.
+      // Parameters:
+      //    0) [in] seqno: sequence number of the packet.
+      //    1) [out] msgno: message number field of the packet.
+      //    2) [out] data: payload of the packet.
+      //    3) [out] len: size of the payload.
+      // Returned value:
+      //    true if the packet is there, false otherwise.
+
+   bool getData(int32_t seqno, int32_t& msgno, const char*& data, int& len) const;
+
+private:
+   int decode(int32_t base, int count, const int* unknown, int num);
+
+private:
+   char* m_pcData;              // coded form (message number, size, payload) of the recent data packets, by sequence number
+   int32_t* m_piSeqNo;          // sequence number held by each slot of m_pcData, -1 if none
+   int* m_piLength;             // payload size held by each slot of m_pcData
+   int m_iSize;                 // number of slots, a power of 2
+   int m_iSlotSize;             // size of a slot
+
+   char* m_pcParity;            // parity packets waiting for their group to be decodable
+   int32_t* m_piParityBase;     // first sequence number of the group of each parity slot, -1 if none
+   int* m_piParityCount;        // number of data packets in the group of each parity slot
+   int* m_piParityIndex;        // index of the parity packet in its group
+   int* m_piParityLength;       // size of the coded part of each parity slot
+   int m_iParitySize;           // number of parity slots
+   int m_iParityPtr;            // next parity slot to reuse
+
+   char* m_pcScratch;           // one buffer per parity packet used by the decoder
+   int m_iPayloadSize;          // largest data payload
+
+private:
+   CRcvFEC(const CRcvFEC&);
+   CRcvFEC& operator=(const CRcvFEC&);
+};
+
+
+#endif
@@ -40,667 +40,535 @@ written by
 
 #include "list.h"
 
-CSndLossList::CSndLossList(int size):
-m_piData1(NULL),
-m_piData2(NULL),
-m_piNext(NULL),
-m_iHead(-1),
-m_iLength(0),
-m_iSize(size),
-m_iLastInsertPos(-1),
-m_ListLock()
+// bit helpers for the 64-bit words of the bitmaps
+static inline int bitcount(uint64_t x)
 {
-   m_piData1 = new int32_t [m_iSize];
-   m_piData2 = new int32_t [m_iSize];
-   m_piNext = new int [m_iSize];
-
-   // -1 means there is no data in the node
-   for (int i = 0; i < size; ++ i)
-   {
-      m_piData1[i] = -1;
-      m_piData2[i] = -1;
-   }
-
-   // sender list needs mutex protection
-   #ifndef WIN32
-      pthread_mutex_init(&m_ListLock, 0);
+   #ifdef __GNUC__
+      return __builtin_popcountll(x);
    #else
-      m_ListLock = CreateMutex(NULL, false, NULL);
+      int n = 0;
+      for (; 0 != x; x &= x - 1)
+         ++ n;
+      return n;
    #endif
 }
 
-CSndLossList::~CSndLossList()
+static inline int lowbit(uint64_t x)
 {
-   delete [] m_piData1;
-   delete [] m_piData2;
-   delete [] m_piNext;
+   #ifdef __GNUC__
+      return __builtin_ctzll(x);
+   #else
+      int n = 0;
+      for (; 0 == (x & 0xFFFFFFFFULL); x >>= 32)
+         n += 32;
+      for (; 0 == (x & 1); x >>= 1)
+         ++ n;
+      return n;
+   #endif
+}
 
-   #ifndef WIN32
-      pthread_mutex_destroy(&m_ListLock);
+static inline int highbit(uint64_t x)
+{
+   #ifdef __GNUC__
+      return 63 - __builtin_clzll(x);
    #else
-      CloseHandle(m_ListLock);
+      int n = 63;
+      for (; 0 == (x & 0xFFFFFFFF00000000ULL); x <<= 32)
+         n -= 32;
+      for (; 0 == (x & 0x8000000000000000ULL); x <<= 1)
+         -- n;
+      return n;
    #endif
 }
 
-// [sq1, sq2]뵽list
-int CSndLossList::insert(int32_t seqno1, int32_t seqno2)
+CSeqBitmap::CSeqBitmap(int size):
+m_pBits(NULL),
+m_iSize(64),
+m_iHead(-1),
+m_iTail(-1),
+m_iLength(0)
 {
-   CGuard listguard(m_ListLock);
+   // a power of 2 divides the seq. no. space, so the bit position of a seq. no. does not change when it wraps
+   while (m_iSize < size)
+      m_iSize <<= 1;
 
-   if (0 == m_iLength)
-   {
-      // insert data into an empty list
+   m_pBits = new uint64_t [m_iSize / 64];
+   for (int i = 0; i < m_iSize / 64; ++ i)
+      m_pBits[i] = 0;
+}
 
-      m_iHead = 0;
-      m_piData1[m_iHead] = seqno1;
-      if (seqno2 != seqno1)
-         m_piData2[m_iHead] = seqno2;
+CSeqBitmap::~CSeqBitmap()
+{
+   delete [] m_pBits;
+}
+
+int CSeqBitmap::insert(int32_t seqno1, int32_t seqno2)
+{
+   if ((seqno1 == seqno2) && (m_iLength > 0) && (CSeqNo::seqcmp(seqno1, m_iHead) > 0) && (CSeqNo::seqlen(m_iHead, seqno1) <= m_iSize))
+   {
+      // most insertions are single packets after the head, which always fit
+      int pos = seqno1 & (m_iSize - 1);
+      uint64_t bit = 1ULL << (pos & 63);
+      if (0 != (m_pBits[pos >> 6] & bit))
+         return 0;
 
-      m_piNext[m_iHead] = -1;
-      m_iLastInsertPos = m_iHead;
+      m_pBits[pos >> 6] |= bit;
+      if (CSeqNo::seqcmp(seqno1, m_iTail) > 0)
+         m_iTail = seqno1;
+      ++ m_iLength;
 
-      m_iLength += CSeqNo::seqlen(seqno1, seqno2);
+      return 1;
+   }
 
-      return m_iLength;
+   if (CSeqNo::seqcmp(seqno1, seqno2) > 0)
+      return 0;
+
+   // the bitmap grows to hold the new seq. no. together with the existing ones, e.g., when a loss report reaches
+   // further than the flow window; it stops at the threshold of comparing seq. no., beyond which what does not fit
+   // is ignored
+   int32_t lo = ((m_iLength > 0) && (CSeqNo::seqcmp(m_iHead, seqno1) < 0)) ? m_iHead : seqno1;
+   int32_t hi = ((m_iLength > 0) && (CSeqNo::seqcmp(m_iTail, seqno2) > 0)) ? m_iTail : seqno2;
+   int span = CSeqNo::seqlen(lo, hi);
+   if (span > m_iSize)
+      grow((span < CSeqNo::m_iSeqNoTH) ? span : CSeqNo::m_iSeqNoTH);
+
+   // the window of seq. no. that can be tracked together with the existing ones
+   int32_t first = seqno1;
+   if (m_iLength > 0)
+   {
+      if (CSeqNo::seqcmp(seqno1, m_iHead) >= 0)
+         first = m_iHead;
+      else if (CSeqNo::seqlen(seqno1, m_iTail) > m_iSize)
+         first = CSeqNo::incseq(seqno1, CSeqNo::seqlen(seqno1, m_iTail) - m_iSize);
    }
+   int32_t last = CSeqNo::incseq(first, m_iSize - 1);
 
-   // otherwise find the position where the data can be inserted
-   int origlen = m_iLength;
-   int offset = CSeqNo::seqoff(m_piData1[m_iHead], seqno1);
-   int loc = (m_iHead + offset + m_iSize) % m_iSize;
+   if (CSeqNo::seqcmp(seqno1, first) < 0)
+      seqno1 = first;
+   if (CSeqNo::seqcmp(seqno2, last) > 0)
+      seqno2 = last;
+   if (CSeqNo::seqcmp(seqno1, seqno2) > 0)
+      return 0;
 
-   if (offset < 0)
-   {
-      // Insert data prior to the head pointer
+   int num = update(seqno1, CSeqNo::seqlen(seqno1, seqno2), true);
 
-      m_piData1[loc] = seqno1;
-      if (seqno2 != seqno1)
-         m_piData2[loc] = seqno2;
+   if ((0 == m_iLength) || (CSeqNo::seqcmp(seqno1, m_iHead) < 0))
+      m_iHead = seqno1;
+   if ((0 == m_iLength) || (CSeqNo::seqcmp(seqno2, m_iTail) > 0))
+      m_iTail = seqno2;
+   m_iLength += num;
 
-      // new node becomes head
-      m_piNext[loc] = m_iHead;
-      m_iHead = loc;
-      m_iLastInsertPos = loc;
+   return num;
+}
 
-      m_iLength += CSeqNo::seqlen(seqno1, seqno2);
-   }
-   else if (offset > 0)
+int CSeqBitmap::remove(int32_t seqno1, int32_t seqno2)
+{
+   if (0 == m_iLength)
+      return 0;
+
+   int num;
+
+   if (seqno1 == seqno2)
    {
-      if (seqno1 == m_piData1[loc])
-      {
-         m_iLastInsertPos = loc;
-
-         // first seqno is equivlent, compare the second
-         if (-1 == m_piData2[loc])
-         {
-            if (seqno2 != seqno1)
-            {
-               m_iLength += CSeqNo::seqlen(seqno1, seqno2) - 1;
-               m_piData2[loc] = seqno2;
-            }
-         }
-         else if (CSeqNo::seqcmp(seqno2, m_piData2[loc]) > 0)
-         {
-            // new seq pair is longer than old pair, e.g., insert [3, 7] to [3, 5], becomes [3, 7]
-            m_iLength += CSeqNo::seqlen(m_piData2[loc], seqno2) - 1;
-            m_piData2[loc] = seqno2;
-         }
-         else
-            // Do nothing if it is already there
-            return 0;
-      }
-      else
-      {
-         // searching the prior node
-         int i;
-         if ((-1 != m_iLastInsertPos) && (CSeqNo::seqcmp(m_piData1[m_iLastInsertPos], seqno1) < 0))
-            i = m_iLastInsertPos;
-         else
-            i = m_iHead;
-
-         while ((-1 != m_piNext[i]) && (CSeqNo::seqcmp(m_piData1[m_piNext[i]], seqno1) < 0))
-            i = m_piNext[i];
-
-         if ((-1 == m_piData2[i]) || (CSeqNo::seqcmp(m_piData2[i], seqno1) < 0))
-         {
-            m_iLastInsertPos = loc;
-
-            // no overlap, create new node
-            m_piData1[loc] = seqno1;
-            if (seqno2 != seqno1)
-               m_piData2[loc] = seqno2;
-
-            m_piNext[loc] = m_piNext[i];
-            m_piNext[i] = loc;
-
-            m_iLength += CSeqNo::seqlen(seqno1, seqno2);
-         }
-         else
-         {
-            m_iLastInsertPos = i;
-
-            // overlap, coalesce with prior node, insert(3, 7) to [2, 5], ... becomes [2, 7]
-            if (CSeqNo::seqcmp(m_piData2[i], seqno2) < 0)
-            {
-               m_iLength += CSeqNo::seqlen(m_piData2[i], seqno2) - 1;
-               m_piData2[i] = seqno2;
-
-               loc = i;
-            }
-            else
-               return 0;
-         }
-      }
+      // most removals are single packets, and most of them were never lost; a seq. no. out of the marked ones
+      // may share its bit with one of them
+      int pos = seqno1 & (m_iSize - 1);
+      uint64_t bit = 1ULL << (pos & 63);
+      if ((0 == (m_pBits[pos >> 6] & bit)) || (CSeqNo::seqcmp(seqno1, m_iHead) < 0) || (CSeqNo::seqcmp(seqno1, m_iTail) > 0))
+         return 0;
+
+      m_pBits[pos >> 6] &= ~bit;
+      num = 1;
    }
    else
    {
-      m_iLastInsertPos = m_iHead;
-
-      // insert to head node
-      if (seqno2 != seqno1)
-      {
-         if (-1 == m_piData2[loc])
-         {
-            m_iLength += CSeqNo::seqlen(seqno1, seqno2) - 1;
-            m_piData2[loc] = seqno2;
-         }
-         else if (CSeqNo::seqcmp(seqno2, m_piData2[loc]) > 0)
-         {
-            m_iLength += CSeqNo::seqlen(m_piData2[loc], seqno2) - 1;
-            m_piData2[loc] = seqno2;
-         }
-         else 
-            return 0;
-      }
-      else
+      if (CSeqNo::seqcmp(seqno1, m_iHead) < 0)
+         seqno1 = m_iHead;
+      if (CSeqNo::seqcmp(seqno2, m_iTail) > 0)
+         seqno2 = m_iTail;
+      if (CSeqNo::seqcmp(seqno1, seqno2) > 0)
          return 0;
+
+      num = update(seqno1, CSeqNo::seqlen(seqno1, seqno2), false);
    }
 
-   // coalesce with next node. E.g., [3, 7], ..., [6, 9] becomes [3, 9] 
-   while ((-1 != m_piNext[loc]) && (-1 != m_piData2[loc]))
+   m_iLength -= num;
+
+   if (0 == m_iLength)
    {
-      int i = m_piNext[loc];
+      m_iHead = m_iTail = -1;
+      return num;
+   }
 
-      if (CSeqNo::seqcmp(m_piData1[i], CSeqNo::incseq(m_piData2[loc])) <= 0)
-      {
-         // coalesce if there is overlap
-         if (-1 != m_piData2[i])
-         {
-            if (CSeqNo::seqcmp(m_piData2[i], m_piData2[loc]) > 0)
-            {
-               if (CSeqNo::seqcmp(m_piData2[loc], m_piData1[i]) >= 0)
-                  m_iLength -= CSeqNo::seqlen(m_piData1[i], m_piData2[loc]);
-
-               m_piData2[loc] = m_piData2[i];
-            }
-            else
-               m_iLength -= CSeqNo::seqlen(m_piData1[i], m_piData2[i]);
-         }
-         else
-         {
-            if (m_piData1[i] == CSeqNo::incseq(m_piData2[loc]))
-               m_piData2[loc] = m_piData1[i];
-            else
-               m_iLength --;
-         }
-
-         m_piData1[i] = -1;
-         m_piData2[i] = -1;
-         m_piNext[loc] = m_piNext[i];
-      }
-      else
-         break;
+   // the remaining marks are between the old head and tail, so the scans always find one
+   if (seqno1 == m_iHead)
+   {
+      int32_t next = CSeqNo::incseq(seqno2);
+      m_iHead = CSeqNo::incseq(next, scan(next, CSeqNo::seqlen(next, m_iTail), true));
+   }
+   if (seqno2 == m_iTail)
+   {
+      int32_t prev = CSeqNo::decseq(seqno1);
+      int len = CSeqNo::seqlen(m_iHead, prev);
+      m_iTail = CSeqNo::incseq(m_iHead, len - 1 - scanBack(prev, len));
    }
 
-   return m_iLength - origlen;
+   return num;
 }
 
-void CSndLossList::remove(int32_t seqno)
+bool CSeqBitmap::find(int32_t seqno1, int32_t seqno2) const
 {
-   CGuard listguard(m_ListLock);
-
    if (0 == m_iLength)
-      return;
-
-   // Remove all from the head pointer to a node with a larger seq. no. or the list is empty
-   int offset = CSeqNo::seqoff(m_piData1[m_iHead], seqno);
-   int loc = (m_iHead + offset + m_iSize) % m_iSize;
+      return false;
 
-   if (0 == offset)
-   {
-      // It is the head. Remove the head and point to the next node
-      loc = (loc + 1) % m_iSize;
+   if (CSeqNo::seqcmp(seqno1, m_iHead) < 0)
+      seqno1 = m_iHead;
+   if (CSeqNo::seqcmp(seqno2, m_iTail) > 0)
+      seqno2 = m_iTail;
+   if (CSeqNo::seqcmp(seqno1, seqno2) > 0)
+      return false;
 
-      if (-1 == m_piData2[m_iHead])
-         loc = m_piNext[m_iHead];
-      else
-      {
-         m_piData1[loc] = CSeqNo::incseq(seqno);
-         if (CSeqNo::seqcmp(m_piData2[m_iHead], CSeqNo::incseq(seqno)) > 0)
-            m_piData2[loc] = m_piData2[m_iHead];
+   return scan(seqno1, CSeqNo::seqlen(seqno1, seqno2), true) >= 0;
+}
 
-         m_piData2[m_iHead] = -1;
+// a run of more than one seq. no. is sent as the first one with the highest bit set, followed by the last one
+static inline void encodeRun(int32_t* array, int& len, int32_t seqno, int num)
+{
+   array[len] = seqno;
+   if (num > 1)
+   {
+      array[len] |= 0x80000000;
+      ++ len;
+      array[len] = CSeqNo::incseq(seqno, num - 1);
+   }
 
-         m_piNext[loc] = m_piNext[m_iHead];
-      }
+   ++ len;
+}
 
-      m_piData1[m_iHead] = -1;
+void CSeqBitmap::encode(int32_t* array, int& len, int limit) const
+{
+   len = 0;
 
-      if (m_iLastInsertPos == m_iHead)
-         m_iLastInsertPos = -1;
+   if (0 == m_iLength)
+      return;
 
-      m_iHead = loc;
+   // walk the words from head to tail: skip the empty words, and take each run from the first marked bit to the
+   // first clear bit after it, so that a run costs about two bit scans however sparse the losses are
+   int wmask = m_iSize / 64 - 1;
+   int left = CSeqNo::seqlen(m_iHead, m_iTail);
+   int p = m_iHead & (m_iSize - 1);
+   int w = p >> 6;
+   int base = -(p & 63);                // offset from the head of bit 0 of word w
+   uint64_t marked = m_pBits[w] & (~0ULL << (p & 63));
 
-      m_iLength --;
-   }
-   else if (offset > 0)
+   while (len < limit - 1)
    {
-      int h = m_iHead;
-
-      if (seqno == m_piData1[loc])
+      while (0 == marked)
       {
-         // target node is not empty, remove part/all of the seqno in the node.
-         int temp = loc;
-         loc = (loc + 1) % m_iSize;
-
-         if (-1 == m_piData2[temp])
-            m_iHead = m_piNext[temp];
-         else
-         {
-            // remove part, e.g., [3, 7] becomes [], [4, 7] after remove(3)
-            m_piData1[loc] = CSeqNo::incseq(seqno);
-            if (CSeqNo::seqcmp(m_piData2[temp], m_piData1[loc]) > 0)
-               m_piData2[loc] = m_piData2[temp];
-            m_iHead = loc;
-            m_piNext[loc] = m_piNext[temp];
-            m_piNext[temp] = loc;
-            m_piData2[temp] = -1;
-         }
+         base += 64;
+         if (base >= left)
+            return;
+         w = (w + 1) & wmask;
+         marked = m_pBits[w];
       }
-      else
+
+      int start = base + lowbit(marked);
+      if (start >= left)
+         return;
+
+      uint64_t clear = ~m_pBits[w] & (~0ULL << lowbit(marked));
+      while (0 == clear)
       {
-         // target node is empty, check prior node
-         int i = m_iHead;
-         while ((-1 != m_piNext[i]) && (CSeqNo::seqcmp(m_piData1[m_piNext[i]], seqno) < 0))
-            i = m_piNext[i];
-
-         loc = (loc + 1) % m_iSize;
-
-         if (-1 == m_piData2[i])
-            m_iHead = m_piNext[i];
-         else if (CSeqNo::seqcmp(m_piData2[i], seqno) > 0)
-         {
-            // remove part/all seqno in the prior node
-            m_piData1[loc] = CSeqNo::incseq(seqno);
-            if (CSeqNo::seqcmp(m_piData2[i], m_piData1[loc]) > 0)
-               m_piData2[loc] = m_piData2[i];
-
-            m_piData2[i] = seqno;
-
-            m_piNext[loc] = m_piNext[i];
-            m_piNext[i] = loc;
-
-            m_iHead = loc;
-         }
-         else
-            m_iHead = m_piNext[i];
+         base += 64;
+         if (base >= left)
+            break;
+         w = (w + 1) & wmask;
+         clear = ~m_pBits[w];
       }
 
-      // Remove all nodes prior to the new head
-      while (h != m_iHead)
+      // the tail is always marked, so a run that does not end before it ends there
+      if (base >= left)
       {
-         if (m_piData2[h] != -1)
-         {
-            m_iLength -= CSeqNo::seqlen(m_piData1[h], m_piData2[h]);
-            m_piData2[h] = -1;
-         }
-         else
-            m_iLength --;
-
-         m_piData1[h] = -1;
-
-         if (m_iLastInsertPos == h)
-            m_iLastInsertPos = -1;
-
-         h = m_piNext[h];
+         encodeRun(array, len, CSeqNo::incseq(m_iHead, start), left - start);
+         return;
       }
-   }
-}
 
-int CSndLossList::getLossLength()
-{
-   CGuard listguard(m_ListLock);
+      int end = base + lowbit(clear);
+      if (end > left)
+         end = left;
+      encodeRun(array, len, CSeqNo::incseq(m_iHead, start), end - start);
 
-   return m_iLength;
+      marked = m_pBits[w] & (~0ULL << lowbit(clear));
+   }
 }
 
-int32_t CSndLossList::getLostSeq()
+void CSeqBitmap::encode(int32_t seqno1, int32_t seqno2, int32_t* array, int& len, int limit) const
 {
-   if (0 == m_iLength)
-     return -1;
-
-   CGuard listguard(m_ListLock);
+   len = 0;
 
    if (0 == m_iLength)
-     return -1;
+      return;
 
-   if (m_iLastInsertPos == m_iHead)
-      m_iLastInsertPos = -1;
+   if (CSeqNo::seqcmp(seqno1, m_iHead) < 0)
+      seqno1 = m_iHead;
+   if (CSeqNo::seqcmp(seqno2, m_iTail) > 0)
+      seqno2 = m_iTail;
+   if (CSeqNo::seqcmp(seqno1, seqno2) > 0)
+      return;
 
-   // return the first loss seq. no.
-   int32_t seqno = m_piData1[m_iHead];
+   int left = CSeqNo::seqlen(seqno1, seqno2);
+   int off = 0;
 
-   // head moves to the next node
-   if (-1 == m_piData2[m_iHead])
+   // alternately skip to the next marked and the next clear bit
+   while ((len < limit - 1) && (off < left))
    {
-      //[3, -1] becomes [], and head moves to next node in the list
-      m_piData1[m_iHead] = -1;
-      m_iHead = m_piNext[m_iHead];
-   }
-   else
-   {
-      // shift to next node, e.g., [3, 7] becomes [], [4, 7]
-      int loc = (m_iHead + 1) % m_iSize;
-
-      m_piData1[loc] = CSeqNo::incseq(seqno);
-      if (CSeqNo::seqcmp(m_piData2[m_iHead], m_piData1[loc]) > 0)
-         m_piData2[loc] = m_piData2[m_iHead];
+      int start = scan(CSeqNo::incseq(seqno1, off), left - off, true);
+      if (start < 0)
+         break;
+      off += start;
 
-      m_piData1[m_iHead] = -1;
-      m_piData2[m_iHead] = -1;
+      int run = scan(CSeqNo::incseq(seqno1, off), left - off, false);
+      if (run < 0)
+         run = left - off;
 
-      m_piNext[loc] = m_piNext[m_iHead];
-      m_iHead = loc;
+      encodeRun(array, len, CSeqNo::incseq(seqno1, off), run);
+      off += run;
    }
-
-   m_iLength --;
-
-   return seqno;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
-CRcvLossList::CRcvLossList(int size):
-m_piData1(NULL),
-m_piData2(NULL),
-m_piNext(NULL),
-m_piPrior(NULL),
-m_iHead(-1),
-m_iTail(-1),
-m_iLength(0),
-m_iSize(size)
+// move the marks to a bitmap of at least "size" bits
+void CSeqBitmap::grow(int size)
 {
-   m_piData1 = new int32_t [m_iSize];
-   m_piData2 = new int32_t [m_iSize];
-   m_piNext = new int [m_iSize];
-   m_piPrior = new int [m_iSize];
+   int oldsize = m_iSize;
+   uint64_t* oldbits = m_pBits;
 
-   // -1 means there is no data in the node
-   for (int i = 0; i < size; ++ i)
+   while (m_iSize < size)
+      m_iSize <<= 1;
+
+   m_pBits = new uint64_t [m_iSize / 64];
+   for (int i = 0; i < m_iSize / 64; ++ i)
+      m_pBits[i] = 0;
+
+   // the marks are within the old size from the head, which gives the seq. no. of each marked bit
+   int head = m_iHead & (oldsize - 1);
+   for (int w = 0; w < oldsize / 64; ++ w)
    {
-      m_piData1[i] = -1;
-      m_piData2[i] = -1;
+      for (uint64_t word = oldbits[w]; 0 != word; word &= word - 1)
+      {
+         int off = ((w << 6) + lowbit(word) - head) & (oldsize - 1);
+         int pos = CSeqNo::incseq(m_iHead, off) & (m_iSize - 1);
+         m_pBits[pos >> 6] |= 1ULL << (pos & 63);
+      }
    }
-}
 
-CRcvLossList::~CRcvLossList()
-{
-   delete [] m_piData1;
-   delete [] m_piData2;
-   delete [] m_piNext;
-   delete [] m_piPrior;
+   delete [] oldbits;
 }
 
-void CRcvLossList::insert(int32_t seqno1, int32_t seqno2)
+// offset of the first bit with the value "marked" among the "len" bits starting from "seqno", -1 if none
+int CSeqBitmap::scan(int32_t seqno, int len, bool marked) const
 {
-   // Data to be inserted must be larger than all those in the list
-   // guaranteed by the UDT receiver
+   int mask = m_iSize - 1;
+   int pos = seqno & mask;
 
-   if (0 == m_iLength)
+   for (int off = 0; off < len; )
    {
-      // insert data into an empty list
-      m_iHead = 0;
-      m_iTail = 0;
-      m_piData1[m_iHead] = seqno1;
-      if (seqno2 != seqno1)
-         m_piData2[m_iHead] = seqno2;
+      int p = (pos + off) & mask;
+      uint64_t word = marked ? m_pBits[p >> 6] : ~m_pBits[p >> 6];
+      word >>= p & 63;
 
-      m_piNext[m_iHead] = -1;
-      m_piPrior[m_iHead] = -1;
-      m_iLength += CSeqNo::seqlen(seqno1, seqno2);
+      if (0 != word)
+      {
+         off += lowbit(word);
+         return (off < len) ? off : -1;
+      }
 
-      return;
+      off += 64 - (p & 63);
    }
 
-   // otherwise searching for the position where the node should be
-   int offset = CSeqNo::seqoff(m_piData1[m_iHead], seqno1);
-   int loc = (m_iHead + offset) % m_iSize;
+   return -1;
+}
 
-   if ((-1 != m_piData2[m_iTail]) && (CSeqNo::incseq(m_piData2[m_iTail]) == seqno1))
-   {
-      // coalesce with prior node, e.g., [2, 5], [6, 7] becomes [2, 7]
-      loc = m_iTail;
-      m_piData2[loc] = seqno2;
-   }
-   else
+// backward offset of the first marked bit among the "len" bits ending at "seqno", -1 if none
+int CSeqBitmap::scanBack(int32_t seqno, int len) const
+{
+   int mask = m_iSize - 1;
+   int pos = seqno & mask;
+
+   for (int off = 0; off < len; )
    {
-      // create new node
-      m_piData1[loc] = seqno1;
+      int p = (pos - off) & mask;
+      uint64_t word = m_pBits[p >> 6] << (63 - (p & 63));
 
-      if (seqno2 != seqno1)
-         m_piData2[loc] = seqno2;
+      if (0 != word)
+      {
+         off += 63 - highbit(word);
+         return (off < len) ? off : -1;
+      }
 
-      m_piNext[m_iTail] = loc;
-      m_piPrior[loc] = m_iTail;
-      m_piNext[loc] = -1;
-      m_iTail = loc;
+      off += (p & 63) + 1;
    }
 
-   m_iLength += CSeqNo::seqlen(seqno1, seqno2);
+   return -1;
 }
 
-bool CRcvLossList::remove(int32_t seqno)
+// set or clear "len" bits starting from "seqno", return the number of bits changed
+int CSeqBitmap::update(int32_t seqno, int len, bool mark)
 {
-   if (0 == m_iLength)
-      return false; 
-
-   // locate the position of "seqno" in the list
-   int offset = CSeqNo::seqoff(m_piData1[m_iHead], seqno);
-   if (offset < 0)
-      return false;
-
-   int loc = (m_iHead + offset) % m_iSize;
+   int mask = m_iSize - 1;
+   int pos = seqno & mask;
+   int num = 0;
 
-   if (seqno == m_piData1[loc])
+   for (int off = 0; off < len; )
    {
-      // This is a seq. no. that starts the loss sequence
+      int p = (pos + off) & mask;
+      int bits = 64 - (p & 63);
+      if (bits > len - off)
+         bits = len - off;
 
-      if (-1 == m_piData2[loc])
+      uint64_t m = ((64 == bits) ? ~0ULL : ((1ULL << bits) - 1)) << (p & 63);
+      uint64_t& word = m_pBits[p >> 6];
+
+      if (mark)
       {
-         // there is only 1 loss in the sequence, delete it from the node
-         if (m_iHead == loc)
-         {
-            m_iHead = m_piNext[m_iHead];
-            if (-1 != m_iHead)
-               m_piPrior[m_iHead] = -1;
-         }
-         else
-         {
-            m_piNext[m_piPrior[loc]] = m_piNext[loc];
-            if (-1 != m_piNext[loc])
-               m_piPrior[m_piNext[loc]] = m_piPrior[loc];
-            else
-               m_iTail = m_piPrior[loc];
-         }
-
-         m_piData1[loc] = -1;
+         num += bitcount(m & ~word);
+         word |= m;
       }
       else
       {
-         // there are more than 1 loss in the sequence
-         // move the node to the next and update the starter as the next loss inSeqNo(seqno)
-
-         // find next node
-         int i = (loc + 1) % m_iSize;
-
-         // remove the "seqno" and change the starter as next seq. no.
-         m_piData1[i] = CSeqNo::incseq(m_piData1[loc]);
-
-         // process the sequence end
-         if (CSeqNo::seqcmp(m_piData2[loc], CSeqNo::incseq(m_piData1[loc])) > 0)
-            m_piData2[i] = m_piData2[loc];
-
-         // remove the current node
-         m_piData1[loc] = -1;
-         m_piData2[loc] = -1;
- 
-         // update list pointer
-         m_piNext[i] = m_piNext[loc];
-         m_piPrior[i] = m_piPrior[loc];
-
-         if (m_iHead == loc)
-            m_iHead = i;
-         else
-            m_piNext[m_piPrior[i]] = i;
-
-         if (m_iTail == loc)
-            m_iTail = i;
-         else
-            m_piPrior[m_piNext[i]] = i;
+         num += bitcount(m & word);
+         word &= ~m;
       }
 
-      m_iLength --;
-
-      return true;
+      off += bits;
    }
 
-   // There is no loss sequence in the current position
-   // the "seqno" may be contained in a previous node
+   return num;
+}
 
-   // searching previous node
-   int i = (loc - 1 + m_iSize) % m_iSize;
-   while (-1 == m_piData1[i])
-      i = (i - 1 + m_iSize) % m_iSize;
+////////////////////////////////////////////////////////////////////////////////
 
-   // not contained in this node, return
-   if ((-1 == m_piData2[i]) || (CSeqNo::seqcmp(seqno, m_piData2[i]) > 0))
-       return false;
+CSndLossList::CSndLossList(int size):
+m_Loss(size),
+m_ListLock()
+{
+   // sender list needs mutex protection
+   #ifndef WIN32
+      pthread_mutex_init(&m_ListLock, 0);
+   #else
+      m_ListLock = CreateMutex(NULL, false, NULL);
+   #endif
+}
 
-   if (seqno == m_piData2[i])
-   {
-      // it is the sequence end
+CSndLossList::~CSndLossList()
+{
+   #ifndef WIN32
+      pthread_mutex_destroy(&m_ListLock);
+   #else
+      CloseHandle(m_ListLock);
+   #endif
+}
 
-      if (seqno == CSeqNo::incseq(m_piData1[i]))
-         m_piData2[i] = -1;
-      else
-         m_piData2[i] = CSeqNo::decseq(seqno);
-   }
-   else
-   {
-      // split the sequence
+int CSndLossList::insert(int32_t seqno1, int32_t seqno2)
+{
+   CGuard listguard(m_ListLock);
 
-      // construct the second sequence from CSeqNo::incseq(seqno) to the original sequence end
-      // located at "loc + 1"
-      loc = (loc + 1) % m_iSize;
+   return m_Loss.insert(seqno1, seqno2);
+}
 
-      m_piData1[loc] = CSeqNo::incseq(seqno);
-      if (CSeqNo::seqcmp(m_piData2[i], m_piData1[loc]) > 0)      
-         m_piData2[loc] = m_piData2[i];
+void CSndLossList::remove(int32_t seqno)
+{
+   CGuard listguard(m_ListLock);
 
-      // the first (original) sequence is between the original sequence start to CSeqNo::decseq(seqno)
-      if (seqno == CSeqNo::incseq(m_piData1[i]))
-         m_piData2[i] = -1;
-      else
-         m_piData2[i] = CSeqNo::decseq(seqno);
+   if (0 == m_Loss.getLength())
+      return;
 
-      // update the list pointer
-      m_piNext[loc] = m_piNext[i];
-      m_piNext[i] = loc;
-      m_piPrior[loc] = i;
+   m_Loss.remove(m_Loss.getFirst(), seqno);
+}
 
-      if (m_iTail == i)
-         m_iTail = loc;
-      else
-         m_piPrior[m_piNext[loc]] = loc;
-   }
+void CSndLossList::remove(int32_t seqno1, int32_t seqno2)
+{
+   CGuard listguard(m_ListLock);
 
-   m_iLength --;
+   m_Loss.remove(seqno1, seqno2);
+}
 
-   return true;
+int CSndLossList::getLossLength()
+{
+   CGuard listguard(m_ListLock);
+
+   return m_Loss.getLength();
 }
 
-bool CRcvLossList::remove(int32_t seqno1, int32_t seqno2)
+int32_t CSndLossList::getLostSeq()
 {
-   if (seqno1 <= seqno2)
-   {
-      for (int32_t i = seqno1; i <= seqno2; ++ i)
-         remove(i);
-   }
-   else
-   {
-      for (int32_t j = seqno1; j < CSeqNo::m_iMaxSeqNo; ++ j)
-         remove(j);
-      for (int32_t k = 0; k <= seqno2; ++ k)
-         remove(k);
-   }
+   if (0 == m_Loss.getLength())
+     return -1;
 
-   return true;
+   CGuard listguard(m_ListLock);
+
+   if (0 == m_Loss.getLength())
+     return -1;
+
+   // return the first loss seq. no.
+   int32_t seqno = m_Loss.getFirst();
+   m_Loss.remove(seqno, seqno);
+
+   return seqno;
 }
 
+////////////////////////////////////////////////////////////////////////////////
 
-// [seqno1, seqno2]ûжʧк
-bool CRcvLossList::find(int32_t seqno1, int32_t seqno2) const
+CRcvLossList::CRcvLossList(int size):
+m_Loss(size)
 {
-   if (0 == m_iLength)
+}
+
+CRcvLossList::~CRcvLossList()
+{
+}
+
+void CRcvLossList::insert(int32_t seqno1, int32_t seqno2)
+{
+   m_Loss.insert(seqno1, seqno2);
+}
+
+bool CRcvLossList::remove(int32_t seqno)
+{
+   // most packets arriving were never lost
+   if (!m_Loss.isMarked(seqno))
       return false;
 
-   int p = m_iHead;
+   return m_Loss.remove(seqno, seqno) > 0;
+}
 
-   while (-1 != p)
-   {
-      if ((CSeqNo::seqcmp(m_piData1[p], seqno1) == 0) ||
-          ((CSeqNo::seqcmp(m_piData1[p], seqno1) > 0) && (CSeqNo::seqcmp(m_piData1[p], seqno2) <= 0)) ||
-          ((CSeqNo::seqcmp(m_piData1[p], seqno1) < 0) && (m_piData2[p] != -1) && CSeqNo::seqcmp(m_piData2[p], seqno1) >= 0))
-          return true;
+bool CRcvLossList::remove(int32_t seqno1, int32_t seqno2)
+{
+   m_Loss.remove(seqno1, seqno2);
 
-      p = m_piNext[p];
-   }
+   return true;
+}
 
-   return false;
+bool CRcvLossList::find(int32_t seqno1, int32_t seqno2) const
+{
+   return m_Loss.find(seqno1, seqno2);
 }
 
 int CRcvLossList::getLossLength() const
 {
-   return m_iLength;
+   return m_Loss.getLength();
 }
 
 int CRcvLossList::getFirstLostSeq() const
 {
-   if (0 == m_iLength)
-      return -1;
-
-   return m_piData1[m_iHead];
+   return m_Loss.getFirst();
 }
 
 void CRcvLossList::getLossArray(int32_t* array, int& len, int limit)
 {
-   len = 0;
-
-   int i = m_iHead;
-
-   while ((len < limit - 1) && (-1 != i))
-   {
-      array[len] = m_piData1[i];
-      if (-1 != m_piData2[i])
-      {
-         // there are more than 1 loss in the sequence
-         array[len] |= 0x80000000;
-         ++ len;
-         array[len] = m_piData2[i];
-      }
-
-      ++ len;
+   m_Loss.encode(array, len, limit);
+}
 
-      i = m_piNext[i];
-   }
+void CRcvLossList::getLossArray(int32_t seqno1, int32_t seqno2, int32_t* array, int& len, int limit)
+{
+   m_Loss.encode(seqno1, seqno2, array, len, limit);
 }
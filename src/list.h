@@ -46,6 +46,92 @@ written by
 #include "common.h"
 
 
+class CSeqBitmap
+{
+public:
+   CSeqBitmap(int size);
+   ~CSeqBitmap();
+
+      // Functionality:
+      //    Mark the seq. no. between "seqno1" and "seqno2". The bitmap grows when the marked seq. no. do not
+      //    stay within its size of each other; only what lies beyond the threshold of comparing seq. no. is ignored.
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      // Returned value:
+      //    number of seq. no. that were not marked before.
+
+   int insert(int32_t seqno1, int32_t seqno2);
+
+      // Functionality:
+      //    Clear the seq. no. between "seqno1" and "seqno2".
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      // Returned value:
+      //    number of seq. no. cleared.
+
+   int remove(int32_t seqno1, int32_t seqno2);
+
+      // Functionality:
+      //    Find if any seq. no. between "seqno1" and "seqno2" is marked.
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      // Returned value:
+      //    True if found; otherwise false.
+
+   bool find(int32_t seqno1, int32_t seqno2) const;
+
+      // Functionality:
+      //    Encode the marked seq. no. as runs, in the format of the NAK loss array: a run of more than one
+      //    seq. no. is written as its first seq. no. with the highest bit set, followed by its last seq. no.
+      // Parameters:
+      //    0) [out] array: the encoded runs.
+      //    1) [out] len: physical length of the result array.
+      //    2) [in] limit: maximum length of the array.
+      // Returned value:
+      //    None.
+
+   void encode(int32_t* array, int& len, int limit) const;
+
+      // Functionality:
+      //    Encode the marked seq. no. between "seqno1" and "seqno2" as runs, in the same format.
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      //    2) [out] array: the encoded runs.
+      //    3) [out] len: physical length of the result array.
+      //    4) [in] limit: maximum length of the array.
+      // Returned value:
+      //    None.
+
+   void encode(int32_t seqno1, int32_t seqno2, int32_t* array, int& len, int limit) const;
+
+   int getLength() const {return m_iLength;}
+   int32_t getFirst() const {return m_iHead;}
+   bool isMarked(int32_t seqno) const {int pos = seqno & (m_iSize - 1); return 0 != (m_pBits[pos >> 6] & (1ULL << (pos & 63)));}
+
+private:
+   int scan(int32_t seqno, int len, bool marked) const;
+   int scanBack(int32_t seqno, int len) const;
+   int update(int32_t seqno, int len, bool mark);
+   void grow(int size);
+
+private:
+   uint64_t* m_pBits;                   // one bit per seq. no., indexed by the low bits of the seq. no.
+   int m_iSize;                         // number of bits, a power of 2
+   int32_t m_iHead;                     // first marked seq. no., -1 if none
+   int32_t m_iTail;                     // last marked seq. no., -1 if none
+   int m_iLength;                       // number of marked seq. no.
+
+private:
+   CSeqBitmap(const CSeqBitmap&);
+   CSeqBitmap& operator=(const CSeqBitmap&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class CSndLossList
 {
 public:
@@ -71,6 +157,16 @@ public:
 
    void remove(int32_t seqno);
 
+      // Functionality:
+      //    Remove the seq. no. between "seqno1" and "seqno2", e.g., those the receiver has reported as received.
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      // Returned value:
+      //    None.
+
+   void remove(int32_t seqno1, int32_t seqno2);
+
       // Functionality:
       //    Read the loss length.
       // Parameters:
@@ -90,14 +186,7 @@ public:
    int32_t getLostSeq();
 
 private:
-   int32_t* m_piData1;                  // sequence number starts
-   int32_t* m_piData2;                  // seqnence number ends
-   int* m_piNext;                       // next node in the list
-
-   int m_iHead;                         // first node
-   int m_iLength;                       // loss length
-   int m_iSize;                         // size of the static array
-   int m_iLastInsertPos;                // position of last insert node
+   CSeqBitmap m_Loss;                   // lost seq. no.
 
    pthread_mutex_t m_ListLock;          // used to synchronize list operation
 
@@ -182,16 +271,21 @@ public:
 
    void getLossArray(int32_t* array, int& len, int limit);
 
+      // Functionality:
+      //    Get a encoded loss array of the seq. no. between "seqno1" and "seqno2".
+      // Parameters:
+      //    0) [in] seqno1: sequence number starts.
+      //    1) [in] seqno2: sequence number ends.
+      //    2) [out] array: the result list of seq. no. to be included in NAK.
+      //    3) [out] physical length of the result array.
+      //    4) [in] limit: maximum length of the array.
+      // Returned value:
+      //    None.
+
+   void getLossArray(int32_t seqno1, int32_t seqno2, int32_t* array, int& len, int limit);
+
 private:
-   int32_t* m_piData1;                  // sequence number starts
-   int32_t* m_piData2;                  // sequence number ends
-   int* m_piNext;                       // next node in the list
-   int* m_piPrior;                      // prior node in the list;
-
-   int m_iHead;                         // first node in the list
-   int m_iTail;                         // last node in the list;
-   int m_iLength;                       // loss length
-   int m_iSize;                         // size of the static array
+   CSeqBitmap m_Loss;                   // lost seq. no.
 
 private:
    CRcvLossList(const CRcvLossList&);
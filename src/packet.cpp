@@ -119,6 +119,9 @@ written by
 //      8: Error Signal from the Peer Side
 //              Add. Info:    Error code
 //              Control Info: None
+//      9: FEC Parity (see CSndFEC), Reserved field: index of the parity packet in its group
+//              Add. Info:    first sequence number of the group
+//              Control Info: parity of the data packets of the group
 //      0x7FFF: Explained by bits 16 - 31
 //              
 //   bit 16 - 31:
@@ -149,6 +152,7 @@ written by
 
 const int CPacket::m_iPktHdrSize = 16;
 const int CHandShake::m_iContentSize = 48;
+const int CHandShake::m_iExtContentSize = 64;
 
 
 // Set up the aliases in the constructure
@@ -158,6 +162,7 @@ m_iMsgNo((int32_t&)(m_nHeader[1])),
 m_iTimeStamp((int32_t&)(m_nHeader[2])),
 m_iID((int32_t&)(m_nHeader[3])),
 m_pcData((char*&)(m_PacketVector[1].iov_base)),
+m_iECN(0),
 __pad()
 {
    for (int i = 0; i < 4; ++ i)
@@ -272,6 +277,16 @@ void CPacket::pack(int pkttype, void* lparam, void* rparam, int size)
 
       break;
 
+   case 9: //1001 - FEC Parity
+      // index of the parity packet, first seq. no. of the group
+      m_nHeader[0] |= ((int32_t *)lparam)[1] & 0xFFFF;
+      m_nHeader[1] = ((int32_t *)lparam)[0];
+
+      m_PacketVector[1].iov_base = (char *)rparam;
+      m_PacketVector[1].iov_len = size;
+
+      break;
+
    case 32767: //0x7FFF - Reserved for user defined control packets
       // for extended control packet
       // "lparam" contains the extended type information for bit 16 - 31
@@ -350,6 +365,7 @@ CPacket* CPacket::clone() const
    pkt->m_pcData = new char[m_PacketVector[1].iov_len];
    memcpy(pkt->m_pcData, m_pcData, m_PacketVector[1].iov_len);
    pkt->m_PacketVector[1].iov_len = m_PacketVector[1].iov_len;
+   pkt->m_iECN = m_iECN;
 
    return pkt;
 }
@@ -362,7 +378,11 @@ m_iMSS(0),
 m_iFlightFlagSize(0),
 m_iReqType(0),
 m_iID(0),
-m_iCookie(0)
+m_iCookie(0),
+m_iMaxACKSpacing(0),
+m_iFECGroup(-1),
+m_iDelayReport(0),
+m_iECNReport(0)
 {
    for (int i = 0; i < 4; ++ i)
       m_piPeerIP[i] = 0;
@@ -373,6 +393,9 @@ int CHandShake::serialize(char* buf, int& size)
    if (size < m_iContentSize)
       return -1;
 
+   // the extension is left out if it carries nothing or does not fit
+   bool ext = ((0 != m_iMaxACKSpacing) || (m_iFECGroup >= 0) || (0 != m_iDelayReport) || (0 != m_iECNReport)) && (size >= m_iExtContentSize);
+
    int32_t* p = (int32_t*)buf;
    *p++ = m_iVersion;
    *p++ = m_iType;
@@ -387,6 +410,15 @@ int CHandShake::serialize(char* buf, int& size)
 
    size = m_iContentSize;
 
+   if (ext)
+   {
+      *p++ = m_iMaxACKSpacing;
+      *p++ = m_iFECGroup;
+      *p++ = m_iDelayReport;
+      *p++ = m_iECNReport;
+      size = m_iExtContentSize;
+   }
+
    return 0;
 }
 
@@ -407,5 +439,11 @@ int CHandShake::deserialize(const char* buf, int size)
    for (int i = 0; i < 4; ++ i)
       m_piPeerIP[i] = *p++;
 
+   // the extension had a single field before FEC, two before the one-way delay reports and three before ECN
+   m_iMaxACKSpacing = (size >= m_iContentSize + 4) ? *p++ : 0;
+   m_iFECGroup = (size >= m_iContentSize + 8) ? *p++ : -1;
+   m_iDelayReport = (size >= m_iContentSize + 12) ? *p++ : 0;
+   m_iECNReport = (size >= m_iExtContentSize) ? *p : 0;
+
    return 0;
 }
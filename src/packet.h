@@ -67,6 +67,8 @@ public:
    int32_t& m_iID;			// alias: socket ID
    char*& m_pcData;                     // alias: data/control information
 
+   int m_iECN;				// ECN field of the IP header: 0: not ECN capable, 1/2: ECT(1)/ECT(0), 3: congestion experienced
+
    static const int m_iPktHdrSize;	// packet header size
 
 public:
@@ -206,6 +208,7 @@ public:
 
 public:
    static const int m_iContentSize;	// Size of hand shake data
+   static const int m_iExtContentSize;	// Size of hand shake data with the extension fields
 
 public:
    int32_t m_iVersion;          // UDT version
@@ -217,6 +220,13 @@ public:
    int32_t m_iID;		// socket ID
    int32_t m_iCookie;		// cookie
    uint32_t m_piPeerIP[4];	// The IP address that the peer's UDP port is bound to
+
+   // Extension, only sent when it is not 0. A listener from before the extension rejects a longer request,
+   // so a client adds it only after the listener's response has carried it.
+   int32_t m_iMaxACKSpacing;	// largest number of data packets between light ACKs the sender accepts, 0: fixed spacing
+   int32_t m_iFECGroup;		// number of data packets per FEC group, 0: no FEC, -1: field absent
+   int32_t m_iDelayReport;	// 1: one-way delays can be reported in ACKs, 0: not, or field absent
+   int32_t m_iECNReport;	// 1: packets marked CE can be counted in ACKs, 0: not, or field absent
 };
 
 
@@ -304,7 +304,8 @@ void CSndUList::update(const CUDT* u, bool reschedule)
 
    if (n->m_iHeapLoc >= 0)
    {
-      if (!reschedule)
+      // a socket only waiting for a held-back packet or a tail loss probe is checked again at once
+      if (!reschedule && ((0 == u->m_ullHoldTime) || (n->m_llTimeStamp != u->m_ullHoldTime)))
          return;
 
       if (n->m_iHeapLoc == 0)
@@ -341,7 +342,12 @@ int CSndUList::pop(sockaddr*& addr, CPacket& pkt)
 
    // pack a packet from the socket
    if (u->packData(pkt, ts) <= 0)
+   {
+      // a partial tail packet is held back or a tail loss probe is armed, check the socket again when it is due
+      if (u->m_ullHoldTime > 0)
+         insert_(u->m_ullHoldTime, u);
       return -1;
+   }
 
    addr = u->m_pPeerAddr;
 
@@ -853,7 +859,7 @@ void CRendezvousQueue::updateConnStatus()
 
    CGuard vg(m_RIDVectorLock);
 
-   for (list<CRL>::iterator i = m_lRendezvousID.begin(); i != m_lRendezvousID.end(); ++ i)
+   for (list<CRL>::iterator i = m_lRendezvousID.begin(); i != m_lRendezvousID.end();)
    {
       // avoid sending too many requests, at most 1 request per 250ms
       if (CTimer::getTime() - i->m_pUDT->m_llLastReqTime > 250000)
@@ -861,8 +867,15 @@ void CRendezvousQueue::updateConnStatus()
          if (CTimer::getTime() >= i->m_ullTTL)
          {
             // connection timer expired, acknowledge app via epoll
+            // the entry is dropped here, as close() only removes the sockets still connecting
             i->m_pUDT->m_bConnecting = false;
-            CUDT::s_UDTUnited.m_EPoll.update_events(i->m_iID, i->m_pUDT->m_sPollID, UDT_EPOLL_ERR, true);
+            i->m_pUDT->updateEPoll(UDT_EPOLL_ERR, true);
+
+            if (AF_INET == i->m_iIPversion)
+               delete (sockaddr_in*)i->m_pPeerAddr;
+            else
+               delete (sockaddr_in6*)i->m_pPeerAddr;
+            i = m_lRendezvousID.erase(i);
             continue;
          }
 
@@ -878,6 +891,8 @@ void CRendezvousQueue::updateConnStatus()
          i->m_pUDT->m_llLastReqTime = CTimer::getTime();
          delete [] reqdata;
       }
+
+      ++ i;
    }
 }
 
@@ -45,6 +45,7 @@ written by
 #ifndef WIN32
    #include <sys/types.h>
    #include <sys/socket.h>
+   #include <sys/uio.h>
    #include <netinet/in.h>
 #else
    #ifdef __MINGW__
@@ -108,6 +109,15 @@ written by
 typedef SYSSOCKET UDPSOCKET;
 typedef int UDTSOCKET;
 
+#ifdef WIN32
+   // scatter/gather buffer descriptor, same as the POSIX one
+   struct iovec
+   {
+      void* iov_base;
+      size_t iov_len;
+   };
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 
 typedef std::set<UDTSOCKET> ud_set;
@@ -122,7 +132,15 @@ enum EPOLLOpt
    // so that if system values are used by mistake, they should have the same effect
    UDT_EPOLL_IN = 0x1,
    UDT_EPOLL_OUT = 0x4,
-   UDT_EPOLL_ERR = 0x8
+   UDT_EPOLL_ERR = 0x8,
+   // report an event once when it turns on, rather than as long as it is on
+   UDT_EPOLL_ET = 0x80000000
+};
+
+struct CEPollEvent
+{
+   UDTSOCKET sock;                      // UDT socket ready
+   int events;                          // events on (UDT_EPOLL_IN, UDT_EPOLL_OUT, UDT_EPOLL_ERR)
 };
 
 enum UDTSTATUS {INIT = 1, OPENED, LISTENING, CONNECTING, CONNECTED, BROKEN, CLOSING, CLOSED, NONEXIST};
@@ -151,7 +169,15 @@ enum UDTOpt
    UDT_STATE,		// current socket state, see UDTSTATUS, read only
    UDT_EVENT,		// current avalable events associated with the socket
    UDT_SNDDATA,		// size of data in the sending buffer
-   UDT_RCVDATA		// size of data available for recv
+   UDT_RCVDATA,		// size of data available for recv
+   UDT_NODELAY,		// send small stream writes immediately; if false, coalesce them into full packets
+   UDT_SACK,		// report received ranges beyond the ACK point so that the peer retransmits only the holes
+   UDT_ARRWND,		// number of packet arrival intervals used to estimate the receiving rate
+   UDT_PROBEWND,	// number of packet pair intervals used to estimate the bandwidth
+   UDT_ACKSPACING,	// largest number of packets between light ACKs when the spacing adapts to rate and RTT, 0 disables
+   UDT_FECGROUP,	// number of data packets protected by each group of FEC parity packets, 0 disables FEC
+   UDT_FECPARITY,	// largest number of parity packets per FEC group, the number used follows the loss rate
+   UDT_ECN		// mark the data sent ECN capable, so that the network signals congestion before it drops packets
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -194,6 +220,14 @@ struct CPerfMon
    double mbpsBandwidth;                // estimated bandwidth, in Mb/s
    int byteAvailSndBuf;                 // available UDT sender buffer size
    int byteAvailRcvBuf;                 // available UDT receiver buffer size
+
+   // added after the fields above, which keep their offsets
+   int64_t byteDiskWriteTotal;          // total size of data written to disk by recvfile
+   int64_t byteDiskWrite;               // size of data written to disk by recvfile
+   int64_t usDiskWrite;                 // busy disk writing time
+   double mbpsDiskWrite;                // disk writing rate in Mb/s, while busy writing
+   int pktRcvCETotal;                   // total number of received data and parity packets marked congestion experienced (CE)
+   int pktRcvCE;                        // number of received data and parity packets marked congestion experienced (CE)
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -303,6 +337,7 @@ namespace UDT
 typedef CUDTException ERRORINFO;
 typedef UDTOpt SOCKOPT;
 typedef CPerfMon TRACEINFO;
+typedef CEPollEvent EPOLLEVENT;
 typedef ud_set UDSET;
 
 UDT_API extern const UDTSOCKET INVALID_SOCK;
@@ -311,6 +346,7 @@ UDT_API extern const int ERROR;
 
 UDT_API int startup();
 UDT_API int cleanup();
+UDT_API int setcachefile(const char* file, int ttl = 3600);
 UDT_API UDTSOCKET socket(int af, int type, int protocol);
 UDT_API int bind(UDTSOCKET u, const struct sockaddr* name, int namelen);
 UDT_API int bind2(UDTSOCKET u, UDPSOCKET udpsock);
@@ -326,8 +362,14 @@ UDT_API int send(UDTSOCKET u, const char* buf, int len, int flags);
 UDT_API int recv(UDTSOCKET u, char* buf, int len, int flags);
 UDT_API int sendmsg(UDTSOCKET u, const char* buf, int len, int ttl = -1, bool inorder = false);
 UDT_API int recvmsg(UDTSOCKET u, char* buf, int len);
+UDT_API int sendv(UDTSOCKET u, const struct iovec* iov, int iovcnt, int flags);
+UDT_API int recvv(UDTSOCKET u, const struct iovec* iov, int iovcnt, int flags);
+UDT_API int sendmsg_batch(UDTSOCKET u, const struct iovec* msgs, int num, int ttl = -1, bool inorder = false);
+UDT_API int recvmsg_batch(UDTSOCKET u, const struct iovec* msgs, int num, int* lens);
 UDT_API int64_t sendfile(UDTSOCKET u, std::fstream& ifs, int64_t& offset, int64_t size, int block = 364000);
+UDT_API int64_t sendfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block = 364000);
 UDT_API int64_t recvfile(UDTSOCKET u, std::fstream& ofs, int64_t& offset, int64_t size, int block = 7280000);
+UDT_API int64_t recvfile(UDTSOCKET u, int fd, int64_t& offset, int64_t size, int block = 7280000);
 UDT_API int64_t sendfile2(UDTSOCKET u, const char* path, int64_t* offset, int64_t size, int block = 364000);
 UDT_API int64_t recvfile2(UDTSOCKET u, const char* path, int64_t* offset, int64_t size, int block = 7280000);
 
@@ -345,6 +387,8 @@ UDT_API int epoll_wait(int eid, std::set<UDTSOCKET>* readfds, std::set<UDTSOCKET
                        std::set<SYSSOCKET>* lrfds = NULL, std::set<SYSSOCKET>* wrfds = NULL);
 UDT_API int epoll_wait2(int eid, UDTSOCKET* readfds, int* rnum, UDTSOCKET* writefds, int* wnum, int64_t msTimeOut,
                         SYSSOCKET* lrfds = NULL, int* lrnum = NULL, SYSSOCKET* lwfds = NULL, int* lwnum = NULL);
+UDT_API int epoll_uwait(int eid, EPOLLEVENT* events, int maxevents, int64_t msTimeOut);
+UDT_API int epoll_getfd(int eid);
 UDT_API int epoll_release(int eid);
 UDT_API ERRORINFO& getlasterror();
 UDT_API int getlasterror_code();
@@ -50,14 +50,14 @@ m_piACKSeqNo(NULL),
 m_piACK(NULL),
 m_pTimeStamp(NULL),
 m_iSize(size),
-m_iHead(0),
-m_iTail(0)
+m_iLastAckSeqNo(-1)
 {
    m_piACKSeqNo = new int32_t[m_iSize];
    m_piACK = new int32_t[m_iSize];
    m_pTimeStamp = new uint64_t[m_iSize];
 
-   m_piACKSeqNo[0] = -1;
+   for (int i = 0; i < m_iSize; ++ i)
+      m_piACKSeqNo[i] = -1;
 }
 
 CACKWindow::~CACKWindow()
@@ -69,114 +69,293 @@ CACKWindow::~CACKWindow()
 
 void CACKWindow::store(int32_t seq, int32_t ack)
 {
-   m_piACKSeqNo[m_iHead] = seq;
-   m_piACK[m_iHead] = ack;
-   m_pTimeStamp[m_iHead] = CTimer::getTime();
+   // ACK seq. no. are consecutive, so a new record overwrites the one sent "size" ACKs ago
+   int i = seq % m_iSize;
 
-   m_iHead = (m_iHead + 1) % m_iSize;
-
-   // overwrite the oldest ACK since it is not likely to be acknowledged
-   if (m_iHead == m_iTail)
-      m_iTail = (m_iTail + 1) % m_iSize;
+   m_piACKSeqNo[i] = seq;
+   m_piACK[i] = ack;
+   m_pTimeStamp[i] = CTimer::getTime();
 }
 
 int CACKWindow::acknowledge(int32_t seq, int32_t& ack)
 {
-   if (m_iHead >= m_iTail)
-   {
-      // Head has not exceeded the physical boundary of the window
+   if (seq < 0)
+      return -1;
 
-      for (int i = m_iTail, n = m_iHead; i < n; ++ i)
-      {
-         // looking for indentical ACK Seq. No.
-         if (seq == m_piACKSeqNo[i])
-         {
-            // return the Data ACK it carried
-            ack = m_piACK[i];
-
-            // calculate RTT
-            int rtt = int(CTimer::getTime() - m_pTimeStamp[i]);
-
-            if (i + 1 == m_iHead)
-            {
-               m_iTail = m_iHead = 0;
-               m_piACKSeqNo[0] = -1;
-            }
-            else
-               m_iTail = (i + 1) % m_iSize;
-
-            return rtt;
-         }
-      }
+   int i = seq % m_iSize;
+
+   // bad input, the ACK record has been overwritten or has never been sent
+   if (seq != m_piACKSeqNo[i])
+      return -1;
 
-      // Bad input, the ACK node has been overwritten
+   // duplicate or out of order ACK-2: a newer ACK has already been acknowledged
+   if ((m_iLastAckSeqNo >= 0) && (CAckNo::ackcmp(seq, m_iLastAckSeqNo) <= 0))
       return -1;
+
+   // return the Data ACK it carried
+   ack = m_piACK[i];
+
+   // calculate RTT
+   int rtt = int(CTimer::getTime() - m_pTimeStamp[i]);
+
+   m_iLastAckSeqNo = seq;
+   m_piACKSeqNo[i] = -1;
+
+   return rtt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// order window positions by their values, for building the heaps
+struct CValueLess
+{
+   CValueLess(const int* value): m_piValue(value) {}
+   bool operator()(int a, int b) const {return m_piValue[a] < m_piValue[b];}
+   const int* m_piValue;
+};
+
+struct CValueGreater
+{
+   CValueGreater(const int* value): m_piValue(value) {}
+   bool operator()(int a, int b) const {return m_piValue[a] > m_piValue[b];}
+   const int* m_piValue;
+};
+
+CMedianWindow::CMedianWindow(int size, int value):
+m_piWindow(NULL),
+m_iSize(size),
+m_iPtr(0),
+m_piHeapValue(NULL),
+m_piLower(NULL),
+m_piUpper(NULL),
+m_piPos(NULL),
+m_iLowerSize(size / 2),
+m_iPending(0),
+m_bHeapValid(false),
+m_iMedian(value)
+{
+   m_piWindow = new int[m_iSize];
+   m_piHeapValue = new int[m_iSize];
+   m_piLower = new int[m_iLowerSize + 1];
+   m_piUpper = new int[m_iSize - m_iLowerSize];
+   m_piPos = new int[m_iSize];
+
+   for (int i = 0; i < m_iSize; ++ i)
+      m_piWindow[i] = value;
+
+   rebuild();
+   m_iMedian = m_piHeapValue[m_piUpper[0]];
+}
+
+CMedianWindow::~CMedianWindow()
+{
+   delete [] m_piWindow;
+   delete [] m_piHeapValue;
+   delete [] m_piLower;
+   delete [] m_piUpper;
+   delete [] m_piPos;
+}
+
+void CMedianWindow::push(int value)
+{
+   m_piWindow[m_iPtr] = value;
+
+   // the window is logically circular
+   if (++ m_iPtr == m_iSize)
+      m_iPtr = 0;
+
+   if (m_iPending < m_iSize)
+      ++ m_iPending;
+}
+
+int CMedianWindow::getMedian()
+{
+   update();
+
+   return m_iMedian;
+}
+
+int CMedianWindow::filter(int64_t& sum)
+{
+   int median = getMedian();
+   int upper = median << 3;
+   int lower = median >> 3;
+
+   int count = 0;
+   sum = 0;
+
+   // a plain pass over the window, no copy or selection is needed once the median is known
+   for (int i = 0; i < m_iSize; ++ i)
+   {
+      int in = (m_piWindow[i] < upper) & (m_piWindow[i] > lower);
+      count += in;
+      sum += in ? m_piWindow[i] : 0;
    }
 
-   // Head has exceeded the physical window boundary, so it is behind tail
-   for (int j = m_iTail, n = m_iHead + m_iSize; j < n; ++ j)
+   return count;
+}
+
+void CMedianWindow::update()
+{
+   if (0 == m_iPending)
+      return;
+
+   // after many arrivals a plain selection is cheaper than catching up the heaps, which are rebuilt later when needed
+   if (m_iPending > (m_iSize >> 4) + 2)
+   {
+      std::copy(m_piWindow, m_piWindow + m_iSize, m_piHeapValue);
+      std::nth_element(m_piHeapValue, m_piHeapValue + m_iLowerSize, m_piHeapValue + m_iSize);
+      m_iMedian = m_piHeapValue[m_iLowerSize];
+
+      m_bHeapValid = false;
+      m_iPending = 0;
+      return;
+   }
+
+   if (!m_bHeapValid)
+   {
+      rebuild();
+      m_iMedian = m_piHeapValue[m_piUpper[0]];
+      return;
+   }
+
+   for (int slot = (m_iPtr - m_iPending + m_iSize) % m_iSize; m_iPending > 0; -- m_iPending)
    {
-      // looking for indentical ACK seq. no.
-      if (seq == m_piACKSeqNo[j % m_iSize])
+      m_piHeapValue[slot] = m_piWindow[slot];
+
+      // restore the heap that holds the replaced value
+      if (m_piPos[slot] < 0)
+         siftLower(-m_piPos[slot] - 1);
+      else
+         siftUpper(m_piPos[slot]);
+
+      // the changed value may now belong to the other half; exchanging the two tops is enough to fix it
+      if ((m_iLowerSize > 0) && (m_piHeapValue[m_piLower[0]] > m_piHeapValue[m_piUpper[0]]))
       {
-         // return Data ACK
-         j %= m_iSize;
-         ack = m_piACK[j];
-
-         // calculate RTT
-         int rtt = int(CTimer::getTime() - m_pTimeStamp[j]);
-
-         if (j == m_iHead)
-         {
-            m_iTail = m_iHead = 0;
-            m_piACKSeqNo[0] = -1;
-         }
-         else
-            m_iTail = (j + 1) % m_iSize;
-
-         return rtt;
+         int l = m_piLower[0];
+         int u = m_piUpper[0];
+         m_piLower[0] = u;
+         m_piUpper[0] = l;
+         m_piPos[u] = -1;
+         m_piPos[l] = 0;
+
+         siftLower(0);
+         siftUpper(0);
       }
+
+      if (++ slot == m_iSize)
+         slot = 0;
    }
 
-   // bad input, the ACK node has been overwritten
-   return -1;
+   m_iMedian = m_piHeapValue[m_piUpper[0]];
+}
+
+void CMedianWindow::rebuild()
+{
+   std::copy(m_piWindow, m_piWindow + m_iSize, m_piHeapValue);
+
+   // split the positions around the median, then heapify both halves
+   int* order = m_piPos;
+   for (int i = 0; i < m_iSize; ++ i)
+      order[i] = i;
+
+   std::nth_element(order, order + m_iLowerSize, order + m_iSize, CValueLess(m_piHeapValue));
+
+   std::copy(order, order + m_iLowerSize, m_piLower);
+   std::copy(order + m_iLowerSize, order + m_iSize, m_piUpper);
+
+   std::make_heap(m_piLower, m_piLower + m_iLowerSize, CValueLess(m_piHeapValue));
+   std::make_heap(m_piUpper, m_piUpper + m_iSize - m_iLowerSize, CValueGreater(m_piHeapValue));
+
+   for (int i = 0; i < m_iLowerSize; ++ i)
+      m_piPos[m_piLower[i]] = -i - 1;
+   for (int i = 0, n = m_iSize - m_iLowerSize; i < n; ++ i)
+      m_piPos[m_piUpper[i]] = i;
+
+   m_bHeapValid = true;
+   m_iPending = 0;
+}
+
+void CMedianWindow::swap(int* heap, int i, int j)
+{
+   int t = heap[i];
+   heap[i] = heap[j];
+   heap[j] = t;
+
+   if (heap == m_piLower)
+   {
+      m_piPos[heap[i]] = -i - 1;
+      m_piPos[heap[j]] = -j - 1;
+   }
+   else
+   {
+      m_piPos[heap[i]] = i;
+      m_piPos[heap[j]] = j;
+   }
+}
+
+void CMedianWindow::siftLower(int i)
+{
+   // move up while greater than the parent
+   while ((i > 0) && (m_piHeapValue[m_piLower[i]] > m_piHeapValue[m_piLower[(i - 1) >> 1]]))
+   {
+      swap(m_piLower, i, (i - 1) >> 1);
+      i = (i - 1) >> 1;
+   }
+
+   // move down while smaller than the greater child
+   for (int c = 2 * i + 1; c < m_iLowerSize; c = 2 * i + 1)
+   {
+      if ((c + 1 < m_iLowerSize) && (m_piHeapValue[m_piLower[c + 1]] > m_piHeapValue[m_piLower[c]]))
+         ++ c;
+      if (m_piHeapValue[m_piLower[c]] <= m_piHeapValue[m_piLower[i]])
+         break;
+      swap(m_piLower, i, c);
+      i = c;
+   }
+}
+
+void CMedianWindow::siftUpper(int i)
+{
+   int n = m_iSize - m_iLowerSize;
+
+   // move up while smaller than the parent
+   while ((i > 0) && (m_piHeapValue[m_piUpper[i]] < m_piHeapValue[m_piUpper[(i - 1) >> 1]]))
+   {
+      swap(m_piUpper, i, (i - 1) >> 1);
+      i = (i - 1) >> 1;
+   }
+
+   // move down while greater than the smaller child
+   for (int c = 2 * i + 1; c < n; c = 2 * i + 1)
+   {
+      if ((c + 1 < n) && (m_piHeapValue[m_piUpper[c + 1]] < m_piHeapValue[m_piUpper[c]]))
+         ++ c;
+      if (m_piHeapValue[m_piUpper[c]] >= m_piHeapValue[m_piUpper[i]])
+         break;
+      swap(m_piUpper, i, c);
+      i = c;
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 CPktTimeWindow::CPktTimeWindow(int asize, int psize):
 m_iAWSize(asize),
-m_piPktWindow(NULL),
-m_iPktWindowPtr(0),
+m_PktWindow(asize, 1000000),
 m_iPWSize(psize),
-m_piProbeWindow(NULL),
-m_iProbeWindowPtr(0),
+m_ProbeWindow(psize, 1000),
 m_iLastSentTime(0),
 m_iMinPktSndInt(1000000),
 m_LastArrTime(),
 m_CurrArrTime(),
 m_ProbeTime()
 {
-   m_piPktWindow = new int[m_iAWSize];
-   m_piPktReplica = new int[m_iAWSize];
-   m_piProbeWindow = new int[m_iPWSize];
-   m_piProbeReplica = new int[m_iPWSize];
-
    m_LastArrTime = CTimer::getTime();
-
-   for (int i = 0; i < m_iAWSize; ++ i)
-      m_piPktWindow[i] = 1000000;
-
-   for (int k = 0; k < m_iPWSize; ++ k)
-      m_piProbeWindow[k] = 1000;
 }
 
 CPktTimeWindow::~CPktTimeWindow()
 {
-   delete [] m_piPktWindow;
-   delete [] m_piPktReplica;
-   delete [] m_piProbeWindow;
-   delete [] m_piProbeReplica;
 }
 
 int CPktTimeWindow::getMinPktSndInt() const
@@ -184,30 +363,11 @@ int CPktTimeWindow::getMinPktSndInt() const
    return m_iMinPktSndInt;
 }
 
-int CPktTimeWindow::getPktRcvSpeed() const
+int CPktTimeWindow::getPktRcvSpeed()
 {
-   // get median value, but cannot change the original value order in the window
-   std::copy(m_piPktWindow, m_piPktWindow + m_iAWSize - 1, m_piPktReplica);
-   std::nth_element(m_piPktReplica, m_piPktReplica + (m_iAWSize / 2), m_piPktReplica + m_iAWSize - 1);
-   int median = m_piPktReplica[m_iAWSize / 2];
-
-   int count = 0;
-   int sum = 0;
-   int upper = median << 3;
-   int lower = median >> 3;
-
-   // median filtering
-   int* p = m_piPktWindow;
-   for (int i = 0, n = m_iAWSize; i < n; ++ i)
-   {
-      // ޳ֵƫϴֵ
-      if ((*p < upper) && (*p > lower))
-      {
-         ++ count;
-         sum += *p;
-      }
-      ++ p;
-   }
+   // median filtering, ޳ֵƫϴֵ
+   int64_t sum;
+   int count = m_PktWindow.filter(sum);
 
    // claculate speed, or return 0 if not enough valid value
    // ʣλ pkts/s
@@ -217,32 +377,13 @@ int CPktTimeWindow::getPktRcvSpeed() const
       return 0;
 }
 
-int CPktTimeWindow::getBandwidth() const
+int CPktTimeWindow::getBandwidth()
 {
-   // m_piProbeWindow¼ǰ̽ʱ
-   // get median value, but cannot change the original value order in the window
-   std::copy(m_piProbeWindow, m_piProbeWindow + m_iPWSize - 1, m_piProbeReplica);
-
-   // ʹnԪشڵnλã0ʼ,λ±Ϊ nԪأԪСԪضԪ֮ǰԪشԪضԪ֮󣬵ܱ֤
-   std::nth_element(m_piProbeReplica, m_piProbeReplica + (m_iPWSize / 2), m_piProbeReplica + m_iPWSize - 1);
-   int median = m_piProbeReplica[m_iPWSize / 2];
-
-   int count = 1;
-   int sum = median;
-   int upper = median << 3;
-   int lower = median >> 3;
-
-   // median filtering
-   int* p = m_piProbeWindow;
-   for (int i = 0, n = m_iPWSize; i < n; ++ i)
-   {
-      if ((*p < upper) && (*p > lower))
-      {
-         ++ count;
-         sum += *p;
-      }
-      ++ p;
-   }
+   // m_ProbeWindow¼ǰ̽ʱ
+   // median filtering, the median itself is counted once more
+   int64_t sum;
+   int count = m_ProbeWindow.filter(sum) + 1;
+   sum += m_ProbeWindow.getMedian();
 
    // ʣλ pkts/s
    return (int)ceil(1000000.0 / (double(sum) / double(count)));
@@ -263,12 +404,7 @@ void CPktTimeWindow::onPktArrival()
    m_CurrArrTime = CTimer::getTime();
 
    // record the packet interval between the current and the last one
-   *(m_piPktWindow + m_iPktWindowPtr) = int(m_CurrArrTime - m_LastArrTime);
-
-   // the window is logically circular
-   ++ m_iPktWindowPtr;
-   if (m_iPktWindowPtr == m_iAWSize)
-      m_iPktWindowPtr = 0;
+   m_PktWindow.push(int(m_CurrArrTime - m_LastArrTime));
 
    // remember last packet arrival time
    m_LastArrTime = m_CurrArrTime;
@@ -283,11 +419,7 @@ void CPktTimeWindow::probe2Arrival()
 {
    m_CurrArrTime = CTimer::getTime();
 
-   // m_piProbeWindow¼ǰ̽ʱ
+   // m_ProbeWindow¼ǰ̽ʱ
    // record the probing packets interval
-   *(m_piProbeWindow + m_iProbeWindowPtr) = int(m_CurrArrTime - m_ProbeTime);
-   // the window is logically circular
-   ++ m_iProbeWindowPtr;
-   if (m_iProbeWindowPtr == m_iPWSize)
-      m_iProbeWindowPtr = 0;
+   m_ProbeWindow.push(int(m_CurrArrTime - m_ProbeTime));
 }
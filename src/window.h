@@ -66,12 +66,13 @@ public:
    void store(int32_t seq, int32_t ack);
 
       // Functionality:
-      //    Search the ACK-2 "seq" in the window, find out the DATA "ack" and caluclate RTT .
+      //    Look up the ACK-2 "seq" in the window, find out the DATA "ack" and caluclate RTT.
+      //    An ACK-2 that is not newer than the last one acknowledged is ignored.
       // Parameters:
       //    0) [in] seq: ACK-2 seq. no.
       //    1) [out] ack: the DATA ACK no. that matches the ACK-2 no.
       // Returned value:
-      //    RTT.
+      //    RTT, or -1 if the ACK record is overwritten, stale or already acknowledged.
 
    int acknowledge(int32_t seq, int32_t& ack);
 
@@ -80,9 +81,8 @@ private:
    int32_t* m_piACK;            // Data Seq. No. carried by the ACK packet
    uint64_t* m_pTimeStamp;      // The timestamp when the ACK was sent
 
-   int m_iSize;                 // Size of the ACK history window
-   int m_iHead;                 // Pointer to the lastest ACK record
-   int m_iTail;                 // Pointer to the oldest ACK record
+   int m_iSize;                 // Size of the ACK history window, records are indexed by ACK seq. no. modulo size
+   int32_t m_iLastAckSeqNo;     // The latest ACK seq. no. that has been acknowledged by an ACK-2, -1 if none
 
 private:
    CACKWindow(const CACKWindow&);
@@ -91,6 +91,73 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class CMedianWindow
+{
+public:
+   CMedianWindow(int size, int value);
+   ~CMedianWindow();
+
+      // Functionality:
+      //    Replace the oldest value in the window.
+      // Parameters:
+      //    0) [in] value: the new value.
+      // Returned value:
+      //    None.
+
+   void push(int value);
+
+      // Functionality:
+      //    Read the median of the values in the window.
+      // Parameters:
+      //    None.
+      // Returned value:
+      //    the median value.
+
+   int getMedian();
+
+      // Functionality:
+      //    Count and sum up the values within (median / 8, median * 8).
+      // Parameters:
+      //    0) [out] sum: sum of the values within the range.
+      // Returned value:
+      //    number of the values within the range.
+
+   int filter(int64_t& sum);
+
+private:
+   void update();
+   void rebuild();
+   void swap(int* heap, int i, int j);
+   void siftLower(int i);
+   void siftUpper(int i);
+
+private:
+   int* m_piWindow;             // values in arrival order, logically circular
+   int m_iSize;                 // size of the window
+   int m_iPtr;                  // position of the oldest value
+
+   // The values are split into two heaps of window positions: a max-heap of the smallest size / 2 values
+   // and a min-heap of the others, whose top is the median. m_piPos locates each window position in the heaps,
+   // as i for m_piUpper[i] and -i - 1 for m_piLower[i]. Arrivals only go into the window; the heaps catch up
+   // when the median is read, one O(log size) step per new value. After many arrivals a plain O(size) selection
+   // is cheaper, and the heaps are rebuilt at the next read that has only a few new values.
+
+   int* m_piHeapValue;          // values as ordered by the heaps
+   int* m_piLower;              // max-heap of the lower half
+   int* m_piUpper;              // min-heap of the upper half
+   int* m_piPos;                // heap location of each window position
+   int m_iLowerSize;            // number of values in the lower half
+   int m_iPending;              // number of values pushed since the median was updated
+   bool m_bHeapValid;           // if the heaps hold the values in the window
+   int m_iMedian;               // the median when m_iPending is 0
+
+private:
+   CMedianWindow(const CMedianWindow&);
+   CMedianWindow& operator=(const CMedianWindow&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class CPktTimeWindow
 {
 public:
@@ -113,7 +180,7 @@ public:
       // Returned value:
       //    Packet arrival speed (packets per second).
 
-   int getPktRcvSpeed() const;
+   int getPktRcvSpeed();
 
       // Functionality:
       //    Estimate the bandwidth.
@@ -122,7 +189,7 @@ public:
       // Returned value:
       //    Estimated bandwidth (packets per second).
 
-   int getBandwidth() const;
+   int getBandwidth();
 
       // Functionality:
       //    Record time information of a packet sending.
@@ -162,14 +229,10 @@ public:
 
 private:
    int m_iAWSize;               // size of the packet arrival history window
-   int* m_piPktWindow;          // packet information window
-   int* m_piPktReplica;
-   int m_iPktWindowPtr;         // position pointer of the packet info. window.
+   CMedianWindow m_PktWindow;   // packet arrival intervals
 
    int m_iPWSize;               // size of probe history window size
-   int* m_piProbeWindow;        // record inter-packet time for probing packet pairs
-   int* m_piProbeReplica;
-   int m_iProbeWindowPtr;       // position pointer to the probing window
+   CMedianWindow m_ProbeWindow; // record inter-packet time for probing packet pairs
 
    int m_iLastSentTime;         // last packet sending time
    int m_iMinPktSndInt;         // Minimum packet sending interval